@@ -19,14 +19,91 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 #include <obs-module.h>
 #include <obs-frontend-api.h>
 #include <plugin-support.h>
+#include <util/platform.h>
+#include <util/threading.h>
 #include "ws-relay.h"
 
 ws_relay_t *global_relay = NULL;
 
+// Relay setup runs on its own thread so it never holds up OBS startup
+static pthread_t init_thread;
+static bool init_thread_started = false;
+
+// Everything that touches global_relay on the UI thread waits for the init thread first
+static void wait_for_init(void)
+{
+    if (init_thread_started) {
+        pthread_join(init_thread, NULL);
+        init_thread_started = false;
+    }
+}
+
+static double elapsed_ms(uint64_t *since)
+{
+    uint64_t now = os_gettime_ns();
+    double ms = (double)(now - *since) / 1000000.0;
+    *since = now;
+    return ms;
+}
+
+static void *relay_init_thread(void *data)
+{
+    UNUSED_PARAMETER(data);
+    os_set_thread_name("ws-relay-init");
+
+    uint64_t start = os_gettime_ns();
+    uint64_t phase = start;
+
+    // Load configuration
+    ws_relay_config_t config;
+    ws_relay_config_init(&config);
+
+    if (!ws_relay_config_load(&config)) {
+        obs_log(LOG_WARNING, "Failed to load configuration, using defaults");
+    }
+    double load_ms = elapsed_ms(&phase);
+
+    // Save configuration if it was initialized with defaults; unchanged values are not written
+    ws_relay_config_save(&config);
+    double save_ms = elapsed_ms(&phase);
+
+    // Create the relay, which also initializes TLS
+    ws_relay_t *relay = ws_relay_create(&config);
+    double create_ms = elapsed_ms(&phase);
+    if (!relay) {
+        obs_log(LOG_ERROR, "Failed to create WebSocket relay");
+        ws_relay_config_free(&config);
+        return NULL;
+    }
+
+    // Start the relay if addresses are configured
+    if (config.remote_ws_address && strlen(config.remote_ws_address) > 0) {
+        if (ws_relay_start(relay)) {
+            obs_log(LOG_INFO, "WebSocket relay started successfully");
+        } else {
+            obs_log(LOG_ERROR, "Failed to start WebSocket relay");
+        }
+    } else {
+        obs_log(LOG_INFO, "Remote WebSocket address not configured - relay not started");
+        obs_log(LOG_INFO, "Please configure the remote address in OBS settings");
+    }
+    double start_ms = elapsed_ms(&phase);
+
+    obs_log(LOG_INFO, "Relay startup took %.1f ms (config load %.1f ms, save %.1f ms, create %.1f ms, start %.1f ms)",
+            (double)(phase - start) / 1000000.0, load_ms, save_ms, create_ms, start_ms);
+
+    // Published through pthread_join in wait_for_init; vendor requests get it right away
+    global_relay = relay;
+    ws_relay_set_vendor_relay(relay);
+    ws_relay_config_free(&config);
+    return NULL;
+}
+
 // Menu action for settings
 static void on_settings_menu_triggered(void *data)
 {
     UNUSED_PARAMETER(data);
+    wait_for_init();
     ws_relay_show_settings();
 }
 
@@ -46,6 +123,8 @@ static void on_obs_frontend_event(enum obs_frontend_event event, void *data)
         break;
     case OBS_FRONTEND_EVENT_EXIT:
         obs_log(LOG_INFO, "OBS exiting - stopping relay");
+        wait_for_init();
+        ws_relay_unregister_vendor();
         if (global_relay) {
             ws_relay_stop(global_relay);
         }
@@ -58,36 +137,13 @@ static void on_obs_frontend_event(enum obs_frontend_event event, void *data)
 bool obs_module_load(void)
 {
     obs_log(LOG_INFO, "OBS WebSocket Relay plugin loaded successfully (version %s)", PLUGIN_VERSION);
-    
-    // Load configuration
-    ws_relay_config_t config;
-    ws_relay_config_init(&config);
-    
-    if (!ws_relay_config_load(&config)) {
-        obs_log(LOG_WARNING, "Failed to load configuration, using defaults");
-    }
-
-    // Save configuration if it was initialized with defaults
-    ws_relay_config_save(&config);
 
-    // Create and start the relay
-    global_relay = ws_relay_create(&config);
-    if (!global_relay) {
-        obs_log(LOG_ERROR, "Failed to create WebSocket relay");
-        ws_relay_config_free(&config);
-        return false;
-    }
-
-    // Start the relay if addresses are configured
-    if (config.remote_ws_address && strlen(config.remote_ws_address) > 0) {
-        if (ws_relay_start(global_relay)) {
-            obs_log(LOG_INFO, "WebSocket relay started successfully");
-        } else {
-            obs_log(LOG_ERROR, "Failed to start WebSocket relay");
-        }
+    // Config persistence, relay creation and the first connect happen in the background
+    if (pthread_create(&init_thread, NULL, relay_init_thread, NULL) == 0) {
+        init_thread_started = true;
     } else {
-        obs_log(LOG_INFO, "Remote WebSocket address not configured - relay not started");
-        obs_log(LOG_INFO, "Please configure the remote address in OBS settings");
+        obs_log(LOG_WARNING, "Failed to create relay init thread, initializing in place");
+        relay_init_thread(NULL);
     }
     
     // Register frontend event callback
@@ -96,10 +152,16 @@ bool obs_module_load(void)
     // Add settings menu item to Tools menu
     obs_frontend_add_tools_menu_item("WebSocket Relay Settings", on_settings_menu_triggered, NULL);
 
-    ws_relay_config_free(&config);
     return true;
 }
 
+// obs-websocket is loaded by now, so the relay's vendor requests can be registered. The init
+// thread attaches the relay whenever it is ready, so startup does not wait for it here
+void obs_module_post_load(void)
+{
+    ws_relay_register_vendor();
+}
+
 void obs_module_unload(void)
 {
     obs_log(LOG_INFO, "Unloading WebSocket relay plugin");
@@ -109,6 +171,9 @@ void obs_module_unload(void)
 
     // Remove frontend event callback
     obs_frontend_remove_event_callback(on_obs_frontend_event, NULL);
+
+    wait_for_init();
+    ws_relay_unregister_vendor();
     
     // Stop and destroy the relay
     if (global_relay) {
@@ -0,0 +1,345 @@
+/*
+OBS WebSocket Relay - Request Admission Control
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "ws-relay-internal.h"
+#include <obs-module.h>
+#include <plugin-support.h>
+#include <util/platform.h>
+#include <libwebsockets.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <string>
+#include <utility>
+
+// obs-websocket op codes subject to admission
+#define WS_OP_REQUEST 6
+#define WS_OP_REQUEST_BATCH 8
+
+// obs-websocket's "server is not ready" request status, used for requests the relay turns away
+#define WS_REQUEST_STATUS_NOT_READY 207
+
+// Weight key for RequestBatch messages, which carry no request type of their own
+#define WS_ADMISSION_BATCH_TYPE "RequestBatch"
+
+// Characters separating the entries of the weight list
+#define WS_ADMISSION_SEPARATORS ", \t\r\n"
+
+// Request OBS is working on
+typedef struct {
+    std::string request_id;
+    int cost;
+    uint64_t admitted_at;
+} ws_admission_inflight_t;
+
+// Request waiting for the in-flight cost to drop
+typedef struct {
+    ws_message_t msg;
+    std::string request_id;
+    int cost;
+    uint64_t queued_at;
+} ws_admission_waiting_t;
+
+struct ws_admission {
+    ws_relay_timer_t timer; // Rejects queued requests once their deadline passes
+    std::vector<ws_admission_inflight_t> inflight;
+    int inflight_cost;
+    std::deque<ws_admission_waiting_t> queue;
+    size_t queue_bytes;
+
+    // Parsed weight list and the configured text it came from
+    std::string weights_source;
+    std::vector<std::pair<std::string, int>> weights;
+};
+
+ws_admission_t *ws_admission_create(ws_relay_t *relay) {
+    ws_admission_t *admission = new ws_admission_t();
+    admission->timer.relay = relay;
+    return admission;
+}
+
+// The timer must be cancelled first; ws_relay_stop does so by closing the OBS connection
+void ws_admission_destroy(ws_admission_t *admission) {
+    delete admission;
+}
+
+bool ws_admission_enabled(ws_relay_t *relay) {
+    return relay->config.admission_max_inflight > 0;
+}
+
+// Re-read "RequestType=weight" pairs when the configured list has changed
+static void ws_admission_parse_weights(ws_admission_t *admission, const char *list) {
+    if (!list) list = "";
+    if (admission->weights_source == list) return;
+
+    admission->weights_source = list;
+    admission->weights.clear();
+    for (const char *p = list; *p;) {
+        p += strspn(p, WS_ADMISSION_SEPARATORS);
+        if (!*p) break;
+        size_t len = strcspn(p, WS_ADMISSION_SEPARATORS);
+        std::string entry(p, len);
+        p += len;
+
+        size_t eq = entry.find('=');
+        if (eq == std::string::npos || eq == 0) {
+            obs_log(LOG_WARNING, "Ignoring request weight without a value: %s", entry.c_str());
+            continue;
+        }
+        int weight = atoi(entry.c_str() + eq + 1);
+        admission->weights.emplace_back(entry.substr(0, eq), weight < 0 ? 0 : weight);
+    }
+}
+
+static int ws_admission_cost(ws_relay_t *relay, const ws_json_fields_t &fields) {
+    ws_admission_t *admission = relay->admission;
+    ws_admission_parse_weights(admission, relay->config.admission_weights);
+
+    const char *type = WS_ADMISSION_BATCH_TYPE;
+    size_t type_len = strlen(WS_ADMISSION_BATCH_TYPE);
+    if (fields.op == WS_OP_REQUEST) {
+        type = fields.request_type ? fields.request_type : "";
+        type_len = fields.request_type ? fields.request_type_len : 0;
+    }
+
+    for (const auto &weight: admission->weights) {
+        if (weight.first.size() == type_len && memcmp(weight.first.data(), type, type_len) == 0) {
+            return weight.second;
+        }
+    }
+    return 1;
+}
+
+static bool ws_admission_fits(ws_relay_t *relay, int cost) {
+    ws_admission_t *admission = relay->admission;
+
+    // A request costlier than the whole limit still runs once nothing else is in flight
+    return admission->inflight_cost == 0 || admission->inflight_cost + cost <= relay->config.admission_max_inflight;
+}
+
+static void ws_admission_admit(ws_relay_t *relay, std::string request_id, int cost, uint64_t wait_us) {
+    ws_admission_t *admission = relay->admission;
+    admission->inflight.push_back({std::move(request_id), cost, os_gettime_ns()});
+    admission->inflight_cost += cost;
+
+    ws_relay_direction_stats_t *stats = &relay->stats.to_obs;
+    stats->admission_wait_last_us = wait_us;
+    stats->admission_wait_max_us = std::max(stats->admission_wait_max_us, wait_us);
+    int bucket = 0;
+    for (uint64_t limit = 1000; bucket < WS_RTT_HISTOGRAM_BUCKETS - 1 && wait_us >= limit; limit *= 2) {
+        bucket++;
+    }
+    stats->admission_wait_histogram[bucket]++;
+}
+
+// Answer a request in OBS's place with a NotReady status. Batches get an empty result list, since
+// a RequestBatchResponse has no status of its own
+static void ws_admission_reject(ws_relay_t *relay, const char *data, size_t len, const char *reason) {
+    relay->stats.to_obs.admission_rejected++;
+
+    ws_json_fields_t fields;
+    if (!ws_json_scan(data, len, &fields) || !fields.request_id) return;
+
+    std::string request_id(fields.request_id, fields.request_id_len);
+    if (relay->config.enable_logging) {
+        obs_log(LOG_INFO, "Rejecting request %s: %s", request_id.c_str(), reason);
+    }
+
+    // Type and id are copied verbatim, so they keep whatever escaping the remote used
+    std::string response;
+    if (fields.op == WS_OP_REQUEST_BATCH) {
+        response = "{\"op\":9,\"d\":{\"requestId\":\"" + request_id + "\",\"results\":[]}}";
+    } else {
+        std::string request_type(fields.request_type ? fields.request_type : "", fields.request_type_len);
+        response = "{\"op\":7,\"d\":{\"requestType\":\"" + request_type + "\",\"requestId\":\"" + request_id +
+                   "\",\"requestStatus\":{\"result\":false,\"code\":" +
+                   std::to_string(WS_REQUEST_STATUS_NOT_READY) + ",\"comment\":\"" + reason + "\"}}}";
+    }
+
+    if (relay->config.auth_offload && !relay->auth.remote_identified) return;
+    ws_connection_send(&relay->remote_conn, response.data(), response.size());
+}
+
+static void ws_admission_timer_cb(lws_sorted_usec_list_t *sul);
+
+// Arm the timer for the deadline of the oldest queued request
+static void ws_admission_schedule(ws_relay_t *relay) {
+    ws_admission_t *admission = relay->admission;
+    if (admission->queue.empty() || relay->config.admission_queue_ms <= 0) {
+        lws_sul_cancel(&admission->timer.sul);
+        return;
+    }
+
+    uint64_t deadline = admission->queue.front().queued_at + (uint64_t) relay->config.admission_queue_ms * 1000000;
+    uint64_t now = os_gettime_ns();
+    lws_usec_t wait = deadline > now ? (lws_usec_t) ((deadline - now) / 1000) + 1 : 1;
+    lws_sul_schedule(relay->context, 0, &admission->timer.sul, ws_admission_timer_cb, wait);
+}
+
+// Hand queued requests to OBS while they fit, oldest first
+static void ws_admission_release(ws_relay_t *relay) {
+    ws_admission_t *admission = relay->admission;
+    bool enabled = ws_admission_enabled(relay);
+
+    while (!admission->queue.empty()) {
+        ws_admission_waiting_t &front = admission->queue.front();
+        if (enabled && !ws_admission_fits(relay, front.cost)) break;
+
+        if (enabled) {
+            ws_admission_admit(relay, std::move(front.request_id), front.cost,
+                               (os_gettime_ns() - front.queued_at) / 1000);
+        }
+        ws_message_t msg = std::move(front.msg);
+        admission->queue_bytes -= msg.data.size() - WS_MSG_PRE;
+        admission->queue.pop_front();
+        ws_relay_deliver_to_obs(relay, msg);
+    }
+
+    ws_admission_schedule(relay);
+}
+
+static void ws_admission_timer_cb(lws_sorted_usec_list_t *sul) {
+    ws_relay_t *relay = ((ws_relay_timer_t *) sul)->relay;
+
+    pthread_mutex_lock(&relay->mutex);
+    ws_admission_t *admission = relay->admission;
+    uint64_t timeout = (uint64_t) relay->config.admission_queue_ms * 1000000;
+    uint64_t now = os_gettime_ns();
+    while (!admission->queue.empty() && now - admission->queue.front().queued_at >= timeout) {
+        ws_admission_waiting_t &front = admission->queue.front();
+        ws_admission_reject(relay, front.msg.data.data() + WS_MSG_PRE, front.msg.data.size() - WS_MSG_PRE,
+                            "OBS is busy, the request timed out waiting in the relay");
+        admission->queue_bytes -= front.msg.data.size() - WS_MSG_PRE;
+        admission->queue.pop_front();
+    }
+    ws_admission_schedule(relay);
+    // Rejected requests no longer hold multiplexing window
+    ws_mux_update_window(relay);
+    pthread_mutex_unlock(&relay->mutex);
+}
+
+// Decide on a complete message from the remote on its way to OBS. Returns true if it may be
+// forwarded now; otherwise it was queued or answered with an error. Called with the mutex held
+bool ws_admission_offer(ws_relay_t *relay, ws_message_t &msg) {
+    ws_admission_t *admission = relay->admission;
+    const char *data = msg.data.data() + WS_MSG_PRE;
+    size_t size = msg.data.size() - WS_MSG_PRE;
+
+    // Session messages and requests that could not be matched to a response pass straight through
+    ws_json_fields_t fields;
+    if (!ws_json_scan(data, size, &fields) || (fields.op != WS_OP_REQUEST && fields.op != WS_OP_REQUEST_BATCH) ||
+        !fields.request_id) {
+        return true;
+    }
+
+    int cost = ws_admission_cost(relay, fields);
+    if (cost <= 0) return true;
+
+    std::string request_id(fields.request_id, fields.request_id_len);
+    if (admission->queue.empty() && ws_admission_fits(relay, cost)) {
+        ws_admission_admit(relay, std::move(request_id), cost, 0);
+        return true;
+    }
+
+    if (relay->config.admission_queue_ms <= 0 || admission->queue.size() >= WS_ADMISSION_QUEUE_MAX) {
+        ws_admission_reject(relay, data, size, "OBS is busy, too many requests in flight");
+        return false;
+    }
+
+    relay->stats.to_obs.admission_queued++;
+    admission->queue_bytes += size;
+    admission->queue.push_back({std::move(msg), std::move(request_id), cost, os_gettime_ns()});
+    if (admission->queue.size() == 1) ws_admission_schedule(relay);
+    return false;
+}
+
+// Match a message from OBS against the requests in flight. The first fragment is enough, since
+// obs-websocket writes d.requestId ahead of the response data; a scan cut short by the end of the
+// fragment still reports the fields before the cut. Called with the mutex held
+void ws_admission_observe(ws_relay_t *relay, const char *data, size_t len) {
+    ws_admission_t *admission = relay->admission;
+    if (admission->inflight.empty()) return;
+
+    ws_json_fields_t fields;
+    ws_json_scan(data, len, &fields);
+    if (!fields.request_id || fields.event_type) return;
+
+    for (auto it = admission->inflight.begin(); it != admission->inflight.end(); ++it) {
+        if (it->request_id.size() == fields.request_id_len &&
+            memcmp(it->request_id.data(), fields.request_id, fields.request_id_len) == 0) {
+            admission->inflight_cost -= it->cost;
+            admission->inflight.erase(it);
+            ws_admission_release(relay);
+            return;
+        }
+    }
+}
+
+// Once-a-second upkeep: forget requests OBS never answered, and let the queue go if admission
+// control was switched off. Called with the mutex held
+void ws_admission_maintain(ws_relay_t *relay) {
+    ws_admission_t *admission = relay->admission;
+    uint64_t now = os_gettime_ns();
+
+    for (auto it = admission->inflight.begin(); it != admission->inflight.end();) {
+        if (now - it->admitted_at < WS_ADMISSION_STALE_NS) {
+            ++it;
+            continue;
+        }
+        obs_log(LOG_WARNING, "No response from OBS to request %s, no longer counting it as in flight",
+                it->request_id.c_str());
+        admission->inflight_cost -= it->cost;
+        it = admission->inflight.erase(it);
+    }
+
+    if (!admission->queue.empty()) ws_admission_release(relay);
+}
+
+// A connection went away. Without OBS nothing in flight will be answered and queued requests are
+// turned away; without the remote, queued requests have nobody to answer to. Called with the
+// mutex held
+void ws_admission_reset(ws_relay_t *relay, bool obs_lost) {
+    ws_admission_t *admission = relay->admission;
+
+    if (obs_lost) {
+        admission->inflight.clear();
+        admission->inflight_cost = 0;
+    }
+
+    for (ws_admission_waiting_t &waiting: admission->queue) {
+        if (obs_lost) {
+            ws_admission_reject(relay, waiting.msg.data.data() + WS_MSG_PRE, waiting.msg.data.size() - WS_MSG_PRE,
+                                "The relay lost its connection to OBS");
+        } else {
+            relay->stats.to_obs.dropped_messages++;
+            relay->stats.to_obs.dropped_bytes += waiting.msg.data.size() - WS_MSG_PRE;
+        }
+    }
+    admission->queue.clear();
+    admission->queue_bytes = 0;
+    lws_sul_cancel(&admission->timer.sul);
+}
+
+// Bytes of queued requests, which keep their multiplexing window until they reach OBS
+size_t ws_admission_pending_bytes(ws_relay_t *relay) {
+    return relay->admission->queue_bytes;
+}
+
+void ws_admission_get_stats(ws_relay_t *relay, ws_relay_direction_stats_t *stats) {
+    stats->admission_inflight_cost = (uint64_t) relay->admission->inflight_cost;
+    stats->admission_waiting = relay->admission->queue.size();
+}
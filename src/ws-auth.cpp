@@ -0,0 +1,434 @@
+/*
+OBS WebSocket Relay - Authentication Offload
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "ws-relay-internal.h"
+#include <obs-module.h>
+#include <plugin-support.h>
+#include <libwebsockets.h>
+#include <string>
+
+// obs-websocket op codes used by the handshake
+#define WS_OP_HELLO 0
+#define WS_OP_IDENTIFY 1
+#define WS_OP_IDENTIFIED 2
+#define WS_OP_REIDENTIFY 3
+
+#define WS_RPC_VERSION 1
+
+// EventSubscription::All, what obs-websocket assumes when a client does not say
+#define WS_EVENT_SUBSCRIPTIONS_ALL 0x7FF
+
+// obs-websocket close codes
+#define WS_CLOSE_UNSUPPORTED_RPC_VERSION 4010
+#define WS_CLOSE_AUTHENTICATION_FAILED 4009
+
+// SHA-256 (FIPS 180-4)
+struct sha256_ctx {
+    uint32_t state[8];
+    uint64_t length;
+    unsigned char block[64];
+    size_t used;
+};
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static inline uint32_t rotr(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+static void sha256_transform(sha256_ctx *ctx, const unsigned char *block) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t) block[i * 4] << 24 | (uint32_t) block[i * 4 + 1] << 16 |
+               (uint32_t) block[i * 4 + 2] << 8 | (uint32_t) block[i * 4 + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = ctx->state[0], b = ctx->state[1], c = ctx->state[2], d = ctx->state[3];
+    uint32_t e = ctx->state[4], f = ctx->state[5], g = ctx->state[6], h = ctx->state[7];
+
+    for (int i = 0; i < 64; i++) {
+        uint32_t s1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+        uint32_t ch = (e & f) ^ (~e & g);
+        uint32_t t1 = h + s1 + ch + sha256_k[i] + w[i];
+        uint32_t s0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+        uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t t2 = s0 + maj;
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    ctx->state[0] += a;
+    ctx->state[1] += b;
+    ctx->state[2] += c;
+    ctx->state[3] += d;
+    ctx->state[4] += e;
+    ctx->state[5] += f;
+    ctx->state[6] += g;
+    ctx->state[7] += h;
+}
+
+static void sha256_init(sha256_ctx *ctx) {
+    static const uint32_t initial[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    memcpy(ctx->state, initial, sizeof(initial));
+    ctx->length = 0;
+    ctx->used = 0;
+}
+
+static void sha256_update(sha256_ctx *ctx, const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *) data;
+    ctx->length += len;
+
+    while (len > 0) {
+        size_t n = 64 - ctx->used < len ? 64 - ctx->used : len;
+        memcpy(ctx->block + ctx->used, p, n);
+        ctx->used += n;
+        p += n;
+        len -= n;
+
+        if (ctx->used == 64) {
+            sha256_transform(ctx, ctx->block);
+            ctx->used = 0;
+        }
+    }
+}
+
+static void sha256_final(sha256_ctx *ctx, unsigned char digest[32]) {
+    uint64_t bits = ctx->length * 8;
+
+    unsigned char pad = 0x80;
+    sha256_update(ctx, &pad, 1);
+    pad = 0;
+    while (ctx->used != 56) sha256_update(ctx, &pad, 1);
+
+    unsigned char length[8];
+    for (int i = 0; i < 8; i++) length[i] = (unsigned char) (bits >> (56 - i * 8));
+    sha256_update(ctx, length, 8);
+
+    for (int i = 0; i < 8; i++) {
+        digest[i * 4] = (unsigned char) (ctx->state[i] >> 24);
+        digest[i * 4 + 1] = (unsigned char) (ctx->state[i] >> 16);
+        digest[i * 4 + 2] = (unsigned char) (ctx->state[i] >> 8);
+        digest[i * 4 + 3] = (unsigned char) ctx->state[i];
+    }
+}
+
+// base64(sha256(a + b))
+std::string ws_auth_sha256_base64(const std::string &a, const std::string &b) {
+    sha256_ctx ctx;
+    unsigned char digest[32];
+    sha256_init(&ctx);
+    sha256_update(&ctx, a.data(), a.size());
+    sha256_update(&ctx, b.data(), b.size());
+    sha256_final(&ctx, digest);
+
+    char encoded[64];
+    int n = lws_b64_encode_string((const char *) digest, sizeof(digest), encoded, sizeof(encoded));
+    return n > 0 ? std::string(encoded, n) : std::string();
+}
+
+// obs-websocket authentication string for a secret, salt and challenge
+std::string ws_auth_compute(const char *secret, const char *salt, const char *challenge) {
+    std::string secret_hash = ws_auth_sha256_base64(secret ? secret : "", salt ? salt : "");
+    return ws_auth_sha256_base64(secret_hash, challenge ? challenge : "");
+}
+
+// Fill out with 32 random bytes, base64 encoded
+static void random_base64(ws_relay_t *relay, char out[WS_AUTH_NONCE_SIZE]) {
+    unsigned char buf[32];
+    lws_get_random(relay->context, buf, sizeof(buf));
+    if (lws_b64_encode_string((const char *) buf, sizeof(buf), out, WS_AUTH_NONCE_SIZE) < 0) {
+        out[0] = '\0';
+    }
+}
+
+static bool secure_equals(const std::string &a, const char *b) {
+    if (!b) return false;
+
+    size_t len = strlen(b);
+    if (a.size() != len) return false;
+
+    unsigned char diff = 0;
+    for (size_t i = 0; i < len; i++) diff |= (unsigned char) (a[i] ^ b[i]);
+    return diff == 0;
+}
+
+static void send_json(ws_connection_t *conn, obs_data_t *data) {
+    const char *json = obs_data_get_json(data);
+    ws_connection_send(conn, json, strlen(json));
+}
+
+static void send_op(ws_connection_t *conn, int op, obs_data_t *d) {
+    obs_data_t *msg = obs_data_create();
+    obs_data_set_int(msg, "op", op);
+    obs_data_set_obj(msg, "d", d);
+    send_json(conn, msg);
+    obs_data_release(msg);
+}
+
+// Present the relay's own Hello to the remote, modelled on the one OBS sent us
+static void send_remote_hello(ws_relay_t *relay) {
+    ws_auth_state_t *auth = &relay->auth;
+    obs_data_t *hello = obs_data_create_from_json(auth->obs_hello);
+    if (!hello) return;
+
+    obs_data_t *d = obs_data_get_obj(hello, "d");
+    if (d) {
+        obs_data_erase(d, "authentication");
+        if (relay->config.relay_token && strlen(relay->config.relay_token) > 0) {
+            random_base64(relay, auth->remote_salt);
+            random_base64(relay, auth->remote_challenge);
+
+            obs_data_t *authentication = obs_data_create();
+            obs_data_set_string(authentication, "challenge", auth->remote_challenge);
+            obs_data_set_string(authentication, "salt", auth->remote_salt);
+            obs_data_set_obj(d, "authentication", authentication);
+            obs_data_release(authentication);
+        }
+        obs_data_release(d);
+    }
+
+    send_json(&relay->remote_conn, hello);
+    obs_data_release(hello);
+
+    auth->remote_hello_sent = true;
+    if (relay->config.enable_logging) {
+        obs_log(LOG_INFO, "Sent relay Hello to remote");
+    }
+}
+
+void ws_auth_on_remote_connected(ws_relay_t *relay) {
+    ws_auth_state_t *auth = &relay->auth;
+    auth->remote_identified = false;
+    auth->remote_hello_sent = false;
+
+    // Without an OBS Hello to model ours on, wait until OBS has greeted us
+    if (auth->obs_hello) {
+        send_remote_hello(relay);
+    }
+}
+
+void ws_auth_on_remote_disconnected(ws_relay_t *relay) {
+    relay->auth.remote_identified = false;
+    relay->auth.remote_hello_sent = false;
+}
+
+void ws_auth_on_obs_disconnected(ws_relay_t *relay) {
+    // An in-process session does not depend on the OBS connection
+    if (ws_obs_api_active(relay)) return;
+
+    relay->auth.obs_identified = false;
+    relay->auth.obs_reidentify_pending = false;
+}
+
+static bool handle_obs_hello(ws_relay_t *relay, obs_data_t *d, const char *data, size_t len) {
+    ws_auth_state_t *auth = &relay->auth;
+    bfree(auth->obs_hello);
+    auth->obs_hello = bstrdup_n(data, len);
+
+    obs_data_t *identify = obs_data_create();
+    obs_data_set_int(identify, "rpcVersion", WS_RPC_VERSION);
+    obs_data_set_int(identify, "eventSubscriptions", auth->event_subscriptions);
+
+    obs_data_t *authentication = obs_data_get_obj(d, "authentication");
+    if (authentication) {
+        if (!relay->config.obs_password || strlen(relay->config.obs_password) == 0) {
+            obs_log(LOG_ERROR, "OBS WebSocket requires a password but none is configured for the relay");
+        }
+        std::string response = ws_auth_compute(relay->config.obs_password,
+                                               obs_data_get_string(authentication, "salt"),
+                                               obs_data_get_string(authentication, "challenge"));
+        obs_data_set_string(identify, "authentication", response.c_str());
+        obs_data_release(authentication);
+    }
+
+    send_op(&relay->obs_conn, WS_OP_IDENTIFY, identify);
+    obs_data_release(identify);
+
+    if (relay->config.enable_logging) {
+        obs_log(LOG_INFO, "Identifying with OBS WebSocket on behalf of the remote");
+    }
+
+    // A remote that connected before OBS greeted us is still waiting for its Hello
+    if (relay->remote_conn.state == WS_STATE_CONNECTED && !auth->remote_hello_sent) {
+        send_remote_hello(relay);
+    }
+    return true;
+}
+
+bool ws_auth_handle_obs_message(ws_relay_t *relay, const char *data, size_t len) {
+    ws_json_fields_t fields;
+    if (!ws_json_scan(data, len, &fields)) return false;
+    if (fields.op != WS_OP_HELLO && fields.op != WS_OP_IDENTIFIED) return false;
+
+    if (fields.op == WS_OP_IDENTIFIED) {
+        ws_auth_state_t *auth = &relay->auth;
+        if (!auth->obs_identified) {
+            obs_log(LOG_INFO, "Relay identified with OBS WebSocket");
+        }
+        auth->obs_identified = true;
+        auth->obs_reidentify_pending = false;
+        return true;
+    }
+
+    obs_data_t *msg = obs_data_create_from_json(std::string(data, len).c_str());
+    if (!msg) return false;
+    obs_data_t *d = obs_data_get_obj(msg, "d");
+    bool consumed = d && handle_obs_hello(relay, d, data, len);
+    obs_data_release(d);
+    obs_data_release(msg);
+    return consumed;
+}
+
+// Apply the event subscriptions the remote asked for to the relay's OBS session
+static void update_subscriptions(ws_relay_t *relay, obs_data_t *d) {
+    ws_auth_state_t *auth = &relay->auth;
+    int64_t subscriptions = obs_data_has_user_value(d, "eventSubscriptions")
+                                ? obs_data_get_int(d, "eventSubscriptions")
+                                : WS_EVENT_SUBSCRIPTIONS_ALL;
+    if (subscriptions == auth->event_subscriptions) return;
+
+    auth->event_subscriptions = subscriptions;
+    // In-process events are filtered as they are delivered
+    if (!auth->obs_identified || ws_obs_api_active(relay)) return;
+
+    ws_mirror_on_subscriptions(relay, subscriptions);
+
+    obs_data_t *reidentify = obs_data_create();
+    obs_data_set_int(reidentify, "eventSubscriptions", subscriptions);
+    send_op(&relay->obs_conn, WS_OP_REIDENTIFY, reidentify);
+    obs_data_release(reidentify);
+    auth->obs_reidentify_pending = true;
+}
+
+ws_auth_result_t ws_auth_handle_remote_message(ws_relay_t *relay, const char *data, size_t len) {
+    ws_auth_state_t *auth = &relay->auth;
+
+    ws_json_fields_t fields;
+    if (!ws_json_scan(data, len, &fields)) {
+        return auth->remote_identified ? WS_AUTH_FORWARD : WS_AUTH_CONSUMED;
+    }
+
+    if (fields.op != WS_OP_IDENTIFY && fields.op != WS_OP_REIDENTIFY) {
+        // obs-websocket ignores everything before Identify as well
+        return auth->remote_identified ? WS_AUTH_FORWARD : WS_AUTH_CONSUMED;
+    }
+    if ((fields.op == WS_OP_IDENTIFY) == auth->remote_identified) return WS_AUTH_CONSUMED;
+
+    obs_data_t *msg = obs_data_create_from_json(std::string(data, len).c_str());
+    if (!msg) return WS_AUTH_CONSUMED;
+    obs_data_t *d = obs_data_get_obj(msg, "d");
+    if (!d) {
+        obs_data_release(msg);
+        return WS_AUTH_CONSUMED;
+    }
+
+    ws_auth_result_t result = WS_AUTH_CONSUMED;
+    if (fields.op == WS_OP_IDENTIFY) {
+        bool has_token = relay->config.relay_token && strlen(relay->config.relay_token) > 0;
+        if (obs_data_get_int(d, "rpcVersion") != WS_RPC_VERSION) {
+            obs_log(LOG_WARNING, "Remote requested an unsupported RPC version");
+            result = WS_AUTH_REJECT_RPC_VERSION;
+        } else if (has_token &&
+                   !secure_equals(ws_auth_compute(relay->config.relay_token, auth->remote_salt,
+                                                  auth->remote_challenge),
+                                  obs_data_get_string(d, "authentication"))) {
+            obs_log(LOG_WARNING, "Remote failed relay authentication");
+            result = WS_AUTH_REJECT_AUTHENTICATION;
+        }
+    }
+
+    if (result == WS_AUTH_CONSUMED) {
+        update_subscriptions(relay, d);
+
+        obs_data_t *identified = obs_data_create();
+        obs_data_set_int(identified, "negotiatedRpcVersion", WS_RPC_VERSION);
+        send_op(&relay->remote_conn, WS_OP_IDENTIFIED, identified);
+        obs_data_release(identified);
+
+        if (!auth->remote_identified) {
+            obs_log(LOG_INFO, "Remote identified with the relay");
+        }
+        auth->remote_identified = true;
+    }
+
+    obs_data_release(d);
+    obs_data_release(msg);
+    return result;
+}
+
+// The relay's OBS session runs in-process, so no Hello comes from OBS. Make one up for the remote
+// to model the relay's Hello on. Called with the mutex held
+void ws_auth_on_obs_api_ready(ws_relay_t *relay, const char *version) {
+    ws_auth_state_t *auth = &relay->auth;
+
+    obs_data_t *d = obs_data_create();
+    obs_data_set_string(d, "obsWebSocketVersion", version);
+    obs_data_set_int(d, "rpcVersion", WS_RPC_VERSION);
+    obs_data_t *hello = obs_data_create();
+    obs_data_set_int(hello, "op", WS_OP_HELLO);
+    obs_data_set_obj(hello, "d", d);
+
+    bfree(auth->obs_hello);
+    auth->obs_hello = bstrdup(obs_data_get_json(hello));
+    obs_data_release(hello);
+    obs_data_release(d);
+
+    auth->obs_identified = true;
+    auth->obs_reidentify_pending = false;
+
+    // A remote that connected before the session was ready is still waiting for its Hello
+    if (relay->remote_conn.state == WS_STATE_CONNECTED && !auth->remote_hello_sent) {
+        send_remote_hello(relay);
+    }
+}
+
+int ws_auth_close_code(ws_auth_result_t result) {
+    return result == WS_AUTH_REJECT_RPC_VERSION ? WS_CLOSE_UNSUPPORTED_RPC_VERSION
+                                                : WS_CLOSE_AUTHENTICATION_FAILED;
+}
+
+void ws_auth_init(ws_auth_state_t *auth) {
+    memset(auth, 0, sizeof(*auth));
+    auth->event_subscriptions = WS_EVENT_SUBSCRIPTIONS_ALL;
+}
+
+void ws_auth_free(ws_auth_state_t *auth) {
+    bfree(auth->obs_hello);
+    memset(auth, 0, sizeof(*auth));
+}
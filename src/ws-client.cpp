@@ -23,25 +23,145 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 #include <util/threading.h>
 #include <util/dstr.h>
 #include <libwebsockets.h>
+#include <new>
+#include <algorithm>
+#include <ctype.h>
 
-// LWS protocols
+#if !defined(LWS_WITH_SYS_ASYNC_DNS)
+#ifdef _WIN32
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#endif
+#endif
+
+// LWS protocols. The first two carry the WebSocket subprotocol names; the others are receive
+// buffer tiers of the same handlers that ws_connect binds connections to locally
 const struct lws_protocols protocols[] = {
     {
         "obs-websocket",
         ws_callback_obs,
         0,
-        4096,
+        WS_RX_BUFFER_MIN,
     },
     {
         "websocket",
         ws_callback_remote,
         0,
-        4096,
+        WS_RX_BUFFER_MIN,
     },
+    {"obs-websocket-16k", ws_callback_obs, 0, 16 * 1024},
+    {"websocket-16k", ws_callback_remote, 0, 16 * 1024},
+    {"obs-websocket-64k", ws_callback_obs, 0, 64 * 1024},
+    {"websocket-64k", ws_callback_remote, 0, 64 * 1024},
+    {"obs-websocket-256k", ws_callback_obs, 0, 256 * 1024},
+    {"websocket-256k", ws_callback_remote, 0, 256 * 1024},
+    {"obs-websocket-1m", ws_callback_obs, 0, 1024 * 1024},
+    {"websocket-1m", ws_callback_remote, 0, 1024 * 1024},
     {NULL, NULL, 0, 0} /* terminator */
 };
 
-// Parse WebSocket URL
+// Pick the receive buffer tier for a new connection: the smallest that holds the recent messages
+// of its direction whole, or the largest within the configured cap
+static const struct lws_protocols *ws_rx_protocol(ws_connection_t *conn) {
+    ws_relay_t *relay = conn->relay;
+    lws_callback_function *callback = conn->is_remote ? ws_callback_remote : ws_callback_obs;
+    // The standby connection takes over the remote's traffic, so it sizes for it as well
+    size_t peak = conn->is_remote ? relay->remote_conn.rx_peak : conn->rx_peak;
+    size_t cap = std::max((size_t) relay->config.rx_buffer_max_kb * 1024, (size_t) WS_RX_BUFFER_MIN);
+
+    const struct lws_protocols *best = NULL;
+    for (const struct lws_protocols *p = protocols; p->name; p++) {
+        if (p->callback != callback || p->rx_buffer_size > cap) continue;
+        if (!best || (best->rx_buffer_size < peak && p->rx_buffer_size > best->rx_buffer_size) ||
+            (p->rx_buffer_size >= peak && p->rx_buffer_size < best->rx_buffer_size)) {
+            best = p;
+        }
+    }
+
+    return best;
+}
+
+// Account one receive callback towards the message it belongs to, and the message towards the
+// size and callback histograms once it is complete. Called with the mutex held
+static void ws_rx_account(ws_connection_t *conn, struct lws *wsi, size_t len) {
+    if (lws_is_first_fragment(wsi)) {
+        conn->rx_bytes = 0;
+        conn->rx_callbacks = 0;
+    }
+    conn->rx_bytes += len;
+    conn->rx_callbacks++;
+    if (!lws_is_final_fragment(wsi)) return;
+
+    ws_relay_direction_stats_t *stats = ws_connection_rx_stats(conn);
+
+    int bucket = 0;
+    for (size_t limit = 1024; bucket < WS_SIZE_HISTOGRAM_BUCKETS - 1 && conn->rx_bytes >= limit; limit *= 2) {
+        bucket++;
+    }
+    stats->size_histogram[bucket]++;
+
+    bucket = 0;
+    for (uint32_t limit = 2; bucket < WS_CALLBACK_HISTOGRAM_BUCKETS - 1 && conn->rx_callbacks >= limit; limit *= 2) {
+        bucket++;
+    }
+    stats->callback_histogram[bucket]++;
+
+    conn->rx_peak = std::max(conn->rx_bytes, conn->rx_peak - conn->rx_peak / WS_RX_PEAK_DECAY);
+}
+
+// Parse a ws+unix://<socket path>[:<request path>] URL. The host is returned in the lws form
+// for Unix domain sockets, the socket path prefixed with '+'
+static bool parse_ws_unix_url(const char *url, char **host, uint16_t *port, char **path) {
+#if defined(LWS_WITH_UNIX_SOCK)
+    // The request path follows the first colon; on Windows a drive letter is part of the socket
+    const char *search = url;
+#if defined(_WIN32)
+    if (isalpha((unsigned char) url[0]) && url[1] == ':') search = url + 2;
+#endif
+    const char *colon = strchr(search, ':');
+    const char *socket_end = colon ? colon : url + strlen(url);
+
+    if (socket_end == url) {
+        obs_log(LOG_ERROR, "WebSocket URL has no socket path");
+        return false;
+    }
+
+    const char *rest = colon ? colon + 1 : socket_end;
+    if (*rest != '\0' && *rest != '/' && *rest != '?') {
+        obs_log(LOG_ERROR, "Request path in WebSocket URL must start with '/'");
+        return false;
+    }
+
+    struct dstr socket_host;
+    dstr_init_copy(&socket_host, "+");
+    dstr_ncat(&socket_host, url, socket_end - url);
+    *host = socket_host.array;
+    *port = 0;
+
+    if (*rest == '?') {
+        struct dstr query;
+        dstr_init_copy(&query, "/");
+        dstr_cat(&query, rest);
+        *path = query.array;
+    } else {
+        *path = bstrdup(*rest ? rest : "/");
+    }
+
+    return true;
+#else
+    UNUSED_PARAMETER(url);
+    UNUSED_PARAMETER(host);
+    UNUSED_PARAMETER(port);
+    UNUSED_PARAMETER(path);
+    obs_log(LOG_ERROR, "libwebsockets was built without Unix domain socket support");
+    return false;
+#endif
+}
+
+// Parse WebSocket URL. Host and port must be well formed; nothing is returned on failure
 bool parse_ws_url(const char *url, char **host, uint16_t *port, char **path, bool *use_ssl) {
     if (!url || !host || !port || !path || !use_ssl) return false;
 
@@ -51,7 +171,9 @@ bool parse_ws_url(const char *url, char **host, uint16_t *port, char **path, boo
     *use_ssl = false;
 
     // Check protocol
-    if (strncmp(url, "wss://", 6) == 0) {
+    if (strncmp(url, "ws+unix://", 10) == 0) {
+        return parse_ws_unix_url(url + 10, host, port, path);
+    } else if (strncmp(url, "wss://", 6) == 0) {
         *use_ssl = true;
         *port = 443;
         url += 6;
@@ -64,36 +186,68 @@ bool parse_ws_url(const char *url, char **host, uint16_t *port, char **path, boo
         return false;
     }
 
-    // Parse host and port
-    const char *colon = strchr(url, ':');
-    const char *slash = strchr(url, '/');
+    // Parse host; IPv6 literals are enclosed in brackets
+    const char *host_start = url;
+    const char *host_end;
+    const char *rest;
+    if (*url == '[') {
+        host_start = url + 1;
+        host_end = strchr(host_start, ']');
+        if (!host_end) {
+            obs_log(LOG_ERROR, "Unterminated IPv6 address in WebSocket URL");
+            return false;
+        }
+        rest = host_end + 1;
+    } else {
+        host_end = url + strcspn(url, ":/?");
+        rest = host_end;
+    }
+
+    if (host_end == host_start) {
+        obs_log(LOG_ERROR, "WebSocket URL has no host");
+        return false;
+    }
 
-    if (colon && (!slash || colon < slash)) {
-        // Port specified
-        size_t host_len = colon - url;
-        *host = (char*) bzalloc(host_len + 1);
-        strncpy(*host, url, host_len);
+    // lws reads a host starting with '+' as a Unix domain socket path; spaces and control
+    // characters would only fail later, in the name lookup
+    bool host_valid = *host_start != '+';
+    for (const char *c = host_start; host_valid && c < host_end; c++) {
+        host_valid = (unsigned char) *c > ' ' && *c != 0x7f;
+    }
+    if (!host_valid) {
+        obs_log(LOG_ERROR, "Invalid host in WebSocket URL");
+        return false;
+    }
 
-        char *endptr;
-        long port_val = strtol(colon + 1, &endptr, 10);
-        if (port_val > 0 && port_val <= 65535 && (endptr == slash || *endptr == '\0')) {
-            *port = (uint16_t) port_val;
+    // Parse port, which must be all digits and in range
+    if (*rest == ':') {
+        const char *digits = rest + 1;
+        size_t count = strspn(digits, "0123456789");
+        long port_val = count > 0 && count <= 5 ? strtol(digits, NULL, 10) : 0;
+        if (port_val <= 0 || port_val > 65535) {
+            obs_log(LOG_ERROR, "Invalid port in WebSocket URL");
+            return false;
         }
+        *port = (uint16_t) port_val;
+        rest = digits + count;
+    }
 
-        if (slash) {
-            *path = bstrdup(slash);
-        } else {
-            *path = bstrdup("/");
-        }
-    } else if (slash) {
-        // No port, path specified
-        size_t host_len = slash - url;
-        *host = (char *)bzalloc(host_len + 1);
-        strncpy(*host, url, host_len);
-        *path = bstrdup(slash);
+    if (*rest != '\0' && *rest != '/' && *rest != '?') {
+        obs_log(LOG_ERROR, "Unexpected characters after host in WebSocket URL");
+        return false;
+    }
+
+    *host = bstrdup_n(host_start, host_end - host_start);
+
+    // Parse path, keeping a query that follows the host directly
+    if (*rest == '/') {
+        *path = bstrdup(rest);
+    } else if (*rest == '?') {
+        struct dstr query;
+        dstr_init_copy(&query, "/");
+        dstr_cat(&query, rest);
+        *path = query.array;
     } else {
-        // No port or path
-        *host = bstrdup(url);
         *path = bstrdup("/");
     }
 
@@ -104,24 +258,776 @@ bool parse_ws_url(const char *url, char **host, uint16_t *port, char **path, boo
 void ws_connection_init(ws_connection_t *conn, bool is_remote, ws_relay_t *relay) {
     if (!conn) return;
 
-    memset(conn, 0, sizeof(ws_connection_t));
+    // Connections live in bzalloc'd memory, so construct the C++ members in place
+    new (conn) ws_connection_t();
     conn->state = WS_STATE_DISCONNECTED;
     conn->is_remote = is_remote;
     conn->relay = relay;
-    conn->buffers = std::vector<std::vector<char>>();
-    conn->payload = std::vector<char>(LWS_PRE);
+    conn->payload = std::vector<char>(WS_MSG_PRE);
 }
 
 // Free connection
 void ws_connection_free(ws_connection_t *conn) {
     if (!conn) return;
 
-    conn->buffers.clear();
     bfree(conn->address);
     bfree(conn->path);
+    bfree(conn->resolved_host);
+    conn->~ws_connection_t();
     memset(conn, 0, sizeof(ws_connection_t));
 }
 
+// Drop everything queued for a connection, reporting it as dropped
+void ws_connection_discard_queue(ws_connection_t *conn) {
+    if (!conn) return;
+
+    ws_relay_direction_stats_t *stats = ws_connection_stats(conn);
+    stats->dropped_messages += conn->buffers.size();
+    stats->dropped_bytes += conn->queued_bytes;
+
+    conn->buffers.clear();
+    conn->queued_bytes = 0;
+    conn->budget_warned = false;
+    conn->payload.resize(WS_MSG_PRE);
+}
+
+// Size cap of the spill log in bytes
+static uint64_t ws_spill_max_bytes(ws_relay_t *relay) {
+    return (uint64_t) relay->config.spill_max_mb * 1024 * 1024;
+}
+
+// Move events still queued for a lost remote session to the spill log. Skipped while older
+// events are on disk, since appending would put them out of order. Called with the mutex held
+static void ws_spill_rescue(ws_connection_t *conn) {
+    ws_relay_t *relay = conn->relay;
+    if (conn != &relay->remote_conn || !relay->spill || !relay->config.spill_enabled ||
+        !relay->config.auth_offload || !ws_spill_empty(relay->spill)) {
+        return;
+    }
+
+    for (auto it = conn->buffers.begin(); it != conn->buffers.end();) {
+        ws_message_class_t msg_class = ws_message_get_class(*it);
+        if (msg_class != WS_MESSAGE_EVENT && msg_class != WS_MESSAGE_EVENT_HIGH_VOLUME) {
+            ++it;
+            continue;
+        }
+
+        size_t size = it->data.size() - WS_MSG_PRE;
+        ws_spill_append(relay->spill, it->data.data() + WS_MSG_PRE, size, ws_spill_max_bytes(relay));
+        conn->queued_bytes -= size;
+        it = conn->buffers.erase(it);
+    }
+}
+
+// Close connection from the service thread, detaching it so late callbacks are ignored
+void ws_connection_close(ws_connection_t *conn) {
+    if (!conn) return;
+
+    if (conn->wsi) {
+        lws_set_opaque_user_data(conn->wsi, NULL);
+        lws_close_reason(conn->wsi, LWS_CLOSE_STATUS_NORMAL, NULL, 0);
+        lws_set_timeout(conn->wsi, PENDING_TIMEOUT_USER_OK, LWS_TO_KILL_ASYNC);
+    }
+    conn->wsi = NULL;
+    conn->state = WS_STATE_DISCONNECTED;
+    conn->resolving = false;
+    ws_spill_rescue(conn);
+    ws_connection_discard_queue(conn);
+
+    // Detached connections get no CLOSED callback, so end their handshake state here
+    if (conn == &conn->relay->remote_conn) {
+        ws_auth_on_remote_disconnected(conn->relay);
+        ws_admission_reset(conn->relay, false);
+        ws_mux_hub_drop_peers(conn->relay);
+    } else if (conn == &conn->relay->obs_conn) {
+        ws_auth_on_obs_disconnected(conn->relay);
+        ws_admission_reset(conn->relay, true);
+    }
+    ws_relay_notify(conn->relay);
+}
+
+// Queue a message generated by the relay itself; called with the mutex held
+void ws_connection_send(ws_connection_t *conn, const char *data, size_t len) {
+    if (!conn || conn->state != WS_STATE_CONNECTED || !conn->wsi) return;
+
+    if (conn->relay->config.enable_logging) {
+        obs_log(LOG_INFO, "Relay to %s: %.*s", conn->is_remote ? "remote" : "OBS", (int) len, data);
+    }
+
+    WS_TRACE_SCOPE("queue");
+    ws_message_t msg;
+    msg.data.resize(WS_MSG_PRE + len);
+    memcpy(msg.data.data() + WS_MSG_PRE, data, len);
+
+    conn->queued_bytes += len;
+    conn->buffers.push_back(std::move(msg));
+    lws_callback_on_writable(conn->wsi);
+}
+
+// Move an established standby connection into the active slot
+void ws_connection_promote(ws_connection_t *active, ws_connection_t *standby) {
+    if (!active || !standby) return;
+
+    ws_connection_close(active);
+
+    active->wsi = standby->wsi;
+    active->state = standby->state;
+    active->rx_buffer_size = standby->rx_buffer_size;
+    if (active->wsi) {
+        lws_set_opaque_user_data(active->wsi, active);
+    }
+
+    standby->wsi = NULL;
+    standby->state = WS_STATE_DISCONNECTED;
+}
+
+// Address to dial for the connection host: the host itself where no lookup is needed, or the
+// cached result while it is fresh. Otherwise starts a lookup on the resolver thread and returns
+// NULL; ws_connection_resolved dials once it is done. Called with the mutex held
+static const char *ws_resolve_cached(ws_connection_t *conn) {
+    if (ws_host_is_unix(conn->address)) return conn->address;
+
+#if defined(LWS_WITH_SYS_ASYNC_DNS)
+    // lws resolves and caches asynchronously by itself
+    return conn->address;
+#else
+    // Literal addresses need no lookup
+    unsigned char literal[sizeof(struct in6_addr)];
+    if (inet_pton(AF_INET, conn->address, literal) == 1 || inet_pton(AF_INET6, conn->address, literal) == 1) {
+        return conn->address;
+    }
+
+    int ttl = conn->relay->config.dns_cache_ttl;
+    if (ttl > 0 && conn->resolved_host && strcmp(conn->resolved_host, conn->address) == 0 &&
+        conn->resolved_addr[0] && time(NULL) - conn->resolved_at < ttl) {
+        return conn->resolved_addr;
+    }
+
+    // Without a resolver thread lws looks the host up itself, blocking the service thread
+    if (!ws_resolver_request(conn->relay, conn->address)) return conn->address;
+    return NULL;
+#endif
+}
+
+// Start health checking on a newly established connection; called with the mutex held
+static void ws_health_start(ws_connection_t *conn, struct lws *wsi) {
+    conn->missed_pongs = 0;
+    conn->ping_due = false;
+
+    if (conn->relay->config.ping_interval > 0) {
+        lws_set_timer_usecs(wsi, (lws_usec_t) conn->relay->config.ping_interval * LWS_US_PER_SEC);
+    }
+}
+
+// Ping timer fired; returns false if the connection should be dropped. Called with the mutex held
+static bool ws_health_on_timer(ws_connection_t *conn, struct lws *wsi) {
+    ws_relay_t *relay = conn->relay;
+    if (relay->config.ping_interval <= 0) return true;
+
+    if (conn->missed_pongs >= relay->config.ping_max_missed) {
+        obs_log(LOG_WARNING, "%s WebSocket missed %d pongs, closing connection",
+                conn->is_remote ? "Remote" : "OBS", conn->missed_pongs);
+        ws_relay_set_error(relay, "%s connection missed %d pongs", conn->is_remote ? "Remote" : "OBS",
+                           conn->missed_pongs);
+        ws_connection_stats(conn)->ping_timeouts++;
+        return false;
+    }
+
+    conn->missed_pongs++;
+    conn->ping_due = true;
+    lws_callback_on_writable(wsi);
+    lws_set_timer_usecs(wsi, (lws_usec_t) relay->config.ping_interval * LWS_US_PER_SEC);
+    return true;
+}
+
+// Send a pending ping carrying its send time; called from WRITEABLE with the mutex held
+static bool ws_health_send_ping(ws_connection_t *conn, struct lws *wsi) {
+    if (!conn->ping_due) return true;
+    conn->ping_due = false;
+
+    unsigned char buf[LWS_PRE + sizeof(uint64_t)];
+    uint64_t sent_at = os_gettime_ns();
+    memcpy(buf + LWS_PRE, &sent_at, sizeof(sent_at));
+
+    if (lws_write(wsi, buf + LWS_PRE, sizeof(sent_at), LWS_WRITE_PING) < 0) {
+        return false;
+    }
+    ws_connection_stats(conn)->pings_sent++;
+    return true;
+}
+
+// Record the round trip of one of our pings; called with the mutex held
+static void ws_health_on_pong(ws_connection_t *conn, const void *in, size_t len) {
+    if (len != sizeof(uint64_t)) return;
+
+    uint64_t sent_at;
+    memcpy(&sent_at, in, sizeof(sent_at));
+    uint64_t now = os_gettime_ns();
+    if (sent_at > now) return;
+
+    uint64_t rtt_us = (now - sent_at) / 1000;
+    conn->missed_pongs = 0;
+
+    ws_relay_direction_stats_t *stats = ws_connection_stats(conn);
+    stats->pongs_received++;
+    stats->rtt_last_us = rtt_us;
+    // Same smoothing as TCP's SRTT
+    stats->rtt_smoothed_us = stats->rtt_smoothed_us ? (stats->rtt_smoothed_us * 7 + rtt_us) / 8 : rtt_us;
+
+    int bucket = 0;
+    for (uint64_t limit = 1000; bucket < WS_RTT_HISTOGRAM_BUCKETS - 1 && rtt_us >= limit; limit *= 2) {
+        bucket++;
+    }
+    stats->rtt_histogram[bucket]++;
+}
+
+// Drop queued events of one connection, oldest first, until the budget is met
+template<typename OverBudget>
+static void ws_evict_events(ws_connection_t *conn, bool high_volume_only, OverBudget over_budget) {
+    ws_relay_direction_stats_t *stats = ws_connection_stats(conn);
+
+    for (auto it = conn->buffers.begin(); it != conn->buffers.end() && over_budget();) {
+        ws_message_class_t msg_class = ws_message_get_class(*it);
+        bool droppable = msg_class == WS_MESSAGE_EVENT_HIGH_VOLUME ||
+                         (!high_volume_only && msg_class == WS_MESSAGE_EVENT);
+        if (!droppable) {
+            ++it;
+            continue;
+        }
+
+        size_t size = it->data.size() - WS_MSG_PRE;
+        conn->queued_bytes -= size;
+        stats->dropped_messages++;
+        stats->dropped_bytes += size;
+        it = conn->buffers.erase(it);
+    }
+}
+
+// Drop every queued event of a connection, keeping requests and responses. Returns the number
+// of events dropped; called with the mutex held
+size_t ws_connection_flush_events(ws_connection_t *conn) {
+    size_t queued = conn->buffers.size();
+    ws_evict_events(conn, false, [] { return true; });
+    return queued - conn->buffers.size();
+}
+
+// Make room for a message in the memory budget; called with the mutex held.
+// Returns false if the message has to be dropped. Requests and responses are never dropped,
+// the connection is closed instead.
+static bool ws_enforce_budget(ws_connection_t *target, ws_message_t &msg) {
+    ws_relay_t *relay = target->relay;
+    ws_connection_t *other = target->is_remote ? &relay->obs_conn : &relay->remote_conn;
+
+    size_t size = msg.data.size() - WS_MSG_PRE;
+    size_t direction_limit = (size_t) (target->is_remote ? relay->config.max_queued_remote_kb
+                                                          : relay->config.max_queued_obs_kb) * 1024;
+    size_t global_limit = (size_t) relay->config.max_queued_kb * 1024;
+
+    auto target_over = [&]() {
+        return (direction_limit && target->queued_bytes + size > direction_limit) ||
+               (global_limit && target->queued_bytes + other->queued_bytes + size > global_limit);
+    };
+    auto global_over = [&]() {
+        return global_limit && target->queued_bytes + other->queued_bytes + size > global_limit;
+    };
+
+    if (!target_over()) return true;
+
+    const char *name = target->is_remote ? "remote" : "OBS";
+    if (!target->budget_warned) {
+        obs_log(LOG_WARNING, "Queue to %s exceeds its memory budget (%zu bytes queued)", name,
+                target->queued_bytes);
+        target->budget_warned = true;
+    }
+
+    ws_message_class_t msg_class = ws_message_get_class(msg);
+    bool msg_droppable = msg_class == WS_MESSAGE_EVENT || msg_class == WS_MESSAGE_EVENT_HIGH_VOLUME;
+    ws_relay_direction_stats_t *stats = ws_connection_stats(target);
+
+    if (relay->config.drop_policy != WS_DROP_DISCONNECT) {
+        if (relay->config.drop_policy == WS_DROP_EVENT_CLASS) {
+            ws_evict_events(target, true, target_over);
+            ws_evict_events(other, true, global_over);
+        }
+
+        // Under the class policy a high-volume event goes before any regular event
+        if (!(relay->config.drop_policy == WS_DROP_EVENT_CLASS && target_over() &&
+              msg_class == WS_MESSAGE_EVENT_HIGH_VOLUME)) {
+            ws_evict_events(target, false, target_over);
+            ws_evict_events(other, false, global_over);
+            if (!target_over()) return true;
+        }
+
+        if (msg_droppable) {
+            stats->dropped_messages++;
+            stats->dropped_bytes += size;
+            if (relay->config.enable_logging) {
+                obs_log(LOG_INFO, "Dropped event to %s over memory budget (%zu bytes)", name, size);
+            }
+            return false;
+        }
+    }
+
+    // Nothing left that may be dropped silently
+    obs_log(LOG_ERROR, "Closing %s connection: memory budget exceeded", name);
+    ws_relay_set_error(relay, "Closed %s connection: memory budget exceeded", name);
+    stats->budget_disconnects++;
+    stats->dropped_messages++;
+    stats->dropped_bytes += size;
+    ws_connection_close(target);
+    return false;
+}
+
+// Queue a complete message for a connection within its memory budget; called with the mutex held
+static void ws_enqueue(ws_connection_t *target, ws_message_t &msg) {
+    WS_TRACE_SCOPE("queue");
+    if (!ws_enforce_budget(target, msg)) return;
+
+    if (target->is_remote && msg.mux_type == WS_MUX_DATA) {
+        msg.mux_value = ws_mux_stamp(target->relay);
+    }
+
+    target->queued_bytes += msg.data.size() - WS_MSG_PRE;
+    target->buffers.push_back(std::move(msg));
+    lws_callback_on_writable(target->wsi);
+}
+
+// lws_write for relayed data, traced as its own span
+static int ws_write(struct lws *wsi, unsigned char *buf, size_t len, enum lws_write_protocol protocol) {
+    WS_TRACE_SCOPE("lws_write");
+    return lws_write(wsi, buf, len, protocol);
+}
+
+// Forward a received fragment to the opposite connection; called with the mutex held
+static void ws_forward_fragment(struct lws *wsi, ws_connection_t *target, void *in, size_t len) {
+    ws_relay_t *relay = target->relay;
+    bool first = lws_is_first_fragment(wsi);
+    bool final = lws_is_final_fragment(wsi);
+
+    if (target->state != WS_STATE_CONNECTED || !target->wsi) {
+        // Fragments arriving after the target comes up must not be sent as a torn message
+        target->payload_discard = true;
+        return;
+    }
+
+    // Fast path: a complete message with nothing queued ahead of it is written straight from
+    // the lws receive buffer, which lws allocates with LWS_PRE bytes of headroom. That leaves no
+    // room for a multiplexing header, so multiplexed remote writes always go through the queue.
+    // It is only taken while the target's pipe is not choked: lws keeps the unsent tail of a
+    // partial write and holds back WRITEABLE until it is out, so with the queue empty nothing can
+    // be written ahead of it
+    bool mux = target->is_remote && ws_mux_enabled(relay);
+    // Requests under admission control are looked at as whole messages
+    bool admission = !target->is_remote && ws_admission_enabled(relay);
+    if (first && final && !mux && !admission && target->buffers.empty() && !lws_send_pipe_choked(target->wsi) &&
+        (!target->is_remote || ws_shaper_ready(relay))) {
+        if (relay->config.enable_logging) {
+            obs_log(LOG_INFO, "Write to %s: %.*s", target->is_remote ? "remote" : "OBS", (int) len, (char *) in);
+        }
+        ws_connection_stats(target)->write_calls++;
+        // Masking a client frame rewrites in, so it is not read after this
+        int n = ws_write(target->wsi, (unsigned char *) in, len, LWS_WRITE_TEXT);
+        if (n < 0) {
+            // The message is lost; closing discards the queue as a failed queued write does
+            obs_log(LOG_ERROR, "Failed to write to %s WebSocket", target->is_remote ? "remote" : "OBS");
+            ws_relay_direction_stats_t *stats = ws_connection_stats(target);
+            stats->dropped_messages++;
+            stats->dropped_bytes += len;
+            ws_connection_close(target);
+            return;
+        }
+
+        if (target->is_remote) {
+            ws_shaper_consume(relay, len);
+        }
+
+        ws_relay_direction_stats_t *stats = ws_connection_stats(target);
+        stats->messages++;
+        stats->bytes += len;
+        stats->fast_path_messages++;
+        return;
+    }
+
+    if (first) {
+        target->payload.resize(WS_MSG_PRE);
+        target->payload_discard = false;
+        // lws knows the frame length up front, so the message is assembled in one allocation
+        // rather than grown a receive buffer at a time
+        size_t expected = len + lws_remaining_packet_payload(wsi);
+        if (expected <= WS_MAX_MESSAGE_SIZE) {
+            target->payload.reserve(WS_MSG_PRE + expected);
+        }
+    }
+    if (target->payload_discard) return;
+
+    // Bound the reassembly buffer, so a runaway message cannot exhaust memory
+    auto size = target->payload.size();
+    if (size - WS_MSG_PRE + len > WS_MAX_MESSAGE_SIZE) {
+        obs_log(LOG_WARNING, "Dropping message to %s larger than %d bytes", target->is_remote ? "remote" : "OBS",
+                WS_MAX_MESSAGE_SIZE);
+        ws_relay_direction_stats_t *stats = ws_connection_stats(target);
+        stats->dropped_messages++;
+        stats->dropped_bytes += size - WS_MSG_PRE + len;
+        stats->oversized_messages++;
+        target->payload = std::vector<char>(WS_MSG_PRE);
+        target->payload_discard = true;
+        return;
+    }
+
+    // concatenate data to payload
+    target->payload.resize(size + len);
+    std::memcpy(target->payload.data() + size, in, len);
+
+    if (final) {
+        ws_message_t msg;
+        msg.data = std::move(target->payload);
+        target->payload = std::vector<char>(WS_MSG_PRE);
+        if (admission && !ws_admission_offer(relay, msg)) return;
+        ws_enqueue(target, msg);
+    }
+}
+
+// While the remote session is missing, OBS events go to the spill log. Once anything is on
+// disk, later events follow it there until replay catches up, so the order is kept
+static bool ws_spill_wanted(ws_relay_t *relay) {
+    if (!relay->spill || !relay->config.auth_offload || !relay->auth.obs_identified) return false;
+
+    return !ws_spill_empty(relay->spill) || (relay->config.spill_enabled && !relay->auth.remote_identified);
+}
+
+// Take a fragment from OBS for the spill log; returns false if it is not spilled.
+// Called with the mutex held
+static bool ws_spill_capture(ws_connection_t *conn, struct lws *wsi, void *in, size_t len) {
+    ws_relay_t *relay = conn->relay;
+
+    if (lws_is_first_fragment(wsi)) {
+        conn->spilling = ws_spill_wanted(relay);
+        conn->spill_discard = false;
+        conn->spill_payload.clear();
+    }
+    if (!conn->spilling) return false;
+    if (conn->spill_discard) return true; // Rest of an oversized event
+
+    if (conn->spill_payload.size() + len > WS_MAX_MESSAGE_SIZE) {
+        obs_log(LOG_WARNING, "Not spilling event larger than %d bytes", WS_MAX_MESSAGE_SIZE);
+        std::vector<char>().swap(conn->spill_payload);
+        conn->spill_discard = true;
+        return true;
+    }
+
+    conn->spill_payload.insert(conn->spill_payload.end(), (char *) in, (char *) in + len);
+    if (!lws_is_final_fragment(wsi)) return true;
+
+    const char *data = conn->spill_payload.data();
+    size_t size = conn->spill_payload.size();
+    ws_message_class_t msg_class = ws_message_classify(data, size);
+
+    if (msg_class == WS_MESSAGE_EVENT || msg_class == WS_MESSAGE_EVENT_HIGH_VOLUME) {
+        ws_spill_append(relay->spill, data, size, ws_spill_max_bytes(relay));
+    } else if (relay->auth.remote_identified && relay->remote_conn.state == WS_STATE_CONNECTED) {
+        // Responses belong to the live session and do not wait for replay
+        ws_message_t msg;
+        msg.data.resize(WS_MSG_PRE + size);
+        memcpy(msg.data.data() + WS_MSG_PRE, data, size);
+        msg.msg_class = msg_class;
+        ws_enqueue(&relay->remote_conn, msg);
+    }
+
+    conn->spill_payload.clear();
+    conn->spilling = false;
+    return true;
+}
+
+// Deliver a complete message from the in-process OBS session the way ws_callback_obs delivers
+// messages received from the OBS connection. Called on the service thread with the mutex held
+void ws_relay_deliver_from_obs(ws_relay_t *relay, ws_message_t &msg) {
+    const char *data = msg.data.data() + WS_MSG_PRE;
+    size_t size = msg.data.size() - WS_MSG_PRE;
+    if (relay->config.enable_logging) {
+        obs_log(LOG_INFO, "Received from OBS: %.*s", (int) size, data);
+    }
+
+    ws_message_class_t msg_class = ws_message_get_class(msg);
+    if ((msg_class == WS_MESSAGE_EVENT || msg_class == WS_MESSAGE_EVENT_HIGH_VOLUME) && ws_spill_wanted(relay)) {
+        ws_spill_append(relay->spill, data, size, ws_spill_max_bytes(relay));
+        return;
+    }
+
+    ws_connection_t *remote = &relay->remote_conn;
+    if (!relay->auth.remote_identified || remote->state != WS_STATE_CONNECTED || !remote->wsi) return;
+
+    ws_enqueue(remote, msg);
+}
+
+// Send a request released by admission control on to OBS. Called on the service thread with the
+// mutex held
+void ws_relay_deliver_to_obs(ws_relay_t *relay, ws_message_t &msg) {
+    ws_connection_t *obs = &relay->obs_conn;
+    if (obs->state != WS_STATE_CONNECTED || !obs->wsi) return;
+
+    ws_enqueue(obs, msg);
+}
+
+// Write a masked client frame (FIN set, text or binary) carrying payload to out, which needs room for
+// WS_FRAME_HEADER_MAX + len bytes. Returns the frame's size. The length takes its shortest
+// encoding, as RFC 6455 requires
+size_t ws_frame_encode(unsigned char *out, bool binary, const unsigned char *mask, const unsigned char *payload,
+                       size_t len) {
+    size_t pos = 0;
+    out[pos++] = (unsigned char) (0x80 | (binary ? 0x2 : 0x1)); // FIN and opcode
+    if (len < 126) {
+        out[pos++] = (unsigned char) (0x80 | len);
+    } else if (len <= 0xffff) {
+        out[pos++] = 0x80 | 126;
+        out[pos++] = (unsigned char) (len >> 8);
+        out[pos++] = (unsigned char) len;
+    } else {
+        out[pos++] = 0x80 | 127;
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            out[pos++] = (unsigned char) ((uint64_t) len >> shift);
+        }
+    }
+
+    memcpy(out + pos, mask, 4);
+    pos += 4;
+
+    // Eight bytes at a time, then the rest
+    unsigned char *dst = out + pos;
+    uint32_t mask32;
+    memcpy(&mask32, mask, 4);
+    uint64_t mask64 = (uint64_t) mask32 << 32 | mask32;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, payload + i, 8);
+        word ^= mask64;
+        memcpy(dst + i, &word, 8);
+    }
+    for (; i < len; i++) {
+        dst[i] = payload[i] ^ mask[i & 3];
+    }
+    return pos + len;
+}
+
+// Append a masked WebSocket frame carrying payload to the connection's write batch. Frames from a
+// client must be masked, which lws would otherwise do for each lws_write; masks are drawn from a
+// pool of random bytes refilled in one go
+static void ws_append_frame(ws_connection_t *conn, bool binary, const unsigned char *payload, size_t len) {
+    if (conn->mask_left < 4) {
+        lws_get_random(conn->relay->context, conn->mask_pool, sizeof(conn->mask_pool));
+        conn->mask_left = sizeof(conn->mask_pool);
+    }
+    const unsigned char *mask = conn->mask_pool + sizeof(conn->mask_pool) - conn->mask_left;
+    conn->mask_left -= 4;
+
+    std::vector<unsigned char> &batch = conn->write_batch;
+    size_t offset = batch.size();
+    batch.resize(offset + WS_FRAME_HEADER_MAX + len);
+    batch.resize(offset + ws_frame_encode(batch.data() + offset, binary, mask, payload, len));
+}
+
+// Send the frames collected in the write batch with a single write. The data messages in it count
+// as sent only once the write succeeded, and as dropped if it failed
+static bool ws_connection_flush_batch(ws_connection_t *conn, struct lws *wsi) {
+    size_t len = conn->write_batch.size() - LWS_PRE;
+    if (!len) return true;
+
+    ws_relay_direction_stats_t *stats = ws_connection_stats(conn);
+    stats->write_calls++;
+    int n = ws_write(wsi, conn->write_batch.data() + LWS_PRE, len, LWS_WRITE_RAW);
+    conn->write_batch.resize(LWS_PRE);
+    uint64_t messages = conn->batch_messages;
+    uint64_t bytes = conn->batch_bytes;
+    conn->batch_messages = 0;
+    conn->batch_bytes = 0;
+    if (n < 0) {
+        obs_log(LOG_ERROR, "Failed to write to %s WebSocket", conn->is_remote ? "remote" : "OBS");
+        stats->dropped_messages += messages;
+        stats->dropped_bytes += bytes;
+        ws_connection_discard_queue(conn);
+        return false;
+    }
+    stats->messages += messages;
+    stats->bytes += bytes;
+    return true;
+}
+
+// Write queued messages in order; called from WRITEABLE with the mutex held.
+// Returns false if the connection has to be dropped
+static bool ws_connection_write_queue(ws_connection_t *conn, struct lws *wsi) {
+    ws_relay_t *relay = conn->relay;
+    ws_relay_direction_stats_t *stats = ws_connection_stats(conn);
+    const char *name = conn->is_remote ? "remote" : "OBS";
+    bool mux = conn->is_remote && ws_mux_enabled(relay);
+    size_t batch_limit = (size_t) relay->config.write_coalesce_kb * 1024;
+    uint64_t start = os_gettime_ns();
+
+    conn->write_batch.resize(LWS_PRE);
+    while (!conn->buffers.empty()) {
+        ws_message_t &msg = conn->buffers.front();
+        size_t size = msg.data.size() - WS_MSG_PRE;
+        // Frames routed for an attached relay carry its header and are flow controlled by it
+        bool data = msg.mux_type == WS_MUX_DATA && !msg.mux_routed;
+        bool header = mux && !msg.mux_routed;
+
+        // Data waits for the uplink shaper and until the remote opens its window again
+        if (conn->is_remote && data && !ws_shaper_ready(relay)) break;
+        if (mux && data && !ws_mux_take_credit(relay, size)) break;
+
+        if (relay->config.enable_logging && data) {
+            obs_log(LOG_INFO, "Write to %s: %.*s", name, (int) size, msg.data.data() + WS_MSG_PRE);
+        }
+
+        unsigned char *frame = header ? ws_mux_header(relay, msg) : (unsigned char *) msg.data.data() + WS_MSG_PRE;
+        size_t frame_len = header ? WS_MUX_HEADER_SIZE + size : size;
+
+        // Small messages are framed into the batch; anything larger goes out on its own after it
+        if (frame_len + WS_FRAME_HEADER_MAX <= batch_limit) {
+            if (conn->write_batch.size() - LWS_PRE + frame_len + WS_FRAME_HEADER_MAX > batch_limit &&
+                !ws_connection_flush_batch(conn, wsi)) {
+                return false;
+            }
+            ws_append_frame(conn, mux, frame, frame_len);
+            if (data) {
+                conn->batch_messages++;
+                conn->batch_bytes += size;
+            }
+        } else {
+            if (!ws_connection_flush_batch(conn, wsi)) return false;
+            stats->write_calls++;
+            if (ws_write(wsi, frame, frame_len, mux ? LWS_WRITE_BINARY : LWS_WRITE_TEXT) < 0) {
+                obs_log(LOG_ERROR, "Failed to write to %s WebSocket", name);
+                ws_connection_discard_queue(conn);
+                return false;
+            }
+            if (data) {
+                stats->messages++;
+                stats->bytes += size;
+            }
+        }
+
+        conn->queued_bytes -= size;
+        if (data && conn->is_remote) {
+            ws_shaper_consume(relay, size);
+        }
+        conn->buffers.pop_front();
+    }
+
+    if (!ws_connection_flush_batch(conn, wsi)) return false;
+    stats->write_ns += os_gettime_ns() - start;
+
+    if (conn->buffers.empty()) {
+        conn->budget_warned = false;
+    }
+    return true;
+}
+
+// Collect a message received on conn into its handshake buffer; returns true once it is complete
+static bool ws_collect_message(ws_connection_t *conn, struct lws *wsi, void *in, size_t len) {
+    if (lws_is_first_fragment(wsi)) {
+        conn->handshake.clear();
+    }
+
+    if (conn->handshake.size() + len > WS_MAX_HANDSHAKE_SIZE) {
+        obs_log(LOG_WARNING, "Ignoring oversized handshake message from %s", conn->is_remote ? "remote" : "OBS");
+        conn->handshake.clear();
+        return false;
+    }
+
+    conn->handshake.insert(conn->handshake.end(), (char *) in, (char *) in + len);
+    return lws_is_final_fragment(wsi) && !conn->handshake.empty();
+}
+
+// With authentication offload the relay owns the OBS handshake; returns true if the
+// fragment must not be forwarded. Called with the mutex held
+static bool ws_auth_intercept_obs(ws_connection_t *conn, struct lws *wsi, void *in, size_t len) {
+    ws_relay_t *relay = conn->relay;
+
+    if (!relay->auth.obs_identified) {
+        if (ws_collect_message(conn, wsi, in, len)) {
+            ws_auth_handle_obs_message(relay, conn->handshake.data(), conn->handshake.size());
+            conn->handshake.clear();
+        }
+        return true;
+    }
+
+    // Swallow the Identified answering a Reidentify sent by the relay
+    if (relay->auth.obs_reidentify_pending && lws_is_first_fragment(wsi) && lws_is_final_fragment(wsi) &&
+        len <= WS_MAX_HANDSHAKE_SIZE && ws_auth_handle_obs_message(relay, (const char *) in, len)) {
+        return true;
+    }
+
+    return false;
+}
+
+// Counterpart for messages from the remote; returns 0 to forward, 1 if consumed and -1 if
+// the remote has to be disconnected. Called with the mutex held
+static int ws_auth_intercept_remote(ws_connection_t *conn, struct lws *wsi, void *in, size_t len) {
+    ws_relay_t *relay = conn->relay;
+
+    if (relay->auth.remote_identified) {
+        // Only a small single-frame message can be a Reidentify
+        if (lws_is_first_fragment(wsi) && lws_is_final_fragment(wsi) && len <= WS_MAX_HANDSHAKE_SIZE &&
+            ws_auth_handle_remote_message(relay, (const char *) in, len) != WS_AUTH_FORWARD) {
+            return 1;
+        }
+
+        // OBS closes sessions that send requests before Identify
+        if (!relay->auth.obs_identified) {
+            if (relay->config.enable_logging) {
+                obs_log(LOG_INFO, "Dropping message from remote until OBS session is identified");
+            }
+            return 1;
+        }
+        return 0;
+    }
+
+    if (!ws_collect_message(conn, wsi, in, len)) return 1;
+
+    ws_auth_result_t result = ws_auth_handle_remote_message(relay, conn->handshake.data(), conn->handshake.size());
+    conn->handshake.clear();
+    if (relay->auth.remote_identified) {
+        ws_mirror_on_remote_identified(relay);
+    }
+
+    if (result == WS_AUTH_REJECT_AUTHENTICATION || result == WS_AUTH_REJECT_RPC_VERSION) {
+        lws_close_reason(wsi, (enum lws_close_status) ws_auth_close_code(result), NULL, 0);
+        return -1;
+    }
+    return 1;
+}
+
+// Start a new obs-websocket session on a freshly promoted remote connection or a reset channel
+static void ws_relay_restart_session(ws_relay_t *relay) {
+    ws_mux_open(relay);
+
+    if (relay->config.auth_offload) {
+        // The relay keeps its OBS session and just greets the remote again
+        ws_auth_on_remote_connected(relay);
+    } else if (relay->obs_conn.wsi) {
+        // The remote sees a new session, so OBS has to start a new one as well
+        ws_connection_close(&relay->obs_conn);
+    }
+}
+
+// Connection setup spans: the transport (TCP, and TLS for wss) is up once lws asks for the
+// upgrade request headers, the upgrade completes with ESTABLISHED
+static void ws_trace_handshake(ws_connection_t *conn) {
+    conn->handshake_started_ns = os_gettime_ns();
+    WS_TRACE_RECORD(conn->use_ssl ? "tcp+tls handshake" : "tcp connect", conn->connect_started_ns,
+                    conn->handshake_started_ns);
+}
+
+static void ws_trace_established(ws_connection_t *conn) {
+#if defined(WS_RELAY_TRACE)
+    uint64_t now = os_gettime_ns();
+    ws_trace_record("websocket upgrade", conn->handshake_started_ns, now);
+    ws_trace_record("reconnect", conn->connect_started_ns, now);
+#else
+    UNUSED_PARAMETER(conn);
+#endif
+}
+
 // OBS WebSocket callback
 int ws_callback_obs(struct lws *wsi, enum lws_callback_reasons reason, void *user, void *in, size_t len) {
     ws_connection_t *conn = (ws_connection_t *) lws_get_opaque_user_data(wsi);
@@ -130,74 +1036,104 @@ int ws_callback_obs(struct lws *wsi, enum lws_callback_reasons reason, void *use
     ws_relay_t *relay = conn->relay;
 
     switch (reason) {
+        case LWS_CALLBACK_CLIENT_APPEND_HANDSHAKE_HEADER:
+            ws_trace_handshake(conn);
+            break;
+
         case LWS_CALLBACK_CLIENT_ESTABLISHED:
+            ws_trace_established(conn);
             obs_log(LOG_INFO, "Connected to OBS WebSocket");
-            pthread_mutex_lock(&relay->mutex);
+            ws_relay_lock(relay);
             conn->state = WS_STATE_CONNECTED;
+            ws_health_start(conn, wsi);
+            ws_relay_notify(relay);
+            pthread_mutex_unlock(&relay->mutex);
+            break;
+
+        case LWS_CALLBACK_CLIENT_RECEIVE_PONG:
+            ws_relay_lock(relay);
+            ws_health_on_pong(conn, in, len);
             pthread_mutex_unlock(&relay->mutex);
             break;
 
-        case LWS_CALLBACK_CLIENT_RECEIVE:
+        case LWS_CALLBACK_TIMER: {
+            ws_relay_lock(relay);
+            bool alive = ws_health_on_timer(conn, wsi);
+            pthread_mutex_unlock(&relay->mutex);
+            if (!alive) return -1;
+            break;
+        }
+
+        case LWS_CALLBACK_CLIENT_RECEIVE: {
+            WS_TRACE_SCOPE("obs receive");
             if (relay->config.enable_logging) {
                 obs_log(LOG_INFO, "Received from OBS: %.*s", (int) len, (char *) in);
             }
 
             // Forward message to remote if connected
-            pthread_mutex_lock(&relay->mutex);
-            if (relay->remote_conn.state == WS_STATE_CONNECTED && relay->remote_conn.wsi) {
-                if (lws_is_first_fragment(wsi)) {
-                    relay->remote_conn.payload.resize(LWS_PRE);
-                }
-
-                // concatenate data to payload
-                auto size = relay->remote_conn.payload.size();
-                relay->remote_conn.payload.resize(size + len);
-                std::memcpy(relay->remote_conn.payload.data() + size, in, len);
-
-                if (lws_is_final_fragment(wsi)) {
-                    relay->remote_conn.buffers.push_back(std::move(relay->remote_conn.payload));
-                    lws_callback_on_writable(relay->remote_conn.wsi);
-                    relay->remote_conn.payload = std::vector<char>(LWS_PRE);
-                }
+            ws_relay_lock(relay);
+            ws_rx_account(conn, wsi, len);
+            if (lws_is_first_fragment(wsi)) {
+                ws_admission_observe(relay, (const char *) in, len);
+            }
+            ws_mirror_observe(relay, lws_is_first_fragment(wsi), lws_is_final_fragment(wsi), in, len);
+            if (relay->config.auth_offload && ws_auth_intercept_obs(conn, wsi, in, len)) {
+                // Handshake traffic, answered by the relay
+            } else if (ws_spill_capture(conn, wsi, in, len)) {
+                // Kept on disk until the remote session has caught up
+            } else if (!relay->config.auth_offload || relay->auth.remote_identified) {
+                // With authentication offload there is no session to deliver to until the
+                // remote has identified with the relay
+                ws_forward_fragment(wsi, &relay->remote_conn, in, len);
             }
             pthread_mutex_unlock(&relay->mutex);
             break;
+        }
 
-        case LWS_CALLBACK_CLIENT_WRITEABLE:
-            pthread_mutex_lock(&relay->mutex);
-            if (!conn->buffers.empty()) {
-                for (auto &buf: conn->buffers) {
-                    if (relay->config.enable_logging) {
-                        obs_log(LOG_INFO, "Write to OBS: %.*s", (int) (buf.size() - LWS_PRE),
-                                buf.data() + LWS_PRE);
-                    }
-                    int n = lws_write(wsi, (unsigned char *) buf.data() + LWS_PRE,
-                                      buf.size() - LWS_PRE, LWS_WRITE_TEXT);
-                    if (n < 0) {
-                        obs_log(LOG_ERROR, "Failed to write to OBS WebSocket");
-                        conn->buffers.clear();
-                        pthread_mutex_unlock(&relay->mutex);
-                        return -1;
-                    }
-                }
-                conn->buffers.clear();
+        case LWS_CALLBACK_CLIENT_WRITEABLE: {
+            WS_TRACE_SCOPE("obs writeable");
+            ws_relay_lock(relay);
+            if (!ws_health_send_ping(conn, wsi)) {
+                obs_log(LOG_ERROR, "Failed to send ping to OBS WebSocket");
+                pthread_mutex_unlock(&relay->mutex);
+                return -1;
+            }
+            if (!ws_connection_write_queue(conn, wsi)) {
+                pthread_mutex_unlock(&relay->mutex);
+                return -1;
             }
+            // Data written to OBS frees window for the remote
+            ws_mux_update_window(relay);
             pthread_mutex_unlock(&relay->mutex);
             break;
+        }
 
         case LWS_CALLBACK_CLIENT_CONNECTION_ERROR:
             obs_log(LOG_ERROR, "OBS WebSocket connection error");
-            pthread_mutex_lock(&relay->mutex);
+            WS_TRACE_RECORD("connect failed", conn->connect_started_ns, os_gettime_ns());
+            ws_relay_lock(relay);
+            ws_relay_set_error(relay, "OBS: %s", in ? (const char *) in : "connection error");
             conn->state = WS_STATE_ERROR;
+            conn->wsi = NULL;
+            conn->resolved_addr[0] = '\0';
+            ws_auth_on_obs_disconnected(relay);
+            ws_admission_reset(relay, true);
+            ws_mirror_invalidate(relay);
+            ws_relay_notify(relay);
             pthread_mutex_unlock(&relay->mutex);
             break;
 
         case LWS_CALLBACK_CLIENT_CLOSED:
         case LWS_CALLBACK_CLOSED:
             obs_log(LOG_INFO, "OBS WebSocket connection closed");
-            pthread_mutex_lock(&relay->mutex);
+            ws_relay_lock(relay);
             conn->state = WS_STATE_DISCONNECTED;
             conn->wsi = NULL;
+            ws_connection_discard_queue(conn);
+            ws_auth_on_obs_disconnected(relay);
+            ws_admission_reset(relay, true);
+            ws_mirror_invalidate(relay);
+            ws_relay_notify(relay);
             pthread_mutex_unlock(&relay->mutex);
             break;
 
@@ -216,72 +1152,137 @@ int ws_callback_remote(struct lws *wsi, enum lws_callback_reasons reason, void *
     ws_relay_t *relay = conn->relay;
 
     switch (reason) {
+        case LWS_CALLBACK_CLIENT_APPEND_HANDSHAKE_HEADER:
+            ws_trace_handshake(conn);
+            break;
+
         case LWS_CALLBACK_CLIENT_ESTABLISHED:
-            obs_log(LOG_INFO, "Connected to remote WebSocket");
-            pthread_mutex_lock(&relay->mutex);
+            ws_trace_established(conn);
+            obs_log(LOG_INFO, conn == &relay->standby_conn ? "Standby remote WebSocket ready"
+                                                           : "Connected to remote WebSocket");
+            ws_relay_lock(relay);
             conn->state = WS_STATE_CONNECTED;
+            ws_health_start(conn, wsi);
+            ws_endpoint_connected(relay, conn == &relay->remote_conn ? relay->endpoint_active : relay->endpoint_standby);
+            if (conn == &relay->remote_conn) {
+                ws_mux_open(relay);
+                if (relay->config.auth_offload) {
+                    ws_auth_on_remote_connected(relay);
+                }
+            }
+            ws_relay_notify(relay);
             pthread_mutex_unlock(&relay->mutex);
             break;
 
-        case LWS_CALLBACK_CLIENT_RECEIVE:
+        case LWS_CALLBACK_CLIENT_RECEIVE_PONG:
+            ws_relay_lock(relay);
+            ws_health_on_pong(conn, in, len);
+            pthread_mutex_unlock(&relay->mutex);
+            break;
+
+        case LWS_CALLBACK_TIMER: {
+            ws_relay_lock(relay);
+            bool alive = ws_health_on_timer(conn, wsi);
+            pthread_mutex_unlock(&relay->mutex);
+            if (!alive) return -1;
+            break;
+        }
+
+        case LWS_CALLBACK_CLIENT_RECEIVE: {
+            // The standby connection carries no session until it is promoted
+            if (conn == &relay->standby_conn) break;
+
+            WS_TRACE_SCOPE("remote receive");
+            ws_relay_lock(relay);
+            ws_rx_account(conn, wsi, len);
+            if (ws_mux_enabled(relay)) {
+                ws_mux_rx_result_t rx = ws_mux_receive(relay, wsi, &in, &len);
+                if (rx == WS_MUX_RX_RESET) {
+                    ws_relay_restart_session(relay);
+                }
+                if (rx != WS_MUX_RX_FORWARD) {
+                    pthread_mutex_unlock(&relay->mutex);
+                    break;
+                }
+            }
+
             if (relay->config.enable_logging) {
                 obs_log(LOG_INFO, "Received from remote: %.*s", (int) len, (char *) in);
             }
 
             // Forward message to OBS if connected
-            pthread_mutex_lock(&relay->mutex);
-            if (relay->obs_conn.state == WS_STATE_CONNECTED && relay->obs_conn.wsi) {
-                if (lws_is_first_fragment(wsi)) {
-                    relay->obs_conn.payload.resize(LWS_PRE);
-                }
-                // concatenate data to payload
-                auto size = relay->obs_conn.payload.size();
-                relay->obs_conn.payload.resize(size + len);
-                std::memcpy(relay->obs_conn.payload.data() + size, in, len);
-                if (lws_is_final_fragment(wsi)) {
-                    relay->obs_conn.buffers.push_back(std::move(relay->obs_conn.payload));
-                    lws_callback_on_writable(relay->obs_conn.wsi);
-                    relay->obs_conn.payload = std::vector<char>(LWS_PRE);
-                }
+            int intercepted = relay->config.auth_offload ? ws_auth_intercept_remote(conn, wsi, in, len) : 0;
+            if (intercepted == 0 &&
+                ws_mirror_intercept(relay, lws_is_first_fragment(wsi), lws_is_final_fragment(wsi), in, len)) {
+                // Snapshot request, answered from the mirror
+            } else if (intercepted == 0 && ws_obs_api_active(relay)) {
+                ws_obs_api_receive(relay, lws_is_first_fragment(wsi), lws_is_final_fragment(wsi), in, len);
+            } else if (intercepted == 0) {
+                ws_forward_fragment(wsi, &relay->obs_conn, in, len);
             }
+            // The remote may have just identified, or its message was dropped
+            ws_mux_update_window(relay);
+            ws_relay_drain_spill(relay);
             pthread_mutex_unlock(&relay->mutex);
+            if (intercepted < 0) return -1;
             break;
+        }
 
-        case LWS_CALLBACK_CLIENT_WRITEABLE:
-            pthread_mutex_lock(&relay->mutex);
-            if (!conn->buffers.empty()) {
-                for (auto &buf: conn->buffers) {
-                    if (relay->config.enable_logging) {
-                        obs_log(LOG_INFO, "Write to remote: %.*s", (int) (buf.size() - LWS_PRE),
-                                buf.data() + LWS_PRE);
-                    }
-                    int n = lws_write(wsi, (unsigned char *) buf.data() + LWS_PRE,
-                                      buf.size() - LWS_PRE, LWS_WRITE_TEXT);
-                    if (n < 0) {
-                        obs_log(LOG_ERROR, "Failed to write to remote WebSocket");
-                        conn->buffers.clear();
-                        pthread_mutex_unlock(&relay->mutex);
-                        return -1;
-                    }
-                }
-                conn->buffers.clear();
+        case LWS_CALLBACK_CLIENT_WRITEABLE: {
+            WS_TRACE_SCOPE("remote writeable");
+            ws_relay_lock(relay);
+            if (!ws_health_send_ping(conn, wsi)) {
+                obs_log(LOG_ERROR, "Failed to send ping to remote WebSocket");
+                pthread_mutex_unlock(&relay->mutex);
+                return -1;
+            }
+            if (!ws_connection_write_queue(conn, wsi)) {
+                pthread_mutex_unlock(&relay->mutex);
+                return -1;
+            }
+            // Top the queue up with spilled events once it has drained
+            if (conn == &relay->remote_conn) {
+                ws_relay_drain_spill(relay);
             }
             pthread_mutex_unlock(&relay->mutex);
             break;
+        }
 
         case LWS_CALLBACK_CLIENT_CONNECTION_ERROR:
             obs_log(LOG_ERROR, "Remote WebSocket connection error");
-            pthread_mutex_lock(&relay->mutex);
+            WS_TRACE_RECORD("connect failed", conn->connect_started_ns, os_gettime_ns());
+            ws_relay_lock(relay);
+            if (conn == &relay->remote_conn) {
+                ws_relay_set_error(relay, "Remote: %s", in ? (const char *) in : "connection error");
+            }
+            // Try the next endpoint rather than waiting for this one
+            ws_endpoint_failed(relay, conn == &relay->remote_conn ? relay->endpoint_active : relay->endpoint_standby,
+                               time(NULL));
             conn->state = WS_STATE_ERROR;
+            conn->wsi = NULL;
+            // The cached address may be stale
+            conn->resolved_addr[0] = '\0';
+            ws_relay_notify(relay);
             pthread_mutex_unlock(&relay->mutex);
             break;
         
         case LWS_CALLBACK_CLIENT_CLOSED:
         case LWS_CALLBACK_CLOSED:
             obs_log(LOG_INFO, "Remote WebSocket connection closed");
-            pthread_mutex_lock(&relay->mutex);
+            ws_relay_lock(relay);
+            ws_endpoint_failed(relay, conn == &relay->remote_conn ? relay->endpoint_active : relay->endpoint_standby,
+                               time(NULL));
             conn->state = WS_STATE_DISCONNECTED;
             conn->wsi = NULL;
+            ws_spill_rescue(conn);
+            ws_connection_discard_queue(conn);
+            if (conn == &relay->remote_conn) {
+                ws_auth_on_remote_disconnected(relay);
+                ws_admission_reset(relay, false);
+                ws_mirror_on_remote_lost(relay);
+                ws_mux_hub_drop_peers(relay);
+            }
+            ws_relay_notify(relay);
             pthread_mutex_unlock(&relay->mutex);
             break;
 
@@ -292,97 +1293,409 @@ int ws_callback_remote(struct lws *wsi, enum lws_callback_reasons reason, void *
     return 0;
 }
 
-// Connect to WebSocket
-bool ws_connect(ws_connection_t *conn, const char *address) {
-    if (!conn || !conn->relay || !address) return false;
-
+// Dial the parsed address of conn at dial_address; called with the mutex held
+static bool ws_dial(ws_connection_t *conn, const char *dial_address) {
     ws_relay_t *relay = conn->relay;
 
-    // Parse URL
-    if (!parse_ws_url(address, &conn->address, &conn->port, &conn->path, &conn->use_ssl)) {
-        obs_log(LOG_ERROR, "Failed to parse WebSocket URL: %s", address);
-        return false;
-    }
-
     struct lws_client_connect_info info = {0};
     info.context = relay->context;
-    info.address = conn->address;
+    info.address = dial_address;
     info.port = conn->port;
     info.path = conn->path;
-    info.host = conn->address;
-    info.origin = conn->address;
+    // A socket path makes no sense as Host header, servers behind one expect a local name
+    info.host = ws_host_is_unix(conn->address) ? "localhost" : conn->address;
+    info.origin = info.host;
     info.protocol = conn->is_remote ? "websocket" : "obs-websocket";
+    const struct lws_protocols *rx_protocol = ws_rx_protocol(conn);
+    info.local_protocol_name = rx_protocol->name;
     info.ietf_version_or_minus_one = -1;
     info.userdata = conn;
+    if (relay->retry_policy.secs_since_valid_ping) {
+        info.retry_and_idle_policy = &relay->retry_policy;
+    }
 
     if (conn->use_ssl) {
         info.ssl_connection = 1;
     }
 
     conn->state = WS_STATE_CONNECTING;
+    conn->resolving = false;
     conn->wsi = lws_client_connect_via_info(&info);
 
     if (!conn->wsi) {
-        obs_log(LOG_ERROR, "Failed to create WebSocket connection to %s", address);
         conn->state = WS_STATE_ERROR;
         return false;
     }
 
     lws_set_opaque_user_data(conn->wsi, conn);
+    conn->rx_buffer_size = rx_protocol->rx_buffer_size;
+    return true;
+}
 
-    obs_log(LOG_INFO, "Connecting to %s WebSocket: %s",
-            conn->is_remote ? "remote" : "OBS", address);
+// Connect to WebSocket
+bool ws_connect(ws_connection_t *conn, const char *address) {
+    if (!conn || !conn->relay || !address) return false;
 
+    ws_relay_t *relay = conn->relay;
+    WS_TRACE_SCOPE("ws_connect");
+    conn->connect_started_ns = os_gettime_ns();
+    conn->handshake_started_ns = 0;
+
+    // Drop the results of a previous parse
+    bfree(conn->address);
+    bfree(conn->path);
+    conn->address = NULL;
+    conn->path = NULL;
+
+    // Parse URL
+    if (!parse_ws_url(address, &conn->address, &conn->port, &conn->path, &conn->use_ssl)) {
+        obs_log(LOG_ERROR, "Failed to parse WebSocket URL: %s", address);
+        return false;
+    }
+
+    const char *dial_address = ws_resolve_cached(conn);
+    if (!dial_address) {
+        // Counts as connecting, so the lifecycle does not dial again meanwhile
+        if (relay->config.enable_logging) {
+            obs_log(LOG_INFO, "Resolving %s for %s WebSocket", conn->address, conn->is_remote ? "remote" : "OBS");
+        }
+        conn->state = WS_STATE_CONNECTING;
+        conn->resolving = true;
+        return true;
+    }
+
+    if (!ws_dial(conn, dial_address)) {
+        obs_log(LOG_ERROR, "Failed to create WebSocket connection to %s", address);
+        return false;
+    }
+
+    obs_log(LOG_INFO, "Connecting to %s WebSocket: %s (receive buffer %zu KiB)",
+            conn->is_remote ? "remote" : "OBS", address, conn->rx_buffer_size / 1024);
     return true;
 }
 
-// Main event loop thread
-void *ws_relay_thread(void *data) {
-    ws_relay_t *relay = (ws_relay_t *) data;
+// The resolver finished looking up the host of a connection waiting for it; address is NULL if
+// the lookup failed. A failure counts as a failed connection attempt. Called on the service
+// thread with the mutex held
+void ws_connection_resolved(ws_connection_t *conn, const char *address) {
+    ws_relay_t *relay = conn->relay;
+    const char *name = conn->is_remote ? "remote" : "OBS";
 
-    obs_log(LOG_INFO, "WebSocket relay thread started");
+    if (address) {
+        snprintf(conn->resolved_addr, sizeof(conn->resolved_addr), "%s", address);
+        bfree(conn->resolved_host);
+        conn->resolved_host = bstrdup(conn->address);
+        conn->resolved_at = time(NULL);
+        if (relay->config.enable_logging) {
+            obs_log(LOG_INFO, "Resolved %s to %s", conn->address, conn->resolved_addr);
+        }
+        if (ws_dial(conn, conn->resolved_addr)) {
+            obs_log(LOG_INFO, "Connecting to %s WebSocket: %s (%s, receive buffer %zu KiB)", name, conn->address,
+                    conn->resolved_addr, conn->rx_buffer_size / 1024);
+            return;
+        }
+        obs_log(LOG_ERROR, "Failed to create WebSocket connection to %s", conn->address);
+    } else {
+        obs_log(LOG_WARNING, "Failed to resolve %s", conn->address);
+        ws_relay_set_error(relay, "%s: failed to resolve %s", conn->is_remote ? "Remote" : "OBS", conn->address);
+    }
 
-    while (relay->running) {
-        lws_service(relay->context, 0);
+    conn->state = WS_STATE_ERROR;
+    conn->resolving = false;
+    if (conn == &relay->remote_conn || conn == &relay->standby_conn) {
+        ws_endpoint_failed(relay, conn == &relay->remote_conn ? relay->endpoint_active : relay->endpoint_standby,
+                           time(NULL));
+    }
+    ws_relay_notify(relay);
+}
 
-        time_t now = time(NULL);
+static void ws_spill_timer_cb(lws_sorted_usec_list_t *sul) {
+    ws_relay_t *relay = ((ws_relay_timer_t *) sul)->relay;
 
-        // Check for reconnection
-        pthread_mutex_lock(&relay->mutex);
+    ws_relay_lock(relay);
+    ws_relay_drain_spill(relay);
+    pthread_mutex_unlock(&relay->mutex);
+}
 
-        // First priority: Connect to remote server if needed
-        if (relay->remote_conn.state != WS_STATE_CONNECTED &&
-            relay->remote_conn.state != WS_STATE_CONNECTING &&
-            now - relay->last_reconnect_attempt >= relay->config.reconnect_interval) {
-            if (strlen(relay->config.remote_ws_address) > 0) {
-                obs_log(LOG_INFO, "Attempting to connect to remote server first");
-                ws_connect(&relay->remote_conn, relay->config.remote_ws_address);
-                relay->last_reconnect_attempt = now;
-            }
+// Replay spilled events to the remote at the configured rate once its session is up. Only a
+// little is queued in memory at a time, the rest waits on disk. Called on the service thread
+// with the mutex held
+void ws_relay_drain_spill(ws_relay_t *relay) {
+    uint64_t now = os_gettime_ns();
+    uint64_t elapsed = now - relay->spill_last_drain;
+    relay->spill_last_drain = now;
+
+    if (ws_spill_empty(relay->spill) || !relay->auth.remote_identified ||
+        relay->remote_conn.state != WS_STATE_CONNECTED) {
+        relay->spill_allowance = 0;
+        return;
+    }
+
+    // Token bucket holding at most one second of replay
+    double rate = relay->config.spill_drain_kbps * 1024.0;
+    if (rate > 0) {
+        relay->spill_allowance = std::min(relay->spill_allowance + rate * (double) elapsed / 1e9, rate);
+    }
+
+    std::vector<char> record;
+    while ((rate <= 0 || relay->spill_allowance > 0) && relay->remote_conn.queued_bytes < WS_SPILL_DRAIN_QUEUE &&
+           ws_spill_read(relay->spill, record, relay->config.spill_ttl)) {
+        ws_connection_send(&relay->remote_conn, record.data(), record.size());
+        relay->spill_allowance -= (double) record.size();
+    }
+
+    // Nothing else may wake the service loop while the rate limit holds replay back
+    if (!ws_spill_empty(relay->spill)) {
+        lws_sul_schedule(relay->context, 0, &relay->spill_timer.sul, ws_spill_timer_cb, WS_SPILL_DRAIN_RETRY_US);
+    }
+}
+
+static void ws_lifecycle_timer_cb(lws_sorted_usec_list_t *sul) {
+    ws_relay_t *relay = ((ws_relay_timer_t *) sul)->relay;
+
+    ws_relay_lock(relay);
+    ws_relay_update(relay);
+    pthread_mutex_unlock(&relay->mutex);
+}
+
+// Once-a-second upkeep: sample the stream output for the shaper, flush the spill log, expire
+// unanswered requests, keep the state mirror seeded, exchange clocks with the remote and publish
+// fresh counters
+static void ws_housekeeping_timer_cb(lws_sorted_usec_list_t *sul) {
+    ws_relay_t *relay = ((ws_relay_timer_t *) sul)->relay;
+
+    ws_relay_lock(relay);
+    ws_shaper_update(relay);
+    ws_spill_maintain(relay->spill, relay->config.spill_ttl, false);
+    ws_admission_maintain(relay);
+    ws_mirror_maintain(relay);
+    ws_mux_maintain(relay);
+    ws_obs_api_maintain(relay);
+    ws_relay_publish_status(relay);
+    pthread_mutex_unlock(&relay->mutex);
+
+    lws_sul_schedule(relay->context, 0, sul, ws_housekeeping_timer_cb, LWS_US_PER_SEC);
+}
+
+// Re-evaluate the connection lifecycle once the current callback has returned; called on the
+// service thread whenever a connection changes state
+void ws_relay_notify(ws_relay_t *relay) {
+    // Connections closed by ws_relay_stop report back after the thread is gone
+    if (!os_atomic_load_bool(&relay->running)) return;
+
+    lws_sul_schedule(relay->context, 0, &relay->lifecycle_timer.sul, ws_lifecycle_timer_cb, 1);
+}
+
+// Drive the connection lifecycle: promote, dial and warm up connections as their states
+// require, and arm the lifecycle timer for the earliest reconnect delay still running.
+// Runs on the service thread with the mutex held, after connection state changes, settings
+// changes and expired reconnect delays
+void ws_relay_update(ws_relay_t *relay) {
+    time_t now = time(NULL);
+    time_t next_attempt = 0;
+
+    // True once the reconnect delay since last has passed, otherwise remembers when it will
+    auto delay_passed = [&](time_t last) {
+        time_t due = last + relay->config.reconnect_interval;
+        if (now >= due) return true;
+        next_attempt = next_attempt ? std::min(next_attempt, due) : due;
+        return false;
+    };
+
+    // Before dialing, find out whether another relay on this host already has the remote
+    // connection to share; attached relays leave endpoint choice and standby to the owner
+    bool remote_down = relay->remote_conn.state != WS_STATE_CONNECTED &&
+                       relay->remote_conn.state != WS_STATE_CONNECTING;
+    ws_hub_role_t hub_role = remote_down ? ws_mux_hub_elect(relay) : ws_mux_hub_role(relay);
+    bool attached = hub_role == WS_HUB_ATTACHED;
+
+    // Move away from an endpoint whose latency has degraded, make before break
+    int closer = attached ? -1 : ws_endpoint_degraded(relay, now);
+    if (closer >= 0) {
+        obs_log(LOG_INFO, "Remote RTT above %d ms, switching to %s", relay->config.failover_rtt_ms,
+                relay->endpoints[closer].address);
+        if (relay->endpoint_standby != closer) {
+            ws_connection_close(&relay->standby_conn);
+            relay->endpoint_standby = -1;
+            relay->last_standby_attempt = 0;
         }
+        relay->remote_switch_pending = true;
+        relay->last_endpoint_switch = now;
+    }
 
-        // Second priority: Connect to OBS only if remote is connected
-        if (relay->remote_conn.state == WS_STATE_CONNECTED &&
-            relay->obs_conn.state != WS_STATE_CONNECTED &&
-            relay->obs_conn.state != WS_STATE_CONNECTING &&
-            now - relay->last_reconnect_attempt >= relay->config.reconnect_interval) {
-            if (strlen(relay->config.local_obs_address) > 0) {
-                obs_log(LOG_INFO, "Remote server connected, now connecting to OBS");
-                ws_connect(&relay->obs_conn, relay->config.local_obs_address);
-                relay->last_reconnect_attempt = now;
+    // Switch to the new remote once its connection is up
+    if (relay->remote_switch_pending && relay->standby_conn.state == WS_STATE_CONNECTED) {
+        obs_log(LOG_INFO, "Switching to new remote server");
+        ws_connection_promote(&relay->remote_conn, &relay->standby_conn);
+        relay->endpoint_active = relay->endpoint_standby;
+        relay->endpoint_standby = -1;
+        ws_relay_restart_session(relay);
+        relay->remote_switch_pending = false;
+        relay->last_standby_attempt = now;
+    }
+
+    // Fail over to the standby connection instead of dialing the remote again
+    if (relay->config.enable_standby && !attached &&
+        relay->remote_conn.state != WS_STATE_CONNECTED &&
+        relay->remote_conn.state != WS_STATE_CONNECTING &&
+        relay->standby_conn.state == WS_STATE_CONNECTED) {
+        obs_log(LOG_INFO, "Remote server disconnected, promoting standby connection");
+        ws_connection_promote(&relay->remote_conn, &relay->standby_conn);
+        relay->endpoint_active = relay->endpoint_standby;
+        relay->endpoint_standby = -1;
+        ws_relay_restart_session(relay);
+        relay->last_standby_attempt = now;
+        relay->last_endpoint_switch = now;
+    }
+
+    // First priority: Connect to remote server if needed, trying the endpoints from best to
+    // worst and waiting out the reconnect interval only once all of them have failed
+    if (attached && relay->remote_conn.state != WS_STATE_CONNECTED &&
+        relay->remote_conn.state != WS_STATE_CONNECTING) {
+        if (delay_passed(relay->last_reconnect_attempt)) {
+            obs_log(LOG_INFO, "Attaching to the shared remote connection");
+            if (relay->standby_conn.wsi) {
+                ws_connection_close(&relay->standby_conn);
+            }
+            relay->endpoint_active = -1;
+            relay->endpoint_standby = -1;
+            if (!ws_connect(&relay->remote_conn, ws_mux_hub_address(relay))) {
+                ws_relay_notify(relay);
+            }
+            relay->last_reconnect_attempt = now;
+            relay->remote_switch_pending = false;
+        }
+    } else if (relay->remote_conn.state != WS_STATE_CONNECTED &&
+               relay->remote_conn.state != WS_STATE_CONNECTING &&
+               relay->endpoint_count > 0) {
+        time_t retry_at = 0;
+        int next = ws_endpoint_pick(relay, -1, now, &retry_at);
+        if (next >= 0) {
+            obs_log(LOG_INFO, "Attempting to connect to remote server first");
+            relay->endpoint_active = next;
+            if (!ws_connect(&relay->remote_conn, relay->endpoints[next].address)) {
+                ws_endpoint_failed(relay, next, now);
+                ws_relay_notify(relay);
             }
+            relay->last_reconnect_attempt = now;
+            // A fresh dial already targets the current address
+            relay->remote_switch_pending = false;
+        } else if (retry_at) {
+            next_attempt = next_attempt ? std::min(next_attempt, retry_at) : retry_at;
         }
+    }
+
+    // Second priority: Connect to OBS only if remote is connected, unless the relay
+    // owns the OBS session and can keep it identified on its own
+    if ((relay->remote_conn.state == WS_STATE_CONNECTED || relay->config.auth_offload) &&
+        !ws_obs_api_active(relay) &&
+        relay->obs_conn.state != WS_STATE_CONNECTED &&
+        relay->obs_conn.state != WS_STATE_CONNECTING &&
+        strlen(relay->config.local_obs_address) > 0 &&
+        delay_passed(relay->last_reconnect_attempt)) {
+        obs_log(LOG_INFO, "Remote server connected, now connecting to OBS");
+        ws_connect(&relay->obs_conn, relay->config.local_obs_address);
+        relay->last_reconnect_attempt = now;
+    }
+
+    // Pre-establish the standby (or switch target) connection while the active one is up
+    if ((relay->config.enable_standby || relay->remote_switch_pending) && !attached &&
+        relay->remote_conn.state == WS_STATE_CONNECTED &&
+        relay->standby_conn.state != WS_STATE_CONNECTED &&
+        relay->standby_conn.state != WS_STATE_CONNECTING &&
+        delay_passed(relay->last_standby_attempt)) {
+        // A standby on another endpoint also covers an outage of the active one's region
+        int target = ws_endpoint_pick(relay, relay->endpoint_active, now, NULL);
+        if (target < 0 && !relay->remote_switch_pending) {
+            target = relay->endpoint_active;
+        }
+        if (target >= 0) {
+            relay->endpoint_standby = target;
+            ws_connect(&relay->standby_conn, relay->endpoints[target].address);
+        }
+        relay->last_standby_attempt = now;
+    }
+
+    // If remote disconnects, disconnect OBS as well
+    if (!relay->config.auth_offload &&
+        relay->remote_conn.state != WS_STATE_CONNECTED &&
+        relay->obs_conn.state == WS_STATE_CONNECTED &&
+        relay->obs_conn.wsi) {
+        obs_log(LOG_INFO, "Remote server disconnected, closing OBS connection");
+        ws_connection_close(&relay->obs_conn);
+    }
+
+    // Closed connections may have released window or made room for replay
+    ws_mux_update_window(relay);
+    ws_relay_drain_spill(relay);
+
+    if (next_attempt) {
+        lws_sul_schedule(relay->context, 0, &relay->lifecycle_timer.sul, ws_lifecycle_timer_cb,
+                         (lws_usec_t) (next_attempt - now) * LWS_US_PER_SEC);
+    }
+
+    ws_relay_publish_status(relay);
+}
+
+// Main event loop thread. Connection work happens in lws callbacks and timers; the loop itself
+// only picks up what other threads hand over: settings and probe results, flagged in
+// service_pending, and output of the in-process session, the mirror and the resolver, which
+// flag their own.
+// They wake it through lws_cancel_service, and wakes without a flag set do nothing
+void *ws_relay_thread(void *data) {
+    ws_relay_t *relay = (ws_relay_t *) data;
+
+    obs_log(LOG_INFO, "WebSocket relay thread started");
+    WS_TRACE_THREAD("ws-relay");
+
+    ws_relay_lock(relay);
+    ws_relay_commit_config(relay);
+    pthread_mutex_unlock(&relay->mutex);
+    ws_obs_api_sync(relay);
+    ws_relay_lock(relay);
+    ws_mirror_sync(relay);
+    ws_relay_update(relay);
+    pthread_mutex_unlock(&relay->mutex);
+    lws_sul_schedule(relay->context, 0, &relay->housekeeping_timer.sul, ws_housekeeping_timer_cb, LWS_US_PER_SEC);
 
-        // If remote disconnects, disconnect OBS as well
-        if (relay->remote_conn.state != WS_STATE_CONNECTED &&
-            relay->obs_conn.state == WS_STATE_CONNECTED &&
-            relay->obs_conn.wsi) {
-            obs_log(LOG_INFO, "Remote server disconnected, closing OBS connection");
-            lws_close_reason(relay->obs_conn.wsi, LWS_CLOSE_STATUS_NORMAL, NULL, 0);
-            relay->obs_conn.wsi = NULL;
-            relay->obs_conn.state = WS_STATE_DISCONNECTED;
+    while (os_atomic_load_bool(&relay->running)) {
+        WS_TRACE_SCOPE("service iteration");
+        {
+            WS_TRACE_SCOPE("lws_service");
+            lws_service(relay->context, 0);
         }
 
+        // Cleared before the work it stands for, so a producer setting it meanwhile is not lost
+        bool pending = os_atomic_load_bool(&relay->service_pending);
+        if (pending) os_atomic_store_bool(&relay->service_pending, false);
+        bool obs_api_output = ws_obs_api_output_ready(relay);
+        bool mirror_result = ws_mirror_result_ready(relay);
+        bool resolved = ws_resolver_result_ready(relay);
+        if (!pending && !obs_api_output && !mirror_result && !resolved) continue;
+
+        bool changed = false;
+        if (pending) {
+            ws_relay_lock(relay);
+            changed = relay->config_pending || relay->endpoints_probed;
+            ws_relay_commit_config(relay);
+            relay->endpoints_probed = false;
+            pthread_mutex_unlock(&relay->mutex);
+        }
+        // Attaching to obs-websocket takes locks its event callbacks hold, so not under the mutex.
+        // The version probe that starts a session answers like output does
+        if (pending || obs_api_output) ws_obs_api_sync(relay);
+
+        ws_relay_lock(relay);
+        if (resolved) ws_resolver_flush(relay);
+        ws_obs_api_flush(relay);
+        if (pending) ws_mirror_sync(relay);
+        ws_mirror_flush(relay);
+        if (changed) {
+            ws_relay_update(relay);
+        } else {
+            // Executed requests free window for the remote
+            ws_mux_update_window(relay);
+        }
         pthread_mutex_unlock(&relay->mutex);
     }
 
@@ -22,15 +22,54 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 #include <plugin-support.h>
 #include <util/config-file.h>
 #include <util/dstr.h>
+#include <util/platform.h>
 #include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #define CONFIG_SECTION "ws_relay"
+// The OBS password and relay token live in a file of the plugin's own rather than in the OBS
+// global config, which other plugins and profile backups read; on Unix only the user may read it
+#define SECRETS_FILE "secrets.ini"
 
 // Default configuration values
 #define DEFAULT_LOCAL_OBS_ADDRESS "ws://localhost:4455"
 #define DEFAULT_REMOTE_WS_ADDRESS ""
 #define DEFAULT_RECONNECT_INTERVAL 5
 #define DEFAULT_ENABLE_LOGGING false
+#define DEFAULT_DNS_CACHE_TTL 300
+#define DEFAULT_ENABLE_STANDBY false
+#define DEFAULT_MAX_QUEUED_KB (64 * 1024)
+#define DEFAULT_MAX_QUEUED_REMOTE_KB 0
+#define DEFAULT_MAX_QUEUED_OBS_KB 0
+#define DEFAULT_DROP_POLICY WS_DROP_OLDEST_EVENT
+#define DEFAULT_PING_INTERVAL 10
+#define DEFAULT_PING_MAX_MISSED 3
+#define DEFAULT_AUTH_OFFLOAD false
+#define DEFAULT_MUX_CHANNEL 0
+#define DEFAULT_MUX_WINDOW_KB 1024
+#define DEFAULT_MUX_SHARE true
+#define DEFAULT_LATENCY_STAMPING false
+#define DEFAULT_SPILL_ENABLED false
+#define DEFAULT_SPILL_MAX_MB 256
+#define DEFAULT_SPILL_TTL 3600
+#define DEFAULT_SPILL_DRAIN_KBPS 512
+#define DEFAULT_UPLINK_RATE_KBPS 0
+#define DEFAULT_UPLINK_BURST_KB 64
+#define DEFAULT_UPLINK_ADAPTIVE false
+#define DEFAULT_ENDPOINT_PROBE_INTERVAL 60
+#define DEFAULT_FAILOVER_RTT_MS 0
+#define DEFAULT_OBS_IN_PROCESS false
+#define DEFAULT_STATE_MIRROR false
+#define DEFAULT_STATE_PUSH false
+#define DEFAULT_RX_BUFFER_MAX_KB 256
+#define DEFAULT_WRITE_COALESCE_KB 16
+#define DEFAULT_ADMISSION_MAX_INFLIGHT 0
+#define DEFAULT_ADMISSION_QUEUE_MS 2000
+#define DEFAULT_ADMISSION_WEIGHTS "GetSourceScreenshot=4, SaveSourceScreenshot=4, RequestBatch=4"
 
 void ws_relay_config_init(ws_relay_config_t *config) {
     if (!config)
@@ -42,6 +81,38 @@ void ws_relay_config_init(ws_relay_config_t *config) {
     config->remote_ws_address = bstrdup(DEFAULT_REMOTE_WS_ADDRESS);
     config->reconnect_interval = DEFAULT_RECONNECT_INTERVAL;
     config->enable_logging = DEFAULT_ENABLE_LOGGING;
+    config->dns_cache_ttl = DEFAULT_DNS_CACHE_TTL;
+    config->enable_standby = DEFAULT_ENABLE_STANDBY;
+    config->max_queued_kb = DEFAULT_MAX_QUEUED_KB;
+    config->max_queued_remote_kb = DEFAULT_MAX_QUEUED_REMOTE_KB;
+    config->max_queued_obs_kb = DEFAULT_MAX_QUEUED_OBS_KB;
+    config->drop_policy = DEFAULT_DROP_POLICY;
+    config->ping_interval = DEFAULT_PING_INTERVAL;
+    config->ping_max_missed = DEFAULT_PING_MAX_MISSED;
+    config->auth_offload = DEFAULT_AUTH_OFFLOAD;
+    config->obs_password = bstrdup("");
+    config->relay_token = bstrdup("");
+    config->mux_channel = DEFAULT_MUX_CHANNEL;
+    config->mux_window_kb = DEFAULT_MUX_WINDOW_KB;
+    config->mux_share = DEFAULT_MUX_SHARE;
+    config->latency_stamping = DEFAULT_LATENCY_STAMPING;
+    config->spill_enabled = DEFAULT_SPILL_ENABLED;
+    config->spill_max_mb = DEFAULT_SPILL_MAX_MB;
+    config->spill_ttl = DEFAULT_SPILL_TTL;
+    config->spill_drain_kbps = DEFAULT_SPILL_DRAIN_KBPS;
+    config->uplink_rate_kbps = DEFAULT_UPLINK_RATE_KBPS;
+    config->uplink_burst_kb = DEFAULT_UPLINK_BURST_KB;
+    config->uplink_adaptive = DEFAULT_UPLINK_ADAPTIVE;
+    config->endpoint_probe_interval = DEFAULT_ENDPOINT_PROBE_INTERVAL;
+    config->failover_rtt_ms = DEFAULT_FAILOVER_RTT_MS;
+    config->obs_in_process = DEFAULT_OBS_IN_PROCESS;
+    config->state_mirror = DEFAULT_STATE_MIRROR;
+    config->state_push = DEFAULT_STATE_PUSH;
+    config->rx_buffer_max_kb = DEFAULT_RX_BUFFER_MAX_KB;
+    config->write_coalesce_kb = DEFAULT_WRITE_COALESCE_KB;
+    config->admission_max_inflight = DEFAULT_ADMISSION_MAX_INFLIGHT;
+    config->admission_queue_ms = DEFAULT_ADMISSION_QUEUE_MS;
+    config->admission_weights = bstrdup(DEFAULT_ADMISSION_WEIGHTS);
 }
 
 void ws_relay_config_free(ws_relay_config_t *config) {
@@ -50,10 +121,102 @@ void ws_relay_config_free(ws_relay_config_t *config) {
 
     bfree(config->local_obs_address);
     bfree(config->remote_ws_address);
+    bfree(config->obs_password);
+    bfree(config->relay_token);
+    bfree(config->admission_weights);
 
     memset(config, 0, sizeof(ws_relay_config_t));
 }
 
+void ws_relay_config_copy(ws_relay_config_t *dst, const ws_relay_config_t *src) {
+    if (!dst || !src || dst == src)
+        return;
+
+    bfree(dst->local_obs_address);
+    bfree(dst->remote_ws_address);
+    bfree(dst->obs_password);
+    bfree(dst->relay_token);
+    bfree(dst->admission_weights);
+
+    *dst = *src;
+
+    // Empty addresses fall back to the defaults, as in ws_relay_config_load
+    dst->local_obs_address = bstrdup(src->local_obs_address && strlen(src->local_obs_address) > 0
+                                         ? src->local_obs_address
+                                         : DEFAULT_LOCAL_OBS_ADDRESS);
+    dst->remote_ws_address = bstrdup(src->remote_ws_address && strlen(src->remote_ws_address) > 0
+                                         ? src->remote_ws_address
+                                         : DEFAULT_REMOTE_WS_ADDRESS);
+    dst->obs_password = bstrdup(src->obs_password ? src->obs_password : "");
+    dst->relay_token = bstrdup(src->relay_token ? src->relay_token : "");
+    dst->admission_weights = bstrdup(src->admission_weights ? src->admission_weights : "");
+}
+
+static char *secrets_path(void) {
+    char *dir = obs_module_config_path("");
+    if (!dir || os_mkdirs(dir) == MKDIR_ERROR) {
+        obs_log(LOG_WARNING, "Failed to create plugin config directory %s", dir ? dir : "(null)");
+        bfree(dir);
+        return NULL;
+    }
+    bfree(dir);
+    return obs_module_config_path(SECRETS_FILE);
+}
+
+static config_t *open_secrets(void) {
+    char *path = secrets_path();
+    if (!path) return NULL;
+
+#ifndef _WIN32
+    // Created private before anything is written to it; config_save keeps the mode
+    int fd = open(path, O_WRONLY | O_CREAT, 0600);
+    if (fd >= 0) {
+        close(fd);
+    }
+    chmod(path, 0600);
+#endif
+
+    config_t *secrets = NULL;
+    if (config_open(&secrets, path, CONFIG_OPEN_ALWAYS) != CONFIG_SUCCESS) {
+        obs_log(LOG_WARNING, "Failed to open %s", path);
+        secrets = NULL;
+    }
+    bfree(path);
+    return secrets;
+}
+
+static void load_secret(config_t *secrets, config_t *obs_config, const char *name, char **value, bool *moved) {
+    const char *stored = NULL;
+    if (secrets && config_has_user_value(secrets, CONFIG_SECTION, name)) {
+        stored = config_get_string(secrets, CONFIG_SECTION, name);
+    } else if (config_has_user_value(obs_config, CONFIG_SECTION, name)) {
+        // Saved by an earlier version in the global config; moved to the secrets file
+        stored = config_get_string(obs_config, CONFIG_SECTION, name);
+        if (secrets) {
+            config_set_string(secrets, CONFIG_SECTION, name, stored ? stored : "");
+            *moved = true;
+        }
+    }
+
+    bfree(*value);
+    *value = bstrdup(stored ? stored : "");
+}
+
+static void load_secrets(config_t *obs_config, ws_relay_config_t *config) {
+    config_t *secrets = open_secrets();
+    bool moved = false;
+    load_secret(secrets, obs_config, "obs_password", &config->obs_password, &moved);
+    load_secret(secrets, obs_config, "relay_token", &config->relay_token, &moved);
+
+    if (moved && config_save(secrets) == CONFIG_SUCCESS) {
+        config_remove_value(obs_config, CONFIG_SECTION, "obs_password");
+        config_remove_value(obs_config, CONFIG_SECTION, "relay_token");
+        config_save(obs_config);
+        obs_log(LOG_INFO, "Moved the OBS password and relay token out of the OBS global config");
+    }
+    if (secrets) config_close(secrets);
+}
+
 bool ws_relay_config_load(ws_relay_config_t *config) {
     if (!config)
         return false;
@@ -85,13 +248,212 @@ bool ws_relay_config_load(ws_relay_config_t *config) {
 
     config->enable_logging = config_get_bool(obs_config, CONFIG_SECTION, "enable_logging");
 
+    if (config_has_user_value(obs_config, CONFIG_SECTION, "dns_cache_ttl")) {
+        config->dns_cache_ttl = (int) config_get_int(obs_config, CONFIG_SECTION, "dns_cache_ttl");
+        if (config->dns_cache_ttl < 0) {
+            config->dns_cache_ttl = DEFAULT_DNS_CACHE_TTL;
+        }
+    }
+
+    config->enable_standby = config_get_bool(obs_config, CONFIG_SECTION, "enable_standby");
+
+    if (config_has_user_value(obs_config, CONFIG_SECTION, "max_queued_kb")) {
+        config->max_queued_kb = (int) config_get_int(obs_config, CONFIG_SECTION, "max_queued_kb");
+        if (config->max_queued_kb < 0) {
+            config->max_queued_kb = DEFAULT_MAX_QUEUED_KB;
+        }
+    }
+
+    config->max_queued_remote_kb = (int) config_get_int(obs_config, CONFIG_SECTION, "max_queued_remote_kb");
+    if (config->max_queued_remote_kb < 0) {
+        config->max_queued_remote_kb = DEFAULT_MAX_QUEUED_REMOTE_KB;
+    }
+
+    config->max_queued_obs_kb = (int) config_get_int(obs_config, CONFIG_SECTION, "max_queued_obs_kb");
+    if (config->max_queued_obs_kb < 0) {
+        config->max_queued_obs_kb = DEFAULT_MAX_QUEUED_OBS_KB;
+    }
+
+    int drop_policy = (int) config_get_int(obs_config, CONFIG_SECTION, "drop_policy");
+    if (drop_policy < WS_DROP_OLDEST_EVENT || drop_policy > WS_DROP_DISCONNECT) {
+        drop_policy = DEFAULT_DROP_POLICY;
+    }
+    config->drop_policy = (ws_drop_policy_t) drop_policy;
+
+    if (config_has_user_value(obs_config, CONFIG_SECTION, "ping_interval")) {
+        config->ping_interval = (int) config_get_int(obs_config, CONFIG_SECTION, "ping_interval");
+        if (config->ping_interval < 0) {
+            config->ping_interval = DEFAULT_PING_INTERVAL;
+        }
+    }
+
+    config->ping_max_missed = (int) config_get_int(obs_config, CONFIG_SECTION, "ping_max_missed");
+    if (config->ping_max_missed <= 0) {
+        config->ping_max_missed = DEFAULT_PING_MAX_MISSED;
+    }
+
+    config->auth_offload = config_get_bool(obs_config, CONFIG_SECTION, "auth_offload");
+
+    load_secrets(obs_config, config);
+
+    config->mux_channel = (int) config_get_int(obs_config, CONFIG_SECTION, "mux_channel");
+    if (config->mux_channel < 0 || config->mux_channel > UINT16_MAX) {
+        config->mux_channel = DEFAULT_MUX_CHANNEL;
+    }
+
+    if (config_has_user_value(obs_config, CONFIG_SECTION, "mux_window_kb")) {
+        config->mux_window_kb = (int) config_get_int(obs_config, CONFIG_SECTION, "mux_window_kb");
+        if (config->mux_window_kb < 0 || config->mux_window_kb > (int) (UINT32_MAX / 1024)) {
+            config->mux_window_kb = DEFAULT_MUX_WINDOW_KB;
+        }
+    }
+
+    if (config_has_user_value(obs_config, CONFIG_SECTION, "mux_share")) {
+        config->mux_share = config_get_bool(obs_config, CONFIG_SECTION, "mux_share");
+    }
+
+    config->latency_stamping = config_get_bool(obs_config, CONFIG_SECTION, "latency_stamping");
+
+    config->obs_in_process = config_get_bool(obs_config, CONFIG_SECTION, "obs_in_process");
+
+    config->state_mirror = config_get_bool(obs_config, CONFIG_SECTION, "state_mirror");
+    config->state_push = config_get_bool(obs_config, CONFIG_SECTION, "state_push");
+
+    config->spill_enabled = config_get_bool(obs_config, CONFIG_SECTION, "spill_enabled");
+
+    config->spill_max_mb = (int) config_get_int(obs_config, CONFIG_SECTION, "spill_max_mb");
+    if (config->spill_max_mb <= 0) {
+        config->spill_max_mb = DEFAULT_SPILL_MAX_MB;
+    }
+
+    if (config_has_user_value(obs_config, CONFIG_SECTION, "spill_ttl")) {
+        config->spill_ttl = (int) config_get_int(obs_config, CONFIG_SECTION, "spill_ttl");
+        if (config->spill_ttl < 0) {
+            config->spill_ttl = DEFAULT_SPILL_TTL;
+        }
+    }
+
+    if (config_has_user_value(obs_config, CONFIG_SECTION, "spill_drain_kbps")) {
+        config->spill_drain_kbps = (int) config_get_int(obs_config, CONFIG_SECTION, "spill_drain_kbps");
+        if (config->spill_drain_kbps < 0) {
+            config->spill_drain_kbps = DEFAULT_SPILL_DRAIN_KBPS;
+        }
+    }
+
+    config->uplink_rate_kbps = (int) config_get_int(obs_config, CONFIG_SECTION, "uplink_rate_kbps");
+    if (config->uplink_rate_kbps < 0) {
+        config->uplink_rate_kbps = DEFAULT_UPLINK_RATE_KBPS;
+    }
+
+    config->uplink_burst_kb = (int) config_get_int(obs_config, CONFIG_SECTION, "uplink_burst_kb");
+    if (config->uplink_burst_kb <= 0) {
+        config->uplink_burst_kb = DEFAULT_UPLINK_BURST_KB;
+    }
+
+    config->uplink_adaptive = config_get_bool(obs_config, CONFIG_SECTION, "uplink_adaptive");
+
+    if (config_has_user_value(obs_config, CONFIG_SECTION, "endpoint_probe_interval")) {
+        config->endpoint_probe_interval = (int) config_get_int(obs_config, CONFIG_SECTION, "endpoint_probe_interval");
+        if (config->endpoint_probe_interval < 0) {
+            config->endpoint_probe_interval = DEFAULT_ENDPOINT_PROBE_INTERVAL;
+        }
+    }
+
+    config->failover_rtt_ms = (int) config_get_int(obs_config, CONFIG_SECTION, "failover_rtt_ms");
+    if (config->failover_rtt_ms < 0) {
+        config->failover_rtt_ms = DEFAULT_FAILOVER_RTT_MS;
+    }
+
+    config->rx_buffer_max_kb = (int) config_get_int(obs_config, CONFIG_SECTION, "rx_buffer_max_kb");
+    if (config->rx_buffer_max_kb <= 0) {
+        config->rx_buffer_max_kb = DEFAULT_RX_BUFFER_MAX_KB;
+    }
+
+    if (config_has_user_value(obs_config, CONFIG_SECTION, "write_coalesce_kb")) {
+        config->write_coalesce_kb = (int) config_get_int(obs_config, CONFIG_SECTION, "write_coalesce_kb");
+        if (config->write_coalesce_kb < 0) {
+            config->write_coalesce_kb = DEFAULT_WRITE_COALESCE_KB;
+        }
+    }
+
+    config->admission_max_inflight = (int) config_get_int(obs_config, CONFIG_SECTION, "admission_max_inflight");
+    if (config->admission_max_inflight < 0) {
+        config->admission_max_inflight = DEFAULT_ADMISSION_MAX_INFLIGHT;
+    }
+
+    if (config_has_user_value(obs_config, CONFIG_SECTION, "admission_queue_ms")) {
+        config->admission_queue_ms = (int) config_get_int(obs_config, CONFIG_SECTION, "admission_queue_ms");
+        if (config->admission_queue_ms < 0) {
+            config->admission_queue_ms = DEFAULT_ADMISSION_QUEUE_MS;
+        }
+    }
+
+    if (config_has_user_value(obs_config, CONFIG_SECTION, "admission_weights")) {
+        const char *admission_weights = config_get_string(obs_config, CONFIG_SECTION, "admission_weights");
+        bfree(config->admission_weights);
+        config->admission_weights = bstrdup(admission_weights ? admission_weights : "");
+    }
+
     obs_log(LOG_INFO, "Configuration loaded - Local: %s, Remote: %s, Reconnect: %ds, Logging: %s",
             config->local_obs_address, config->remote_ws_address, config->reconnect_interval,
             config->enable_logging ? "enabled" : "disabled");
+    obs_log(LOG_INFO, "Configuration loaded - DNS cache TTL: %ds, Standby connection: %s",
+            config->dns_cache_ttl, config->enable_standby ? "enabled" : "disabled");
+    obs_log(LOG_INFO, "Configuration loaded - Queue budget: %d KiB (remote %d KiB, OBS %d KiB), Drop policy: %d",
+            config->max_queued_kb, config->max_queued_remote_kb, config->max_queued_obs_kb,
+            (int) config->drop_policy);
+    obs_log(LOG_INFO, "Configuration loaded - Ping interval: %ds, Max missed pongs: %d", config->ping_interval,
+            config->ping_max_missed);
+    obs_log(LOG_INFO, "Configuration loaded - Authentication offload: %s, In-process OBS requests: %s",
+            config->auth_offload ? "enabled" : "disabled", config->obs_in_process ? "enabled" : "disabled");
+    obs_log(LOG_INFO, "Configuration loaded - State mirror: %s, Push state snapshot: %s",
+            config->state_mirror ? "enabled" : "disabled", config->state_push ? "enabled" : "disabled");
+    obs_log(LOG_INFO, "Configuration loaded - Multiplexing channel: %d, Window: %d KiB, Sharing: %s, Latency stamping: %s",
+            config->mux_channel, config->mux_window_kb, config->mux_share ? "enabled" : "disabled",
+            config->latency_stamping ? "enabled" : "disabled");
+    obs_log(LOG_INFO, "Configuration loaded - Spill log: %s, Cap: %d MiB, TTL: %ds, Replay rate: %d KiB/s",
+            config->spill_enabled ? "enabled" : "disabled", config->spill_max_mb, config->spill_ttl,
+            config->spill_drain_kbps);
+    obs_log(LOG_INFO, "Configuration loaded - Uplink rate: %d KiB/s, Burst: %d KiB, Adaptive: %s",
+            config->uplink_rate_kbps, config->uplink_burst_kb, config->uplink_adaptive ? "enabled" : "disabled");
+    obs_log(LOG_INFO, "Configuration loaded - Endpoint probe interval: %ds, Failover RTT: %d ms",
+            config->endpoint_probe_interval, config->failover_rtt_ms);
+    obs_log(LOG_INFO, "Configuration loaded - Max receive buffer: %d KiB, Write coalescing: %d KiB",
+            config->rx_buffer_max_kb, config->write_coalesce_kb);
+    obs_log(LOG_INFO, "Configuration loaded - Requests in flight: %d, Admission queue: %d ms, Weights: %s",
+            config->admission_max_inflight, config->admission_queue_ms, config->admission_weights);
 
     return true;
 }
 
+// Setters that leave values the user config already holds alone and report whether anything changed
+static void set_string(config_t *obs_config, const char *name, const char *value, bool *changed) {
+    const char *current = config_get_string(obs_config, CONFIG_SECTION, name);
+    if (config_has_user_value(obs_config, CONFIG_SECTION, name) && current && strcmp(current, value ? value : "") == 0)
+        return;
+
+    config_set_string(obs_config, CONFIG_SECTION, name, value ? value : "");
+    *changed = true;
+}
+
+static void set_int(config_t *obs_config, const char *name, int64_t value, bool *changed) {
+    if (config_has_user_value(obs_config, CONFIG_SECTION, name) &&
+        config_get_int(obs_config, CONFIG_SECTION, name) == value)
+        return;
+
+    config_set_int(obs_config, CONFIG_SECTION, name, value);
+    *changed = true;
+}
+
+static void set_bool(config_t *obs_config, const char *name, bool value, bool *changed) {
+    if (config_has_user_value(obs_config, CONFIG_SECTION, name) &&
+        config_get_bool(obs_config, CONFIG_SECTION, name) == value)
+        return;
+
+    config_set_bool(obs_config, CONFIG_SECTION, name, value);
+    *changed = true;
+}
+
 bool ws_relay_config_save(const ws_relay_config_t *config) {
     if (!config)
         return false;
@@ -102,28 +464,77 @@ bool ws_relay_config_save(const ws_relay_config_t *config) {
         return false;
     }
 
-    // Save configuration values
-    config_set_string(obs_config, CONFIG_SECTION, "local_obs_address", config->local_obs_address);
-    config_set_string(obs_config, CONFIG_SECTION, "remote_ws_address", config->remote_ws_address);
-    config_set_int(obs_config, CONFIG_SECTION, "reconnect_interval", config->reconnect_interval);
-    config_set_bool(obs_config, CONFIG_SECTION, "enable_logging", config->enable_logging);
+    // Save configuration values, only writing the file if one of them changed
+    bool changed = false;
+    set_string(obs_config, "local_obs_address", config->local_obs_address, &changed);
+    set_string(obs_config, "remote_ws_address", config->remote_ws_address, &changed);
+    set_int(obs_config, "reconnect_interval", config->reconnect_interval, &changed);
+    set_bool(obs_config, "enable_logging", config->enable_logging, &changed);
+    set_int(obs_config, "dns_cache_ttl", config->dns_cache_ttl, &changed);
+    set_bool(obs_config, "enable_standby", config->enable_standby, &changed);
+    set_int(obs_config, "max_queued_kb", config->max_queued_kb, &changed);
+    set_int(obs_config, "max_queued_remote_kb", config->max_queued_remote_kb, &changed);
+    set_int(obs_config, "max_queued_obs_kb", config->max_queued_obs_kb, &changed);
+    set_int(obs_config, "drop_policy", config->drop_policy, &changed);
+    set_int(obs_config, "ping_interval", config->ping_interval, &changed);
+    set_int(obs_config, "ping_max_missed", config->ping_max_missed, &changed);
+    set_bool(obs_config, "auth_offload", config->auth_offload, &changed);
+    set_bool(obs_config, "obs_in_process", config->obs_in_process, &changed);
+    set_bool(obs_config, "state_mirror", config->state_mirror, &changed);
+    set_bool(obs_config, "state_push", config->state_push, &changed);
+    set_int(obs_config, "mux_channel", config->mux_channel, &changed);
+    set_int(obs_config, "mux_window_kb", config->mux_window_kb, &changed);
+    set_bool(obs_config, "mux_share", config->mux_share, &changed);
+    set_bool(obs_config, "latency_stamping", config->latency_stamping, &changed);
+    set_bool(obs_config, "spill_enabled", config->spill_enabled, &changed);
+    set_int(obs_config, "spill_max_mb", config->spill_max_mb, &changed);
+    set_int(obs_config, "spill_ttl", config->spill_ttl, &changed);
+    set_int(obs_config, "spill_drain_kbps", config->spill_drain_kbps, &changed);
+    set_int(obs_config, "uplink_rate_kbps", config->uplink_rate_kbps, &changed);
+    set_int(obs_config, "uplink_burst_kb", config->uplink_burst_kb, &changed);
+    set_bool(obs_config, "uplink_adaptive", config->uplink_adaptive, &changed);
+    set_int(obs_config, "endpoint_probe_interval", config->endpoint_probe_interval, &changed);
+    set_int(obs_config, "failover_rtt_ms", config->failover_rtt_ms, &changed);
+    set_int(obs_config, "rx_buffer_max_kb", config->rx_buffer_max_kb, &changed);
+    set_int(obs_config, "write_coalesce_kb", config->write_coalesce_kb, &changed);
+    set_int(obs_config, "admission_max_inflight", config->admission_max_inflight, &changed);
+    set_int(obs_config, "admission_queue_ms", config->admission_queue_ms, &changed);
+    set_string(obs_config, "admission_weights", config->admission_weights, &changed);
 
-    config_save(obs_config);
+    if (changed) {
+        config_save(obs_config);
+        obs_log(LOG_INFO, "Configuration saved");
+    } else {
+        obs_log(LOG_DEBUG, "Configuration unchanged, not saved");
+    }
 
-    obs_log(LOG_INFO, "Configuration saved");
+    config_t *secrets = open_secrets();
+    if (secrets) {
+        bool secrets_changed = false;
+        set_string(secrets, "obs_password", config->obs_password, &secrets_changed);
+        set_string(secrets, "relay_token", config->relay_token, &secrets_changed);
+        if (secrets_changed) {
+            config_save(secrets);
+        }
+        config_close(secrets);
+    } else {
+        obs_log(LOG_WARNING, "OBS password and relay token not saved");
+    }
 
-    // Stop and restart the relay if running
+    // Apply the new settings to the relay in place, keeping its connections and TLS state
     if (global_relay) {
-        ws_relay_stop(global_relay);
-        ws_relay_destroy(global_relay);
-        global_relay = ws_relay_create(config);
+        ws_relay_apply_config(global_relay, config);
 
         if (config->remote_ws_address && strlen(config->remote_ws_address) > 0) {
-            if (ws_relay_start(global_relay)) {
-                obs_log(LOG_INFO, "WebSocket relay started successfully");
-            } else {
-                obs_log(LOG_ERROR, "Failed to start WebSocket relay");
+            if (!ws_relay_is_running(global_relay)) {
+                if (ws_relay_start(global_relay)) {
+                    obs_log(LOG_INFO, "WebSocket relay started successfully");
+                } else {
+                    obs_log(LOG_ERROR, "Failed to start WebSocket relay");
+                }
             }
+        } else {
+            ws_relay_stop(global_relay);
         }
     }
 
@@ -0,0 +1,237 @@
+/*
+OBS WebSocket Relay - Remote Endpoint Selection
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "ws-relay-internal.h"
+#include <obs-module.h>
+#include <plugin-support.h>
+#include <util/threading.h>
+#include <libwebsockets.h>
+#include <errno.h>
+
+// Characters separating the entries of the remote address list
+#define WS_ENDPOINT_SEPARATORS ", \t\r\n"
+
+static int ws_endpoint_find(ws_endpoint_t *endpoints, size_t count, const char *address) {
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(endpoints[i].address, address) == 0) return (int) i;
+    }
+    return -1;
+}
+
+// Re-read the endpoint list from the configured remote addresses, keeping the probe results
+// and failures of endpoints that stay in the list. Called with the mutex held
+void ws_endpoints_update(ws_relay_t *relay) {
+    const char *list = relay->config.remote_ws_address ? relay->config.remote_ws_address : "";
+
+    size_t capacity = 0;
+    for (const char *p = list; *p;) {
+        p += strspn(p, WS_ENDPOINT_SEPARATORS);
+        if (!*p) break;
+        capacity++;
+        p += strcspn(p, WS_ENDPOINT_SEPARATORS);
+    }
+
+    ws_endpoint_t *endpoints = capacity ? (ws_endpoint_t *) bzalloc(capacity * sizeof(ws_endpoint_t)) : NULL;
+    size_t count = 0;
+    for (const char *p = list; *p;) {
+        p += strspn(p, WS_ENDPOINT_SEPARATORS);
+        if (!*p) break;
+        size_t len = strcspn(p, WS_ENDPOINT_SEPARATORS);
+        char *address = bstrdup_n(p, len);
+        p += len;
+
+        if (ws_endpoint_find(endpoints, count, address) >= 0) {
+            bfree(address);
+            continue;
+        }
+
+        ws_endpoint_t *endpoint = &endpoints[count++];
+        int old = ws_endpoint_find(relay->endpoints, relay->endpoint_count, address);
+        if (old >= 0) {
+            *endpoint = relay->endpoints[old];
+        } else {
+            endpoint->rtt_us = -1;
+        }
+        endpoint->address = address;
+    }
+
+    // Connections keep their endpoint if it is still listed
+    int active = relay->endpoint_active >= 0
+                     ? ws_endpoint_find(endpoints, count, relay->endpoints[relay->endpoint_active].address)
+                     : -1;
+    int standby = relay->endpoint_standby >= 0
+                      ? ws_endpoint_find(endpoints, count, relay->endpoints[relay->endpoint_standby].address)
+                      : -1;
+
+    ws_endpoints_free(relay);
+    relay->endpoints = endpoints;
+    relay->endpoint_count = count;
+    relay->endpoint_active = active;
+    relay->endpoint_standby = standby;
+}
+
+void ws_endpoints_free(ws_relay_t *relay) {
+    for (size_t i = 0; i < relay->endpoint_count; i++) {
+        bfree(relay->endpoints[i].address);
+    }
+    bfree(relay->endpoints);
+    relay->endpoints = NULL;
+    relay->endpoint_count = 0;
+    relay->endpoint_active = -1;
+    relay->endpoint_standby = -1;
+}
+
+// Endpoints with a measured RTT come first, then unprobed ones, then unreachable ones; the
+// configured order breaks ties
+static int ws_endpoint_rank(const ws_endpoint_t *endpoint) {
+    if (endpoint->rtt_us >= 0) return 0;
+    return endpoint->unreachable ? 2 : 1;
+}
+
+static bool ws_endpoint_better(const ws_endpoint_t *a, const ws_endpoint_t *b) {
+    int rank_a = ws_endpoint_rank(a);
+    int rank_b = ws_endpoint_rank(b);
+    if (rank_a != rank_b) return rank_a < rank_b;
+
+    return rank_a == 0 && a->rtt_us < b->rtt_us;
+}
+
+// Pick the best endpoint to connect to, skipping exclude and endpoints still waiting out the
+// reconnect interval after a failure. Returns -1 if there is none; retry_at then tells when the
+// next one becomes eligible. Called with the mutex held
+int ws_endpoint_pick(ws_relay_t *relay, int exclude, time_t now, time_t *retry_at) {
+    int best = -1;
+
+    for (size_t i = 0; i < relay->endpoint_count; i++) {
+        if ((int) i == exclude) continue;
+
+        ws_endpoint_t *endpoint = &relay->endpoints[i];
+        time_t due = endpoint->failed_at ? endpoint->failed_at + relay->config.reconnect_interval : 0;
+        if (due > now) {
+            if (retry_at && (!*retry_at || due < *retry_at)) *retry_at = due;
+            continue;
+        }
+
+        if (best < 0 || ws_endpoint_better(endpoint, &relay->endpoints[best])) {
+            best = (int) i;
+        }
+    }
+
+    return best;
+}
+
+// A connection to the endpoint failed or was lost; called with the mutex held
+void ws_endpoint_failed(ws_relay_t *relay, int index, time_t now) {
+    if (index < 0 || (size_t) index >= relay->endpoint_count) return;
+
+    relay->endpoints[index].failed_at = now;
+}
+
+// A connection to the endpoint is up; called with the mutex held
+void ws_endpoint_connected(ws_relay_t *relay, int index) {
+    if (index < 0 || (size_t) index >= relay->endpoint_count) return;
+
+    relay->endpoints[index].failed_at = 0;
+}
+
+// Returns the endpoint to move to if the active one's probed RTT has degraded past the failover
+// threshold and another endpoint is below it, otherwise -1. Called with the mutex held
+int ws_endpoint_degraded(ws_relay_t *relay, time_t now) {
+    int active = relay->endpoint_active;
+    if (relay->config.failover_rtt_ms <= 0 || relay->endpoint_count < 2 || active < 0 ||
+        relay->remote_conn.state != WS_STATE_CONNECTED || relay->remote_switch_pending) {
+        return -1;
+    }
+
+    // Give a new endpoint time to settle, so two similar regions do not flap
+    if (now - relay->last_endpoint_switch < WS_ENDPOINT_SWITCH_HOLDDOWN) return -1;
+
+    int64_t threshold = (int64_t) relay->config.failover_rtt_ms * 1000;
+    ws_endpoint_t *current = &relay->endpoints[active];
+    if (current->rtt_us <= threshold) return -1;
+
+    int best = ws_endpoint_pick(relay, active, now, NULL);
+    if (best < 0 || relay->endpoints[best].rtt_us < 0 || relay->endpoints[best].rtt_us >= threshold) return -1;
+
+    return best;
+}
+
+// Probe every endpoint in the background and hand the results to the service thread. Each probe
+// uses a connection of its own, so the relay's connections are not disturbed
+void *ws_endpoint_probe_thread(void *data) {
+    ws_relay_t *relay = (ws_relay_t *) data;
+    os_set_thread_name("ws-relay-probe");
+
+    unsigned long wait_ms = 0; // The first round runs right away
+    while (os_event_timedwait(relay->probe_stop, wait_ms) == ETIMEDOUT) {
+        std::vector<char *> addresses;
+
+        pthread_mutex_lock(&relay->mutex);
+        int interval = relay->config.endpoint_probe_interval;
+        if (interval > 0 && relay->endpoint_count > 1) {
+            for (size_t i = 0; i < relay->endpoint_count; i++) {
+                addresses.push_back(bstrdup(relay->endpoints[i].address));
+            }
+        }
+        pthread_mutex_unlock(&relay->mutex);
+
+        wait_ms = interval > 0 ? (unsigned long) interval * 1000 : WS_ENDPOINT_PROBE_IDLE_MS;
+
+        for (char *address: addresses) {
+            ws_probe_result_t result;
+            if (os_event_try(relay->probe_stop) != EAGAIN) {
+                bfree(address);
+                continue;
+            }
+            // Stopping the relay cancels a probe in flight rather than waiting out its pings
+            ws_probe_endpoint_cancellable(address, "websocket", WS_ENDPOINT_PROBE_PINGS, WS_ENDPOINT_PROBE_TIMEOUT_MS,
+                                          relay->probe_stop, &result);
+            if (os_event_try(relay->probe_stop) != EAGAIN) {
+                bfree(address);
+                continue;
+            }
+
+            pthread_mutex_lock(&relay->mutex);
+            int index = ws_endpoint_find(relay->endpoints, relay->endpoint_count, address);
+            if (index >= 0) {
+                ws_endpoint_t *endpoint = &relay->endpoints[index];
+                endpoint->unreachable = !result.success;
+                endpoint->rtt_us = result.success ? (int64_t) result.rtt_median_us : -1;
+            }
+            if (relay->config.enable_logging) {
+                if (result.success) {
+                    obs_log(LOG_INFO, "Probed %s: median RTT %.1f ms", address, result.rtt_median_us / 1000.0);
+                } else {
+                    obs_log(LOG_INFO, "Probed %s: %s", address, result.error);
+                }
+            }
+            pthread_mutex_unlock(&relay->mutex);
+            bfree(address);
+        }
+
+        if (!addresses.empty()) {
+            pthread_mutex_lock(&relay->mutex);
+            relay->endpoints_probed = true;
+            pthread_mutex_unlock(&relay->mutex);
+            os_atomic_store_bool(&relay->service_pending, true);
+            lws_cancel_service(relay->context);
+        }
+    }
+
+    return NULL;
+}
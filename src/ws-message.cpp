@@ -0,0 +1,467 @@
+/*
+OBS WebSocket Relay - Message Inspection
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "ws-relay-internal.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+#define WS_SCAN_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define WS_TARGET_AVX2
+#else
+#define WS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define WS_SCAN_X86 0
+#endif
+
+// obs-websocket op codes
+#define WS_OP_EVENT 5
+#define WS_OP_REQUEST 6
+#define WS_OP_REQUEST_RESPONSE 7
+#define WS_OP_REQUEST_BATCH 8
+#define WS_OP_REQUEST_BATCH_RESPONSE 9
+
+// Events obs-websocket only sends to clients that explicitly subscribe to high-volume events
+static const char *const high_volume_events[] = {
+    "InputVolumeMeters",
+    "InputActiveStateChanged",
+    "InputShowStateChanged",
+    "SceneItemTransformChanged",
+};
+
+static inline bool key_equals(const char *key, size_t key_len, const char *name) {
+    size_t name_len = strlen(name);
+    return key_len == name_len && memcmp(key, name, name_len) == 0;
+}
+
+static inline size_t skip_whitespace(const char *data, size_t len, size_t i) {
+    while (i < len && (data[i] == ' ' || data[i] == '\t' || data[i] == '\n' || data[i] == '\r')) i++;
+    return i;
+}
+
+// Structural character search used by the scanner, one per instruction set. Returns the index
+// of the first match at or after i, or len if there is none.
+typedef size_t (*ws_find_fn)(const char *data, size_t len, size_t i);
+
+static inline bool is_structural(char c) {
+    return c == '"' || c == ',' || c == '{' || c == '}' || c == '[' || c == ']';
+}
+
+// Next quote, comma or bracket
+static size_t find_structural_scalar(const char *data, size_t len, size_t i) {
+    while (i < len && !is_structural(data[i])) i++;
+    return i;
+}
+
+#if WS_SCAN_X86
+static inline unsigned first_bit(uint32_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (unsigned) index;
+#else
+    return (unsigned) __builtin_ctz(mask);
+#endif
+}
+
+// '[' and ']' differ from '{' and '}' only in bit 0x20, so OR-ing it in folds four
+// bracket comparisons into two
+static size_t find_structural_sse2(const char *data, size_t len, size_t i) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i fold = _mm_set1_epi8(0x20);
+    const __m128i open = _mm_set1_epi8('{');
+    const __m128i close = _mm_set1_epi8('}');
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *) (data + i));
+        __m128i folded = _mm_or_si128(chunk, fold);
+        __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, comma)),
+                                    _mm_or_si128(_mm_cmpeq_epi8(folded, open), _mm_cmpeq_epi8(folded, close)));
+        uint32_t mask = (uint32_t) _mm_movemask_epi8(hits);
+        if (mask) return i + first_bit(mask);
+    }
+    return find_structural_scalar(data, len, i);
+}
+
+WS_TARGET_AVX2 static size_t find_structural_avx2(const char *data, size_t len, size_t i) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i fold = _mm256_set1_epi8(0x20);
+    const __m256i open = _mm256_set1_epi8('{');
+    const __m256i close = _mm256_set1_epi8('}');
+
+    for (; i + 32 <= len; i += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *) (data + i));
+        __m256i folded = _mm256_or_si256(chunk, fold);
+        __m256i hits = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote), _mm256_cmpeq_epi8(chunk, comma)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(folded, open), _mm256_cmpeq_epi8(folded, close)));
+        uint32_t mask = (uint32_t) _mm256_movemask_epi8(hits);
+        if (mask) return i + first_bit(mask);
+    }
+    // GCC tail calls here without the vzeroupper it adds on return, leaving the caller's
+    // legacy SSE code to stall on the dirty upper halves
+    _mm256_zeroupper();
+    return find_structural_scalar(data, len, i);
+}
+
+static bool cpu_has_avx2() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+
+    // AVX2 also needs the OS to save the YMM registers
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    if (!osxsave || (_xgetbv(0) & 0x6) != 0x6) return false;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+struct ws_scan_impl {
+    ws_find_fn find_structural;
+    const char *name;
+};
+
+// Every variant this CPU can run, scalar first
+static const std::vector<ws_scan_impl> &scan_variants() {
+    static const std::vector<ws_scan_impl> variants = []() {
+        std::vector<ws_scan_impl> list = {{find_structural_scalar, "scalar"}};
+#if WS_SCAN_X86
+        list.push_back({find_structural_sse2, "SSE2"});
+        if (cpu_has_avx2()) list.push_back({find_structural_avx2, "AVX2"});
+#endif
+        return list;
+    }();
+    return variants;
+}
+
+// SSE2 where there is one. Structural characters in obs-websocket messages are rarely more than
+// 16 bytes apart, so AVX2 blocks do not pay off: bench-json-scan measured it no faster on any
+// message shape
+static const ws_scan_impl &scan_impl() {
+    const std::vector<ws_scan_impl> &variants = scan_variants();
+    return variants.size() > 1 ? variants[1] : variants[0];
+}
+
+const char *ws_json_scan_impl_name(void) {
+    return scan_impl().name;
+}
+
+size_t ws_json_scan_variant_count(void) {
+    return scan_variants().size();
+}
+
+const char *ws_json_scan_variant_name(size_t variant) {
+    return variant < scan_variants().size() ? scan_variants()[variant].name : NULL;
+}
+
+// Find the closing quote of a string starting after its opening quote; returns len if unterminated.
+// String bodies are where large messages spend their bytes, and libc's memchr outruns a search
+// for both quotes and backslashes, so escapes are checked by counting the backslashes before a quote
+static size_t find_string_end(const char *data, size_t len, size_t i) {
+    while (i < len) {
+        const char *quote = (const char *) memchr(data + i, '"', len - i);
+        if (!quote) return len;
+
+        size_t end = quote - data;
+        size_t backslashes = 0;
+        while (end - backslashes > i && data[end - backslashes - 1] == '\\') backslashes++;
+        if (backslashes % 2 == 0) return end;
+        i = end + 1;
+    }
+    return len;
+}
+
+static bool json_scan(const ws_scan_impl &impl, const char *data, size_t len, ws_json_fields_t *fields) {
+    if (!data || !fields) return false;
+
+    memset(fields, 0, sizeof(*fields));
+    fields->op = -1;
+
+    // One bit per nesting level: set for objects, clear for arrays
+    uint64_t object_bits = 0;
+    int depth = 0;
+    bool expect_key = false;
+    bool pending_d = false;
+    bool in_d = false;
+    const char *request_data = NULL; // Start of "d.requestData" until its object closes
+
+    size_t i = skip_whitespace(data, len, 0);
+    if (i >= len || data[i] != '{') return false;
+
+    while (i < len) {
+        // Everything between structural characters is irrelevant to the fields we look for. The
+        // next one often follows directly, which is not worth a call
+        if (!is_structural(data[i])) i = impl.find_structural(data, len, i);
+        if (i >= len) break;
+        char c = data[i];
+
+        if (c == '"') {
+            size_t start = i + 1;
+            size_t end = find_string_end(data, len, start);
+            if (end >= len) return false;
+
+            bool top_key = expect_key && depth == 1;
+            bool d_key = expect_key && depth == 2 && in_d;
+            if (!top_key && !d_key) {
+                i = end + 1;
+                expect_key = false;
+                continue;
+            }
+
+            const char *key = data + start;
+            size_t key_len = end - start;
+            size_t value = skip_whitespace(data, len, end + 1);
+            if (value >= len || data[value] != ':') return false;
+            value = skip_whitespace(data, len, value + 1);
+            if (value >= len) return false;
+
+            if (top_key && key_equals(key, key_len, "op")) {
+                int op = 0;
+                bool digits = false;
+                while (value < len && data[value] >= '0' && data[value] <= '9' && op < 1000) {
+                    op = op * 10 + (data[value] - '0');
+                    digits = true;
+                    value++;
+                }
+                if (digits) fields->op = op;
+            } else if (top_key && key_equals(key, key_len, "d")) {
+                pending_d = data[value] == '{';
+            } else if (d_key && data[value] == '{' && key_equals(key, key_len, "requestData")) {
+                request_data = data + value;
+            } else if (d_key && data[value] == '"') {
+                const char **target = NULL;
+                size_t *target_len = NULL;
+                if (key_equals(key, key_len, "eventType")) {
+                    target = &fields->event_type;
+                    target_len = &fields->event_type_len;
+                } else if (key_equals(key, key_len, "requestId")) {
+                    target = &fields->request_id;
+                    target_len = &fields->request_id_len;
+                } else if (key_equals(key, key_len, "requestType")) {
+                    target = &fields->request_type;
+                    target_len = &fields->request_type_len;
+                }
+
+                if (target) {
+                    size_t value_end = find_string_end(data, len, value + 1);
+                    if (value_end >= len) return false;
+                    *target = data + value + 1;
+                    *target_len = value_end - value - 1;
+                    i = value_end + 1;
+                    expect_key = false;
+                    continue;
+                }
+            }
+
+            i = value;
+            expect_key = false;
+            continue;
+        }
+
+        switch (c) {
+            case '{':
+                if (depth < 64) object_bits |= (uint64_t) 1 << depth;
+                depth++;
+                expect_key = true;
+                if (depth == 2 && pending_d) in_d = true;
+                pending_d = false;
+                break;
+            case '[':
+                if (depth < 64) object_bits &= ~((uint64_t) 1 << depth);
+                depth++;
+                expect_key = false;
+                pending_d = false;
+                break;
+            case '}':
+            case ']':
+                if (depth == 3 && request_data && !fields->request_data) {
+                    fields->request_data = request_data;
+                    fields->request_data_len = (size_t) (data + i + 1 - request_data);
+                }
+                if (depth == 2) in_d = false;
+                depth--;
+                if (depth == 0) return true;
+                expect_key = false;
+                break;
+            case ',':
+                expect_key = depth > 0 && depth <= 64 && (object_bits & ((uint64_t) 1 << (depth - 1)));
+                break;
+            default:
+                break;
+        }
+        i++;
+    }
+
+    // Truncated message
+    return false;
+}
+
+bool ws_json_scan(const char *data, size_t len, ws_json_fields_t *fields) {
+    return json_scan(scan_impl(), data, len, fields);
+}
+
+bool ws_json_scan_variant(size_t variant, const char *data, size_t len, ws_json_fields_t *fields) {
+    if (variant >= scan_variants().size()) return false;
+    return json_scan(scan_variants()[variant], data, len, fields);
+}
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Four hex digits at str, -1 if they are not
+static long hex4(const char *str, const char *end) {
+    if (end - str < 4) return -1;
+    long value = 0;
+    for (int i = 0; i < 4; i++) {
+        int digit = hex_digit(str[i]);
+        if (digit < 0) return -1;
+        value = value * 16 + digit;
+    }
+    return value;
+}
+
+static void append_utf8(std::string &out, unsigned long cp) {
+    if (cp < 0x80) {
+        out += (char) cp;
+    } else if (cp < 0x800) {
+        out += (char) (0xc0 | (cp >> 6));
+        out += (char) (0x80 | (cp & 0x3f));
+    } else if (cp < 0x10000) {
+        out += (char) (0xe0 | (cp >> 12));
+        out += (char) (0x80 | ((cp >> 6) & 0x3f));
+        out += (char) (0x80 | (cp & 0x3f));
+    } else {
+        out += (char) (0xf0 | (cp >> 18));
+        out += (char) (0x80 | ((cp >> 12) & 0x3f));
+        out += (char) (0x80 | ((cp >> 6) & 0x3f));
+        out += (char) (0x80 | (cp & 0x3f));
+    }
+}
+
+// Decode the contents of a JSON string literal as ws_json_scan returns them. Malformed escapes are
+// kept as they are, and lone surrogates become U+FFFD
+std::string ws_json_unescape(const char *str, size_t len) {
+    std::string out;
+    out.reserve(len);
+    const char *end = str + len;
+
+    for (const char *p = str; p < end; p++) {
+        if (*p != '\\' || p + 1 == end) {
+            out += *p;
+            continue;
+        }
+
+        switch (p[1]) {
+            case '"':
+            case '\\':
+            case '/':
+                out += p[1];
+                break;
+            case 'b':
+                out += '\b';
+                break;
+            case 'f':
+                out += '\f';
+                break;
+            case 'n':
+                out += '\n';
+                break;
+            case 'r':
+                out += '\r';
+                break;
+            case 't':
+                out += '\t';
+                break;
+            case 'u': {
+                long cp = hex4(p + 2, end);
+                if (cp < 0) {
+                    out += *p;
+                    continue;
+                }
+                p += 4;
+                if (cp >= 0xd800 && cp < 0xdc00) {
+                    long low = end - p >= 4 && p[2] == '\\' && p[3] == 'u' ? hex4(p + 4, end) : -1;
+                    if (low >= 0xdc00 && low < 0xe000) {
+                        cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                        p += 6;
+                    } else {
+                        cp = 0xfffd;
+                    }
+                } else if (cp >= 0xdc00 && cp < 0xe000) {
+                    cp = 0xfffd;
+                }
+                append_utf8(out, (unsigned long) cp);
+                break;
+            }
+            default:
+                out += *p;
+                continue;
+        }
+        p++;
+    }
+    return out;
+}
+
+bool ws_event_is_high_volume(const char *event_type, size_t len) {
+    for (const char *name: high_volume_events) {
+        if (key_equals(event_type, len, name)) return true;
+    }
+    return false;
+}
+
+ws_message_class_t ws_message_classify(const char *data, size_t len) {
+    ws_json_fields_t fields;
+    if (!ws_json_scan(data, len, &fields)) return WS_MESSAGE_SESSION;
+
+    switch (fields.op) {
+        case WS_OP_EVENT:
+            return ws_event_is_high_volume(fields.event_type, fields.event_type_len) ? WS_MESSAGE_EVENT_HIGH_VOLUME
+                                                                                     : WS_MESSAGE_EVENT;
+        case WS_OP_REQUEST:
+        case WS_OP_REQUEST_BATCH:
+            return WS_MESSAGE_REQUEST;
+        case WS_OP_REQUEST_RESPONSE:
+        case WS_OP_REQUEST_BATCH_RESPONSE:
+            return WS_MESSAGE_RESPONSE;
+        default:
+            return WS_MESSAGE_SESSION;
+    }
+}
+
+ws_message_class_t ws_message_get_class(ws_message_t &msg) {
+    if (msg.msg_class == WS_MESSAGE_UNCLASSIFIED) {
+        msg.msg_class = ws_message_classify(msg.data.data() + WS_MSG_PRE, msg.data.size() - WS_MSG_PRE);
+    }
+    return msg.msg_class;
+}
@@ -0,0 +1,1042 @@
+/*
+OBS WebSocket Relay - OBS State Mirror
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "ws-relay-internal.h"
+#include <obs-module.h>
+#include <plugin-support.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <libwebsockets.h>
+#include <set>
+#include <string>
+#include <utility>
+
+// obs-websocket op codes the mirror looks at
+#define WS_OP_EVENT 5
+#define WS_OP_REQUEST 6
+
+// obs-websocket request status codes
+#define WS_REQUEST_STATUS_SUCCESS 100
+#define WS_REQUEST_STATUS_NOT_READY 207
+
+// Event subscriptions that carry every change the mirror follows: Scenes, Inputs, Transitions,
+// Filters and SceneItems
+#define WS_MIRROR_SUBSCRIPTIONS ((1 << 2) | (1 << 3) | (1 << 4) | (1 << 5) | (1 << 7))
+#define WS_EVENT_SUBSCRIPTION_VENDORS (1 << 9)
+#define WS_EVENT_SUBSCRIPTION_TRANSFORMS (1 << 19)
+
+// How long scene item lists fetched for their transforms serve the vendor request made to OBS
+#define WS_MIRROR_TRANSFORMS_FRESH_NS (1000ULL * 1000000)
+
+// Vendor request and event of the relay's vendor, named after the plugin, that carry snapshots
+#define WS_MIRROR_REQUEST "GetStateSnapshot"
+#define WS_MIRROR_EVENT "StateSnapshot"
+
+typedef struct ws_mirror ws_mirror_t;
+typedef void (*ws_mirror_handler_t)(ws_mirror_t *mirror, obs_data_t *event_data);
+
+// Parts of the OBS state to fetch through obs-websocket's plugin API
+typedef struct {
+    bool all; // Everything, replacing the whole mirror
+    bool scenes;
+    bool inputs;
+    bool transitions;
+    std::set<std::string> scene_items; // Scenes whose item lists are fetched
+    std::set<std::string> filters; // Sources whose filter lists are fetched
+    bool transforms; // scene_items holds every scene, to bring their transforms up to date
+
+    bool empty() const {
+        return !all && !scenes && !inputs && !transitions && scene_items.empty() && filters.empty() && !transforms;
+    }
+} ws_mirror_fetch_t;
+
+// Event applied while a fetch was running, applied again on top of its result
+typedef struct {
+    ws_mirror_handler_t handler;
+    obs_data_t *event_data;
+} ws_mirror_replay_t;
+
+// Snapshot owed to the remote, as the answer to a request or pushed as an event
+typedef struct {
+    std::string request_id; // Copied verbatim from the request
+    bool push;
+    uint64_t fetch_needed; // Fetch that has to complete first, 0 if the mirror is current
+    uint64_t queued_at;
+} ws_mirror_pending_t;
+
+// Fetches run on a worker thread, since obs-websocket executes requests on the calling thread.
+// The worker does not take the relay mutex: it hands its results over under lock and wakes the
+// service thread. The lock nests inside the relay mutex, never the other way round
+struct ws_mirror {
+    pthread_mutex_t lock;
+    os_sem_t *sem; // Posted for every fetch and on detach
+    struct lws_context *context; // Woken when a result is ready, NULL once detached
+    bool detached;
+    ws_mirror_fetch_t request;
+    bool request_ready;
+    ws_mirror_fetch_t result_fetch;
+    obs_data_t *result; // NULL if a full fetch failed
+    volatile bool result_ready;
+    long refs; // Held by the relay and the worker
+
+    // The mirror itself, service thread only with the mutex held. Lists have the shape of the
+    // GetSceneList, GetInputList and GetSceneTransitionList responses; scene items and filters
+    // are keyed by scene and source name
+    obs_data_t *scene_list;
+    obs_data_t *input_list;
+    obs_data_t *transition_list;
+    obs_data_t *scene_items;
+    obs_data_t *filters;
+    bool seeded; // The last full fetch succeeded
+    bool seed_failed; // The last full fetch failed, which has been logged
+    bool live; // Every change since that fetch has been applied
+    uint64_t epoch; // Bumped whenever changes may have been missed
+    std::string json; // Serialized snapshot, empty when stale
+
+    ws_mirror_fetch_t dirty; // Parts changed in ways events do not describe fully
+    bool fetching;
+    uint64_t fetch_started; // Fetches started and completed, counting from 1
+    uint64_t fetch_completed;
+    uint64_t fetch_epoch; // Epoch when the running fetch started
+    time_t last_seed;
+    uint64_t transforms_fetched_ns; // When every scene's items were last fetched
+    std::vector<ws_mirror_replay_t> replay;
+    bool replay_overflow;
+
+    std::vector<ws_mirror_pending_t> pending;
+
+    // Event from the OBS connection being reassembled
+    std::vector<char> rx;
+    bool rx_collecting;
+};
+
+// Keep the string under key in src, if there is one, as dst_key in dst
+static void ws_mirror_copy_string(obs_data_t *dst, const char *dst_key, obs_data_t *src, const char *key) {
+    if (obs_data_has_user_value(src, key)) {
+        obs_data_set_string(dst, dst_key, obs_data_get_string(src, key));
+    }
+}
+
+// Index of the first entry whose string under key equals value, -1 if there is none
+static long long ws_mirror_find(obs_data_array_t *array, const char *key, const char *value) {
+    size_t count = array ? obs_data_array_count(array) : 0;
+    for (size_t i = 0; i < count; i++) {
+        obs_data_t *item = obs_data_array_item(array, i);
+        bool match = strcmp(obs_data_get_string(item, key), value) == 0;
+        obs_data_release(item);
+        if (match) return (long long) i;
+    }
+    return -1;
+}
+
+static void ws_mirror_rename(obs_data_array_t *array, const char *key, const char *from, const char *to) {
+    size_t count = array ? obs_data_array_count(array) : 0;
+    for (size_t i = 0; i < count; i++) {
+        obs_data_t *item = obs_data_array_item(array, i);
+        if (strcmp(obs_data_get_string(item, key), from) == 0) {
+            obs_data_set_string(item, key, to);
+        }
+        obs_data_release(item);
+    }
+}
+
+static void ws_mirror_rename_key(obs_data_t *obj, const char *from, const char *to) {
+    if (!obs_data_has_user_value(obj, from)) return;
+
+    obs_data_array_t *array = obs_data_get_array(obj, from);
+    obs_data_set_array(obj, to, array);
+    obs_data_array_release(array);
+    obs_data_erase(obj, from);
+}
+
+// Index of the scene item with the given id, -1 if there is none
+static long long ws_mirror_find_id(obs_data_array_t *array, long long id) {
+    size_t count = array ? obs_data_array_count(array) : 0;
+    for (size_t i = 0; i < count; i++) {
+        obs_data_t *item = obs_data_array_item(array, i);
+        bool match = obs_data_get_int(item, "sceneItemId") == id;
+        obs_data_release(item);
+        if (match) return (long long) i;
+    }
+    return -1;
+}
+
+// The scene item an event is about; release it after use
+static obs_data_t *ws_mirror_scene_item(ws_mirror_t *mirror, obs_data_t *event_data) {
+    obs_data_array_t *items = obs_data_get_array(mirror->scene_items, obs_data_get_string(event_data, "sceneName"));
+    long long index = ws_mirror_find_id(items, obs_data_get_int(event_data, "sceneItemId"));
+    obs_data_t *item = index >= 0 ? obs_data_array_item(items, (size_t) index) : NULL;
+    obs_data_array_release(items);
+    return item;
+}
+
+// The filter an event is about; release it after use
+static obs_data_t *ws_mirror_filter(ws_mirror_t *mirror, obs_data_t *event_data) {
+    obs_data_array_t *filters = obs_data_get_array(mirror->filters, obs_data_get_string(event_data, "sourceName"));
+    long long index = ws_mirror_find(filters, "filterName", obs_data_get_string(event_data, "filterName"));
+    obs_data_t *filter = index >= 0 ? obs_data_array_item(filters, (size_t) index) : NULL;
+    obs_data_array_release(filters);
+    return filter;
+}
+
+static void ws_mirror_erase(obs_data_t *lists, const char *list, const char *key, const char *value) {
+    obs_data_array_t *array = obs_data_get_array(lists, list);
+    long long index = ws_mirror_find(array, key, value);
+    if (index >= 0) obs_data_array_erase(array, (size_t) index);
+    obs_data_array_release(array);
+}
+
+// A source was renamed: follow it in the scene item lists and as key of its filter list
+static void ws_mirror_rename_source(ws_mirror_t *mirror, const char *from, const char *to) {
+    for (obs_data_item_t *item = obs_data_first(mirror->scene_items); item; obs_data_item_next(&item)) {
+        obs_data_array_t *array = obs_data_item_get_array(item);
+        ws_mirror_rename(array, "sourceName", from, to);
+        obs_data_array_release(array);
+    }
+    ws_mirror_rename_key(mirror->filters, from, to);
+}
+
+// Event handlers. Changes an event describes completely are applied in place; the rest mark the
+// affected part to be fetched again
+
+static void ws_mirror_on_program_scene(ws_mirror_t *mirror, obs_data_t *event_data) {
+    if (!mirror->scene_list) return;
+    ws_mirror_copy_string(mirror->scene_list, "currentProgramSceneName", event_data, "sceneName");
+    ws_mirror_copy_string(mirror->scene_list, "currentProgramSceneUuid", event_data, "sceneUuid");
+}
+
+static void ws_mirror_on_preview_scene(ws_mirror_t *mirror, obs_data_t *event_data) {
+    if (!mirror->scene_list) return;
+    ws_mirror_copy_string(mirror->scene_list, "currentPreviewSceneName", event_data, "sceneName");
+    ws_mirror_copy_string(mirror->scene_list, "currentPreviewSceneUuid", event_data, "sceneUuid");
+}
+
+static void ws_mirror_on_scene_list(ws_mirror_t *mirror, obs_data_t *event_data) {
+    if (!mirror->scene_list) return;
+    obs_data_array_t *scenes = obs_data_get_array(event_data, "scenes");
+    if (scenes) obs_data_set_array(mirror->scene_list, "scenes", scenes);
+    obs_data_array_release(scenes);
+}
+
+static void ws_mirror_on_scene_created(ws_mirror_t *mirror, obs_data_t *event_data) {
+    if (obs_data_get_bool(event_data, "isGroup")) return;
+
+    // A duplicated scene starts out with items and filters
+    const char *name = obs_data_get_string(event_data, "sceneName");
+    mirror->dirty.scene_items.insert(name);
+    mirror->dirty.filters.insert(name);
+}
+
+static void ws_mirror_on_scene_removed(ws_mirror_t *mirror, obs_data_t *event_data) {
+    if (obs_data_get_bool(event_data, "isGroup")) return;
+
+    const char *name = obs_data_get_string(event_data, "sceneName");
+    obs_data_erase(mirror->scene_items, name);
+    obs_data_erase(mirror->filters, name);
+}
+
+static void ws_mirror_on_scene_name(ws_mirror_t *mirror, obs_data_t *event_data) {
+    const char *from = obs_data_get_string(event_data, "oldSceneName");
+    const char *to = obs_data_get_string(event_data, "sceneName");
+
+    ws_mirror_rename_key(mirror->scene_items, from, to);
+    ws_mirror_rename_source(mirror, from, to);
+    if (!mirror->scene_list) return;
+
+    obs_data_array_t *scenes = obs_data_get_array(mirror->scene_list, "scenes");
+    ws_mirror_rename(scenes, "sceneName", from, to);
+    obs_data_array_release(scenes);
+    if (strcmp(obs_data_get_string(mirror->scene_list, "currentProgramSceneName"), from) == 0) {
+        obs_data_set_string(mirror->scene_list, "currentProgramSceneName", to);
+    }
+    if (strcmp(obs_data_get_string(mirror->scene_list, "currentPreviewSceneName"), from) == 0) {
+        obs_data_set_string(mirror->scene_list, "currentPreviewSceneName", to);
+    }
+}
+
+static void ws_mirror_on_input_created(ws_mirror_t *mirror, obs_data_t *event_data) {
+    // The input list entry carries fields the event does not
+    mirror->dirty.inputs = true;
+    mirror->dirty.filters.insert(obs_data_get_string(event_data, "inputName"));
+}
+
+static void ws_mirror_on_input_removed(ws_mirror_t *mirror, obs_data_t *event_data) {
+    const char *name = obs_data_get_string(event_data, "inputName");
+    if (mirror->input_list) ws_mirror_erase(mirror->input_list, "inputs", "inputName", name);
+    obs_data_erase(mirror->filters, name);
+}
+
+static void ws_mirror_on_input_name(ws_mirror_t *mirror, obs_data_t *event_data) {
+    const char *from = obs_data_get_string(event_data, "oldInputName");
+    const char *to = obs_data_get_string(event_data, "inputName");
+
+    ws_mirror_rename_source(mirror, from, to);
+    if (!mirror->input_list) return;
+
+    obs_data_array_t *inputs = obs_data_get_array(mirror->input_list, "inputs");
+    ws_mirror_rename(inputs, "inputName", from, to);
+    obs_data_array_release(inputs);
+}
+
+static void ws_mirror_on_scene_items_changed(ws_mirror_t *mirror, obs_data_t *event_data) {
+    mirror->dirty.scene_items.insert(obs_data_get_string(event_data, "sceneName"));
+}
+
+static void ws_mirror_on_scene_item_removed(ws_mirror_t *mirror, obs_data_t *event_data) {
+    obs_data_array_t *items = obs_data_get_array(mirror->scene_items, obs_data_get_string(event_data, "sceneName"));
+    long long index = ws_mirror_find_id(items, obs_data_get_int(event_data, "sceneItemId"));
+    if (index >= 0) obs_data_array_erase(items, (size_t) index);
+    obs_data_array_release(items);
+}
+
+static void ws_mirror_on_scene_item_enabled(ws_mirror_t *mirror, obs_data_t *event_data) {
+    obs_data_t *item = ws_mirror_scene_item(mirror, event_data);
+    if (!item) return;
+    obs_data_set_bool(item, "sceneItemEnabled", obs_data_get_bool(event_data, "sceneItemEnabled"));
+    obs_data_release(item);
+}
+
+static void ws_mirror_on_scene_item_locked(ws_mirror_t *mirror, obs_data_t *event_data) {
+    obs_data_t *item = ws_mirror_scene_item(mirror, event_data);
+    if (!item) return;
+    obs_data_set_bool(item, "sceneItemLocked", obs_data_get_bool(event_data, "sceneItemLocked"));
+    obs_data_release(item);
+}
+
+static void ws_mirror_on_scene_item_transform(ws_mirror_t *mirror, obs_data_t *event_data) {
+    obs_data_t *item = ws_mirror_scene_item(mirror, event_data);
+    if (!item) return;
+    obs_data_t *transform = obs_data_get_obj(event_data, "sceneItemTransform");
+    obs_data_set_obj(item, "sceneItemTransform", transform);
+    obs_data_release(transform);
+    obs_data_release(item);
+}
+
+static void ws_mirror_on_filters_changed(ws_mirror_t *mirror, obs_data_t *event_data) {
+    mirror->dirty.filters.insert(obs_data_get_string(event_data, "sourceName"));
+}
+
+static void ws_mirror_on_filter_removed(ws_mirror_t *mirror, obs_data_t *event_data) {
+    ws_mirror_erase(mirror->filters, obs_data_get_string(event_data, "sourceName"), "filterName",
+                    obs_data_get_string(event_data, "filterName"));
+}
+
+static void ws_mirror_on_filter_name(ws_mirror_t *mirror, obs_data_t *event_data) {
+    obs_data_array_t *filters = obs_data_get_array(mirror->filters, obs_data_get_string(event_data, "sourceName"));
+    ws_mirror_rename(filters, "filterName", obs_data_get_string(event_data, "oldFilterName"),
+                     obs_data_get_string(event_data, "filterName"));
+    obs_data_array_release(filters);
+}
+
+static void ws_mirror_on_filter_enabled(ws_mirror_t *mirror, obs_data_t *event_data) {
+    obs_data_t *filter = ws_mirror_filter(mirror, event_data);
+    if (!filter) return;
+    obs_data_set_bool(filter, "filterEnabled", obs_data_get_bool(event_data, "filterEnabled"));
+    obs_data_release(filter);
+}
+
+static void ws_mirror_on_filter_settings(ws_mirror_t *mirror, obs_data_t *event_data) {
+    obs_data_t *filter = ws_mirror_filter(mirror, event_data);
+    if (!filter) return;
+    obs_data_t *settings = obs_data_get_obj(event_data, "filterSettings");
+    obs_data_set_obj(filter, "filterSettings", settings);
+    obs_data_release(settings);
+    obs_data_release(filter);
+}
+
+static void ws_mirror_on_filter_list(ws_mirror_t *mirror, obs_data_t *event_data) {
+    // The event carries the whole list, as GetSourceFilterList returns it
+    obs_data_array_t *filters = obs_data_get_array(event_data, "filters");
+    if (filters) obs_data_set_array(mirror->filters, obs_data_get_string(event_data, "sourceName"), filters);
+    obs_data_array_release(filters);
+}
+
+static void ws_mirror_on_transition(ws_mirror_t *mirror, obs_data_t *event_data) {
+    UNUSED_PARAMETER(event_data);
+    // The transition list entry carries its kind and capabilities, which the event does not
+    mirror->dirty.transitions = true;
+}
+
+static void ws_mirror_on_transition_duration(ws_mirror_t *mirror, obs_data_t *event_data) {
+    if (!mirror->transition_list) return;
+    obs_data_set_int(mirror->transition_list, "currentSceneTransitionDuration",
+                     obs_data_get_int(event_data, "transitionDuration"));
+}
+
+static const struct {
+    const char *event_type;
+    ws_mirror_handler_t handler;
+} ws_mirror_handlers[] = {
+    {"CurrentProgramSceneChanged", ws_mirror_on_program_scene},
+    {"CurrentPreviewSceneChanged", ws_mirror_on_preview_scene},
+    {"SceneListChanged", ws_mirror_on_scene_list},
+    {"SceneCreated", ws_mirror_on_scene_created},
+    {"SceneRemoved", ws_mirror_on_scene_removed},
+    {"SceneNameChanged", ws_mirror_on_scene_name},
+    {"InputCreated", ws_mirror_on_input_created},
+    {"InputRemoved", ws_mirror_on_input_removed},
+    {"InputNameChanged", ws_mirror_on_input_name},
+    {"SceneItemCreated", ws_mirror_on_scene_items_changed},
+    {"SceneItemListReindexed", ws_mirror_on_scene_items_changed},
+    {"SceneItemRemoved", ws_mirror_on_scene_item_removed},
+    {"SceneItemEnableStateChanged", ws_mirror_on_scene_item_enabled},
+    {"SceneItemLockStateChanged", ws_mirror_on_scene_item_locked},
+    {"SceneItemTransformChanged", ws_mirror_on_scene_item_transform},
+    {"SourceFilterCreated", ws_mirror_on_filters_changed},
+    {"SourceFilterRemoved", ws_mirror_on_filter_removed},
+    {"SourceFilterNameChanged", ws_mirror_on_filter_name},
+    {"SourceFilterEnableStateChanged", ws_mirror_on_filter_enabled},
+    {"SourceFilterSettingsChanged", ws_mirror_on_filter_settings},
+    {"SourceFilterListReindexed", ws_mirror_on_filter_list},
+    {"CurrentSceneTransitionChanged", ws_mirror_on_transition},
+    {"CurrentSceneTransitionDurationChanged", ws_mirror_on_transition_duration},
+};
+
+static ws_mirror_handler_t ws_mirror_handler(const char *event_type, size_t len) {
+    if (!event_type) return NULL;
+
+    for (const auto &entry: ws_mirror_handlers) {
+        if (strlen(entry.event_type) == len && memcmp(entry.event_type, event_type, len) == 0) {
+            return entry.handler;
+        }
+    }
+    return NULL;
+}
+
+// Events reach the relay's OBS session in-process regardless of subscriptions; over the OBS
+// connection only those the remote subscribed to arrive
+static bool ws_mirror_covered(ws_relay_t *relay) {
+    if (ws_obs_api_active(relay)) return true;
+
+    return relay->obs_conn.state == WS_STATE_CONNECTED && relay->auth.obs_identified &&
+           !relay->auth.obs_reidentify_pending &&
+           (relay->auth.event_subscriptions & WS_MIRROR_SUBSCRIPTIONS) == WS_MIRROR_SUBSCRIPTIONS;
+}
+
+static void ws_mirror_release(ws_mirror_t *mirror) {
+    if (os_atomic_dec_long(&mirror->refs) > 0) return;
+
+    obs_data_release(mirror->result);
+    os_sem_destroy(mirror->sem);
+    pthread_mutex_destroy(&mirror->lock);
+    delete mirror;
+}
+
+// Fetch one request's response data through obs-websocket; release it after use
+static obs_data_t *ws_mirror_request(const char *type, const char *key, const char *value) {
+    const char *data = NULL;
+    obs_data_t *request = NULL;
+    if (key) {
+        request = obs_data_create();
+        obs_data_set_string(request, key, value);
+        data = obs_data_get_json(request);
+    }
+
+    char *json = ws_obs_api_request(type, data);
+    obs_data_release(request);
+    obs_data_t *response = json ? obs_data_create_from_json(json) : NULL;
+    bfree(json);
+    return response;
+}
+
+// Names under key in the array under list of a response
+static void ws_mirror_names(obs_data_t *response, const char *list, const char *key, std::set<std::string> &names) {
+    obs_data_array_t *array = obs_data_get_array(response, list);
+    size_t count = array ? obs_data_array_count(array) : 0;
+    for (size_t i = 0; i < count; i++) {
+        obs_data_t *item = obs_data_array_item(array, i);
+        names.insert(obs_data_get_string(item, key));
+        obs_data_release(item);
+    }
+    obs_data_array_release(array);
+}
+
+// SceneItemTransformChanged is a high-volume event: obs-websocket only emits it while some
+// WebSocket client subscribes to it, and in-process the relay cannot tell whether one does
+static bool ws_mirror_follows_transforms(ws_relay_t *relay) {
+    return !ws_obs_api_active(relay) && (relay->auth.event_subscriptions & WS_EVENT_SUBSCRIPTION_TRANSFORMS);
+}
+
+// Mark every scene's item list to be fetched again, as events do not keep their transforms
+// current. Called with the mutex held
+static void ws_mirror_refresh_transforms(ws_mirror_t *mirror) {
+    if (mirror->scene_list) ws_mirror_names(mirror->scene_list, "scenes", "sceneName", mirror->dirty.scene_items);
+    mirror->dirty.transforms = true;
+}
+
+// Fetch the lists under list_key for each name into a keyed object of result
+static void ws_mirror_fetch_lists(obs_data_t *result, const char *result_key, const char *type,
+                                  const char *param, const char *list_key, const std::set<std::string> &names) {
+    obs_data_t *lists = obs_data_create();
+    for (const std::string &name: names) {
+        // A source removed in the meantime is simply left out
+        obs_data_t *response = ws_mirror_request(type, param, name.c_str());
+        if (!response) continue;
+        obs_data_array_t *array = obs_data_get_array(response, list_key);
+        if (array) obs_data_set_array(lists, name.c_str(), array);
+        obs_data_array_release(array);
+        obs_data_release(response);
+    }
+    obs_data_set_obj(result, result_key, lists);
+    obs_data_release(lists);
+}
+
+// Fetch the parts of the OBS state named by fetch, in the mirror's layout. Returns NULL if a full
+// fetch failed. Worker thread
+static obs_data_t *ws_mirror_fetch(ws_mirror_fetch_t &fetch) {
+    static const struct {
+        const char *type;
+        const char *key;
+        bool ws_mirror_fetch_t::*wanted;
+    } lists[] = {
+        {"GetSceneList", "sceneList", &ws_mirror_fetch_t::scenes},
+        {"GetInputList", "inputList", &ws_mirror_fetch_t::inputs},
+        {"GetSceneTransitionList", "transitionList", &ws_mirror_fetch_t::transitions},
+    };
+
+    obs_data_t *result = obs_data_create();
+    for (const auto &list: lists) {
+        if (!fetch.all && !(fetch.*list.wanted)) continue;
+
+        obs_data_t *response = ws_mirror_request(list.type, NULL, NULL);
+        if (!response) {
+            if (fetch.all) {
+                obs_data_release(result);
+                return NULL;
+            }
+            continue;
+        }
+        if (fetch.all) {
+            if (list.wanted == &ws_mirror_fetch_t::scenes) {
+                ws_mirror_names(response, "scenes", "sceneName", fetch.scene_items);
+                ws_mirror_names(response, "scenes", "sceneName", fetch.filters);
+            } else if (list.wanted == &ws_mirror_fetch_t::inputs) {
+                ws_mirror_names(response, "inputs", "inputName", fetch.filters);
+            }
+        }
+        obs_data_set_obj(result, list.key, response);
+        obs_data_release(response);
+    }
+
+    if (fetch.all || !fetch.scene_items.empty()) {
+        ws_mirror_fetch_lists(result, "sceneItems", "GetSceneItemList", "sceneName", "sceneItems",
+                              fetch.scene_items);
+    }
+    if (fetch.all || !fetch.filters.empty()) {
+        ws_mirror_fetch_lists(result, "filters", "GetSourceFilterList", "sourceName", "filters", fetch.filters);
+    }
+    return result;
+}
+
+static void *ws_mirror_thread(void *data) {
+    ws_mirror_t *mirror = (ws_mirror_t *) data;
+    os_set_thread_name("ws-relay-mirror");
+
+    for (;;) {
+        os_sem_wait(mirror->sem);
+
+        pthread_mutex_lock(&mirror->lock);
+        if (mirror->detached) {
+            pthread_mutex_unlock(&mirror->lock);
+            break;
+        }
+        if (!mirror->request_ready) {
+            pthread_mutex_unlock(&mirror->lock);
+            continue;
+        }
+        ws_mirror_fetch_t fetch = std::move(mirror->request);
+        mirror->request = ws_mirror_fetch_t();
+        mirror->request_ready = false;
+        pthread_mutex_unlock(&mirror->lock);
+
+        obs_data_t *result = ws_mirror_fetch(fetch);
+
+        pthread_mutex_lock(&mirror->lock);
+        if (mirror->detached) {
+            obs_data_release(result);
+        } else {
+            mirror->result_fetch = std::move(fetch);
+            mirror->result = result;
+            os_atomic_store_bool(&mirror->result_ready, true);
+            lws_cancel_service(mirror->context);
+        }
+        pthread_mutex_unlock(&mirror->lock);
+    }
+
+    ws_mirror_release(mirror);
+    return NULL;
+}
+
+// Hand the parts marked dirty to the worker unless a fetch is running. Called with the mutex held
+static void ws_mirror_kick(ws_relay_t *relay) {
+    ws_mirror_t *mirror = relay->mirror;
+    if (mirror->fetching || mirror->dirty.empty()) return;
+    // Parts of a mirror that was never seeded wait for the full fetch, which covers them
+    if (!mirror->seeded && !mirror->dirty.all) return;
+
+    if (mirror->dirty.all) {
+        mirror->dirty = ws_mirror_fetch_t();
+        mirror->dirty.all = true;
+        mirror->last_seed = time(NULL);
+    }
+
+    pthread_mutex_lock(&mirror->lock);
+    mirror->request = std::move(mirror->dirty);
+    mirror->request_ready = true;
+    pthread_mutex_unlock(&mirror->lock);
+    mirror->dirty = ws_mirror_fetch_t();
+
+    mirror->fetching = true;
+    mirror->fetch_started++;
+    mirror->fetch_epoch = mirror->epoch;
+    mirror->replay_overflow = false;
+    os_sem_post(mirror->sem);
+}
+
+static const std::string &ws_mirror_snapshot(ws_mirror_t *mirror) {
+    if (!mirror->json.empty()) return mirror->json;
+
+    obs_data_t *snapshot = obs_data_create();
+    if (mirror->scene_list) obs_data_set_obj(snapshot, "sceneList", mirror->scene_list);
+    if (mirror->input_list) obs_data_set_obj(snapshot, "inputList", mirror->input_list);
+    if (mirror->transition_list) obs_data_set_obj(snapshot, "transitionList", mirror->transition_list);
+    obs_data_set_obj(snapshot, "sceneItems", mirror->scene_items);
+    obs_data_set_obj(snapshot, "filters", mirror->filters);
+    mirror->json = obs_data_get_json(snapshot);
+    obs_data_release(snapshot);
+    return mirror->json;
+}
+
+// Send a snapshot owed to the remote: a CallVendorRequest response, or a VendorEvent when pushed.
+// Called with the mutex held
+static void ws_mirror_send(ws_relay_t *relay, const ws_mirror_pending_t &pending, bool available) {
+    ws_mirror_t *mirror = relay->mirror;
+    std::string vendor = std::string("\"vendorName\":\"") + PLUGIN_NAME + "\"";
+
+    std::string message;
+    if (pending.push) {
+        if (!available) return;
+        message = "{\"op\":" + std::to_string(WS_OP_EVENT) +
+                  ",\"d\":{\"eventType\":\"VendorEvent\",\"eventIntent\":" +
+                  std::to_string(WS_EVENT_SUBSCRIPTION_VENDORS) + ",\"eventData\":{" + vendor +
+                  ",\"eventType\":\"" WS_MIRROR_EVENT "\",\"eventData\":" + ws_mirror_snapshot(mirror) + "}}}";
+    } else {
+        message = "{\"op\":7,\"d\":{\"requestType\":\"CallVendorRequest\",\"requestId\":\"" + pending.request_id +
+                  "\",\"requestStatus\":";
+        if (available) {
+            message += "{\"result\":true,\"code\":" + std::to_string(WS_REQUEST_STATUS_SUCCESS) + "},\"responseData\":{" +
+                       vendor + ",\"requestType\":\"" WS_MIRROR_REQUEST "\",\"responseData\":" +
+                       ws_mirror_snapshot(mirror) + "}}}";
+        } else {
+            message += "{\"result\":false,\"code\":" + std::to_string(WS_REQUEST_STATUS_NOT_READY) +
+                       ",\"comment\":\"The OBS state could not be fetched through obs-websocket\"}}}";
+        }
+    }
+
+    ws_connection_send(&relay->remote_conn, message.data(), message.size());
+    if (available) {
+        relay->stats.to_remote.mirror_snapshots++;
+        relay->stats.to_remote.mirror_snapshot_bytes = message.size();
+    }
+}
+
+// Send the snapshots whose fetches have completed and which no refresh is pending for. A pushed
+// snapshot also waits for spilled events to be replayed, as those are older than the snapshot.
+// Called with the mutex held
+static void ws_mirror_answer(ws_relay_t *relay) {
+    ws_mirror_t *mirror = relay->mirror;
+    if (mirror->pending.empty()) return;
+
+    if (!relay->auth.remote_identified || relay->remote_conn.state != WS_STATE_CONNECTED) {
+        mirror->pending.clear();
+        return;
+    }
+
+    uint64_t now = os_gettime_ns();
+    bool settled = !mirror->fetching && mirror->dirty.empty();
+    bool spill_pending = relay->spill && !ws_spill_empty(relay->spill);
+    for (auto it = mirror->pending.begin(); it != mirror->pending.end();) {
+        bool fetched = mirror->fetch_completed >= it->fetch_needed;
+        bool expired = now - it->queued_at >= WS_MIRROR_SNAPSHOT_WAIT_NS;
+        if ((!(fetched && settled) && !expired) || (it->push && spill_pending)) {
+            ++it;
+            continue;
+        }
+
+        ws_mirror_send(relay, *it, fetched && mirror->seeded);
+        it = mirror->pending.erase(it);
+    }
+}
+
+// Owe the remote a snapshot. Without a live mirror it is fetched afresh. Called with the mutex held
+static void ws_mirror_queue(ws_relay_t *relay, std::string request_id, bool push) {
+    ws_mirror_t *mirror = relay->mirror;
+
+    uint64_t fetch_needed = 0;
+    if (!mirror->live) {
+        mirror->dirty.all = true;
+        fetch_needed = mirror->fetch_started + 1;
+    } else if (!ws_mirror_follows_transforms(relay)) {
+        ws_mirror_refresh_transforms(mirror);
+        fetch_needed = mirror->fetch_started + 1;
+    }
+    mirror->pending.push_back({std::move(request_id), push, fetch_needed, os_gettime_ns()});
+
+    ws_mirror_kick(relay);
+    ws_mirror_answer(relay);
+}
+
+// Changes may have gone unseen; the mirror is fetched again once events cover it. Called with
+// the mutex held
+void ws_mirror_invalidate(ws_relay_t *relay) {
+    ws_mirror_t *mirror = relay->mirror;
+    if (!mirror) return;
+
+    if (mirror->live && relay->config.enable_logging) {
+        obs_log(LOG_INFO, "OBS state mirror no longer follows OBS events");
+    }
+    mirror->live = false;
+    mirror->epoch++;
+}
+
+// The relay's OBS session changed its subscriptions; called with the mutex held
+void ws_mirror_on_subscriptions(ws_relay_t *relay, int64_t subscriptions) {
+    if ((subscriptions & WS_MIRROR_SUBSCRIPTIONS) != WS_MIRROR_SUBSCRIPTIONS) {
+        ws_mirror_invalidate(relay);
+    }
+}
+
+static void ws_mirror_apply(ws_relay_t *relay, ws_mirror_handler_t handler, const char *data, size_t len) {
+    ws_mirror_t *mirror = relay->mirror;
+
+    obs_data_t *msg = obs_data_create_from_json(std::string(data, len).c_str());
+    obs_data_t *d = msg ? obs_data_get_obj(msg, "d") : NULL;
+    obs_data_t *event_data = d ? obs_data_get_obj(d, "eventData") : NULL;
+    if (event_data) {
+        handler(mirror, event_data);
+        mirror->json.clear();
+        relay->stats.to_remote.mirror_events++;
+
+        // A running fetch may have read the state before this change
+        if (mirror->fetching && mirror->replay.size() < WS_MIRROR_REPLAY_MAX) {
+            mirror->replay.push_back({handler, event_data});
+            event_data = NULL;
+        } else if (mirror->fetching) {
+            mirror->replay_overflow = true;
+        }
+    }
+    obs_data_release(event_data);
+    obs_data_release(d);
+    obs_data_release(msg);
+    ws_mirror_kick(relay);
+}
+
+// Apply a complete message from OBS if it is an event the mirror follows. Called on the service
+// thread with the mutex held
+void ws_mirror_observe_message(ws_relay_t *relay, const char *data, size_t len) {
+    if (!relay->mirror) return;
+
+    ws_json_fields_t fields;
+    if (!ws_json_scan(data, len, &fields) || fields.op != WS_OP_EVENT) return;
+
+    ws_mirror_handler_t handler = ws_mirror_handler(fields.event_type, fields.event_type_len);
+    if (handler) ws_mirror_apply(relay, handler, data, len);
+}
+
+// Take a fragment received from OBS. obs-websocket writes eventType after eventData, so the type
+// of an event spread over several fragments is only known once it is complete; such messages are
+// collected unless the first fragment already shows they are something else. Called with the
+// mutex held
+void ws_mirror_observe(ws_relay_t *relay, bool first, bool final, const void *in, size_t len) {
+    ws_mirror_t *mirror = relay->mirror;
+    if (!mirror) return;
+
+    if (first) {
+        mirror->rx.clear();
+        mirror->rx_collecting = false;
+        if (final) {
+            ws_mirror_observe_message(relay, (const char *) in, len);
+            return;
+        }
+
+        ws_json_fields_t fields;
+        ws_json_scan((const char *) in, len, &fields);
+        if (fields.request_id || (fields.op >= 0 && fields.op != WS_OP_EVENT) ||
+            (fields.event_type && !ws_mirror_handler(fields.event_type, fields.event_type_len))) {
+            return;
+        }
+        mirror->rx_collecting = true;
+    }
+    if (!mirror->rx_collecting) return;
+
+    if (mirror->rx.size() + len > WS_MIRROR_EVENT_MAX) {
+        // Possibly an event the mirror follows, so it cannot be trusted any more
+        std::vector<char>().swap(mirror->rx);
+        mirror->rx_collecting = false;
+        ws_mirror_invalidate(relay);
+        return;
+    }
+
+    mirror->rx.insert(mirror->rx.end(), (const char *) in, (const char *) in + len);
+    if (!final) return;
+
+    ws_mirror_observe_message(relay, mirror->rx.data(), mirror->rx.size());
+    mirror->rx.clear();
+    mirror->rx_collecting = false;
+}
+
+// Answer a CallVendorRequest for the relay's snapshot in OBS's place; returns true if the
+// fragment was such a request. Requests are small, so only single-fragment ones are looked at.
+// Called with the mutex held
+bool ws_mirror_intercept(ws_relay_t *relay, bool first, bool final, const void *in, size_t len) {
+    if (!relay->mirror || !first || !final) return false;
+
+    ws_json_fields_t fields;
+    if (!ws_json_scan((const char *) in, len, &fields) || fields.op != WS_OP_REQUEST || !fields.request_id ||
+        !fields.request_data || fields.request_type_len != strlen("CallVendorRequest") ||
+        memcmp(fields.request_type, "CallVendorRequest", fields.request_type_len) != 0) {
+        return false;
+    }
+
+    obs_data_t *request_data = obs_data_create_from_json(std::string(fields.request_data, fields.request_data_len).c_str());
+    bool ours = request_data && strcmp(obs_data_get_string(request_data, "vendorName"), PLUGIN_NAME) == 0 &&
+                strcmp(obs_data_get_string(request_data, "requestType"), WS_MIRROR_REQUEST) == 0;
+    obs_data_release(request_data);
+    if (!ours) return false;
+
+    ws_mirror_queue(relay, std::string(fields.request_id, fields.request_id_len), false);
+    return true;
+}
+
+// The remote has identified with the relay; push it a snapshot if configured. Called with the
+// mutex held
+void ws_mirror_on_remote_identified(ws_relay_t *relay) {
+    if (!relay->mirror || !relay->config.state_push) return;
+
+    if (!(relay->auth.event_subscriptions & WS_EVENT_SUBSCRIPTION_VENDORS)) {
+        if (relay->config.enable_logging) {
+            obs_log(LOG_INFO, "Not pushing the OBS state, the remote is not subscribed to vendor events");
+        }
+        return;
+    }
+    ws_mirror_queue(relay, std::string(), true);
+}
+
+// Install a result handed over by the worker, then replay the events that arrived meanwhile.
+// Called on the service thread with the mutex held
+void ws_mirror_flush(ws_relay_t *relay) {
+    ws_mirror_t *mirror = relay->mirror;
+    if (!mirror) return;
+
+    pthread_mutex_lock(&mirror->lock);
+    if (!mirror->result_ready) {
+        pthread_mutex_unlock(&mirror->lock);
+        return;
+    }
+    ws_mirror_fetch_t fetch = std::move(mirror->result_fetch);
+    obs_data_t *result = mirror->result;
+    mirror->result = NULL;
+    os_atomic_store_bool(&mirror->result_ready, false);
+    pthread_mutex_unlock(&mirror->lock);
+
+    mirror->fetching = false;
+    mirror->fetch_completed = mirror->fetch_started;
+    if (result && (fetch.all || fetch.transforms)) {
+        mirror->transforms_fetched_ns = os_gettime_ns();
+    }
+
+    if (fetch.all && !result) {
+        if (!mirror->seed_failed) {
+            obs_log(LOG_WARNING, "Failed to fetch the OBS state through obs-websocket's plugin API");
+        }
+        mirror->seed_failed = true;
+        mirror->seeded = false;
+        mirror->live = false;
+    } else if (result) {
+        relay->stats.to_remote.mirror_refreshes++;
+        static const struct {
+            const char *key;
+            obs_data_t *ws_mirror_t::*list;
+        } lists[] = {
+            {"sceneList", &ws_mirror_t::scene_list},
+            {"inputList", &ws_mirror_t::input_list},
+            {"transitionList", &ws_mirror_t::transition_list},
+        };
+        for (const auto &list: lists) {
+            obs_data_t *value = obs_data_get_obj(result, list.key);
+            if (!value) continue;
+            obs_data_release(mirror->*list.list);
+            mirror->*list.list = value;
+        }
+
+        if (fetch.all) {
+            obs_data_release(mirror->scene_items);
+            obs_data_release(mirror->filters);
+            mirror->scene_items = obs_data_get_obj(result, "sceneItems");
+            mirror->filters = obs_data_get_obj(result, "filters");
+
+            bool was_live = mirror->live;
+            mirror->seeded = true;
+            mirror->seed_failed = false;
+            mirror->live = mirror->epoch == mirror->fetch_epoch && ws_mirror_covered(relay);
+            if (mirror->live && !was_live) {
+                obs_log(LOG_INFO, "OBS state mirror seeded and following OBS events");
+            }
+        } else {
+            obs_data_t *parts[] = {obs_data_get_obj(result, "sceneItems"), obs_data_get_obj(result, "filters")};
+            obs_data_t *targets[] = {mirror->scene_items, mirror->filters};
+            for (int i = 0; i < 2; i++) {
+                if (!parts[i]) continue;
+                for (obs_data_item_t *item = obs_data_first(parts[i]); item; obs_data_item_next(&item)) {
+                    obs_data_array_t *array = obs_data_item_get_array(item);
+                    obs_data_set_array(targets[i], obs_data_item_get_name(item), array);
+                    obs_data_array_release(array);
+                }
+                obs_data_release(parts[i]);
+            }
+        }
+        obs_data_release(result);
+    }
+
+    for (ws_mirror_replay_t &replay: mirror->replay) {
+        replay.handler(mirror, replay.event_data);
+        obs_data_release(replay.event_data);
+    }
+    mirror->replay.clear();
+    if (mirror->replay_overflow) {
+        mirror->dirty.all = true;
+    }
+    mirror->json.clear();
+
+    ws_mirror_kick(relay);
+    ws_mirror_answer(relay);
+}
+
+// Once-a-second upkeep: drop out of live mode when events stop covering the mirror, seed it again
+// once they do, and send snapshots that stopped waiting. Called with the mutex held
+void ws_mirror_maintain(ws_relay_t *relay) {
+    ws_mirror_t *mirror = relay->mirror;
+    if (!mirror) return;
+
+    bool covered = ws_mirror_covered(relay);
+    if (!covered && mirror->live) {
+        ws_mirror_invalidate(relay);
+    }
+    if (covered && !mirror->live && !mirror->fetching &&
+        time(NULL) - mirror->last_seed >= relay->config.reconnect_interval) {
+        mirror->dirty.all = true;
+    }
+
+    ws_mirror_kick(relay);
+    ws_mirror_answer(relay);
+}
+
+void ws_mirror_on_remote_lost(ws_relay_t *relay) {
+    if (relay->mirror) relay->mirror->pending.clear();
+}
+
+static void ws_mirror_attach(ws_relay_t *relay) {
+    ws_mirror_t *mirror = new ws_mirror_t();
+    mirror->context = relay->context;
+    mirror->refs = 2;
+    mirror->scene_items = obs_data_create();
+    mirror->filters = obs_data_create();
+    pthread_mutex_init(&mirror->lock, NULL);
+    os_sem_init(&mirror->sem, 0);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, ws_mirror_thread, mirror) != 0) {
+        obs_log(LOG_ERROR, "Failed to create OBS state mirror thread");
+        obs_data_release(mirror->scene_items);
+        obs_data_release(mirror->filters);
+        os_sem_destroy(mirror->sem);
+        pthread_mutex_destroy(&mirror->lock);
+        delete mirror;
+        return;
+    }
+    // Like the in-process request worker, nothing joins this thread: a fetch waiting on OBS must
+    // not block a relay stopped from the UI thread
+    pthread_detach(thread);
+
+    relay->mirror = mirror;
+    obs_log(LOG_INFO, "Mirroring OBS state for the remote");
+    ws_mirror_maintain(relay);
+}
+
+// Start or end the mirror to match the settings. Called on the service thread with the mutex held
+void ws_mirror_sync(ws_relay_t *relay) {
+    bool wanted = os_atomic_load_bool(&relay->running) && relay->config.auth_offload && relay->config.state_mirror;
+    if (wanted && !relay->mirror) {
+        ws_mirror_attach(relay);
+    } else if (!wanted && relay->mirror) {
+        ws_mirror_detach(relay);
+    }
+}
+
+// Drop the mirror; a fetch still running finishes in the background. Called with the mutex held
+void ws_mirror_detach(ws_relay_t *relay) {
+    ws_mirror_t *mirror = relay->mirror;
+    if (!mirror) return;
+
+    relay->mirror = NULL;
+    obs_log(LOG_INFO, "No longer mirroring OBS state");
+
+    obs_data_release(mirror->scene_list);
+    obs_data_release(mirror->input_list);
+    obs_data_release(mirror->transition_list);
+    obs_data_release(mirror->scene_items);
+    obs_data_release(mirror->filters);
+    for (ws_mirror_replay_t &replay: mirror->replay) {
+        obs_data_release(replay.event_data);
+    }
+
+    pthread_mutex_lock(&mirror->lock);
+    mirror->detached = true;
+    mirror->context = NULL;
+    pthread_mutex_unlock(&mirror->lock);
+    os_sem_post(mirror->sem);
+    ws_mirror_release(mirror);
+}
+
+// Whether the worker has handed over a result for ws_mirror_flush. Service thread only, without
+// the mutex: only that thread attaches and detaches the mirror while the relay runs
+bool ws_mirror_result_ready(ws_relay_t *relay) {
+    return relay->mirror && os_atomic_load_bool(&relay->mirror->result_ready);
+}
+
+// Serialized snapshot for the vendor request made to OBS directly, NULL unless the mirror is
+// current. Unless transforms follow events, the scene item lists have to have been fetched
+// within the last second; if not, a fetch is started for the caller's next try. Free with
+// bfree; called with the mutex held
+char *ws_mirror_get_snapshot(ws_relay_t *relay) {
+    ws_mirror_t *mirror = relay->mirror;
+    if (!mirror || !mirror->seeded || !mirror->live || mirror->fetching || !mirror->dirty.empty()) return NULL;
+
+    if (!ws_mirror_follows_transforms(relay) &&
+        os_gettime_ns() - mirror->transforms_fetched_ns > WS_MIRROR_TRANSFORMS_FRESH_NS) {
+        ws_mirror_refresh_transforms(mirror);
+        ws_mirror_kick(relay);
+        return NULL;
+    }
+
+    return bstrdup(ws_mirror_snapshot(mirror).c_str());
+}
+
+void ws_mirror_get_stats(ws_relay_t *relay, ws_relay_direction_stats_t *stats) {
+    stats->mirror_live = relay->mirror && relay->mirror->live;
+}
@@ -0,0 +1,490 @@
+/*
+OBS WebSocket Relay - Remote Connection Sharing
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "ws-relay-internal.h"
+#include <obs-module.h>
+#include <plugin-support.h>
+#include <libwebsockets.h>
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// A relay on this host attached to the owner's remote connection
+typedef struct {
+    ws_relay_t *relay; // The owner
+    struct lws *wsi;
+    int channel; // Taken from its first frame, -1 until then
+    std::vector<char> payload; // Frame being reassembled, after WS_MSG_PRE bytes of headroom
+    std::deque<ws_message_t> buffers; // Frames from the remote waiting to be written to it
+    size_t queued_bytes;
+} ws_hub_peer_t;
+
+// The owner listens for attached relays on a Unix socket; the lock file is held for as long as
+// it owns the connection, so the lock goes away with a crashed owner's process
+struct ws_mux_hub {
+    ws_hub_role_t role = WS_HUB_NONE;
+    std::string socket_path;
+    std::string address; // ws+unix:// address of the owner's socket while attached
+    int lock_fd = -1; // Held while owner
+    struct lws_vhost *vhost = NULL;
+    struct lws_protocols protocols[2] = {};
+    std::vector<ws_hub_peer_t *> peers;
+    ws_hub_peer_t *route = NULL; // Peer the remote's current message goes to, NULL to drop it
+    std::vector<char> route_payload;
+};
+
+static ws_hub_peer_t *ws_hub_find_peer(ws_mux_hub_t *hub, int channel) {
+    for (ws_hub_peer_t *peer: hub->peers) {
+        if (peer->channel == channel) return peer;
+    }
+    return NULL;
+}
+
+// Queue a frame of an attached relay's channel for the remote as it is; called with the mutex held
+static void ws_hub_queue_remote(ws_relay_t *relay, ws_message_t &msg) {
+    ws_connection_t *remote = &relay->remote_conn;
+    if (remote->state != WS_STATE_CONNECTED || !remote->wsi) return;
+
+    msg.msg_class = WS_MESSAGE_SESSION;
+    msg.mux_routed = true;
+    remote->queued_bytes += msg.data.size() - WS_MSG_PRE;
+    remote->buffers.push_back(std::move(msg));
+    lws_callback_on_writable(remote->wsi);
+}
+
+// Forget a peer, ending its channel at the remote as a relay of its own that went away would.
+// With detach its connection is closed as well. Called with the mutex held
+static void ws_hub_peer_remove(ws_relay_t *relay, ws_hub_peer_t *peer, bool detach) {
+    ws_mux_hub_t *hub = relay->hub;
+
+    if (peer->channel > 0) {
+        ws_message_t msg;
+        msg.data.resize(WS_MSG_PRE + WS_MUX_HEADER_SIZE);
+        ws_mux_put_header((unsigned char *) msg.data.data() + WS_MSG_PRE, WS_MUX_CLOSE, (uint16_t) peer->channel, 0);
+        ws_hub_queue_remote(relay, msg);
+        obs_log(LOG_INFO, "Relay on channel %d detached from the shared remote connection", peer->channel);
+    }
+
+    if (detach && peer->wsi) {
+        lws_set_opaque_user_data(peer->wsi, NULL);
+        lws_close_reason(peer->wsi, LWS_CLOSE_STATUS_GOINGAWAY, NULL, 0);
+        lws_set_timeout(peer->wsi, PENDING_TIMEOUT_USER_OK, LWS_TO_KILL_ASYNC);
+    }
+
+    if (hub->route == peer) {
+        hub->route = NULL;
+    }
+    hub->peers.erase(std::find(hub->peers.begin(), hub->peers.end(), peer));
+    delete peer;
+}
+
+// Directory and file name without extension of the lock and socket for the relay's remote
+// addresses; false if there is no safe place for them
+static bool ws_hub_key_path(ws_relay_t *relay, std::string &base) {
+#if defined(_WIN32)
+    UNUSED_PARAMETER(relay);
+    UNUSED_PARAMETER(base);
+    return false;
+#else
+    const char *tmp = getenv("TMPDIR");
+    std::string dir = std::string(tmp && *tmp ? tmp : "/tmp") + "/" WS_HUB_DIR_PREFIX + std::to_string(getuid());
+    if (mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST) {
+        obs_log(LOG_WARNING, "Not sharing the remote connection: cannot create %s: %s", dir.c_str(), strerror(errno));
+        return false;
+    }
+
+    // Anyone else able to write there could listen in place of the owner
+    struct stat st;
+    if (lstat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode) || st.st_uid != getuid() || (st.st_mode & 077)) {
+        obs_log(LOG_WARNING, "Not sharing the remote connection: %s is not a private directory", dir.c_str());
+        return false;
+    }
+
+    // FNV-1a of the address list, so relays share exactly when they would dial the same remote
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const char *p = relay->config.remote_ws_address; *p; p++) {
+        hash ^= (unsigned char) *p;
+        hash *= 0x100000001b3ULL;
+    }
+    char key[17];
+    snprintf(key, sizeof(key), "%016llx", (unsigned long long) hash);
+    base = dir + "/" + key;
+
+    // The socket path has to fit sockaddr_un, and a colon would end it early in a ws+unix:// URL
+    struct sockaddr_un addr;
+    if (base.size() + strlen(".sock") >= sizeof(addr.sun_path) || base.find(':') != std::string::npos) {
+        obs_log(LOG_WARNING, "Not sharing the remote connection: %s does not fit a socket address", dir.c_str());
+        return false;
+    }
+    return true;
+#endif
+}
+
+// Decide how the relay reaches the remote before it dials: as the owner of the host's shared
+// connection, attached to another relay owning it, or on its own. The first relay to lock the
+// key of its remote addresses owns the connection until it releases it or its process exits.
+// Called on the service thread with the mutex held
+ws_hub_role_t ws_mux_hub_elect(ws_relay_t *relay) {
+#if defined(_WIN32) || !defined(LWS_WITH_UNIX_SOCK)
+    UNUSED_PARAMETER(relay);
+    return WS_HUB_NONE;
+#else
+    if (!ws_mux_enabled(relay) || !relay->config.mux_share) {
+        ws_mux_hub_release(relay);
+        return WS_HUB_NONE;
+    }
+
+    if (!relay->hub) {
+        relay->hub = new ws_mux_hub_t();
+        relay->hub->protocols[0].name = "websocket";
+        relay->hub->protocols[0].callback = ws_callback_hub;
+        relay->hub->protocols[0].rx_buffer_size = WS_SERV_BUF_SIZE;
+        relay->hub->protocols[0].user = relay;
+    }
+    ws_mux_hub_t *hub = relay->hub;
+    if (hub->role == WS_HUB_OWNER) return WS_HUB_OWNER;
+
+    std::string base;
+    if (!ws_hub_key_path(relay, base)) {
+        hub->role = WS_HUB_NONE;
+        hub->address.clear();
+        return WS_HUB_NONE;
+    }
+    hub->socket_path = base + ".sock";
+
+    std::string lock_path = base + ".lock";
+    int fd = open(lock_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        obs_log(LOG_WARNING, "Not sharing the remote connection: cannot open %s: %s", lock_path.c_str(),
+                strerror(errno));
+        hub->role = WS_HUB_NONE;
+        hub->address.clear();
+        return WS_HUB_NONE;
+    }
+
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        close(fd);
+        if (hub->role != WS_HUB_ATTACHED) {
+            obs_log(LOG_INFO, "Another relay on this host is connected to %s, attaching to it",
+                    relay->config.remote_ws_address);
+        }
+        hub->role = WS_HUB_ATTACHED;
+        hub->address = "ws+unix://" + hub->socket_path;
+        return WS_HUB_ATTACHED;
+    }
+
+    // Whoever held the lock before is gone, so a socket it left behind is stale
+    unlink(hub->socket_path.c_str());
+
+    struct lws_context_creation_info info = {0};
+    info.port = 0;
+    info.iface = hub->socket_path.c_str();
+    info.options = LWS_SERVER_OPTION_UNIX_SOCK;
+    info.protocols = hub->protocols;
+    info.vhost_name = "relay-hub";
+    hub->vhost = lws_create_vhost(relay->context, &info);
+    if (!hub->vhost) {
+        obs_log(LOG_WARNING, "Not sharing the remote connection: cannot listen on %s", hub->socket_path.c_str());
+        close(fd);
+        hub->role = WS_HUB_NONE;
+        hub->address.clear();
+        return WS_HUB_NONE;
+    }
+
+    hub->lock_fd = fd;
+    hub->role = WS_HUB_OWNER;
+    hub->address.clear();
+    obs_log(LOG_INFO, "Sharing the connection to %s with other relays on this host through %s",
+            relay->config.remote_ws_address, hub->socket_path.c_str());
+    return WS_HUB_OWNER;
+#endif
+}
+
+ws_hub_role_t ws_mux_hub_role(ws_relay_t *relay) {
+    return relay->hub ? relay->hub->role : WS_HUB_NONE;
+}
+
+// ws+unix:// address of the owner while attached to it, otherwise NULL
+const char *ws_mux_hub_address(ws_relay_t *relay) {
+    return ws_mux_hub_role(relay) == WS_HUB_ATTACHED ? relay->hub->address.c_str() : NULL;
+}
+
+// Close the connections of all attached relays; they attach again, or take over, once the
+// remote is back. Called with the mutex held
+void ws_mux_hub_drop_peers(ws_relay_t *relay) {
+    ws_mux_hub_t *hub = relay->hub;
+    if (!hub) return;
+
+    while (!hub->peers.empty()) {
+        ws_hub_peer_remove(relay, hub->peers.back(), true);
+    }
+    hub->route = NULL;
+}
+
+// Stop owning or using the shared connection, so another relay can take it over; called with
+// the mutex held
+void ws_mux_hub_release(ws_relay_t *relay) {
+    ws_mux_hub_t *hub = relay->hub;
+    if (!hub) return;
+
+    ws_mux_hub_drop_peers(relay);
+    if (hub->role == WS_HUB_OWNER) {
+        lws_vhost_destroy(hub->vhost);
+        hub->vhost = NULL;
+#if !defined(_WIN32)
+        // The socket goes before the lock, so the next owner does not find it
+        unlink(hub->socket_path.c_str());
+        close(hub->lock_fd);
+#endif
+        hub->lock_fd = -1;
+        obs_log(LOG_INFO, "Stopped sharing the remote connection");
+    }
+    hub->role = WS_HUB_NONE;
+    hub->address.clear();
+}
+
+// Free the hub after the lws context, which took the listening vhost and the attached relays'
+// connections with it
+void ws_mux_hub_destroy(ws_relay_t *relay) {
+    ws_mux_hub_t *hub = relay->hub;
+    if (!hub) return;
+
+    for (ws_hub_peer_t *peer: hub->peers) {
+        delete peer;
+    }
+#if !defined(_WIN32)
+    if (hub->role == WS_HUB_OWNER) {
+        unlink(hub->socket_path.c_str());
+        close(hub->lock_fd);
+    }
+#endif
+    delete hub;
+    relay->hub = NULL;
+}
+
+// A message on the remote connection starts for a channel other than the relay's own; returns
+// true if it belongs to an attached relay, which ws_mux_hub_route then hands it to. Called
+// with the mutex held
+bool ws_mux_hub_route_begin(ws_relay_t *relay, uint16_t channel) {
+    ws_mux_hub_t *hub = relay->hub;
+    if (!hub || hub->role != WS_HUB_OWNER) return false;
+
+    hub->route = ws_hub_find_peer(hub, channel);
+    hub->route_payload.resize(WS_MSG_PRE);
+    return hub->route != NULL;
+}
+
+// Collect a fragment of a message routed to an attached relay, header included, and queue the
+// message for it once complete. A relay that falls too far behind is dropped rather than
+// holding the shared connection up. Called with the mutex held
+void ws_mux_hub_route(ws_relay_t *relay, struct lws *wsi, const void *in, size_t len) {
+    ws_mux_hub_t *hub = relay->hub;
+    ws_hub_peer_t *peer = hub ? hub->route : NULL;
+    if (!peer) return;
+
+    size_t size = hub->route_payload.size() - WS_MSG_PRE + len;
+    if (size > WS_MAX_MESSAGE_SIZE) {
+        obs_log(LOG_WARNING, "Dropping message for channel %d larger than %d bytes", peer->channel,
+                WS_MAX_MESSAGE_SIZE);
+        hub->route = NULL;
+        hub->route_payload = std::vector<char>(WS_MSG_PRE);
+        return;
+    }
+    hub->route_payload.insert(hub->route_payload.end(), (const char *) in, (const char *) in + len);
+    if (!lws_is_final_fragment(wsi)) return;
+
+    hub->route = NULL;
+    if (peer->queued_bytes + size > WS_HUB_PEER_QUEUE_MAX) {
+        obs_log(LOG_WARNING, "Dropping relay on channel %d, it is not reading from the shared remote connection",
+                peer->channel);
+        ws_hub_peer_remove(relay, peer, true);
+        return;
+    }
+
+    ws_message_t msg;
+    msg.data = std::move(hub->route_payload);
+    hub->route_payload = std::vector<char>(WS_MSG_PRE);
+    peer->queued_bytes += size;
+    peer->buffers.push_back(std::move(msg));
+    lws_callback_on_writable(peer->wsi);
+
+    relay->stats.to_obs.hub_messages++;
+    relay->stats.to_obs.hub_bytes += size;
+}
+
+void ws_mux_hub_get_stats(ws_relay_t *relay, ws_relay_direction_stats_t *stats) {
+    stats->hub_peers = relay->hub ? relay->hub->peers.size() : 0;
+}
+
+// Collect a fragment from an attached relay and pass complete frames on to the remote. The
+// relay's first frame claims its channel, which must not be in use; returns false if the relay
+// has to be disconnected. Called with the mutex held
+static bool ws_hub_peer_receive(ws_hub_peer_t *peer, struct lws *wsi, const void *in, size_t len) {
+    ws_relay_t *relay = peer->relay;
+
+    if (lws_is_first_fragment(wsi)) {
+        peer->payload.resize(WS_MSG_PRE);
+    }
+    if (peer->payload.size() - WS_MSG_PRE + len > WS_MAX_MESSAGE_SIZE) {
+        obs_log(LOG_WARNING, "Closing attached relay: message larger than %d bytes", WS_MAX_MESSAGE_SIZE);
+        return false;
+    }
+    peer->payload.insert(peer->payload.end(), (const char *) in, (const char *) in + len);
+    if (!lws_is_final_fragment(wsi)) return true;
+
+    size_t size = peer->payload.size() - WS_MSG_PRE;
+    const unsigned char *header = (const unsigned char *) peer->payload.data() + WS_MSG_PRE;
+    if (size < WS_MUX_HEADER_SIZE || header[0] != WS_MUX_VERSION) {
+        obs_log(LOG_WARNING, "Closing attached relay: message without multiplexing header");
+        return false;
+    }
+
+    int channel = (header[2] << 8) | header[3];
+    if (peer->channel < 0) {
+        if (channel == 0 || channel == relay->config.mux_channel || ws_hub_find_peer(relay->hub, channel)) {
+            obs_log(LOG_WARNING, "Closing attached relay: channel %d is already in use", channel);
+            return false;
+        }
+        peer->channel = channel;
+        obs_log(LOG_INFO, "Relay on channel %d attached to the shared remote connection", channel);
+    } else if (channel != peer->channel) {
+        obs_log(LOG_WARNING, "Closing attached relay on channel %d: frame for channel %d", peer->channel, channel);
+        return false;
+    }
+
+    ws_connection_t *remote = &relay->remote_conn;
+    if (remote->state != WS_STATE_CONNECTED || !remote->wsi) return false;
+    if (remote->queued_bytes + size > WS_HUB_PEER_QUEUE_MAX) {
+        obs_log(LOG_WARNING, "Closing attached relay on channel %d: the remote is not keeping up", peer->channel);
+        return false;
+    }
+
+    ws_message_t msg;
+    msg.data = std::move(peer->payload);
+    peer->payload = std::vector<char>(WS_MSG_PRE);
+    ws_hub_queue_remote(relay, msg);
+
+    relay->stats.to_remote.hub_messages++;
+    relay->stats.to_remote.hub_bytes += size;
+    return true;
+}
+
+// Write what the remote sent for an attached relay; returns false if the write failed.
+// Called with the mutex held
+static bool ws_hub_peer_write(ws_hub_peer_t *peer, struct lws *wsi) {
+    while (!peer->buffers.empty() && !lws_send_pipe_choked(wsi)) {
+        ws_message_t &msg = peer->buffers.front();
+        size_t size = msg.data.size() - WS_MSG_PRE;
+        if (lws_write(wsi, (unsigned char *) msg.data.data() + WS_MSG_PRE, size, LWS_WRITE_BINARY) < 0) {
+            obs_log(LOG_ERROR, "Failed to write to attached relay on channel %d", peer->channel);
+            return false;
+        }
+        peer->queued_bytes -= size;
+        peer->buffers.pop_front();
+    }
+
+    if (!peer->buffers.empty()) {
+        lws_callback_on_writable(wsi);
+    }
+    return true;
+}
+
+// Callback of the owner's listening socket for attached relays. Their connections are only
+// accepted while the remote is up, since their sessions start with it
+int ws_callback_hub(struct lws *wsi, enum lws_callback_reasons reason, void *user, void *in, size_t len) {
+    UNUSED_PARAMETER(user);
+    ws_hub_peer_t *peer = (ws_hub_peer_t *) lws_get_opaque_user_data(wsi);
+
+    switch (reason) {
+        case LWS_CALLBACK_ESTABLISHED: {
+            ws_relay_t *relay = (ws_relay_t *) lws_get_protocol(wsi)->user;
+            ws_relay_lock(relay);
+            bool accept = ws_mux_hub_role(relay) == WS_HUB_OWNER &&
+                          relay->remote_conn.state == WS_STATE_CONNECTED && relay->remote_conn.wsi;
+            if (accept) {
+                peer = new ws_hub_peer_t();
+                peer->relay = relay;
+                peer->wsi = wsi;
+                peer->channel = -1;
+                peer->payload = std::vector<char>(WS_MSG_PRE);
+                peer->queued_bytes = 0;
+                relay->hub->peers.push_back(peer);
+                lws_set_opaque_user_data(wsi, peer);
+            }
+            pthread_mutex_unlock(&relay->mutex);
+            if (!accept) {
+                obs_log(LOG_INFO, "Refusing relay attaching while the remote is not connected");
+                return -1;
+            }
+            break;
+        }
+
+        case LWS_CALLBACK_RECEIVE: {
+            if (!peer) break;
+
+            ws_relay_t *relay = peer->relay;
+            ws_relay_lock(relay);
+            bool keep = ws_hub_peer_receive(peer, wsi, in, len);
+            pthread_mutex_unlock(&relay->mutex);
+            // Closing reports back with CLOSED, which forgets the peer
+            if (!keep) {
+                lws_close_reason(wsi, LWS_CLOSE_STATUS_POLICY_VIOLATION, NULL, 0);
+                return -1;
+            }
+            break;
+        }
+
+        case LWS_CALLBACK_SERVER_WRITEABLE: {
+            if (!peer) break;
+
+            ws_relay_t *relay = peer->relay;
+            ws_relay_lock(relay);
+            bool ok = ws_hub_peer_write(peer, wsi);
+            pthread_mutex_unlock(&relay->mutex);
+            if (!ok) return -1;
+            break;
+        }
+
+        case LWS_CALLBACK_CLOSED: {
+            if (!peer) break;
+
+            ws_relay_t *relay = peer->relay;
+            ws_relay_lock(relay);
+            lws_set_opaque_user_data(wsi, NULL);
+            ws_hub_peer_remove(relay, peer, false);
+            pthread_mutex_unlock(&relay->mutex);
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    return 0;
+}
@@ -0,0 +1,321 @@
+/*
+OBS WebSocket Relay - Channel Multiplexing
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "ws-relay-internal.h"
+#include <obs-module.h>
+#include <plugin-support.h>
+#include <libwebsockets.h>
+#include <util/platform.h>
+
+// Window of the relay's channel in bytes, 0 if flow control is off
+static size_t ws_mux_window(ws_relay_t *relay) {
+    return relay->config.mux_window_kb > 0 ? (size_t) relay->config.mux_window_kb * 1024 : 0;
+}
+
+// Queue a control frame ahead of any data; called with the mutex held
+static void ws_mux_send_control(ws_connection_t *conn, ws_mux_frame_type_t type, uint32_t value,
+                                const unsigned char *payload = NULL, size_t len = 0) {
+    if (conn->state != WS_STATE_CONNECTED || !conn->wsi) return;
+
+    ws_message_t msg;
+    msg.data.resize(WS_MSG_PRE + len);
+    if (len) {
+        memcpy(msg.data.data() + WS_MSG_PRE, payload, len);
+    }
+    msg.msg_class = WS_MESSAGE_SESSION;
+    msg.mux_type = type;
+    msg.mux_value = value;
+
+    // Control frames are not flow controlled, so they must not wait behind blocked data
+    conn->buffers.push_front(std::move(msg));
+    lws_callback_on_writable(conn->wsi);
+}
+
+bool ws_mux_enabled(ws_relay_t *relay) {
+    return relay->config.mux_channel > 0;
+}
+
+// Start a session on the relay's channel of the active remote connection; called with the mutex held
+void ws_mux_open(ws_relay_t *relay) {
+    if (!ws_mux_enabled(relay)) return;
+
+    // Both sides start out with the same window, so data can flow without waiting for a grant
+    size_t window = ws_mux_window(relay);
+    relay->mux.send_credit = (int64_t) window;
+    relay->mux.recv_pending = 0;
+    relay->mux.rx_skip = false;
+
+    ws_mux_send_control(&relay->remote_conn, WS_MUX_OPEN, (uint32_t) window);
+
+    // The remote may be another server with another clock, so the offset is learned anew
+    relay->mux.clock_request_us = 0;
+    relay->mux.clock_request_ns = 0;
+    relay->mux.clock_samples = 0;
+    relay->mux.clock_valid = false;
+    ws_mux_maintain(relay);
+
+    if (relay->config.enable_logging) {
+        obs_log(LOG_INFO, "Opened multiplexing channel %d (window %zu bytes)", relay->config.mux_channel, window);
+    }
+}
+
+// Account for a data message about to be sent; returns false if the remote's window is closed.
+// A message larger than the remaining window may still go out while any credit is left, so
+// messages bigger than the whole window cannot stall the channel. Called with the mutex held
+bool ws_mux_take_credit(ws_relay_t *relay, size_t size) {
+    if (!ws_mux_window(relay)) return true;
+    if (relay->mux.send_credit <= 0) return false;
+
+    relay->mux.send_credit -= (int64_t) size;
+    return true;
+}
+
+// Write a multiplexing header to out
+void ws_mux_put_header(unsigned char *out, ws_mux_frame_type_t type, uint16_t channel, uint32_t value) {
+    out[0] = WS_MUX_VERSION;
+    out[1] = (unsigned char) type;
+    out[2] = (unsigned char) (channel >> 8);
+    out[3] = (unsigned char) channel;
+    out[4] = (unsigned char) (value >> 24);
+    out[5] = (unsigned char) (value >> 16);
+    out[6] = (unsigned char) (value >> 8);
+    out[7] = (unsigned char) value;
+}
+
+// Put the multiplexing header of a queued message into its headroom, right in front of the
+// payload; returns the start of the frame
+unsigned char *ws_mux_header(ws_relay_t *relay, ws_message_t &msg) {
+    unsigned char *header = (unsigned char *) msg.data.data() + LWS_PRE;
+    ws_mux_put_header(header, msg.mux_type, (uint16_t) relay->config.mux_channel, msg.mux_value);
+    return header;
+}
+
+static bool ws_mux_stamping(ws_relay_t *relay) {
+    return ws_mux_enabled(relay) && relay->config.latency_stamping;
+}
+
+static uint64_t ws_mux_clock_us(void) {
+    return os_gettime_ns() / 1000;
+}
+
+static void ws_mux_put_u64(unsigned char *out, uint64_t value) {
+    for (int i = 7; i >= 0; i--) {
+        out[i] = (unsigned char) value;
+        value >>= 8;
+    }
+}
+
+static uint64_t ws_mux_get_u64(const unsigned char *in) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+// Header value for a data message on its way to the remote: the relay clock once the message is
+// complete at the relay, 0 while stamping is off
+uint32_t ws_mux_stamp(ws_relay_t *relay) {
+    if (!ws_mux_stamping(relay)) return 0;
+
+    uint32_t stamp = (uint32_t) ws_mux_clock_us();
+    return stamp ? stamp : 1;
+}
+
+// Start a clock exchange every WS_MUX_CLOCK_INTERVAL_NS; a request that got no response by then is
+// given up. Called with the mutex held
+void ws_mux_maintain(ws_relay_t *relay) {
+    if (!ws_mux_stamping(relay) || relay->remote_conn.state != WS_STATE_CONNECTED) return;
+
+    uint64_t now = os_gettime_ns();
+    if (relay->mux.clock_request_ns && now - relay->mux.clock_request_ns < WS_MUX_CLOCK_INTERVAL_NS) return;
+
+    unsigned char payload[sizeof(uint64_t)];
+    relay->mux.clock_request_ns = now;
+    relay->mux.clock_request_us = ws_mux_clock_us();
+    ws_mux_put_u64(payload, relay->mux.clock_request_us);
+    ws_mux_send_control(&relay->remote_conn, WS_MUX_CLOCK, WS_MUX_CLOCK_REQUEST, payload, sizeof(payload));
+}
+
+// NTP-style offset from one exchange: the remote clock runs offset ahead of ours, assuming both
+// directions take equally long. The exchange with the lowest round trip among the recent ones is
+// the least disturbed by queueing, so its offset is used and announced to the remote
+static void ws_mux_on_clock_response(ws_relay_t *relay, const unsigned char *payload) {
+    ws_mux_state_t *mux = &relay->mux;
+    int64_t t1 = (int64_t) ws_mux_get_u64(payload);
+    int64_t t2 = (int64_t) ws_mux_get_u64(payload + 8);
+    int64_t t3 = (int64_t) ws_mux_get_u64(payload + 16);
+    int64_t t4 = (int64_t) ws_mux_clock_us();
+
+    // Late responses to a request given up on are ignored
+    if (!mux->clock_request_us || t1 != (int64_t) mux->clock_request_us) return;
+    mux->clock_request_us = 0;
+
+    int64_t offset = ((t2 - t1) + (t3 - t4)) / 2;
+    int64_t delay = (t4 - t1) - (t3 - t2);
+    size_t slot = mux->clock_samples % WS_MUX_CLOCK_SAMPLES;
+    mux->clock_offsets[slot] = offset;
+    mux->clock_delays[slot] = delay > 0 ? (uint64_t) delay : 0;
+    mux->clock_samples++;
+
+    size_t count = mux->clock_samples < WS_MUX_CLOCK_SAMPLES ? mux->clock_samples : WS_MUX_CLOCK_SAMPLES;
+    size_t best = 0;
+    for (size_t i = 1; i < count; i++) {
+        if (mux->clock_delays[i] < mux->clock_delays[best]) {
+            best = i;
+        }
+    }
+    mux->clock_offset_us = mux->clock_offsets[best];
+    mux->clock_valid = true;
+
+    ws_relay_direction_stats_t *stats = &relay->stats.to_remote;
+    stats->clock_exchanges++;
+    stats->clock_offset_us = mux->clock_offset_us;
+    stats->clock_delay_us = mux->clock_delays[best];
+
+    unsigned char announce[2 * sizeof(uint64_t)];
+    ws_mux_put_u64(announce, (uint64_t) mux->clock_offset_us);
+    ws_mux_put_u64(announce + 8, mux->clock_delays[best]);
+    ws_mux_send_control(&relay->remote_conn, WS_MUX_CLOCK, WS_MUX_CLOCK_OFFSET, announce, sizeof(announce));
+
+    if (relay->config.enable_logging) {
+        obs_log(LOG_INFO, "Clock exchange with remote: offset %lld us, round trip %lld us, using offset %lld us",
+                (long long) offset, (long long) delay, (long long) mux->clock_offset_us);
+    }
+}
+
+// Record how long a stamped message from the remote took to reach the relay. Stamps are 32 bit,
+// so the difference is taken modulo 2^32, which holds for latencies up to about 35 minutes
+static void ws_mux_record_latency(ws_relay_t *relay, uint32_t stamp) {
+    if (!ws_mux_stamping(relay) || !relay->mux.clock_valid) return;
+
+    // The remote clock at this moment, cut to the stamp's width
+    uint32_t now = (uint32_t) (ws_mux_clock_us() + (uint64_t) relay->mux.clock_offset_us);
+    int32_t elapsed = (int32_t) (now - stamp);
+    // The offset is an estimate, so a fast message can appear to arrive before it was sent
+    uint64_t latency_us = elapsed > 0 ? (uint64_t) elapsed : 0;
+
+    ws_relay_direction_stats_t *stats = &relay->stats.to_obs;
+    stats->one_way_messages++;
+    stats->one_way_last_us = latency_us;
+    stats->one_way_max_us = std::max(stats->one_way_max_us, latency_us);
+    int bucket = 0;
+    for (uint64_t limit = 1000; bucket < WS_RTT_HISTOGRAM_BUCKETS - 1 && latency_us >= limit; limit *= 2) {
+        bucket++;
+    }
+    stats->one_way_histogram[bucket]++;
+}
+
+// Demultiplex a fragment received on the remote connection. The header is only present on the
+// first fragment of a message; for data on our channel it is stripped from in and len. Messages
+// for the channel of an attached relay are handed to the hub whole, header included.
+// Called with the mutex held
+ws_mux_rx_result_t ws_mux_receive(ws_relay_t *relay, struct lws *wsi, void **in, size_t *len) {
+    ws_mux_state_t *mux = &relay->mux;
+
+    if (lws_is_first_fragment(wsi)) {
+        mux->rx_skip = true;
+        mux->rx_route = false;
+
+        if (*len < WS_MUX_HEADER_SIZE) {
+            obs_log(LOG_WARNING, "Ignoring message from remote without multiplexing header");
+            return WS_MUX_RX_CONSUMED;
+        }
+
+        const unsigned char *header = (const unsigned char *) *in;
+        if (header[0] != WS_MUX_VERSION) {
+            obs_log(LOG_WARNING, "Ignoring message with unsupported multiplexing version %d", header[0]);
+            return WS_MUX_RX_CONSUMED;
+        }
+
+        int type = header[1];
+        int channel = (header[2] << 8) | header[3];
+        uint32_t value = ((uint32_t) header[4] << 24) | ((uint32_t) header[5] << 16) |
+                         ((uint32_t) header[6] << 8) | (uint32_t) header[7];
+
+        if (channel != relay->config.mux_channel) {
+            if (ws_mux_hub_route_begin(relay, (uint16_t) channel)) {
+                mux->rx_route = true;
+                ws_mux_hub_route(relay, wsi, *in, *len);
+            } else if (relay->config.enable_logging) {
+                obs_log(LOG_INFO, "Ignoring message for multiplexing channel %d", channel);
+            }
+            return WS_MUX_RX_CONSUMED;
+        }
+
+        switch (type) {
+            case WS_MUX_DATA:
+                if (value) {
+                    ws_mux_record_latency(relay, value);
+                }
+                mux->rx_skip = false;
+                *in = (void *) (header + WS_MUX_HEADER_SIZE);
+                *len -= WS_MUX_HEADER_SIZE;
+                break;
+
+            case WS_MUX_WINDOW:
+                mux->send_credit += value;
+                if (!relay->remote_conn.buffers.empty()) {
+                    lws_callback_on_writable(wsi);
+                }
+                return WS_MUX_RX_CONSUMED;
+
+            case WS_MUX_CLOSE:
+                obs_log(LOG_INFO, "Remote closed multiplexing channel %d", channel);
+                return WS_MUX_RX_RESET;
+
+            case WS_MUX_CLOCK:
+                if (value == WS_MUX_CLOCK_RESPONSE && *len >= WS_MUX_HEADER_SIZE + 3 * sizeof(uint64_t)) {
+                    ws_mux_on_clock_response(relay, header + WS_MUX_HEADER_SIZE);
+                }
+                return WS_MUX_RX_CONSUMED;
+
+            default:
+                return WS_MUX_RX_CONSUMED;
+        }
+    } else if (mux->rx_route) {
+        ws_mux_hub_route(relay, wsi, *in, *len);
+        return WS_MUX_RX_CONSUMED;
+    } else if (mux->rx_skip) {
+        return WS_MUX_RX_CONSUMED;
+    }
+
+    mux->recv_pending += *len;
+    return WS_MUX_RX_FORWARD;
+}
+
+// Grant the remote window for data that has left the relay: written to OBS, executed in-process,
+// dropped or consumed by the relay. Data still queued for OBS or waiting for admission keeps its
+// window, so a slow OBS pushes back on the remote. Called from the service thread with the mutex held
+void ws_mux_update_window(ws_relay_t *relay) {
+    size_t window = ws_mux_window(relay);
+    if (!ws_mux_enabled(relay) || !window || relay->remote_conn.state != WS_STATE_CONNECTED) return;
+
+    ws_connection_t *obs = &relay->obs_conn;
+    size_t held = obs->queued_bytes + (obs->payload.size() > WS_MSG_PRE ? obs->payload.size() - WS_MSG_PRE : 0) +
+                  ws_obs_api_pending_bytes(relay) + ws_admission_pending_bytes(relay);
+    if (relay->mux.recv_pending <= held) return;
+
+    // Batch grants so small messages do not each cost a WINDOW frame
+    size_t grant = relay->mux.recv_pending - held;
+    if (grant < window / 2) return;
+    if (grant > UINT32_MAX) grant = UINT32_MAX;
+
+    relay->mux.recv_pending -= grant;
+    ws_mux_send_control(&relay->remote_conn, WS_MUX_WINDOW, (uint32_t) grant);
+}
@@ -0,0 +1,633 @@
+/*
+OBS WebSocket Relay - In-process obs-websocket Requests
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "ws-relay-internal.h"
+#include <obs-module.h>
+#include <plugin-support.h>
+#include <callback/calldata.h>
+#include <callback/proc.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <libwebsockets.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string>
+
+// obs-websocket op codes handled in-process
+#define WS_OP_EVENT 5
+#define WS_OP_REQUEST 6
+#define WS_OP_REQUEST_RESPONSE 7
+#define WS_OP_REQUEST_BATCH 8
+#define WS_OP_REQUEST_BATCH_RESPONSE 9
+
+// obs-websocket request status codes
+#define WS_REQUEST_STATUS_SUCCESS 100
+#define WS_REQUEST_STATUS_GENERIC_ERROR 205
+
+// obs-websocket's plugin API is a set of procedures on a proc handler of its own, which is what
+// obs-websocket-api.h wraps. Calling them directly needs no header from obs-websocket and lets
+// request data go through as the JSON text the remote sent
+struct obs_websocket_request_response {
+    unsigned int status_code;
+    char *comment;
+    char *response_data;
+};
+
+typedef void (*ws_obs_api_event_cb)(uint64_t intent, const char *event_type, const char *event_data, void *priv);
+
+// Message produced in-process, waiting for the service thread
+typedef struct {
+    ws_message_t msg;
+    uint64_t intent; // Event intent checked against the remote's subscriptions, 0 for responses
+} ws_obs_api_output_t;
+
+// Version probe that attaching starts with
+typedef enum {
+    WS_OBS_API_PROBING,
+    WS_OBS_API_PROBE_OK,
+    WS_OBS_API_PROBE_FAILED
+} ws_obs_api_probe_t;
+
+// Requests run on a worker thread, since obs-websocket executes them on the calling thread and
+// some wait for the UI thread; so does the version probe that starts a session. Events arrive on
+// whatever thread OBS raised them on. Neither takes the relay mutex: they hand their messages
+// over under lock and wake the service thread. The lock nests inside the relay mutex, never the
+// other way round
+struct ws_obs_api {
+    proc_handler_t *ph;
+    char version[64]; // obs-websocket version, for the relay's Hello
+    int log_level; // Of attach failures: warnings on the first attempt, debug on retries
+
+    pthread_mutex_t lock;
+    os_sem_t *sem; // Posted for every queued request and on detach
+    struct lws_context *context; // Woken when output is ready, NULL once detached
+    bool detached;
+    ws_obs_api_probe_t probe;
+    volatile bool wake_pending; // Output or the probe result waits for the service thread
+    std::deque<std::vector<char>> requests;
+    size_t request_bytes; // Bytes queued or executing
+    std::deque<ws_obs_api_output_t> output;
+    long refs; // Held by the relay and the worker
+
+    // Message from the remote being reassembled, service thread only
+    std::vector<char> rx;
+    bool rx_discard;
+};
+
+// obs-websocket's plugin API, NULL if obs-websocket is not loaded
+proc_handler_t *ws_obs_api_get_ph(void) {
+    proc_handler_t *global_ph = obs_get_proc_handler();
+    if (!global_ph) return NULL;
+
+    calldata_t cd = {0};
+    proc_handler_t *ph = NULL;
+    if (proc_handler_call(global_ph, "obs_websocket_api_get_ph", &cd)) {
+        ph = (proc_handler_t *) calldata_ptr(&cd, "ph");
+    }
+    calldata_free(&cd);
+    return ph;
+}
+
+static obs_websocket_request_response *ws_obs_api_call(proc_handler_t *ph, const char *type, const char *data) {
+    calldata_t cd = {0};
+    calldata_set_string(&cd, "request_type", type);
+    calldata_set_string(&cd, "request_data", data);
+    proc_handler_call(ph, "call_request", &cd);
+    auto *response = (obs_websocket_request_response *) calldata_ptr(&cd, "response");
+    calldata_free(&cd);
+    return response;
+}
+
+static void ws_obs_api_response_free(obs_websocket_request_response *response) {
+    if (!response) return;
+
+    bfree(response->comment);
+    bfree(response->response_data);
+    bfree(response);
+}
+
+static bool ws_obs_api_set_event_callback(proc_handler_t *ph, const char *proc, ws_obs_api_event_cb cb, void *priv) {
+    calldata_t cd = {0};
+    calldata_set_ptr(&cd, "callback", (void *) cb);
+    calldata_set_ptr(&cd, "priv_data", priv);
+    bool success = proc_handler_call(ph, proc, &cd) && calldata_bool(&cd, "success");
+    calldata_free(&cd);
+    return success;
+}
+
+static void ws_obs_api_release(ws_obs_api_t *api) {
+    if (os_atomic_dec_long(&api->refs) > 0) return;
+
+    os_sem_destroy(api->sem);
+    pthread_mutex_destroy(&api->lock);
+    delete api;
+}
+
+static void ws_append(std::vector<char> &out, const char *data, size_t len) {
+    out.insert(out.end(), data, data + len);
+}
+
+static void ws_append(std::vector<char> &out, const char *str) {
+    ws_append(out, str, strlen(str));
+}
+
+// Append str as a JSON string literal
+static void ws_append_quoted(std::vector<char> &out, const char *str) {
+    out.push_back('"');
+    for (const unsigned char *p = (const unsigned char *) str; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            out.push_back('\\');
+            out.push_back((char) *p);
+        } else if (*p < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", *p);
+            ws_append(out, escaped);
+        } else {
+            out.push_back((char) *p);
+        }
+    }
+    out.push_back('"');
+}
+
+// Execute one request and append its result object. type_json and id_json are already JSON
+// string literals; id_json may be NULL. Returns the request status code
+static unsigned int ws_obs_api_execute_one(ws_obs_api_t *api, const char *type, const char *data,
+                                           const std::string &type_json, const char *id_json, size_t id_json_len,
+                                           std::vector<char> &out) {
+    obs_websocket_request_response *response = ws_obs_api_call(api->ph, type, data);
+    unsigned int code = response ? response->status_code : WS_REQUEST_STATUS_GENERIC_ERROR;
+
+    ws_append(out, "{\"requestType\":");
+    ws_append(out, type_json.data(), type_json.size());
+    if (id_json) {
+        ws_append(out, ",\"requestId\":");
+        ws_append(out, id_json, id_json_len);
+    }
+
+    char status[64];
+    snprintf(status, sizeof(status), ",\"requestStatus\":{\"result\":%s,\"code\":%u",
+             code == WS_REQUEST_STATUS_SUCCESS ? "true" : "false", code);
+    ws_append(out, status);
+    if (!response) {
+        ws_append(out, ",\"comment\":\"obs-websocket did not handle the request\"");
+    } else if (response->comment) {
+        ws_append(out, ",\"comment\":");
+        ws_append_quoted(out, response->comment);
+    }
+    out.push_back('}');
+
+    if (response && response->response_data) {
+        ws_append(out, ",\"responseData\":");
+        ws_append(out, response->response_data);
+    }
+    out.push_back('}');
+
+    ws_obs_api_response_free(response);
+    return code;
+}
+
+// Answer a RequestBatch by running its requests in order. Every execution type runs serially
+// here, which is what obs-websocket does for all but the frame-paced one
+static void ws_obs_api_execute_batch(ws_obs_api_t *api, const char *data, size_t len, const ws_json_fields_t &fields,
+                                     std::vector<char> &out) {
+    ws_append(out, "{\"op\":9,\"d\":{");
+    if (fields.request_id) {
+        ws_append(out, "\"requestId\":\"");
+        ws_append(out, fields.request_id, fields.request_id_len);
+        ws_append(out, "\",");
+    }
+    ws_append(out, "\"results\":[");
+
+    obs_data_t *msg = obs_data_create_from_json(std::string(data, len).c_str());
+    obs_data_t *d = msg ? obs_data_get_obj(msg, "d") : NULL;
+    obs_data_array_t *requests = d ? obs_data_get_array(d, "requests") : NULL;
+    bool halt_on_failure = d && obs_data_get_bool(d, "haltOnFailure");
+
+    size_t count = requests ? obs_data_array_count(requests) : 0;
+    for (size_t i = 0; i < count; i++) {
+        obs_data_t *request = obs_data_array_item(requests, i);
+        const char *type = obs_data_get_string(request, "requestType");
+        obs_data_t *request_data = obs_data_get_obj(request, "requestData");
+
+        std::vector<char> type_json;
+        ws_append_quoted(type_json, type);
+        std::vector<char> id_json;
+        if (obs_data_has_user_value(request, "requestId")) {
+            ws_append_quoted(id_json, obs_data_get_string(request, "requestId"));
+        }
+
+        if (i > 0) out.push_back(',');
+        unsigned int code = ws_obs_api_execute_one(api, type, request_data ? obs_data_get_json(request_data) : NULL,
+                                                   std::string(type_json.begin(), type_json.end()),
+                                                   id_json.empty() ? NULL : id_json.data(), id_json.size(), out);
+
+        obs_data_release(request_data);
+        obs_data_release(request);
+        if (halt_on_failure && code != WS_REQUEST_STATUS_SUCCESS) break;
+    }
+
+    obs_data_array_release(requests);
+    obs_data_release(d);
+    obs_data_release(msg);
+    ws_append(out, "]}}");
+}
+
+// Execute a Request or RequestBatch from the remote and build the message answering it in out,
+// after WS_MSG_PRE bytes of headroom. Returns false if there is nothing to answer
+static bool ws_obs_api_execute(ws_obs_api_t *api, const char *data, size_t len, std::vector<char> &out) {
+    ws_json_fields_t fields;
+    if (!ws_json_scan(data, len, &fields)) return false;
+
+    out.resize(WS_MSG_PRE);
+    if (fields.op == WS_OP_REQUEST_BATCH) {
+        ws_obs_api_execute_batch(api, data, len, fields, out);
+        return true;
+    }
+    if (fields.op != WS_OP_REQUEST) return false;
+
+    // The request data goes to obs-websocket as the JSON text the remote sent, the request type
+    // decoded. Type and id are echoed in the escaped form they arrived in
+    std::string type_raw(fields.request_type ? fields.request_type : "", fields.request_type_len);
+    std::string type = ws_json_unescape(type_raw.data(), type_raw.size());
+    char *request_data = fields.request_data ? bstrdup_n(fields.request_data, fields.request_data_len) : NULL;
+    std::string type_json = "\"" + type_raw + "\"";
+    std::string id_json = fields.request_id ? "\"" + std::string(fields.request_id, fields.request_id_len) + "\""
+                                            : std::string();
+
+    ws_append(out, "{\"op\":7,\"d\":");
+    // Like the batch path, an answer to a request without an id has none either
+    ws_obs_api_execute_one(api, type.c_str(), request_data, type_json, id_json.empty() ? NULL : id_json.data(),
+                           id_json.size(), out);
+    out.push_back('}');
+
+    bfree(request_data);
+    return true;
+}
+
+// Hand a message to the service thread; called with api->lock held
+static void ws_obs_api_push(ws_obs_api_t *api, ws_obs_api_output_t &output) {
+    api->output.push_back(std::move(output));
+    if (!api->wake_pending && api->context) {
+        os_atomic_store_bool(&api->wake_pending, true);
+        lws_cancel_service(api->context);
+    }
+}
+
+// Ask for obs-websocket's version, which goes into the relay's Hello; the answer also proves
+// requests get through. Runs on the worker before any request
+static void ws_obs_api_probe(ws_obs_api_t *api) {
+    obs_websocket_request_response *response = ws_obs_api_call(api->ph, "GetVersion", NULL);
+    bool success = response && response->status_code == WS_REQUEST_STATUS_SUCCESS && response->response_data;
+    obs_data_t *version = success ? obs_data_create_from_json(response->response_data) : NULL;
+    ws_obs_api_response_free(response);
+
+    pthread_mutex_lock(&api->lock);
+    if (version) {
+        snprintf(api->version, sizeof(api->version), "%s", obs_data_get_string(version, "obsWebSocketVersion"));
+    }
+    api->probe = success ? WS_OBS_API_PROBE_OK : WS_OBS_API_PROBE_FAILED;
+    if (!api->wake_pending && api->context) {
+        os_atomic_store_bool(&api->wake_pending, true);
+        lws_cancel_service(api->context);
+    }
+    pthread_mutex_unlock(&api->lock);
+    obs_data_release(version);
+}
+
+static void *ws_obs_api_thread(void *data) {
+    ws_obs_api_t *api = (ws_obs_api_t *) data;
+    os_set_thread_name("ws-relay-obs-api");
+
+    ws_obs_api_probe(api);
+
+    for (;;) {
+        os_sem_wait(api->sem);
+
+        pthread_mutex_lock(&api->lock);
+        if (api->detached) {
+            pthread_mutex_unlock(&api->lock);
+            break;
+        }
+        if (api->requests.empty()) {
+            pthread_mutex_unlock(&api->lock);
+            continue;
+        }
+        std::vector<char> request = std::move(api->requests.front());
+        api->requests.pop_front();
+        pthread_mutex_unlock(&api->lock);
+
+        ws_obs_api_output_t output;
+        output.intent = 0;
+        output.msg.msg_class = WS_MESSAGE_RESPONSE;
+        bool answered = ws_obs_api_execute(api, request.data(), request.size(), output.msg.data);
+
+        pthread_mutex_lock(&api->lock);
+        api->request_bytes -= request.size();
+        if (answered && !api->detached) {
+            ws_obs_api_push(api, output);
+        }
+        pthread_mutex_unlock(&api->lock);
+    }
+
+    ws_obs_api_release(api);
+    return NULL;
+}
+
+// Called by obs-websocket on the thread that raised the event, for every event
+static void ws_obs_api_event(uint64_t intent, const char *event_type, const char *event_data, void *priv) {
+    ws_obs_api_t *api = (ws_obs_api_t *) priv;
+    if (!event_type) return;
+
+    ws_obs_api_output_t output;
+    output.intent = intent;
+    output.msg.msg_class = ws_event_is_high_volume(event_type, strlen(event_type)) ? WS_MESSAGE_EVENT_HIGH_VOLUME
+                                                                                   : WS_MESSAGE_EVENT;
+
+    std::vector<char> &out = output.msg.data;
+    out.resize(WS_MSG_PRE);
+    ws_append(out, "{\"op\":5,\"d\":{\"eventType\":");
+    ws_append_quoted(out, event_type);
+    char intent_json[48];
+    snprintf(intent_json, sizeof(intent_json), ",\"eventIntent\":%" PRIu64, intent);
+    ws_append(out, intent_json);
+    if (event_data && *event_data && strcmp(event_data, "null") != 0) {
+        ws_append(out, ",\"eventData\":");
+        ws_append(out, event_data);
+    }
+    ws_append(out, "}}");
+
+    pthread_mutex_lock(&api->lock);
+    if (!api->detached) {
+        ws_obs_api_push(api, output);
+    }
+    pthread_mutex_unlock(&api->lock);
+}
+
+// Have the worker drop its reference once it is done with what it is executing
+static void ws_obs_api_stop_worker(ws_obs_api_t *api) {
+    pthread_mutex_lock(&api->lock);
+    api->detached = true;
+    api->context = NULL;
+    api->output.clear();
+    pthread_mutex_unlock(&api->lock);
+    os_sem_post(api->sem);
+    ws_obs_api_release(api);
+}
+
+// Start connecting to obs-websocket's plugin API: the worker probes the version, which may wait
+// for the UI thread, and ws_obs_api_finish_attach takes the session from there. Called on the
+// service thread without the mutex
+static void ws_obs_api_attach(ws_relay_t *relay, bool first_attempt) {
+    int level = first_attempt ? LOG_WARNING : LOG_DEBUG;
+
+    proc_handler_t *ph = ws_obs_api_get_ph();
+    if (!ph) {
+        obs_log(level, "obs-websocket plugin API not available, reaching OBS over its WebSocket");
+        return;
+    }
+
+    ws_obs_api_t *api = new ws_obs_api_t();
+    api->ph = ph;
+    api->log_level = level;
+    api->probe = WS_OBS_API_PROBING;
+    api->context = relay->context;
+    api->refs = 2;
+    pthread_mutex_init(&api->lock, NULL);
+    os_sem_init(&api->sem, 0);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, ws_obs_api_thread, api) != 0) {
+        obs_log(LOG_ERROR, "Failed to create obs-websocket request thread");
+        os_sem_destroy(api->sem);
+        pthread_mutex_destroy(&api->lock);
+        delete api;
+        return;
+    }
+    // Nothing joins the worker: a request waiting for the UI thread must not block a relay
+    // stopped from the UI thread. It drops its reference once it has seen the detach
+    pthread_detach(thread);
+
+    relay->obs_api_attaching = api;
+}
+
+// Take the session once the version probe has answered; until then the relay keeps using the
+// WebSocket. Called on the service thread without the mutex
+static void ws_obs_api_finish_attach(ws_relay_t *relay) {
+    ws_obs_api_t *api = relay->obs_api_attaching;
+
+    pthread_mutex_lock(&api->lock);
+    ws_obs_api_probe_t probe = api->probe;
+    if (probe != WS_OBS_API_PROBING) {
+        os_atomic_store_bool(&api->wake_pending, false);
+    }
+    pthread_mutex_unlock(&api->lock);
+    if (probe == WS_OBS_API_PROBING) return;
+
+    relay->obs_api_attaching = NULL;
+    if (probe == WS_OBS_API_PROBE_FAILED) {
+        obs_log(api->log_level, "obs-websocket does not execute plugin API requests, reaching OBS over its WebSocket");
+        ws_obs_api_stop_worker(api);
+        return;
+    }
+
+    if (!ws_obs_api_set_event_callback(api->ph, "register_event_callback", ws_obs_api_event, api)) {
+        obs_log(api->log_level, "obs-websocket does not deliver events to plugins, reaching OBS over its WebSocket");
+        ws_obs_api_stop_worker(api);
+        return;
+    }
+
+    pthread_mutex_lock(&relay->mutex);
+    // The socket session is not needed any more; it ends before the in-process one starts, so
+    // its disconnect does not touch the new session's handshake state
+    ws_connection_close(&relay->obs_conn);
+    relay->obs_api = api;
+    obs_log(LOG_INFO, "Executing remote requests in-process through obs-websocket %s", api->version);
+    ws_auth_on_obs_api_ready(relay, api->version);
+    ws_relay_notify(relay);
+    pthread_mutex_unlock(&relay->mutex);
+}
+
+// Start or end the in-process session to match the settings, retrying an unavailable API every
+// reconnect interval, e.g. while obs-websocket is still loading. Called on the service thread
+// without the mutex
+void ws_obs_api_sync(ws_relay_t *relay) {
+    pthread_mutex_lock(&relay->mutex);
+    bool wanted = os_atomic_load_bool(&relay->running) && relay->config.auth_offload && relay->config.obs_in_process;
+    bool attached = relay->obs_api != NULL;
+    int interval = relay->config.reconnect_interval;
+    pthread_mutex_unlock(&relay->mutex);
+
+    if (!wanted) {
+        relay->obs_api_last_attempt = 0;
+        ws_obs_api_detach(relay);
+        return;
+    }
+    if (attached) return;
+    if (relay->obs_api_attaching) {
+        ws_obs_api_finish_attach(relay);
+        return;
+    }
+
+    time_t now = time(NULL);
+    bool first_attempt = relay->obs_api_last_attempt == 0;
+    if (!first_attempt && now - relay->obs_api_last_attempt < interval) return;
+
+    relay->obs_api_last_attempt = now;
+    ws_obs_api_attach(relay, first_attempt);
+}
+
+// End the in-process session, or abandon one still probing; OBS is reached over its WebSocket
+// again. Called without the mutex, as obs-websocket holds its callback lock while it calls
+// ws_obs_api_event
+void ws_obs_api_detach(ws_relay_t *relay) {
+    if (relay->obs_api_attaching) {
+        ws_obs_api_stop_worker(relay->obs_api_attaching);
+        relay->obs_api_attaching = NULL;
+    }
+
+    pthread_mutex_lock(&relay->mutex);
+    ws_obs_api_t *api = relay->obs_api;
+    relay->obs_api = NULL;
+    if (api) {
+        obs_log(LOG_INFO, "Ending in-process obs-websocket session");
+        ws_auth_on_obs_disconnected(relay);
+        ws_mirror_invalidate(relay);
+
+        // Requests not executed yet get no answer, as if the OBS connection had dropped
+        pthread_mutex_lock(&api->lock);
+        relay->stats.to_obs.dropped_messages += api->requests.size();
+        api->requests.clear();
+        pthread_mutex_unlock(&api->lock);
+        ws_relay_notify(relay);
+    }
+    pthread_mutex_unlock(&relay->mutex);
+    if (!api) return;
+
+    ws_obs_api_set_event_callback(api->ph, "unregister_event_callback", ws_obs_api_event, api);
+    ws_obs_api_stop_worker(api);
+}
+
+bool ws_obs_api_active(ws_relay_t *relay) {
+    return relay->obs_api != NULL;
+}
+
+// Whether responses or events wait for ws_obs_api_flush, or the version probe for
+// ws_obs_api_sync. Service thread only, without the mutex: only that thread attaches and
+// detaches the session while the relay runs
+bool ws_obs_api_output_ready(ws_relay_t *relay) {
+    ws_obs_api_t *api = relay->obs_api ? relay->obs_api : relay->obs_api_attaching;
+    return api && os_atomic_load_bool(&api->wake_pending);
+}
+
+// Have the service loop retry an unavailable plugin API; ws_obs_api_sync keeps to the reconnect
+// interval. Called from housekeeping with the mutex held
+void ws_obs_api_maintain(ws_relay_t *relay) {
+    if (!relay->obs_api && relay->config.auth_offload && relay->config.obs_in_process) {
+        os_atomic_store_bool(&relay->service_pending, true);
+    }
+}
+
+// Execute a request of the relay's own through obs-websocket's plugin API, independent of any
+// session. Returns the response data as JSON ("{}" if there is none), or NULL if obs-websocket is
+// unavailable or the request failed. Blocks like the request itself, so call it off the service
+// thread
+char *ws_obs_api_request(const char *type, const char *data) {
+    proc_handler_t *ph = ws_obs_api_get_ph();
+    if (!ph) return NULL;
+
+    obs_websocket_request_response *response = ws_obs_api_call(ph, type, data);
+    char *json = NULL;
+    if (response && response->status_code == WS_REQUEST_STATUS_SUCCESS) {
+        json = bstrdup(response->response_data ? response->response_data : "{}");
+    }
+    ws_obs_api_response_free(response);
+    return json;
+}
+
+// Take a fragment from the remote for the in-process session; complete messages are queued for
+// the worker. Called on the service thread with the mutex held
+void ws_obs_api_receive(ws_relay_t *relay, bool first, bool final, const void *in, size_t len) {
+    ws_obs_api_t *api = relay->obs_api;
+    if (!api) return;
+
+    if (first) {
+        api->rx.clear();
+        api->rx_discard = false;
+    }
+    if (api->rx_discard) return;
+
+    if (api->rx.size() + len > WS_MAX_MESSAGE_SIZE) {
+        obs_log(LOG_WARNING, "Dropping message to OBS larger than %d bytes", WS_MAX_MESSAGE_SIZE);
+        ws_relay_direction_stats_t *stats = &relay->stats.to_obs;
+        stats->dropped_messages++;
+        stats->dropped_bytes += api->rx.size() + len;
+        stats->oversized_messages++;
+        std::vector<char>().swap(api->rx);
+        api->rx_discard = true;
+        return;
+    }
+
+    api->rx.insert(api->rx.end(), (const char *) in, (const char *) in + len);
+    if (!final) return;
+
+    relay->stats.to_obs.messages++;
+    relay->stats.to_obs.bytes += api->rx.size();
+
+    pthread_mutex_lock(&api->lock);
+    api->request_bytes += api->rx.size();
+    api->requests.push_back(std::move(api->rx));
+    pthread_mutex_unlock(&api->lock);
+    api->rx = std::vector<char>();
+    os_sem_post(api->sem);
+}
+
+// Deliver responses and events handed over since the last call. Called on the service thread
+// with the mutex held
+void ws_obs_api_flush(ws_relay_t *relay) {
+    ws_obs_api_t *api = relay->obs_api;
+    if (!api) return;
+
+    std::deque<ws_obs_api_output_t> output;
+    pthread_mutex_lock(&api->lock);
+    output.swap(api->output);
+    os_atomic_store_bool(&api->wake_pending, false);
+    pthread_mutex_unlock(&api->lock);
+
+    for (ws_obs_api_output_t &item: output) {
+        // The mirror follows every event, subscribed or not
+        if (item.intent) {
+            ws_mirror_observe_message(relay, item.msg.data.data() + WS_MSG_PRE, item.msg.data.size() - WS_MSG_PRE);
+        }
+
+        // obs-websocket leaves filtering by subscription to its plugin API clients
+        if (item.intent && !((uint64_t) relay->auth.event_subscriptions & item.intent)) continue;
+
+        ws_relay_deliver_from_obs(relay, item.msg);
+    }
+}
+
+// Bytes from the remote the in-process session has not finished with; called with the mutex held
+size_t ws_obs_api_pending_bytes(ws_relay_t *relay) {
+    ws_obs_api_t *api = relay->obs_api;
+    if (!api) return 0;
+
+    pthread_mutex_lock(&api->lock);
+    size_t pending = api->request_bytes;
+    pthread_mutex_unlock(&api->lock);
+    return pending + api->rx.size();
+}
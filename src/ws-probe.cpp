@@ -0,0 +1,425 @@
+/*
+OBS WebSocket Relay - Endpoint Probing
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "ws-relay-internal.h"
+#include <obs-module.h>
+#include <plugin-support.h>
+#include <util/platform.h>
+#include <libwebsockets.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+// Pause between the pings of a series
+#define WS_PROBE_PING_GAP_US (100 * 1000)
+
+// A probe runs one connection on a context of its own, so it never touches the relay
+typedef struct {
+    ws_probe_result_t *result;
+    int ping_count;
+    lws_usec_t ping_timeout;
+
+    uint64_t connect_start;
+    uint64_t transport_ready; // TCP and TLS are up, the upgrade request goes out
+    uint64_t established;
+#if defined(LWS_WITH_CONMON)
+    // lws's own per-phase timings of the connection, taken once it is established
+    struct lws_conmon conmon;
+    bool conmon_taken;
+#endif
+
+    uint64_t ping_sent_at; // Payload of the ping awaiting its pong, 0 if none
+    bool ping_due;
+    std::vector<uint64_t> rtts;
+
+    bool done;
+} ws_probe_t;
+
+static void ws_probe_fail(ws_probe_result_t *result, const char *format, ...) {
+    if (result->error[0]) return;
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(result->error, sizeof(result->error), format, args);
+    va_end(args);
+}
+
+static int64_t ws_probe_elapsed_us(uint64_t from, uint64_t to) {
+    return from && to >= from ? (int64_t) ((to - from) / 1000) : -1;
+}
+
+// Time a bare TCP connect to addr, so it can be told apart from the TLS handshake.
+// Returns microseconds, or -1 if the connect failed or timed out
+static int64_t ws_probe_tcp_connect(const struct addrinfo *addr, int timeout_ms) {
+#ifdef _WIN32
+    SOCKET fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+    if (fd == INVALID_SOCKET) return -1;
+    u_long nonblocking = 1;
+    ioctlsocket(fd, FIONBIO, &nonblocking);
+#else
+    int fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+    if (fd < 0) return -1;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+#endif
+
+    uint64_t start = os_gettime_ns();
+    bool connected = connect(fd, addr->ai_addr, (int) addr->ai_addrlen) == 0;
+
+    if (!connected) {
+#ifdef _WIN32
+        if (WSAGetLastError() == WSAEWOULDBLOCK) {
+            fd_set writable, failed;
+            FD_ZERO(&writable);
+            FD_ZERO(&failed);
+            FD_SET(fd, &writable);
+            FD_SET(fd, &failed);
+            struct timeval tv = {timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+            connected = select(0, NULL, &writable, &failed, &tv) > 0 && FD_ISSET(fd, &writable);
+        }
+#else
+        if (errno == EINPROGRESS) {
+            struct pollfd pfd = {fd, POLLOUT, 0};
+            int error = 0;
+            socklen_t error_len = sizeof(error);
+            connected = poll(&pfd, 1, timeout_ms) > 0 &&
+                        getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &error_len) == 0 && error == 0;
+        }
+#endif
+    }
+    uint64_t end = os_gettime_ns();
+
+#ifdef _WIN32
+    closesocket(fd);
+#else
+    close(fd);
+#endif
+    return connected ? ws_probe_elapsed_us(start, end) : -1;
+}
+
+static void ws_probe_send_next(ws_probe_t *probe, struct lws *wsi) {
+    probe->ping_due = true;
+    lws_callback_on_writable(wsi);
+}
+
+static int ws_callback_probe(struct lws *wsi, enum lws_callback_reasons reason, void *user, void *in, size_t len) {
+    ws_probe_t *probe = (ws_probe_t *) user;
+    if (!probe) return 0;
+
+    ws_probe_result_t *result = probe->result;
+
+    switch (reason) {
+        case LWS_CALLBACK_CLIENT_APPEND_HANDSHAKE_HEADER:
+            if (!probe->transport_ready) {
+                probe->transport_ready = os_gettime_ns();
+            }
+            break;
+
+        case LWS_CALLBACK_CLIENT_ESTABLISHED:
+            probe->established = os_gettime_ns();
+#if defined(LWS_WITH_CONMON)
+            lws_conmon_wsi_take(wsi, &probe->conmon);
+            probe->conmon_taken = true;
+#endif
+            if (probe->ping_count <= 0) return -1;
+            ws_probe_send_next(probe, wsi);
+            break;
+
+        case LWS_CALLBACK_CLIENT_WRITEABLE: {
+            if (!probe->ping_due) break;
+            probe->ping_due = false;
+
+            unsigned char buf[LWS_PRE + sizeof(uint64_t)];
+            uint64_t sent_at = os_gettime_ns();
+            memcpy(buf + LWS_PRE, &sent_at, sizeof(sent_at));
+            if (lws_write(wsi, buf + LWS_PRE, sizeof(sent_at), LWS_WRITE_PING) < 0) {
+                ws_probe_fail(result, "Failed to send ping");
+                return -1;
+            }
+            probe->ping_sent_at = sent_at;
+            result->pings_sent++;
+            lws_set_timer_usecs(wsi, probe->ping_timeout);
+            break;
+        }
+
+        case LWS_CALLBACK_CLIENT_RECEIVE_PONG: {
+            uint64_t sent_at;
+            if (len != sizeof(sent_at)) break;
+            memcpy(&sent_at, in, sizeof(sent_at));
+
+            // Pongs for pings that already timed out do not count
+            if (!probe->ping_sent_at || sent_at != probe->ping_sent_at) break;
+            probe->rtts.push_back((os_gettime_ns() - sent_at) / 1000);
+            probe->ping_sent_at = 0;
+            result->pongs_received++;
+            lws_set_timer_usecs(wsi, WS_PROBE_PING_GAP_US);
+            break;
+        }
+
+        case LWS_CALLBACK_TIMER:
+            // Either the gap after a pong is over or the pong is lost
+            probe->ping_sent_at = 0;
+            if (result->pings_sent >= probe->ping_count) return -1;
+            ws_probe_send_next(probe, wsi);
+            break;
+
+        case LWS_CALLBACK_CLIENT_CONNECTION_ERROR:
+            ws_probe_fail(result, "%s", in ? (const char *) in : "Connection failed");
+            probe->done = true;
+            break;
+
+        case LWS_CALLBACK_CLIENT_CLOSED:
+            if (!probe->established) {
+                ws_probe_fail(result, "Connection closed during the handshake");
+            }
+            probe->done = true;
+            break;
+
+        default:
+            break;
+    }
+
+    return 0;
+}
+
+static const struct lws_protocols probe_protocols[] = {
+    {
+        "ws-probe",
+        ws_callback_probe,
+        0,
+        4096,
+    },
+    {NULL, NULL, 0, 0} /* terminator */
+};
+
+// Fill in the RTT distribution from the collected samples
+static void ws_probe_summarize(ws_probe_t *probe) {
+    std::vector<uint64_t> &rtts = probe->rtts;
+    if (rtts.empty()) return;
+
+    std::sort(rtts.begin(), rtts.end());
+    uint64_t sum = 0;
+    for (uint64_t rtt: rtts) sum += rtt;
+
+    ws_probe_result_t *result = probe->result;
+    result->rtt_min_us = rtts.front();
+    result->rtt_median_us = rtts[rtts.size() / 2];
+    result->rtt_p90_us = rtts[std::min(rtts.size() - 1, rtts.size() * 9 / 10)];
+    result->rtt_max_us = rtts.back();
+    result->rtt_avg_us = sum / rtts.size();
+}
+
+// Resolve host and time the lookup and a bare TCP connect to the first address, which is
+// copied to resolved so lws connects to the same one
+static bool ws_probe_resolve_and_connect(ws_probe_result_t *result, const char *host, uint16_t port, char *resolved,
+                                         int timeout_ms) {
+    // DNS lookup, which also gives the TCP probe and lws a fixed address
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    char port_str[8];
+    snprintf(port_str, sizeof(port_str), "%u", port);
+
+    struct addrinfo *addrs = NULL;
+    uint64_t dns_start = os_gettime_ns();
+    int rc = getaddrinfo(host, port_str, &hints, &addrs);
+    result->dns_us = ws_probe_elapsed_us(dns_start, os_gettime_ns());
+    if (rc != 0 || !addrs) {
+        ws_probe_fail(result, "Failed to resolve %s", host);
+        return false;
+    }
+
+    const void *addr = NULL;
+    if (addrs->ai_family == AF_INET) {
+        addr = &((struct sockaddr_in *) addrs->ai_addr)->sin_addr;
+    } else if (addrs->ai_family == AF_INET6) {
+        addr = &((struct sockaddr_in6 *) addrs->ai_addr)->sin6_addr;
+    }
+    if (addr) {
+        inet_ntop(addrs->ai_family, addr, resolved, INET6_ADDRSTRLEN);
+    }
+
+    result->tcp_us = ws_probe_tcp_connect(addrs, timeout_ms);
+    freeaddrinfo(addrs);
+    if (result->tcp_us < 0) {
+        ws_probe_fail(result, "TCP connect to %s:%u failed", resolved[0] ? resolved : host, port);
+        return false;
+    }
+
+    return true;
+}
+
+static bool ws_probe_cancelled(os_event_t *cancel, ws_probe_result_t *result) {
+    if (!cancel || os_event_try(cancel) == EAGAIN) return false;
+
+    ws_probe_fail(result, "Probe cancelled");
+    return true;
+}
+
+// Open a throwaway connection to address and time DNS, TCP connect, TLS handshake and the
+// WebSocket upgrade separately, then measure ping_count ping round trips. Blocks for up to
+// about timeout_ms per phase, so call it off the UI thread
+bool ws_probe_endpoint(const char *address, const char *protocol, int ping_count, int timeout_ms,
+                       ws_probe_result_t *result) {
+    return ws_probe_endpoint_cancellable(address, protocol, ping_count, timeout_ms, NULL, result);
+}
+
+// As ws_probe_endpoint, but gives up within about a second of cancel being signalled. Only the
+// DNS lookup and the bare TCP connect run to their end
+bool ws_probe_endpoint_cancellable(const char *address, const char *protocol, int ping_count, int timeout_ms,
+                                   os_event_t *cancel, ws_probe_result_t *result) {
+    if (!address || !result) return false;
+
+    memset(result, 0, sizeof(*result));
+    result->dns_us = result->tcp_us = result->tls_us = result->upgrade_us = -1;
+    if (timeout_ms <= 0) timeout_ms = WS_PROBE_DEFAULT_TIMEOUT_MS;
+
+    char *host = NULL;
+    char *path = NULL;
+    uint16_t port;
+    bool use_ssl;
+    if (!parse_ws_url(address, &host, &port, &path, &use_ssl)) {
+        ws_probe_fail(result, "Invalid WebSocket URL");
+        return false;
+    }
+
+    // Unix domain sockets need neither a lookup nor a separate TCP probe
+    bool unix_socket = ws_host_is_unix(host);
+    char resolved[INET6_ADDRSTRLEN] = "";
+    if ((!unix_socket && !ws_probe_resolve_and_connect(result, host, port, resolved, timeout_ms)) ||
+        ws_probe_cancelled(cancel, result)) {
+        bfree(host);
+        bfree(path);
+        return false;
+    }
+
+    // The relay's context already initialized the TLS library; doing it again from this context
+    // would reset global state under the relay's live connections. The option only goes on the
+    // probe's vhost, where it makes lws set up a client TLS context and nothing global
+    struct lws_context_creation_info info = {0};
+    info.port = CONTEXT_PORT_NO_LISTEN;
+    info.protocols = probe_protocols;
+    info.gid = -1;
+    info.uid = -1;
+    info.options = LWS_SERVER_OPTION_EXPLICIT_VHOSTS;
+    info.timeout_secs = (unsigned int) std::max(1, timeout_ms / 1000);
+
+    struct lws_context *context = lws_create_context(&info);
+    struct lws_vhost *vhost = NULL;
+    if (context) {
+        info.options = LWS_SERVER_OPTION_DO_SSL_GLOBAL_INIT;
+        vhost = lws_create_vhost(context, &info);
+    }
+    if (!vhost) {
+        ws_probe_fail(result, "Failed to create libwebsockets context");
+        if (context) lws_context_destroy(context);
+        bfree(host);
+        bfree(path);
+        return false;
+    }
+
+    ws_probe_t probe = {};
+    probe.result = result;
+    probe.ping_count = ping_count;
+    probe.ping_timeout = (lws_usec_t) timeout_ms * 1000;
+
+    struct lws_client_connect_info connect_info = {0};
+    connect_info.context = context;
+    connect_info.vhost = vhost;
+    connect_info.address = resolved[0] ? resolved : host;
+    connect_info.port = port;
+    connect_info.path = path;
+    connect_info.host = unix_socket ? "localhost" : host;
+    connect_info.origin = connect_info.host;
+    connect_info.protocol = protocol;
+    connect_info.ietf_version_or_minus_one = -1;
+    connect_info.userdata = &probe;
+    if (use_ssl) {
+        connect_info.ssl_connection = LCCSCF_USE_SSL;
+    }
+#if defined(LWS_WITH_CONMON)
+    connect_info.ssl_connection |= LCCSCF_CONMON;
+#endif
+
+    probe.connect_start = os_gettime_ns();
+    if (!lws_client_connect_via_info(&connect_info)) {
+        ws_probe_fail(result, "Failed to create WebSocket connection");
+        probe.done = true;
+    }
+
+    // Connect and handshake timeouts come from the context; the pings time out on their own.
+    // lws checks its timeouts every second, so a service run returns at least that often
+    uint64_t deadline = probe.connect_start +
+                        (uint64_t) timeout_ms * 1000000 * (uint64_t) (std::max(ping_count, 0) + 3);
+    while (!probe.done) {
+        lws_service(context, 0);
+        if (ws_probe_cancelled(cancel, result)) break;
+        if (os_gettime_ns() > deadline) {
+            ws_probe_fail(result, "Probe timed out");
+            break;
+        }
+    }
+    lws_context_destroy(context);
+
+    int64_t transport_us = ws_probe_elapsed_us(probe.connect_start, probe.transport_ready);
+    if (unix_socket) {
+        result->tcp_us = transport_us;
+    }
+    bool measured = false;
+#if defined(LWS_WITH_CONMON)
+    if (probe.conmon_taken) {
+        // lws timed the connect and the handshake on the probe connection itself
+        if (!unix_socket) result->tcp_us = probe.conmon.ciu_sockconn;
+        if (use_ssl) result->tls_us = probe.conmon.ciu_tls;
+        lws_conmon_release(&probe.conmon);
+        measured = true;
+    }
+#endif
+    if (!measured && use_ssl && !unix_socket && transport_us >= 0) {
+        // Without lws connection monitoring, transport setup minus the separate bare connect
+        // above is all there is; it includes a second connect's variance, so mark it
+        result->tls_us = std::max<int64_t>(transport_us - result->tcp_us, 0);
+        result->tls_estimated = true;
+    }
+    result->upgrade_us = ws_probe_elapsed_us(probe.transport_ready, probe.established);
+    ws_probe_summarize(&probe);
+
+    result->success = probe.established != 0;
+    if (result->success && ping_count > 0 && !result->pongs_received) {
+        ws_probe_fail(result, "No pong received");
+        result->success = false;
+    }
+
+    bfree(host);
+    bfree(path);
+    return result->success;
+}
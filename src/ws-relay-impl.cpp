@@ -22,6 +22,8 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 #include <util/platform.h>
 #include <util/threading.h>
 #include <libwebsockets.h>
+#include <stdarg.h>
+#include <stdio.h>
 
 ws_relay_t *ws_relay_create(const ws_relay_config_t *config) {
     if (!config) {
@@ -37,21 +39,15 @@ ws_relay_t *ws_relay_create(const ws_relay_config_t *config) {
 
     // Copy configuration
     ws_relay_config_init(&relay->config);
-    if (config->local_obs_address && strlen(config->local_obs_address) > 0) {
-        bfree(relay->config.local_obs_address);
-        relay->config.local_obs_address = bstrdup(config->local_obs_address);
-    }
-    if (config->remote_ws_address && strlen(config->remote_ws_address) > 0) {
-        bfree(relay->config.remote_ws_address);
-        relay->config.remote_ws_address = bstrdup(config->remote_ws_address);
-    }
-    relay->config.reconnect_interval = config->reconnect_interval;
-    relay->config.enable_logging = config->enable_logging;
+    ws_relay_config_copy(&relay->config, config);
+    ws_relay_config_init(&relay->pending_config);
+    ws_relay_update_retry_policy(relay);
 
     // Initialize mutex
     if (pthread_mutex_init(&relay->mutex, NULL) != 0) {
         obs_log(LOG_ERROR, "Failed to initialize mutex");
         ws_relay_config_free(&relay->config);
+        ws_relay_config_free(&relay->pending_config);
         bfree(relay);
         return NULL;
     }
@@ -59,6 +55,9 @@ ws_relay_t *ws_relay_create(const ws_relay_config_t *config) {
     // Initialize connections
     ws_connection_init(&relay->obs_conn, false, relay);
     ws_connection_init(&relay->remote_conn, true, relay);
+    ws_connection_init(&relay->standby_conn, true, relay);
+    ws_auth_init(&relay->auth);
+    ws_shaper_init(relay);
 
     // Create libwebsockets context
     struct lws_context_creation_info info = {0};
@@ -66,15 +65,27 @@ ws_relay_t *ws_relay_create(const ws_relay_config_t *config) {
     info.protocols = protocols;
     info.gid = -1;
     info.uid = -1;
+    // info.extensions stays NULL: write coalescing frames messages itself, so lws must not
+    // negotiate permessage-deflate underneath it
     info.options = LWS_SERVER_OPTION_DO_SSL_GLOBAL_INIT;
+    // Read the sockets in chunks large enough to fill the bigger receive buffer tiers quickly
+    info.pt_serv_buf_size = WS_SERV_BUF_SIZE;
+#if defined(LWS_WITH_TLS_SESSIONS)
+    // Keep client TLS sessions on the context so reconnects can resume them
+    info.tls_session_timeout = WS_TLS_SESSION_TIMEOUT;
+    info.tls_session_cache_max = WS_TLS_SESSION_CACHE_MAX;
+#endif
 
     relay->context = lws_create_context(&info);
     if (!relay->context) {
         obs_log(LOG_ERROR, "Failed to create libwebsockets context");
         ws_connection_free(&relay->obs_conn);
         ws_connection_free(&relay->remote_conn);
+        ws_connection_free(&relay->standby_conn);
+        ws_auth_free(&relay->auth);
         pthread_mutex_destroy(&relay->mutex);
         ws_relay_config_free(&relay->config);
+        ws_relay_config_free(&relay->pending_config);
         bfree(relay);
         return NULL;
     }
@@ -82,8 +93,18 @@ ws_relay_t *ws_relay_create(const ws_relay_config_t *config) {
     relay->running = false;
     relay->thread_started = false;
     relay->last_reconnect_attempt = 0;
-
-    obs_log(LOG_INFO, "WebSocket relay created successfully");
+    relay->last_standby_attempt = 0;
+    relay->spill_timer.relay = relay;
+    relay->lifecycle_timer.relay = relay;
+    relay->housekeeping_timer.relay = relay;
+    relay->admission = ws_admission_create(relay);
+    relay->endpoint_active = -1;
+    relay->endpoint_standby = -1;
+    ws_endpoints_update(relay);
+    os_event_init(&relay->probe_stop, OS_EVENT_TYPE_MANUAL);
+    ws_relay_open_spill(relay);
+
+    obs_log(LOG_INFO, "WebSocket relay created successfully (message scanner: %s)", ws_json_scan_impl_name());
     return relay;
 }
 
@@ -100,16 +121,24 @@ void ws_relay_destroy(ws_relay_t *relay) {
         lws_context_destroy(relay->context);
         relay->context = NULL;
     }
+    ws_mux_hub_destroy(relay);
 
     // Clean up connections
     ws_connection_free(&relay->obs_conn);
     ws_connection_free(&relay->remote_conn);
+    ws_connection_free(&relay->standby_conn);
+    ws_auth_free(&relay->auth);
+    ws_spill_destroy(relay->spill);
+    ws_admission_destroy(relay->admission);
+    ws_endpoints_free(relay);
+    os_event_destroy(relay->probe_stop);
 
     // Clean up mutex
     pthread_mutex_destroy(&relay->mutex);
 
     // Clean up configuration
     ws_relay_config_free(&relay->config);
+    ws_relay_config_free(&relay->pending_config);
 
     bfree(relay);
     obs_log(LOG_INFO, "WebSocket relay destroyed");
@@ -139,17 +168,31 @@ bool ws_relay_start(ws_relay_t *relay) {
         return false;
     }
 
-    relay->running = true;
+    os_atomic_store_bool(&relay->running, true);
     relay->last_reconnect_attempt = 0;
+    relay->last_standby_attempt = 0;
+    relay->obs_api_last_attempt = 0;
+    for (size_t i = 0; i < relay->endpoint_count; i++) {
+        relay->endpoints[i].failed_at = 0;
+    }
 
     // Start the thread
     if (pthread_create(&relay->thread, NULL, ws_relay_thread, relay) != 0) {
         obs_log(LOG_ERROR, "Failed to create relay thread");
-        relay->running = false;
+        os_atomic_store_bool(&relay->running, false);
         return false;
     }
 
     relay->thread_started = true;
+
+    // Latency probing is optional, the relay runs without it
+    os_event_reset(relay->probe_stop);
+    if (pthread_create(&relay->probe_thread, NULL, ws_endpoint_probe_thread, relay) == 0) {
+        relay->probe_thread_started = true;
+    } else {
+        obs_log(LOG_WARNING, "Failed to create endpoint probe thread");
+    }
+
     obs_log(LOG_INFO, "WebSocket relay started successfully");
     return true;
 }
@@ -164,65 +207,306 @@ void ws_relay_stop(ws_relay_t *relay) {
 
     obs_log(LOG_INFO, "Stopping WebSocket relay");
 
-    relay->running = false;
+    os_atomic_store_bool(&relay->running, false);
 
     if (relay->context) {
 	    lws_cancel_service(relay->context);
     }
 
-    // Close connections
-    pthread_mutex_lock(&relay->mutex);
-
-    if (relay->obs_conn.wsi && relay->obs_conn.state == WS_STATE_CONNECTED) {
-        lws_close_reason(relay->obs_conn.wsi, LWS_CLOSE_STATUS_NORMAL, NULL, 0);
-        relay->obs_conn.wsi = NULL;
-    }
-    relay->obs_conn.state = WS_STATE_DISCONNECTED;
-
-    if (relay->remote_conn.wsi && relay->remote_conn.state == WS_STATE_CONNECTED) {
-        lws_close_reason(relay->remote_conn.wsi, LWS_CLOSE_STATUS_NORMAL, NULL, 0);
-        relay->remote_conn.wsi = NULL;
-    }
-    relay->remote_conn.state = WS_STATE_DISCONNECTED;
-
-    pthread_mutex_unlock(&relay->mutex);
-
     // Wait for thread to finish
     if (relay->thread_started) {
         pthread_join(relay->thread, NULL);
         relay->thread_started = false;
     }
 
+    ws_obs_api_detach(relay);
+
+    // A probe in flight notices the stop event within about a second
+    if (relay->probe_thread_started) {
+        os_event_signal(relay->probe_stop);
+        pthread_join(relay->probe_thread, NULL);
+        relay->probe_thread_started = false;
+    }
+
+    // Close connections; lws finishes closing them on the next service run or on destroy
+    pthread_mutex_lock(&relay->mutex);
+    ws_connection_close(&relay->obs_conn);
+    ws_connection_close(&relay->remote_conn);
+    ws_connection_close(&relay->standby_conn);
+    ws_mux_hub_release(relay);
+    relay->remote_switch_pending = false;
+    ws_auth_on_obs_disconnected(relay);
+    ws_auth_on_remote_disconnected(relay);
+    ws_mirror_detach(relay);
+    ws_resolver_detach(relay);
+    lws_sul_cancel(&relay->spill_timer.sul);
+    lws_sul_cancel(&relay->shaper.timer.sul);
+    lws_sul_cancel(&relay->lifecycle_timer.sul);
+    lws_sul_cancel(&relay->housekeeping_timer.sul);
+    ws_spill_maintain(relay->spill, relay->config.spill_ttl, true);
+    ws_relay_publish_status(relay);
+    pthread_mutex_unlock(&relay->mutex);
+
     obs_log(LOG_INFO, "WebSocket relay stopped");
 }
 
-bool ws_relay_is_connected(ws_relay_t *relay) {
+bool ws_relay_is_running(ws_relay_t *relay) {
     if (!relay) return false;
 
+    return os_atomic_load_bool(&relay->running);
+}
+
+bool ws_relay_apply_config(ws_relay_t *relay, const ws_relay_config_t *config) {
+    if (!relay || !config) return false;
+
     pthread_mutex_lock(&relay->mutex);
-    bool connected = (relay->obs_conn.state == WS_STATE_CONNECTED &&
-                      relay->remote_conn.state == WS_STATE_CONNECTED);
+    ws_relay_config_copy(&relay->pending_config, config);
+    relay->config_pending = true;
+
+    // Without a service thread nobody reads the config, so commit right away
+    if (!relay->running) {
+        ws_relay_commit_config(relay);
+    }
     pthread_mutex_unlock(&relay->mutex);
 
-    return connected;
+    if (relay->running && relay->context) {
+        os_atomic_store_bool(&relay->service_pending, true);
+        lws_cancel_service(relay->context);
+    }
+
+    return true;
 }
 
-ws_connection_state_t ws_relay_get_obs_state(ws_relay_t *relay) {
-    if (!relay) return WS_STATE_DISCONNECTED;
+// Swap in the pending configuration; called with the mutex held, between service runs
+void ws_relay_commit_config(ws_relay_t *relay) {
+    if (!relay->config_pending) return;
+
+    bool local_changed = strcmp(relay->config.local_obs_address, relay->pending_config.local_obs_address) != 0;
+    bool remote_changed = strcmp(relay->config.remote_ws_address, relay->pending_config.remote_ws_address) != 0;
+    bool standby_disabled = relay->config.enable_standby && !relay->pending_config.enable_standby;
+    bool auth_changed = relay->config.auth_offload != relay->pending_config.auth_offload ||
+                        strcmp(relay->config.obs_password, relay->pending_config.obs_password) != 0 ||
+                        strcmp(relay->config.relay_token, relay->pending_config.relay_token) != 0;
+    bool mux_changed = relay->config.mux_channel != relay->pending_config.mux_channel ||
+                       relay->config.mux_window_kb != relay->pending_config.mux_window_kb ||
+                       relay->config.mux_share != relay->pending_config.mux_share;
+
+    ws_relay_config_copy(&relay->config, &relay->pending_config);
+    relay->config_pending = false;
+    ws_relay_update_retry_policy(relay);
+    ws_relay_open_spill(relay);
+
+    if (remote_changed) {
+        ws_endpoints_update(relay);
+    }
+
+    if (remote_changed && relay->endpoint_active >= 0) {
+        // The active endpoint is still listed, so only a standby to a dropped one has to go
+        obs_log(LOG_INFO, "Remote endpoint list changed, staying on %s",
+                relay->endpoints[relay->endpoint_active].address);
+        if (relay->endpoint_standby < 0) {
+            ws_connection_close(&relay->standby_conn);
+        }
+        relay->remote_switch_pending = false;
+    } else if (remote_changed) {
+        // Whatever the standby connection points at is now the wrong endpoint
+        ws_connection_close(&relay->standby_conn);
+        relay->endpoint_standby = -1;
+
+        if (relay->remote_conn.state == WS_STATE_CONNECTED) {
+            // Make before break: switch over once the new remote is connected
+            obs_log(LOG_INFO, "Remote address changed, connecting to %s before switching",
+                    relay->config.remote_ws_address);
+            relay->remote_switch_pending = true;
+            relay->last_standby_attempt = 0;
+        } else {
+            ws_connection_close(&relay->remote_conn);
+            relay->remote_switch_pending = false;
+            relay->last_reconnect_attempt = 0;
+        }
+    } else if (standby_disabled && !relay->remote_switch_pending) {
+        ws_connection_close(&relay->standby_conn);
+    }
+
+    if (auth_changed && os_atomic_load_bool(&relay->running)) {
+        // Both sessions were set up under the old handshake rules
+        obs_log(LOG_INFO, "Authentication settings changed, restarting sessions");
+        ws_connection_close(&relay->obs_conn);
+        ws_connection_close(&relay->remote_conn);
+        relay->remote_switch_pending = false;
+        relay->last_reconnect_attempt = 0;
+    } else if (local_changed) {
+        obs_log(LOG_INFO, "Local OBS address changed, reconnecting to %s", relay->config.local_obs_address);
+        ws_connection_close(&relay->obs_conn);
+    }
+
+    if (mux_changed && os_atomic_load_bool(&relay->running)) {
+        // Framing applies to the whole connection, so the remote has to start over
+        obs_log(LOG_INFO, "Multiplexing settings changed, reconnecting to remote");
+        ws_connection_close(&relay->standby_conn);
+        ws_connection_close(&relay->remote_conn);
+        relay->remote_switch_pending = false;
+        relay->last_reconnect_attempt = 0;
+    }
+
+    if ((remote_changed || mux_changed) && ws_mux_hub_role(relay) != WS_HUB_NONE) {
+        // A shared connection is keyed to the remote addresses, so it starts over as well
+        ws_mux_hub_release(relay);
+        if (os_atomic_load_bool(&relay->running)) {
+            ws_connection_close(&relay->standby_conn);
+            ws_connection_close(&relay->remote_conn);
+            relay->remote_switch_pending = false;
+            relay->last_reconnect_attempt = 0;
+        }
+    }
+
+    obs_log(LOG_INFO, "Configuration applied to relay");
+}
+
+// Open the spill log the first time it is enabled. It stays open after being disabled, so
+// events already on disk are still replayed
+void ws_relay_open_spill(ws_relay_t *relay) {
+    if (relay->spill || !relay->config.spill_enabled) return;
+
+    char *dir = obs_module_config_path("spill");
+    relay->spill = ws_spill_create(dir);
+    bfree(dir);
+}
+
+// Derive the lws idle policy from the ping settings; it applies to connections made afterwards
+void ws_relay_update_retry_policy(ws_relay_t *relay) {
+    memset(&relay->retry_policy, 0, sizeof(relay->retry_policy));
+    if (relay->config.ping_interval <= 0) return;
+
+    // Our own pings measure RTT and normally keep the connection valid; lws only steps in
+    // as a backstop if the connection goes quiet for longer than the missed pong limit
+    int interval = relay->config.ping_interval < UINT16_MAX ? relay->config.ping_interval : UINT16_MAX;
+    int hangup = interval * (relay->config.ping_max_missed + 1);
+    relay->retry_policy.secs_since_valid_ping = (uint16_t) interval;
+    relay->retry_policy.secs_since_valid_hangup = (uint16_t) (hangup < UINT16_MAX ? hangup : UINT16_MAX);
+}
+
+// Record why a connection failed for the status; called with the mutex held
+void ws_relay_set_error(ws_relay_t *relay, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    vsnprintf(relay->status.last_error, sizeof(relay->status.last_error), format, args);
+    va_end(args);
+}
+
+// Publish the current status for ws_relay_get_status and the status callback, along with the
+// statistics for ws_relay_read_stats. Called with the mutex held, which also keeps writers of
+// the seqlocks apart
+void ws_relay_publish_status(ws_relay_t *relay) {
+    ws_relay_status_t *status = &relay->status;
+    int64_t now = (int64_t) time(NULL);
+
+    ws_connection_state_t obs_state = ws_obs_api_active(relay) ? WS_STATE_CONNECTED : relay->obs_conn.state;
+    if (status->obs_state != obs_state) {
+        status->obs_state = obs_state;
+        status->obs_since = now;
+    }
+    if (status->remote_state != relay->remote_conn.state) {
+        status->remote_state = relay->remote_conn.state;
+        status->remote_since = now;
+    }
+    status->messages_to_remote = relay->stats.to_remote.messages;
+    status->messages_to_obs = relay->stats.to_obs.messages;
+    status->bytes_to_remote = relay->stats.to_remote.bytes;
+    status->bytes_to_obs = relay->stats.to_obs.bytes;
+    status->dropped_messages = relay->stats.to_remote.dropped_messages + relay->stats.to_obs.dropped_messages;
+
+    bool remote_up = relay->remote_conn.state == WS_STATE_CONNECTED || relay->remote_conn.state == WS_STATE_CONNECTING;
+    const char *remote_address = "";
+    if (remote_up && ws_mux_hub_address(relay)) {
+        remote_address = ws_mux_hub_address(relay);
+    } else if (remote_up && relay->endpoint_active >= 0) {
+        remote_address = relay->endpoints[relay->endpoint_active].address;
+    }
+    snprintf(status->remote_address, sizeof(status->remote_address), "%s", remote_address);
+
+    relay->status_lock.write(*status);
+
+    ws_stats_snapshot_t snapshot;
+    ws_relay_collect_stats(relay, &snapshot.stats);
+    snapshot.published_ns = os_gettime_ns();
+    relay->stats_lock.write(snapshot);
+
+    if (relay->status_callback) {
+        relay->status_callback(status, relay->status_data);
+    }
+}
+
+// Copy the last published status; never blocks on the relay
+bool ws_relay_get_status(ws_relay_t *relay, ws_relay_status_t *status) {
+    if (!relay || !status) return false;
+
+    relay->status_lock.read(status);
+    return true;
+}
+
+void ws_relay_set_status_callback(ws_relay_t *relay, ws_status_callback_t callback, void *user_data) {
+    if (!relay) return;
 
     pthread_mutex_lock(&relay->mutex);
-    ws_connection_state_t state = relay->obs_conn.state;
+    relay->status_callback = callback;
+    relay->status_data = user_data;
     pthread_mutex_unlock(&relay->mutex);
+}
+
+bool ws_relay_is_connected(ws_relay_t *relay) {
+    ws_relay_status_t status;
+    if (!ws_relay_get_status(relay, &status)) return false;
 
-    return state;
+    return status.obs_state == WS_STATE_CONNECTED && status.remote_state == WS_STATE_CONNECTED;
+}
+
+ws_connection_state_t ws_relay_get_obs_state(ws_relay_t *relay) {
+    ws_relay_status_t status;
+    if (!ws_relay_get_status(relay, &status)) return WS_STATE_DISCONNECTED;
+
+    return status.obs_state;
 }
 
 ws_connection_state_t ws_relay_get_remote_state(ws_relay_t *relay) {
-    if (!relay) return WS_STATE_DISCONNECTED;
+    ws_relay_status_t status;
+    if (!ws_relay_get_status(relay, &status)) return WS_STATE_DISCONNECTED;
 
-    pthread_mutex_lock(&relay->mutex);
-    ws_connection_state_t state = relay->remote_conn.state;
-    pthread_mutex_unlock(&relay->mutex);
+    return status.remote_state;
+}
+
+// Gather the counters along with the current queue depths; called with the mutex held
+void ws_relay_collect_stats(ws_relay_t *relay, ws_relay_stats_t *stats) {
+    *stats = relay->stats;
+    stats->to_remote.queued_messages = relay->remote_conn.buffers.size();
+    stats->to_remote.queued_bytes = relay->remote_conn.queued_bytes;
+    stats->to_obs.queued_messages = relay->obs_conn.buffers.size();
+    stats->to_obs.queued_bytes = relay->obs_conn.queued_bytes;
+    stats->to_remote.rx_buffer_size = relay->obs_conn.wsi ? relay->obs_conn.rx_buffer_size : 0;
+    stats->to_obs.rx_buffer_size = relay->remote_conn.wsi ? relay->remote_conn.rx_buffer_size : 0;
+    ws_spill_get_stats(relay->spill, &stats->to_remote);
+    ws_admission_get_stats(relay, &stats->to_obs);
+    ws_mirror_get_stats(relay, &stats->to_remote);
+    ws_mux_hub_get_stats(relay, &stats->to_remote);
+}
+
+// Copy the statistics last published with the status; never blocks on the relay. Fails if none
+// were published yet
+bool ws_relay_get_stats(ws_relay_t *relay, ws_relay_stats_t *stats) {
+    if (!relay || !stats) return false;
+
+    ws_stats_snapshot_t snapshot;
+    if (!ws_relay_read_stats(relay, &snapshot)) return false;
+
+    *stats = snapshot.stats;
+    return true;
+}
+
+// Copy the statistics last published with the status, at least once a second while running;
+// never blocks on the relay. Fails if none were published yet
+bool ws_relay_read_stats(ws_relay_t *relay, ws_stats_snapshot_t *snapshot) {
+    if (!relay || !snapshot) return false;
 
-    return state;
+    relay->stats_lock.read(snapshot);
+    return snapshot->published_ns != 0;
 }
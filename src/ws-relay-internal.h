@@ -20,57 +20,612 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 
 #include "ws-relay.h"
 #include <libwebsockets.h>
+#include <callback/proc.h>
 #include <util/dstr.h>
+#include <util/platform.h>
 #include <util/threading.h>
+#include <string.h>
 #include <time.h>
+#include <atomic>
+#include <deque>
+#include <string>
 #include <vector>
 
+// TLS session cache limits for client connections
+#define WS_TLS_SESSION_TIMEOUT 3600
+#define WS_TLS_SESSION_CACHE_MAX 4
+
+// Channel multiplexing on the remote connection: every frame starts with an 8 byte header of
+// version, frame type, channel (u16) and a type specific value (u32), all big-endian
+#define WS_MUX_VERSION 1
+#define WS_MUX_HEADER_SIZE 8
+
+// Latency stamping on the multiplexed connection: data frames carry the sender's monotonic clock
+// in microseconds, truncated to 32 bits, in the header value; 0 means unstamped
+#define WS_MUX_CLOCK_INTERVAL_NS (5 * 1000000000ULL) // Between clock exchanges with the remote
+#define WS_MUX_CLOCK_SAMPLES 8 // Exchanges the clock offset is picked from, by lowest round trip
+
+// Remote connection sharing: the relays of one host with the same remote addresses send their
+// channels over one remote connection. The first of them to lock the addresses' key owns the
+// connection and accepts the others on a Unix socket next to the lock, in a directory private
+// to the user; they connect to it instead of the remote, and it routes frames by channel
+#define WS_HUB_DIR_PREFIX "obs-ws-relay-" // Directory in the temporary directory, followed by the uid
+#define WS_HUB_PEER_QUEUE_MAX (2 * WS_MAX_MESSAGE_SIZE) // Routed bytes backed up for or from an attached relay before it is dropped
+
+// Largest message the relay reassembles; obs-websocket screenshots can run to tens of MB
+#define WS_MAX_MESSAGE_SIZE (64 * 1024 * 1024)
+
+// Receive buffer sizing. lws hands a message to the receive callback in pieces of at most the
+// protocol's rx_buffer_size, so each connection is bound to the smallest buffer tier that holds
+// its recent messages whole, up to the configured cap. The peak size decays by 1/WS_RX_PEAK_DECAY
+// per message, so a single large response does not keep a connection on a large buffer for good
+#define WS_RX_BUFFER_MIN 4096
+#define WS_RX_PEAK_DECAY 256
+#define WS_SERV_BUF_SIZE (64 * 1024) // Socket reads of the service thread
+
+// Write coalescing: small queued messages are framed by the relay and sent as one raw write. That
+// is only sound while lws transforms nothing on the way out, so the context registers no
+// extensions; messages are never fragmented, so lws is always between messages when a batch goes
+// out. A client frame header is at most 2 bytes, an 8 byte length and a 4 byte mask
+#define WS_FRAME_HEADER_MAX 14
+#define WS_MASK_POOL_SIZE 256 // Random bytes fetched at once for frame masks
+
+// Request admission control
+#define WS_ADMISSION_QUEUE_MAX 256 // Requests waiting for admission before more are rejected outright
+#define WS_ADMISSION_STALE_NS (60 * 1000000000ULL) // Unanswered requests stop counting as in flight
+
+// OBS state mirror
+#define WS_MIRROR_EVENT_MAX (1024 * 1024) // Largest event from the OBS connection the mirror reassembles
+#define WS_MIRROR_REPLAY_MAX 4096 // Events kept for replay over a fetch before the mirror is seeded again
+#define WS_MIRROR_SNAPSHOT_WAIT_NS (5 * 1000000000ULL) // Longest a snapshot waits for pending fetches
+
+// Span tracing, compiled in with ENABLE_RELAY_TRACE
+#define WS_TRACE_RING_SIZE 8192 // Spans kept per thread
+#define WS_TRACE_MAX_THREADS 64
+#define WS_TRACE_MIN_WAIT_NS 1000 // Shorter mutex waits are not recorded
+
+// Headroom in front of queued payloads: lws framing plus room for a multiplexing header
+#define WS_MSG_PRE (LWS_PRE + WS_MUX_HEADER_SIZE)
+
+// Spill log limits
+#define WS_SPILL_SEGMENT_SIZE (4 * 1024 * 1024)
+#define WS_SPILL_SYNC_INTERVAL_NS 1000000000ULL
+#define WS_SPILL_DRAIN_QUEUE (256 * 1024) // Replay pauses while this much is queued to the remote
+#define WS_SPILL_DRAIN_RETRY_US (50 * 1000)
+
+// Remote uplink shaping
+#define WS_SHAPER_SAMPLE_INTERVAL_NS 1000000000ULL
+#define WS_SHAPER_CONGESTION_THRESHOLD 0.1f // Stream output congestion treated as struggling
+#define WS_SHAPER_MIN_FACTOR 0.1 // Lowest share of the configured rate the uplink backs off to
+#define WS_SHAPER_RECOVERY_STEP 0.1 // Share of the configured rate regained per healthy sample
+
+// Remote endpoint selection
+#define WS_ENDPOINT_PROBE_PINGS 3
+#define WS_ENDPOINT_PROBE_TIMEOUT_MS 2000
+#define WS_ENDPOINT_PROBE_IDLE_MS 5000 // Settings check interval while probing is off
+#define WS_ENDPOINT_SWITCH_HOLDDOWN 60 // Seconds before the RTT may trigger another switch
+
 // Forward declarations
 typedef struct ws_connection ws_connection_t;
 typedef struct ws_relay ws_relay_t;
+typedef struct ws_spill ws_spill_t;
+typedef struct ws_obs_api ws_obs_api_t;
+typedef struct ws_admission ws_admission_t;
+typedef struct ws_mirror ws_mirror_t;
+typedef struct ws_resolver ws_resolver_t;
+typedef struct ws_mux_hub ws_mux_hub_t;
+
+// obs-websocket message classes, used to decide what may be dropped
+typedef enum {
+    WS_MESSAGE_UNCLASSIFIED,
+    WS_MESSAGE_SESSION, // Hello, Identify, Identified, Reidentify or unrecognized
+    WS_MESSAGE_EVENT,
+    WS_MESSAGE_EVENT_HIGH_VOLUME, // Events such as InputVolumeMeters
+    WS_MESSAGE_REQUEST,
+    WS_MESSAGE_RESPONSE
+} ws_message_class_t;
+
+// Multiplexing frame types
+typedef enum {
+    WS_MUX_DATA = 0, // One obs-websocket message
+    WS_MUX_OPEN = 1, // Start of a channel session, value is the sender's initial receive window
+    WS_MUX_WINDOW = 2, // Value is additional receive window granted to the other side
+    WS_MUX_CLOSE = 3, // End of a channel session
+    WS_MUX_CLOCK = 4 // Clock exchange, value is a ws_mux_clock_type_t
+} ws_mux_frame_type_t;
+
+// Clock exchange messages; the payload is big-endian 64 bit microseconds
+typedef enum {
+    WS_MUX_CLOCK_REQUEST = 0, // Relay to remote: t1, the relay's send time
+    WS_MUX_CLOCK_RESPONSE = 1, // Remote to relay: t1, t2 the remote's receive time, t3 its send time
+    WS_MUX_CLOCK_OFFSET = 2 // Relay to remote: the estimated offset (remote minus relay clock) and its round trip
+} ws_mux_clock_type_t;
+
+// Queued outbound message
+typedef struct ws_message {
+    std::vector<char> data; // WS_MSG_PRE bytes of headroom followed by the payload
+    ws_message_class_t msg_class = WS_MESSAGE_UNCLASSIFIED; // Classified lazily
+    ws_mux_frame_type_t mux_type = WS_MUX_DATA; // Frame type when multiplexing
+    uint32_t mux_value = 0;
+    bool mux_routed = false; // A frame of another relay's channel, header included, sent as it is
+} ws_message_t;
+
+// Fields located in an obs-websocket JSON message; strings point into the scanned buffer
+typedef struct {
+    int op; // Top-level "op", -1 if missing
+    const char *event_type; // "d.eventType"
+    size_t event_type_len;
+    const char *request_id; // "d.requestId"
+    size_t request_id_len;
+    const char *request_type; // "d.requestType"
+    size_t request_type_len;
+    const char *request_data; // "d.requestData", the whole object including its braces
+    size_t request_data_len;
+} ws_json_fields_t;
+
+// Authentication offload state
+#define WS_AUTH_NONCE_SIZE 64
+#define WS_MAX_HANDSHAKE_SIZE (64 * 1024)
+
+typedef struct {
+    char *obs_hello; // Last Hello received from OBS, template for the relay's Hello
+    bool obs_identified;
+    bool obs_reidentify_pending;
+    bool remote_identified;
+    bool remote_hello_sent;
+    char remote_salt[WS_AUTH_NONCE_SIZE];
+    char remote_challenge[WS_AUTH_NONCE_SIZE];
+    int64_t event_subscriptions; // Subscriptions of the relay's OBS session
+} ws_auth_state_t;
+
+typedef enum {
+    WS_AUTH_FORWARD, // Not a handshake message, forward it
+    WS_AUTH_CONSUMED, // Handled by the relay
+    WS_AUTH_REJECT_AUTHENTICATION, // Close the remote: authentication failed
+    WS_AUTH_REJECT_RPC_VERSION // Close the remote: unsupported RPC version
+} ws_auth_result_t;
+
+// Multiplexing state of the relay's channel on the active remote connection
+typedef struct {
+    int64_t send_credit; // Payload bytes the remote still accepts, may go negative by one message
+    size_t recv_pending; // Payload bytes received from the remote and not yet granted back
+    bool rx_skip; // Remaining fragments of the current message are not ours to forward
+    bool rx_route; // Remaining fragments of the current message go to an attached relay
+
+    // Clock exchange for latency stamping
+    uint64_t clock_request_us; // t1 of the outstanding request, 0 if there is none
+    uint64_t clock_request_ns; // When the last request was sent
+    int64_t clock_offsets[WS_MUX_CLOCK_SAMPLES]; // Recent offsets in microseconds, remote minus relay clock
+    uint64_t clock_delays[WS_MUX_CLOCK_SAMPLES]; // Their round trips
+    size_t clock_samples; // Exchanges completed on this connection
+    bool clock_valid; // clock_offset is known
+    int64_t clock_offset_us;
+} ws_mux_state_t;
+
+// lws scheduled callback that knows its relay
+typedef struct {
+    lws_sorted_usec_list_t sul; // Must stay first
+    ws_relay_t *relay;
+} ws_relay_timer_t;
+
+// Token bucket for the remote uplink
+typedef struct {
+    double tokens; // Bytes that may be sent right now, negative after an oversized message
+    uint64_t last_refill;
+    double factor; // Share of the configured rate in use, lowered while the stream is congested
+    uint64_t last_sample;
+    int frames_dropped; // Stream output frames dropped at the last sample
+    ws_relay_timer_t timer;
+} ws_shaper_state_t;
+
+// Seqlock holding a published copy of T. The service thread writes it with the mutex held;
+// readers copy it lock-free and retry if a write overlapped. T must be trivially copyable
+template<typename T>
+struct ws_seqlock {
+    static const size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    std::atomic<uint32_t> seq; // Odd while a write is in progress
+    std::atomic<uint64_t> words[WORDS];
+
+    // Writers must be kept apart by the caller
+    void write(const T &value) {
+        uint64_t copy[WORDS] = {0};
+        memcpy(copy, &value, sizeof(T));
+
+        uint32_t start = seq.load(std::memory_order_relaxed);
+        seq.store(start + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < WORDS; i++) {
+            words[i].store(copy[i], std::memory_order_relaxed);
+        }
+        seq.store(start + 2, std::memory_order_release);
+    }
+
+    void read(T *value) const {
+        uint64_t copy[WORDS];
+        uint32_t before, after;
+        do {
+            before = seq.load(std::memory_order_acquire);
+            for (size_t i = 0; i < WORDS; i++) {
+                copy[i] = words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = seq.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+
+        memcpy(value, copy, sizeof(T));
+    }
+};
+
+// Statistics as last published, for readers that must not wait on the relay
+typedef struct {
+    ws_relay_stats_t stats;
+    uint64_t published_ns; // os_gettime_ns at publication, 0 before the first
+} ws_stats_snapshot_t;
+
+typedef ws_seqlock<ws_relay_status_t> ws_status_seqlock_t;
+typedef ws_seqlock<ws_stats_snapshot_t> ws_stats_seqlock_t;
+
+// One entry of the remote address list
+typedef struct {
+    char *address;
+    int64_t rtt_us; // Median RTT of the last probe, -1 if unknown or unreachable
+    bool unreachable; // The last probe failed
+    time_t failed_at; // Last failed or lost connection, 0 if none since it last connected
+} ws_endpoint_t;
 
 // Connection data structure
 struct ws_connection {
     struct lws *wsi;
     ws_connection_state_t state;
     std::vector<char> payload;
-    std::vector<std::vector<char>> buffers;
+    bool payload_discard; // Rest of the message being reassembled in payload is dropped
+    std::deque<ws_message_t> buffers;
+    size_t queued_bytes;
+    std::vector<char> handshake; // Handshake message received from this connection
+    std::vector<char> spill_payload; // Message received from this connection on its way to the spill log
+    bool spilling; // The message being received goes to the spill log
+    bool spill_discard; // The message being spilled is too large and is dropped
+    bool budget_warned;
     bool is_remote;
+
+    // Write coalescing
+    std::vector<unsigned char> write_batch; // Masked frames waiting for one write, after LWS_PRE bytes
+    uint64_t batch_messages; // Data messages in the write batch, counted as sent once it is written
+    uint64_t batch_bytes;
+    unsigned char mask_pool[WS_MASK_POOL_SIZE];
+    size_t mask_left; // Unused bytes at the end of mask_pool
+
+    // Receive buffer sizing
+    size_t rx_buffer_size; // Receive buffer tier the connection is bound to
+    size_t rx_peak; // Decaying peak of received message sizes
+    size_t rx_bytes; // Size of the message being received so far
+    uint32_t rx_callbacks; // Receive callbacks the message has taken so far
+
     ws_relay_t *relay;
     char *address;
     uint16_t port;
     char *path;
     bool use_ssl;
+    uint64_t connect_started_ns; // When ws_connect started the current attempt, for tracing
+    uint64_t handshake_started_ns; // When the transport was up and the upgrade request went out
+
+    // Health checking
+    int missed_pongs;
+    bool ping_due;
+
+    // Cached DNS resolution of address
+    char *resolved_host;
+    char resolved_addr[64];
+    time_t resolved_at;
+    bool resolving; // Connecting, waiting for the resolver before dialing
 };
 
 // Main relay structure
 struct ws_relay {
+    // Active configuration, only replaced on the service thread
     ws_relay_config_t config;
+
+    // Configuration waiting to be committed by the service thread
+    ws_relay_config_t pending_config;
+    bool config_pending;
+    bool remote_switch_pending;
     
     ws_connection_t obs_conn;
     ws_connection_t remote_conn;
+    ws_connection_t standby_conn;
     
     struct lws_context *context;
     pthread_t thread;
-    bool running;
+    volatile bool running; // Set by start and stop, read by the service thread
     bool thread_started;
     
     pthread_mutex_t mutex;
     
+    // Authentication offload, guarded by mutex
+    ws_auth_state_t auth;
+
+    // Channel multiplexing, guarded by mutex
+    ws_mux_state_t mux;
+
+    // Remote connection sharing, NULL until the first dial with it enabled; guarded by mutex
+    ws_mux_hub_t *hub;
+
+    // Remote uplink shaping, guarded by mutex
+    ws_shaper_state_t shaper;
+
+    // Outage spill log and its replay, guarded by mutex
+    ws_spill_t *spill;
+    double spill_allowance; // Bytes that may be replayed right now
+    uint64_t spill_last_drain;
+    ws_relay_timer_t spill_timer;
+
+    // Connection lifecycle and periodic upkeep, run on the service thread
+    ws_relay_timer_t lifecycle_timer;
+    ws_relay_timer_t housekeeping_timer;
+
+    // Idle policy handed to lws for new connections
+    lws_retry_bo_t retry_policy;
+
+    // Traffic counters, guarded by mutex, and the copy published with the status
+    ws_relay_stats_t stats;
+    ws_stats_seqlock_t stats_lock;
+
+    // Status last published, guarded by mutex, and its lock-free copy
+    ws_relay_status_t status;
+    ws_status_seqlock_t status_lock;
+    ws_status_callback_t status_callback;
+    void *status_data;
+
+    // Remote endpoints from the configured address list, guarded by mutex
+    ws_endpoint_t *endpoints;
+    size_t endpoint_count;
+    int endpoint_active; // Endpoint of remote_conn, -1 if none
+    int endpoint_standby; // Endpoint of standby_conn, -1 if none
+    time_t last_endpoint_switch;
+    bool endpoints_probed; // Fresh probe results for the service thread
+    volatile bool service_pending; // Settings, probe results or a retry wait for the service loop
+
+    // In-process obs-websocket session, NULL while OBS is reached over obs_conn; guarded by mutex
+    ws_obs_api_t *obs_api;
+    ws_obs_api_t *obs_api_attaching; // Session waiting for its version probe, service thread only
+    time_t obs_api_last_attempt; // Service thread only
+
+    // Admission control for requests from the remote, guarded by mutex
+    ws_admission_t *admission;
+
+    // Mirror of the OBS state for the remote, NULL while disabled; guarded by mutex
+    ws_mirror_t *mirror;
+
+    // Host name lookups off the service thread, started with the first one; guarded by mutex
+    ws_resolver_t *resolver;
+
+    // Background latency probing of the endpoints
+    pthread_t probe_thread;
+    bool probe_thread_started;
+    os_event_t *probe_stop;
+
     // Reconnection handling
     time_t last_reconnect_attempt;
+    time_t last_standby_attempt;
 };
 
+// Counters for traffic written to a connection
+static inline ws_relay_direction_stats_t *ws_connection_stats(ws_connection_t *conn) {
+    return conn->is_remote ? &conn->relay->stats.to_remote : &conn->relay->stats.to_obs;
+}
+
+// Counters for traffic received from a connection, which travels the other way
+static inline ws_relay_direction_stats_t *ws_connection_rx_stats(ws_connection_t *conn) {
+    return conn->is_remote ? &conn->relay->stats.to_obs : &conn->relay->stats.to_remote;
+}
+
 // Internal function declarations
 void *ws_relay_thread(void *data);
+void ws_relay_commit_config(ws_relay_t *relay);
+void ws_relay_update(ws_relay_t *relay);
+void ws_relay_notify(ws_relay_t *relay);
+void ws_relay_publish_status(ws_relay_t *relay);
+void ws_relay_collect_stats(ws_relay_t *relay, ws_relay_stats_t *stats);
+bool ws_relay_read_stats(ws_relay_t *relay, ws_stats_snapshot_t *snapshot);
+void ws_relay_set_error(ws_relay_t *relay, const char *format, ...);
+void ws_relay_update_retry_policy(ws_relay_t *relay);
 void ws_connection_init(ws_connection_t *conn, bool is_remote, ws_relay_t *relay);
 void ws_connection_free(ws_connection_t *conn);
+void ws_connection_close(ws_connection_t *conn);
+void ws_connection_discard_queue(ws_connection_t *conn);
+size_t ws_connection_flush_events(ws_connection_t *conn);
+void ws_connection_send(ws_connection_t *conn, const char *data, size_t len);
+void ws_connection_promote(ws_connection_t *active, ws_connection_t *standby);
 bool ws_connect(ws_connection_t *conn, const char *address);
+void ws_connection_resolved(ws_connection_t *conn, const char *address);
 bool parse_ws_url(const char *url, char **host, uint16_t *port, char **path, bool *use_ssl);
+size_t ws_frame_encode(unsigned char *out, bool binary, const unsigned char *mask, const unsigned char *payload,
+                       size_t len);
+
+// Hosts parsed from ws+unix:// URLs are socket paths in the lws form, prefixed with '+'
+static inline bool ws_host_is_unix(const char *host) {
+    return host && host[0] == '+';
+}
+
+// Message inspection
+bool ws_json_scan(const char *data, size_t len, ws_json_fields_t *fields);
+const char *ws_json_scan_impl_name(void);
+// Scanner variants this CPU can run, scalar first, for tests and benchmarks
+size_t ws_json_scan_variant_count(void);
+const char *ws_json_scan_variant_name(size_t variant);
+bool ws_json_scan_variant(size_t variant, const char *data, size_t len, ws_json_fields_t *fields);
+std::string ws_json_unescape(const char *str, size_t len);
+ws_message_class_t ws_message_classify(const char *data, size_t len);
+bool ws_event_is_high_volume(const char *event_type, size_t len);
+ws_message_class_t ws_message_get_class(ws_message_t &msg);
+
+// Authentication offload
+void ws_auth_init(ws_auth_state_t *auth);
+void ws_auth_free(ws_auth_state_t *auth);
+void ws_auth_on_remote_connected(ws_relay_t *relay);
+void ws_auth_on_remote_disconnected(ws_relay_t *relay);
+void ws_auth_on_obs_disconnected(ws_relay_t *relay);
+bool ws_auth_handle_obs_message(ws_relay_t *relay, const char *data, size_t len);
+ws_auth_result_t ws_auth_handle_remote_message(ws_relay_t *relay, const char *data, size_t len);
+int ws_auth_close_code(ws_auth_result_t result);
+void ws_auth_on_obs_api_ready(ws_relay_t *relay, const char *version);
+// base64(sha256(a + b)), and the obs-websocket authentication string built from it
+std::string ws_auth_sha256_base64(const std::string &a, const std::string &b);
+std::string ws_auth_compute(const char *secret, const char *salt, const char *challenge);
+
+// Channel multiplexing
+typedef enum {
+    WS_MUX_RX_FORWARD, // Data for our channel, header stripped
+    WS_MUX_RX_CONSUMED, // Control frame or another channel's data
+    WS_MUX_RX_RESET // The remote closed our channel
+} ws_mux_rx_result_t;
+
+bool ws_mux_enabled(ws_relay_t *relay);
+void ws_mux_open(ws_relay_t *relay);
+bool ws_mux_take_credit(ws_relay_t *relay, size_t size);
+unsigned char *ws_mux_header(ws_relay_t *relay, ws_message_t &msg);
+ws_mux_rx_result_t ws_mux_receive(ws_relay_t *relay, struct lws *wsi, void **in, size_t *len);
+void ws_mux_update_window(ws_relay_t *relay);
+uint32_t ws_mux_stamp(ws_relay_t *relay);
+void ws_mux_maintain(ws_relay_t *relay);
+void ws_mux_put_header(unsigned char *out, ws_mux_frame_type_t type, uint16_t channel, uint32_t value);
+
+// Remote connection sharing
+typedef enum {
+    WS_HUB_NONE, // The relay dials the remote itself and shares it with nobody
+    WS_HUB_OWNER, // The relay dials the remote and routes the channels of attached relays
+    WS_HUB_ATTACHED // The relay's remote connection goes to the owner on this host
+} ws_hub_role_t;
+
+ws_hub_role_t ws_mux_hub_elect(ws_relay_t *relay);
+ws_hub_role_t ws_mux_hub_role(ws_relay_t *relay);
+const char *ws_mux_hub_address(ws_relay_t *relay);
+void ws_mux_hub_release(ws_relay_t *relay);
+void ws_mux_hub_destroy(ws_relay_t *relay);
+void ws_mux_hub_drop_peers(ws_relay_t *relay);
+bool ws_mux_hub_route_begin(ws_relay_t *relay, uint16_t channel);
+void ws_mux_hub_route(ws_relay_t *relay, struct lws *wsi, const void *in, size_t len);
+void ws_mux_hub_get_stats(ws_relay_t *relay, ws_relay_direction_stats_t *stats);
+
+// Outage spill log
+ws_spill_t *ws_spill_create(const char *dir);
+void ws_spill_destroy(ws_spill_t *spill);
+bool ws_spill_empty(ws_spill_t *spill);
+bool ws_spill_append(ws_spill_t *spill, const char *data, size_t len, uint64_t max_bytes);
+bool ws_spill_read(ws_spill_t *spill, std::vector<char> &record, int ttl);
+void ws_spill_maintain(ws_spill_t *spill, int ttl, bool force_sync);
+void ws_spill_get_stats(ws_spill_t *spill, ws_relay_direction_stats_t *stats);
+void ws_relay_open_spill(ws_relay_t *relay);
+
+// Remote endpoint selection
+void ws_endpoints_update(ws_relay_t *relay);
+void ws_endpoints_free(ws_relay_t *relay);
+int ws_endpoint_pick(ws_relay_t *relay, int exclude, time_t now, time_t *retry_at);
+void ws_endpoint_failed(ws_relay_t *relay, int index, time_t now);
+void ws_endpoint_connected(ws_relay_t *relay, int index);
+int ws_endpoint_degraded(ws_relay_t *relay, time_t now);
+void *ws_endpoint_probe_thread(void *data);
+bool ws_probe_endpoint_cancellable(const char *address, const char *protocol, int ping_count, int timeout_ms,
+                                   os_event_t *cancel, ws_probe_result_t *result);
+void ws_relay_drain_spill(ws_relay_t *relay);
+
+// In-process obs-websocket path
+void ws_obs_api_sync(ws_relay_t *relay);
+void ws_obs_api_detach(ws_relay_t *relay);
+bool ws_obs_api_active(ws_relay_t *relay);
+bool ws_obs_api_output_ready(ws_relay_t *relay);
+void ws_obs_api_maintain(ws_relay_t *relay);
+void ws_obs_api_receive(ws_relay_t *relay, bool first, bool final, const void *in, size_t len);
+void ws_obs_api_flush(ws_relay_t *relay);
+size_t ws_obs_api_pending_bytes(ws_relay_t *relay);
+proc_handler_t *ws_obs_api_get_ph(void);
+char *ws_obs_api_request(const char *type, const char *data);
+void ws_relay_deliver_from_obs(ws_relay_t *relay, ws_message_t &msg);
+
+// Request admission control
+ws_admission_t *ws_admission_create(ws_relay_t *relay);
+void ws_admission_destroy(ws_admission_t *admission);
+bool ws_admission_enabled(ws_relay_t *relay);
+bool ws_admission_offer(ws_relay_t *relay, ws_message_t &msg);
+void ws_admission_observe(ws_relay_t *relay, const char *data, size_t len);
+void ws_admission_maintain(ws_relay_t *relay);
+void ws_admission_reset(ws_relay_t *relay, bool obs_lost);
+size_t ws_admission_pending_bytes(ws_relay_t *relay);
+void ws_admission_get_stats(ws_relay_t *relay, ws_relay_direction_stats_t *stats);
+void ws_relay_deliver_to_obs(ws_relay_t *relay, ws_message_t &msg);
+
+// OBS state mirror
+void ws_mirror_sync(ws_relay_t *relay);
+void ws_mirror_detach(ws_relay_t *relay);
+void ws_mirror_observe(ws_relay_t *relay, bool first, bool final, const void *in, size_t len);
+void ws_mirror_observe_message(ws_relay_t *relay, const char *data, size_t len);
+bool ws_mirror_intercept(ws_relay_t *relay, bool first, bool final, const void *in, size_t len);
+void ws_mirror_on_remote_identified(ws_relay_t *relay);
+void ws_mirror_on_remote_lost(ws_relay_t *relay);
+void ws_mirror_on_subscriptions(ws_relay_t *relay, int64_t subscriptions);
+void ws_mirror_invalidate(ws_relay_t *relay);
+void ws_mirror_flush(ws_relay_t *relay);
+bool ws_mirror_result_ready(ws_relay_t *relay);
+void ws_mirror_maintain(ws_relay_t *relay);
+void ws_mirror_get_stats(ws_relay_t *relay, ws_relay_direction_stats_t *stats);
+char *ws_mirror_get_snapshot(ws_relay_t *relay);
+
+// Host name resolution
+bool ws_resolver_request(ws_relay_t *relay, const char *host);
+bool ws_resolver_result_ready(ws_relay_t *relay);
+void ws_resolver_flush(ws_relay_t *relay);
+void ws_resolver_detach(ws_relay_t *relay);
+
+// Remote uplink shaping
+void ws_shaper_init(ws_relay_t *relay);
+bool ws_shaper_ready(ws_relay_t *relay);
+void ws_shaper_consume(ws_relay_t *relay, size_t size);
+void ws_shaper_update(ws_relay_t *relay);
+
+// Span tracing. With WS_RELAY_TRACE undefined the macros compile to nothing
+#if defined(WS_RELAY_TRACE)
+void ws_trace_record(const char *name, uint64_t start_ns, uint64_t end_ns);
+void ws_trace_thread_name(const char *name);
+
+// Records a span from construction to the end of the enclosing scope
+struct ws_trace_scope {
+    const char *name;
+    uint64_t start_ns;
+
+    explicit ws_trace_scope(const char *name) : name(name), start_ns(os_gettime_ns()) {}
+    ~ws_trace_scope() { ws_trace_record(name, start_ns, os_gettime_ns()); }
+};
+
+#define WS_TRACE_CONCAT_(a, b) a##b
+#define WS_TRACE_CONCAT(a, b) WS_TRACE_CONCAT_(a, b)
+#define WS_TRACE_SCOPE(name) ws_trace_scope WS_TRACE_CONCAT(ws_trace_scope_, __LINE__)(name)
+#define WS_TRACE_RECORD(name, start_ns, end_ns) ws_trace_record(name, start_ns, end_ns)
+#define WS_TRACE_THREAD(name) ws_trace_thread_name(name)
+#else
+#define WS_TRACE_SCOPE(name) ((void) 0)
+#define WS_TRACE_RECORD(name, start_ns, end_ns) ((void) 0)
+#define WS_TRACE_THREAD(name) ((void) 0)
+#endif
+
+// Lock the relay mutex, recording contended waits as spans
+static inline void ws_relay_lock(ws_relay_t *relay) {
+#if defined(WS_RELAY_TRACE)
+    uint64_t start_ns = os_gettime_ns();
+    pthread_mutex_lock(&relay->mutex);
+    uint64_t end_ns = os_gettime_ns();
+    if (end_ns - start_ns >= WS_TRACE_MIN_WAIT_NS) {
+        ws_trace_record("mutex wait", start_ns, end_ns);
+    }
+#else
+    pthread_mutex_lock(&relay->mutex);
+#endif
+}
 
 // LWS protocol callbacks
 int ws_callback_obs(struct lws *wsi, enum lws_callback_reasons reason, void *user, void *in, size_t len);
 int ws_callback_remote(struct lws *wsi, enum lws_callback_reasons reason, void *user, void *in, size_t len);
+int ws_callback_hub(struct lws *wsi, enum lws_callback_reasons reason, void *user, void *in, size_t len);
 
 // LWS protocols array
 extern const struct lws_protocols protocols[];
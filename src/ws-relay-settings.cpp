@@ -26,21 +26,58 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 #include <QFormLayout>
 #include <QGroupBox>
 #include <QMessageBox>
+#include <QDateTime>
+#include <QRegularExpression>
+#include <QFileDialog>
+
+// Relay status callback; only hands the update over to the UI thread
+static void ws_relay_status_changed(const ws_relay_status_t *, void *user_data)
+{
+    emit static_cast<WSRelaySettingsDialog *>(user_data)->StatusChanged();
+}
+
+static const char *ws_state_name(ws_connection_state_t state)
+{
+    switch (state) {
+    case WS_STATE_CONNECTING:
+        return "Connecting";
+    case WS_STATE_CONNECTED:
+        return "Connected";
+    case WS_STATE_ERROR:
+        return "Error";
+    default:
+        return "Disconnected";
+    }
+}
 
 WSRelaySettingsDialog::WSRelaySettingsDialog(QWidget *parent)
     : QDialog(parent)
 {
     setWindowTitle("WebSocket Relay Settings");
     setModal(true);
-    resize(500, 350);
+    resize(500, 980);
 
     ws_relay_config_init(&current_config);
     SetupUI();
     LoadSettings();
+
+    // Status is pushed by the relay instead of polled
+    connect(this, &WSRelaySettingsDialog::StatusChanged, this, &WSRelaySettingsDialog::OnStatusChanged,
+            Qt::QueuedConnection);
+    if (global_relay) {
+        ws_relay_set_status_callback(global_relay, ws_relay_status_changed, this);
+    }
 }
 
 WSRelaySettingsDialog::~WSRelaySettingsDialog()
 {
+    if (global_relay) {
+        ws_relay_set_status_callback(global_relay, nullptr, nullptr);
+    }
+    if (probeThread) {
+        probeThread->wait();
+        delete probeThread;
+    }
     ws_relay_config_free(&current_config);
 }
 
@@ -54,11 +91,17 @@ void WSRelaySettingsDialog::SetupUI()
 
     localAddressEdit = new QLineEdit();
     localAddressEdit->setPlaceholderText("ws://localhost:4455");
+    localAddressEdit->setToolTip("ws://host:port, or ws+unix://<socket path>[:<request path>] for a Unix domain socket");
     connectionLayout->addRow("Local OBS Address:", localAddressEdit);
 
+    obsInProcessCheck = new QCheckBox("Execute requests in-process through obs-websocket");
+    obsInProcessCheck->setToolTip("Skips the local WebSocket connection to OBS. Requires authenticating with OBS in the relay");
+    connectionLayout->addRow(obsInProcessCheck);
+
     remoteAddressEdit = new QLineEdit();
-    remoteAddressEdit->setPlaceholderText("wss://example.com:8080/ws");
-    connectionLayout->addRow("Remote WebSocket Address:", remoteAddressEdit);
+    remoteAddressEdit->setPlaceholderText("wss://eu.example.com/ws, wss://us.example.com/ws");
+    remoteAddressEdit->setToolTip("One or more addresses separated by commas, in order of preference");
+    connectionLayout->addRow("Remote WebSocket Address(es):", remoteAddressEdit);
 
     reconnectIntervalSpin = new QSpinBox();
     reconnectIntervalSpin->setRange(1, 300);
@@ -70,6 +113,203 @@ void WSRelaySettingsDialog::SetupUI()
 
     mainLayout->addWidget(connectionGroup);
 
+    // Authentication group
+    QGroupBox *authGroup = new QGroupBox("Authentication");
+    QFormLayout *authLayout = new QFormLayout(authGroup);
+
+    authOffloadCheck = new QCheckBox("Authenticate with OBS in the relay");
+    authLayout->addRow(authOffloadCheck);
+
+    const char *secretsTip = "Saved in plain text in secrets.ini in the plugin's config folder, not in the OBS global "
+                             "config; on Linux and macOS only your user can read it";
+
+    obsPasswordEdit = new QLineEdit();
+    obsPasswordEdit->setEchoMode(QLineEdit::Password);
+    obsPasswordEdit->setToolTip(secretsTip);
+    authLayout->addRow("OBS WebSocket Password:", obsPasswordEdit);
+
+    relayTokenEdit = new QLineEdit();
+    relayTokenEdit->setEchoMode(QLineEdit::Password);
+    relayTokenEdit->setPlaceholderText("No authentication");
+    relayTokenEdit->setToolTip(secretsTip);
+    authLayout->addRow("Relay Token for Remote:", relayTokenEdit);
+
+    stateMirrorCheck = new QCheckBox("Mirror OBS state for the remote");
+    stateMirrorCheck->setToolTip("Lets the remote fetch scenes, inputs, scene items, filters and transitions as one snapshot");
+    authLayout->addRow(stateMirrorCheck);
+
+    statePushCheck = new QCheckBox("Push the state snapshot when the remote identifies");
+    statePushCheck->setToolTip("Sent as a VendorEvent, to remotes subscribed to vendor events");
+    authLayout->addRow(statePushCheck);
+
+    mainLayout->addWidget(authGroup);
+
+    // Advanced settings group
+    QGroupBox *advancedGroup = new QGroupBox("Advanced");
+    QFormLayout *advancedLayout = new QFormLayout(advancedGroup);
+
+    dnsCacheTtlSpin = new QSpinBox();
+    dnsCacheTtlSpin->setRange(0, 86400);
+    dnsCacheTtlSpin->setSuffix(" seconds");
+    dnsCacheTtlSpin->setSpecialValueText("Disabled");
+    advancedLayout->addRow("DNS Cache TTL:", dnsCacheTtlSpin);
+
+    enableStandbyCheck = new QCheckBox("Keep a standby remote connection for fast failover");
+    advancedLayout->addRow(enableStandbyCheck);
+
+    endpointProbeIntervalSpin = new QSpinBox();
+    endpointProbeIntervalSpin->setRange(0, 3600);
+    endpointProbeIntervalSpin->setSuffix(" seconds");
+    endpointProbeIntervalSpin->setSpecialValueText("Disabled");
+    endpointProbeIntervalSpin->setToolTip("How often to measure the latency of each remote address");
+    advancedLayout->addRow("Endpoint Probe Interval:", endpointProbeIntervalSpin);
+
+    failoverRttSpin = new QSpinBox();
+    failoverRttSpin->setRange(0, 10000);
+    failoverRttSpin->setSuffix(" ms");
+    failoverRttSpin->setSpecialValueText("Disabled");
+    failoverRttSpin->setToolTip("Switch to a faster remote address once the current one's round trip exceeds this");
+    advancedLayout->addRow("Switch Endpoint Above RTT:", failoverRttSpin);
+
+    rxBufferMaxSpin = new QSpinBox();
+    rxBufferMaxSpin->setRange(4, 1024);
+    rxBufferMaxSpin->setSuffix(" KiB");
+    rxBufferMaxSpin->setToolTip("Connections get receive buffers sized to their recent messages, up to this size");
+    advancedLayout->addRow("Max Receive Buffer:", rxBufferMaxSpin);
+
+    writeCoalesceSpin = new QSpinBox();
+    writeCoalesceSpin->setRange(0, 1024);
+    writeCoalesceSpin->setSuffix(" KiB");
+    writeCoalesceSpin->setSpecialValueText("Disabled");
+    writeCoalesceSpin->setToolTip("Send bursts of small messages with one write of up to this size");
+    advancedLayout->addRow("Write Coalescing:", writeCoalesceSpin);
+
+    pingIntervalSpin = new QSpinBox();
+    pingIntervalSpin->setRange(0, 300);
+    pingIntervalSpin->setSuffix(" seconds");
+    pingIntervalSpin->setSpecialValueText("Disabled");
+    advancedLayout->addRow("Ping Interval:", pingIntervalSpin);
+
+    pingMaxMissedSpin = new QSpinBox();
+    pingMaxMissedSpin->setRange(1, 20);
+    advancedLayout->addRow("Missed Pongs Before Reconnect:", pingMaxMissedSpin);
+
+    muxChannelSpin = new QSpinBox();
+    muxChannelSpin->setRange(0, 65535);
+    muxChannelSpin->setSpecialValueText("Disabled");
+    advancedLayout->addRow("Multiplexing Channel:", muxChannelSpin);
+
+    muxWindowSpin = new QSpinBox();
+    muxWindowSpin->setRange(0, 1024 * 1024);
+    muxWindowSpin->setSuffix(" KiB");
+    muxWindowSpin->setSpecialValueText("No flow control");
+    advancedLayout->addRow("Channel Window:", muxWindowSpin);
+
+    muxShareCheck = new QCheckBox("Share the remote connection with other relays on this computer");
+    muxShareCheck->setToolTip("Relays with the same remote address send their channels over one connection; each needs a channel of its own");
+    advancedLayout->addRow(muxShareCheck);
+
+    latencyStampingCheck = new QCheckBox("Stamp frames for end-to-end latency");
+    latencyStampingCheck->setToolTip("Needs a remote that understands the clock exchange, such as tools/mux-demux.py");
+    advancedLayout->addRow(latencyStampingCheck);
+
+    uplinkRateSpin = new QSpinBox();
+    uplinkRateSpin->setRange(0, 1024 * 1024);
+    uplinkRateSpin->setSuffix(" KiB/s");
+    uplinkRateSpin->setSpecialValueText("Unlimited");
+    advancedLayout->addRow("Remote Upload Limit:", uplinkRateSpin);
+
+    uplinkBurstSpin = new QSpinBox();
+    uplinkBurstSpin->setRange(1, 64 * 1024);
+    uplinkBurstSpin->setSuffix(" KiB");
+    advancedLayout->addRow("Upload Burst:", uplinkBurstSpin);
+
+    uplinkAdaptiveCheck = new QCheckBox("Lower the upload limit while the stream output is congested");
+    advancedLayout->addRow(uplinkAdaptiveCheck);
+
+    mainLayout->addWidget(advancedGroup);
+
+    // Request admission group
+    QGroupBox *admissionGroup = new QGroupBox("Request Admission");
+    QFormLayout *admissionLayout = new QFormLayout(admissionGroup);
+
+    admissionMaxInflightSpin = new QSpinBox();
+    admissionMaxInflightSpin->setRange(0, 1000);
+    admissionMaxInflightSpin->setSpecialValueText("Unlimited");
+    admissionMaxInflightSpin->setToolTip("Total weight of remote requests OBS may work on at once");
+    admissionLayout->addRow("Requests In Flight:", admissionMaxInflightSpin);
+
+    admissionQueueSpin = new QSpinBox();
+    admissionQueueSpin->setRange(0, 60000);
+    admissionQueueSpin->setSuffix(" ms");
+    admissionQueueSpin->setSpecialValueText("Reject at once");
+    admissionQueueSpin->setToolTip("How long requests over the limit wait before the relay rejects them");
+    admissionLayout->addRow("Queue Timeout:", admissionQueueSpin);
+
+    admissionWeightsEdit = new QLineEdit();
+    admissionWeightsEdit->setPlaceholderText("GetSourceScreenshot=4, RequestBatch=4");
+    admissionWeightsEdit->setToolTip("Weight of each request type; unlisted requests weigh 1");
+    admissionLayout->addRow("Request Weights:", admissionWeightsEdit);
+
+    mainLayout->addWidget(admissionGroup);
+
+    // Memory budget group
+    QGroupBox *budgetGroup = new QGroupBox("Queue Memory Budget");
+    QFormLayout *budgetLayout = new QFormLayout(budgetGroup);
+
+    maxQueuedSpin = new QSpinBox();
+    maxQueuedSpin->setRange(0, 1024 * 1024);
+    maxQueuedSpin->setSuffix(" KiB");
+    maxQueuedSpin->setSpecialValueText("Unlimited");
+    budgetLayout->addRow("Total:", maxQueuedSpin);
+
+    maxQueuedRemoteSpin = new QSpinBox();
+    maxQueuedRemoteSpin->setRange(0, 1024 * 1024);
+    maxQueuedRemoteSpin->setSuffix(" KiB");
+    maxQueuedRemoteSpin->setSpecialValueText("Total only");
+    budgetLayout->addRow("To Remote:", maxQueuedRemoteSpin);
+
+    maxQueuedObsSpin = new QSpinBox();
+    maxQueuedObsSpin->setRange(0, 1024 * 1024);
+    maxQueuedObsSpin->setSuffix(" KiB");
+    maxQueuedObsSpin->setSpecialValueText("Total only");
+    budgetLayout->addRow("To OBS:", maxQueuedObsSpin);
+
+    dropPolicyCombo = new QComboBox();
+    dropPolicyCombo->addItem("Drop oldest events", WS_DROP_OLDEST_EVENT);
+    dropPolicyCombo->addItem("Drop high-volume events first", WS_DROP_EVENT_CLASS);
+    dropPolicyCombo->addItem("Disconnect", WS_DROP_DISCONNECT);
+    budgetLayout->addRow("When Exceeded:", dropPolicyCombo);
+
+    mainLayout->addWidget(budgetGroup);
+
+    // Outage spill group
+    QGroupBox *spillGroup = new QGroupBox("Remote Outages");
+    QFormLayout *spillLayout = new QFormLayout(spillGroup);
+
+    spillEnabledCheck = new QCheckBox("Keep OBS events on disk while the remote is unavailable");
+    spillEnabledCheck->setToolTip("Requires authentication offload, so the relay can keep its OBS session");
+    spillLayout->addRow(spillEnabledCheck);
+
+    spillMaxSpin = new QSpinBox();
+    spillMaxSpin->setRange(1, 1024 * 1024);
+    spillMaxSpin->setSuffix(" MiB");
+    spillLayout->addRow("Max Size on Disk:", spillMaxSpin);
+
+    spillTtlSpin = new QSpinBox();
+    spillTtlSpin->setRange(0, 7 * 86400);
+    spillTtlSpin->setSuffix(" seconds");
+    spillTtlSpin->setSpecialValueText("Until replayed");
+    spillLayout->addRow("Keep Events For:", spillTtlSpin);
+
+    spillDrainRateSpin = new QSpinBox();
+    spillDrainRateSpin->setRange(0, 1024 * 1024);
+    spillDrainRateSpin->setSuffix(" KiB/s");
+    spillDrainRateSpin->setSpecialValueText("Unlimited");
+    spillLayout->addRow("Replay Rate:", spillDrainRateSpin);
+
+    mainLayout->addWidget(spillGroup);
+
     // Status group
     QGroupBox *statusGroup = new QGroupBox("Status");
     QVBoxLayout *statusLayout = new QVBoxLayout(statusGroup);
@@ -80,6 +320,12 @@ void WSRelaySettingsDialog::SetupUI()
     testConnectionBtn = new QPushButton("Test Connection");
     statusLayout->addWidget(testConnectionBtn);
 
+    // Only builds with ENABLE_RELAY_TRACE record spans
+    saveTraceBtn = new QPushButton("Save Trace...");
+    saveTraceBtn->setToolTip("Write the recorded relay spans as a Chrome trace, which Perfetto also opens");
+    saveTraceBtn->setVisible(ws_relay_trace_available());
+    statusLayout->addWidget(saveTraceBtn);
+
     mainLayout->addWidget(statusGroup);
 
     // Button box
@@ -95,12 +341,59 @@ void WSRelaySettingsDialog::SetupUI()
             this, &WSRelaySettingsDialog::SaveSettings);
 
     connect(testConnectionBtn, &QPushButton::clicked, this, &WSRelaySettingsDialog::OnTestConnection);
+    connect(saveTraceBtn, &QPushButton::clicked, this, &WSRelaySettingsDialog::OnSaveTrace);
 
     connect(localAddressEdit, &QLineEdit::textChanged, this, &WSRelaySettingsDialog::OnSettingsChanged);
+    connect(obsInProcessCheck, &QCheckBox::toggled, this, &WSRelaySettingsDialog::OnSettingsChanged);
     connect(remoteAddressEdit, &QLineEdit::textChanged, this, &WSRelaySettingsDialog::OnSettingsChanged);
     connect(reconnectIntervalSpin, QOverload<int>::of(&QSpinBox::valueChanged),
             this, &WSRelaySettingsDialog::OnSettingsChanged);
     connect(enableLoggingCheck, &QCheckBox::toggled, this, &WSRelaySettingsDialog::OnSettingsChanged);
+    connect(dnsCacheTtlSpin, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &WSRelaySettingsDialog::OnSettingsChanged);
+    connect(enableStandbyCheck, &QCheckBox::toggled, this, &WSRelaySettingsDialog::OnSettingsChanged);
+    connect(endpointProbeIntervalSpin, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &WSRelaySettingsDialog::OnSettingsChanged);
+    connect(failoverRttSpin, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &WSRelaySettingsDialog::OnSettingsChanged);
+    connect(rxBufferMaxSpin, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &WSRelaySettingsDialog::OnSettingsChanged);
+    connect(writeCoalesceSpin, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &WSRelaySettingsDialog::OnSettingsChanged);
+    connect(admissionMaxInflightSpin, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &WSRelaySettingsDialog::OnSettingsChanged);
+    connect(authOffloadCheck, &QCheckBox::toggled, this, &WSRelaySettingsDialog::OnSettingsChanged);
+    connect(stateMirrorCheck, &QCheckBox::toggled, this, &WSRelaySettingsDialog::OnSettingsChanged);
+    connect(pingIntervalSpin, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &WSRelaySettingsDialog::OnSettingsChanged);
+    connect(pingMaxMissedSpin, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &WSRelaySettingsDialog::OnSettingsChanged);
+    connect(muxChannelSpin, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &WSRelaySettingsDialog::OnSettingsChanged);
+    connect(muxWindowSpin, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &WSRelaySettingsDialog::OnSettingsChanged);
+    connect(muxShareCheck, &QCheckBox::toggled, this, &WSRelaySettingsDialog::OnSettingsChanged);
+    connect(latencyStampingCheck, &QCheckBox::toggled, this, &WSRelaySettingsDialog::OnSettingsChanged);
+    connect(uplinkRateSpin, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &WSRelaySettingsDialog::OnSettingsChanged);
+    connect(uplinkBurstSpin, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &WSRelaySettingsDialog::OnSettingsChanged);
+    connect(uplinkAdaptiveCheck, &QCheckBox::toggled, this, &WSRelaySettingsDialog::OnSettingsChanged);
+    connect(maxQueuedSpin, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &WSRelaySettingsDialog::OnSettingsChanged);
+    connect(maxQueuedRemoteSpin, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &WSRelaySettingsDialog::OnSettingsChanged);
+    connect(maxQueuedObsSpin, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &WSRelaySettingsDialog::OnSettingsChanged);
+    connect(dropPolicyCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &WSRelaySettingsDialog::OnSettingsChanged);
+    connect(spillEnabledCheck, &QCheckBox::toggled, this, &WSRelaySettingsDialog::OnSettingsChanged);
+    connect(spillMaxSpin, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &WSRelaySettingsDialog::OnSettingsChanged);
+    connect(spillTtlSpin, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &WSRelaySettingsDialog::OnSettingsChanged);
+    connect(spillDrainRateSpin, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &WSRelaySettingsDialog::OnSettingsChanged);
 }
 
 void WSRelaySettingsDialog::LoadSettings()
@@ -110,9 +403,41 @@ void WSRelaySettingsDialog::LoadSettings()
         remoteAddressEdit->setText(current_config.remote_ws_address);
         reconnectIntervalSpin->setValue(current_config.reconnect_interval);
         enableLoggingCheck->setChecked(current_config.enable_logging);
+        dnsCacheTtlSpin->setValue(current_config.dns_cache_ttl);
+        enableStandbyCheck->setChecked(current_config.enable_standby);
+        endpointProbeIntervalSpin->setValue(current_config.endpoint_probe_interval);
+        failoverRttSpin->setValue(current_config.failover_rtt_ms);
+        rxBufferMaxSpin->setValue(current_config.rx_buffer_max_kb);
+        writeCoalesceSpin->setValue(current_config.write_coalesce_kb);
+        authOffloadCheck->setChecked(current_config.auth_offload);
+        obsInProcessCheck->setChecked(current_config.obs_in_process);
+        obsPasswordEdit->setText(current_config.obs_password);
+        relayTokenEdit->setText(current_config.relay_token);
+        stateMirrorCheck->setChecked(current_config.state_mirror);
+        statePushCheck->setChecked(current_config.state_push);
+        pingIntervalSpin->setValue(current_config.ping_interval);
+        pingMaxMissedSpin->setValue(current_config.ping_max_missed);
+        muxChannelSpin->setValue(current_config.mux_channel);
+        muxWindowSpin->setValue(current_config.mux_window_kb);
+        muxShareCheck->setChecked(current_config.mux_share);
+        latencyStampingCheck->setChecked(current_config.latency_stamping);
+        uplinkRateSpin->setValue(current_config.uplink_rate_kbps);
+        uplinkBurstSpin->setValue(current_config.uplink_burst_kb);
+        uplinkAdaptiveCheck->setChecked(current_config.uplink_adaptive);
+        maxQueuedSpin->setValue(current_config.max_queued_kb);
+        maxQueuedRemoteSpin->setValue(current_config.max_queued_remote_kb);
+        maxQueuedObsSpin->setValue(current_config.max_queued_obs_kb);
+        dropPolicyCombo->setCurrentIndex(dropPolicyCombo->findData(current_config.drop_policy));
+        spillEnabledCheck->setChecked(current_config.spill_enabled);
+        spillMaxSpin->setValue(current_config.spill_max_mb);
+        spillTtlSpin->setValue(current_config.spill_ttl);
+        spillDrainRateSpin->setValue(current_config.spill_drain_kbps);
+        admissionMaxInflightSpin->setValue(current_config.admission_max_inflight);
+        admissionQueueSpin->setValue(current_config.admission_queue_ms);
+        admissionWeightsEdit->setText(current_config.admission_weights);
     }
 
-    UpdateConnectionStatus();
+    OnSettingsChanged();
 }
 
 void WSRelaySettingsDialog::SaveSettings()
@@ -125,6 +450,41 @@ void WSRelaySettingsDialog::SaveSettings()
     current_config.remote_ws_address = bstrdup(remoteAddressEdit->text().toUtf8().constData());
     current_config.reconnect_interval = reconnectIntervalSpin->value();
     current_config.enable_logging = enableLoggingCheck->isChecked();
+    current_config.dns_cache_ttl = dnsCacheTtlSpin->value();
+    current_config.enable_standby = enableStandbyCheck->isChecked();
+    current_config.endpoint_probe_interval = endpointProbeIntervalSpin->value();
+    current_config.failover_rtt_ms = failoverRttSpin->value();
+    current_config.rx_buffer_max_kb = rxBufferMaxSpin->value();
+    current_config.write_coalesce_kb = writeCoalesceSpin->value();
+    current_config.auth_offload = authOffloadCheck->isChecked();
+    current_config.obs_in_process = obsInProcessCheck->isChecked();
+    current_config.state_mirror = stateMirrorCheck->isChecked();
+    current_config.state_push = statePushCheck->isChecked();
+    bfree(current_config.obs_password);
+    current_config.obs_password = bstrdup(obsPasswordEdit->text().toUtf8().constData());
+    bfree(current_config.relay_token);
+    current_config.relay_token = bstrdup(relayTokenEdit->text().toUtf8().constData());
+    current_config.ping_interval = pingIntervalSpin->value();
+    current_config.ping_max_missed = pingMaxMissedSpin->value();
+    current_config.mux_channel = muxChannelSpin->value();
+    current_config.mux_window_kb = muxWindowSpin->value();
+    current_config.mux_share = muxShareCheck->isChecked();
+    current_config.latency_stamping = latencyStampingCheck->isChecked();
+    current_config.uplink_rate_kbps = uplinkRateSpin->value();
+    current_config.uplink_burst_kb = uplinkBurstSpin->value();
+    current_config.uplink_adaptive = uplinkAdaptiveCheck->isChecked();
+    current_config.max_queued_kb = maxQueuedSpin->value();
+    current_config.max_queued_remote_kb = maxQueuedRemoteSpin->value();
+    current_config.max_queued_obs_kb = maxQueuedObsSpin->value();
+    current_config.drop_policy = (ws_drop_policy_t) dropPolicyCombo->currentData().toInt();
+    current_config.spill_enabled = spillEnabledCheck->isChecked();
+    current_config.spill_max_mb = spillMaxSpin->value();
+    current_config.spill_ttl = spillTtlSpin->value();
+    current_config.spill_drain_kbps = spillDrainRateSpin->value();
+    current_config.admission_max_inflight = admissionMaxInflightSpin->value();
+    current_config.admission_queue_ms = admissionQueueSpin->value();
+    bfree(current_config.admission_weights);
+    current_config.admission_weights = bstrdup(admissionWeightsEdit->text().toUtf8().constData());
 
     if (ws_relay_config_save(&current_config)) {
         QMessageBox::information(this, "WebSocket Relay Settings", "Settings saved successfully!");
@@ -137,23 +497,93 @@ void WSRelaySettingsDialog::SaveSettings()
     }
 }
 
+void WSRelaySettingsDialog::OnSaveTrace()
+{
+    QString path = QFileDialog::getSaveFileName(this, "Save Relay Trace", "obs-ws-relay-trace.json",
+                                                "Chrome trace (*.json)");
+    if (path.isEmpty()) return;
+
+    if (!ws_relay_trace_dump(path.toUtf8().constData())) {
+        QMessageBox::warning(this, "Save Trace", "Failed to write the trace file.");
+    }
+}
+
 void WSRelaySettingsDialog::OnTestConnection()
 {
+    if (probeThread) return;
+
+    // Split like the relay does, so every endpoint it may connect to gets tested
+    QStringList addresses = remoteAddressEdit->text().split(QRegularExpression("[,\\s]+"), Qt::SkipEmptyParts);
+    addresses.removeDuplicates();
+    if (addresses.isEmpty()) {
+        QMessageBox::warning(this, "Test Connection", "Please enter a remote WebSocket address first.");
+        return;
+    }
+
     testConnectionBtn->setEnabled(false);
     testConnectionBtn->setText("Testing...");
 
-    QString remote_addr = remoteAddressEdit->text().trimmed();
-    if (remote_addr.isEmpty()) {
-        QMessageBox::warning(this, "Test Connection", "Please enter a remote WebSocket address first.");
-    } else {
-        // For now, just show a message. In a real implementation, you would
-        // create a temporary connection to test
-        QMessageBox::information(this, "Test Connection",
-            QString("Connection test for: %1\n\nNote: Full connection testing will be implemented in a future version.").arg(remote_addr));
+    // The probes use connections of their own and block, so they run on a thread of their own
+    probeAddresses = addresses;
+    probeResults.assign(addresses.size(), ws_probe_result_t{});
+    probeThread = QThread::create([this]() {
+        for (int i = 0; i < probeAddresses.size(); i++) {
+            ws_probe_endpoint(probeAddresses[i].toUtf8().constData(), "websocket", WS_PROBE_DEFAULT_PINGS,
+                              WS_PROBE_DEFAULT_TIMEOUT_MS, &probeResults[i]);
+        }
+    });
+    connect(probeThread, &QThread::finished, this, &WSRelaySettingsDialog::OnTestFinished);
+    probeThread->start();
+}
+
+static QString ws_format_ms(int64_t us)
+{
+    return us < 0 ? QString("-") : QString("%1 ms").arg(us / 1000.0, 0, 'f', 1);
+}
+
+static QString ws_format_probe(const ws_probe_result_t &result)
+{
+    QString tls = ws_format_ms(result.tls_us);
+    if (result.tls_estimated) tls += " (estimate)";
+    QString report = QString("DNS lookup: %1\nTCP connect: %2\nTLS handshake: %3\nWebSocket upgrade: %4")
+                         .arg(ws_format_ms(result.dns_us), ws_format_ms(result.tcp_us), tls,
+                              ws_format_ms(result.upgrade_us));
+    if (result.pings_sent) {
+        report += QString("\nPings: %1 of %2 answered").arg(result.pongs_received).arg(result.pings_sent);
+    }
+    if (result.pongs_received) {
+        report += QString("\nRound trip: min %1, median %2, p90 %3, max %4")
+                      .arg(ws_format_ms((int64_t) result.rtt_min_us), ws_format_ms((int64_t) result.rtt_median_us),
+                           ws_format_ms((int64_t) result.rtt_p90_us), ws_format_ms((int64_t) result.rtt_max_us));
+    }
+    if (!result.success) {
+        report = QString("Failed: %1\n%2").arg(QString::fromUtf8(result.error), report);
     }
+    return report;
+}
+
+void WSRelaySettingsDialog::OnTestFinished()
+{
+    probeThread->wait();
+    delete probeThread;
+    probeThread = nullptr;
 
     testConnectionBtn->setEnabled(true);
     testConnectionBtn->setText("Test Connection");
+
+    bool success = true;
+    QStringList reports;
+    for (int i = 0; i < probeAddresses.size(); i++) {
+        success = success && probeResults[i].success;
+        reports << (probeAddresses.size() > 1 ? probeAddresses[i] + "\n" : QString()) + ws_format_probe(probeResults[i]);
+    }
+
+    QString report = reports.join("\n\n");
+    if (success) {
+        QMessageBox::information(this, "Test Connection", report);
+    } else {
+        QMessageBox::warning(this, "Test Connection", report);
+    }
 }
 
 void WSRelaySettingsDialog::OnAccepted()
@@ -168,18 +598,71 @@ void WSRelaySettingsDialog::OnRejected()
 }
 
 void WSRelaySettingsDialog::OnSettingsChanged()
+{
+    obsPasswordEdit->setEnabled(authOffloadCheck->isChecked() && !obsInProcessCheck->isChecked());
+    obsInProcessCheck->setEnabled(authOffloadCheck->isChecked());
+    localAddressEdit->setEnabled(!authOffloadCheck->isChecked() || !obsInProcessCheck->isChecked());
+    relayTokenEdit->setEnabled(authOffloadCheck->isChecked());
+    stateMirrorCheck->setEnabled(authOffloadCheck->isChecked());
+    statePushCheck->setEnabled(authOffloadCheck->isChecked() && stateMirrorCheck->isChecked());
+    muxWindowSpin->setEnabled(muxChannelSpin->value() > 0);
+    muxShareCheck->setEnabled(muxChannelSpin->value() > 0);
+    latencyStampingCheck->setEnabled(muxChannelSpin->value() > 0);
+    uplinkBurstSpin->setEnabled(uplinkRateSpin->value() > 0);
+    uplinkAdaptiveCheck->setEnabled(uplinkRateSpin->value() > 0);
+    failoverRttSpin->setEnabled(endpointProbeIntervalSpin->value() > 0);
+    admissionQueueSpin->setEnabled(admissionMaxInflightSpin->value() > 0);
+    admissionWeightsEdit->setEnabled(admissionMaxInflightSpin->value() > 0);
+
+    bool spill = authOffloadCheck->isChecked() && spillEnabledCheck->isChecked();
+    spillEnabledCheck->setEnabled(authOffloadCheck->isChecked());
+    spillMaxSpin->setEnabled(spill);
+    spillTtlSpin->setEnabled(spill);
+    spillDrainRateSpin->setEnabled(spill);
+    UpdateConnectionStatus();
+}
+
+void WSRelaySettingsDialog::OnStatusChanged()
 {
     UpdateConnectionStatus();
 }
 
 void WSRelaySettingsDialog::UpdateConnectionStatus()
 {
+    ws_relay_status_t status = {};
     if (remoteAddressEdit->text().trimmed().isEmpty()) {
         statusLabel->setText("Status: Not configured");
         statusLabel->setStyleSheet("color: orange;");
-    } else {
-        statusLabel->setText("Status: Configured");
+        return;
+    }
+    if (!global_relay || !ws_relay_is_running(global_relay) || !ws_relay_get_status(global_relay, &status)) {
+        statusLabel->setText("Status: Not running");
+        statusLabel->setStyleSheet("color: orange;");
+        return;
+    }
+
+    QString text = QString("OBS: %1, Remote: %2").arg(ws_state_name(status.obs_state), ws_state_name(status.remote_state));
+    if (status.remote_address[0]) {
+        text += QString(" (%1)").arg(QString::fromUtf8(status.remote_address));
+    }
+    if (status.remote_state == WS_STATE_CONNECTED && status.remote_since) {
+        text += QString(" since %1").arg(QDateTime::fromSecsSinceEpoch(status.remote_since).toString("HH:mm:ss"));
+    }
+    text += QString("\n%1 messages to remote, %2 to OBS, %3 dropped")
+                .arg(status.messages_to_remote)
+                .arg(status.messages_to_obs)
+                .arg(status.dropped_messages);
+    if (status.last_error[0]) {
+        text += QString("\nLast error: %1").arg(QString::fromUtf8(status.last_error));
+    }
+    statusLabel->setText(text);
+
+    if (status.obs_state == WS_STATE_CONNECTED && status.remote_state == WS_STATE_CONNECTED) {
         statusLabel->setStyleSheet("color: green;");
+    } else if (status.obs_state == WS_STATE_ERROR || status.remote_state == WS_STATE_ERROR) {
+        statusLabel->setStyleSheet("color: red;");
+    } else {
+        statusLabel->setStyleSheet("color: orange;");
     }
 }
 
@@ -22,9 +22,13 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 #include <QLineEdit>
 #include <QSpinBox>
 #include <QCheckBox>
+#include <QComboBox>
 #include <QPushButton>
 #include <QLabel>
 #include <QDialogButtonBox>
+#include <QThread>
+#include <QStringList>
+#include <vector>
 #include "ws-relay.h"
 
 class WSRelaySettingsDialog : public QDialog
@@ -33,14 +37,53 @@ class WSRelaySettingsDialog : public QDialog
 
 private:
     QLineEdit *localAddressEdit;
+    QCheckBox *obsInProcessCheck;
     QLineEdit *remoteAddressEdit;
     QSpinBox *reconnectIntervalSpin;
+    QSpinBox *endpointProbeIntervalSpin;
+    QSpinBox *failoverRttSpin;
+    QSpinBox *rxBufferMaxSpin;
+    QSpinBox *writeCoalesceSpin;
     QCheckBox *enableLoggingCheck;
+    QSpinBox *dnsCacheTtlSpin;
+    QCheckBox *enableStandbyCheck;
+    QSpinBox *pingIntervalSpin;
+    QSpinBox *pingMaxMissedSpin;
+    QSpinBox *muxChannelSpin;
+    QSpinBox *muxWindowSpin;
+    QCheckBox *muxShareCheck;
+    QCheckBox *latencyStampingCheck;
+    QSpinBox *uplinkRateSpin;
+    QSpinBox *uplinkBurstSpin;
+    QCheckBox *uplinkAdaptiveCheck;
+    QSpinBox *maxQueuedSpin;
+    QSpinBox *maxQueuedRemoteSpin;
+    QSpinBox *maxQueuedObsSpin;
+    QComboBox *dropPolicyCombo;
+    QCheckBox *spillEnabledCheck;
+    QSpinBox *spillMaxSpin;
+    QSpinBox *spillTtlSpin;
+    QSpinBox *spillDrainRateSpin;
+    QSpinBox *admissionMaxInflightSpin;
+    QSpinBox *admissionQueueSpin;
+    QLineEdit *admissionWeightsEdit;
+    QCheckBox *authOffloadCheck;
+    QLineEdit *obsPasswordEdit;
+    QLineEdit *relayTokenEdit;
+    QCheckBox *stateMirrorCheck;
+    QCheckBox *statePushCheck;
     QLabel *statusLabel;
     QPushButton *testConnectionBtn;
+    QPushButton *saveTraceBtn;
 
     ws_relay_config_t current_config;
 
+    // Connection test running in the background; probeResults is written by probeThread, one
+    // result per entry of probeAddresses
+    QThread *probeThread = nullptr;
+    QStringList probeAddresses;
+    std::vector<ws_probe_result_t> probeResults;
+
 public:
     WSRelaySettingsDialog(QWidget *parent = nullptr);
     ~WSRelaySettingsDialog();
@@ -50,12 +93,17 @@ public:
 
 signals:
     void SettingsChanged();
+    void StatusChanged(); // Emitted from the relay thread, delivered queued
+
 
 private slots:
     void OnTestConnection();
+    void OnTestFinished();
+    void OnSaveTrace();
     void OnAccepted();
     void OnRejected();
     void OnSettingsChanged();
+    void OnStatusChanged();
 
 private:
     void UpdateConnectionStatus();
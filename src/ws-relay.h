@@ -35,6 +35,121 @@ typedef enum {
     WS_STATE_ERROR
 } ws_connection_state_t;
 
+// What to do when queued messages exceed the memory budget
+typedef enum {
+    WS_DROP_OLDEST_EVENT, // Drop the oldest queued events
+    WS_DROP_EVENT_CLASS, // Drop high-volume events first, then the oldest events
+    WS_DROP_DISCONNECT // Close the stalled connection
+} ws_drop_policy_t;
+
+// Ping round-trip histogram: bucket 0 counts RTTs below 1 ms, bucket i counts RTTs in
+// [2^(i-1), 2^i) ms and the last bucket counts everything above
+#define WS_RTT_HISTOGRAM_BUCKETS 16
+
+// Received message size histogram: bucket 0 counts messages below 1 KiB, bucket i counts sizes in
+// [2^(i-1), 2^i) KiB and the last bucket counts everything above
+#define WS_SIZE_HISTOGRAM_BUCKETS 16
+
+// Receive callbacks per message: bucket i counts messages that took [2^i, 2^(i+1)) callbacks and
+// the last bucket counts everything above
+#define WS_CALLBACK_HISTOGRAM_BUCKETS 12
+
+// Per-direction traffic counters
+typedef struct {
+    uint64_t messages; // Messages written to the connection
+    uint64_t bytes; // Payload bytes written to the connection
+    uint64_t fast_path_messages; // Messages written straight from the receive buffer without queueing
+    uint64_t write_calls; // Writes issued to the connection, each normally one send()
+    uint64_t write_ns; // Time spent writing queued messages
+    uint64_t dropped_messages; // Messages discarded by the memory budget or a closed connection
+    uint64_t dropped_bytes;
+    uint64_t oversized_messages; // Messages dropped for exceeding the maximum message size
+    uint64_t budget_disconnects; // Connections closed because the memory budget was exceeded
+    uint64_t queued_messages; // Messages currently waiting to be written
+    uint64_t queued_bytes;
+    uint64_t pings_sent; // Health check pings sent on the connection
+    uint64_t pongs_received;
+    uint64_t ping_timeouts; // Connections declared dead after missing too many pongs
+    uint64_t rtt_last_us; // Last measured ping round-trip time
+    uint64_t rtt_smoothed_us; // Smoothed ping round-trip time
+    uint64_t rtt_histogram[WS_RTT_HISTOGRAM_BUCKETS];
+    uint64_t spilled_messages; // Events written to the spill log during a remote outage
+    uint64_t spill_replayed_messages; // Spilled events replayed to the remote
+    uint64_t spill_dropped_messages; // Spilled events lost to the size cap, TTL or corruption
+    uint64_t spill_queued_messages; // Events currently waiting in the spill log
+    uint64_t spill_queued_bytes;
+    uint64_t shaper_delays; // Times writes waited for the uplink shaper
+    uint64_t shaper_rate; // Current uplink rate limit in bytes per second (0 = unlimited)
+    uint64_t size_histogram[WS_SIZE_HISTOGRAM_BUCKETS]; // Messages received for this direction, by size
+    uint64_t callback_histogram[WS_CALLBACK_HISTOGRAM_BUCKETS]; // The same messages, by receive callbacks
+    uint64_t rx_buffer_size; // Receive buffer of the connection these messages arrive on
+    uint64_t admission_inflight_cost; // Cost of the requests OBS is working on
+    uint64_t admission_waiting; // Requests currently waiting for admission
+    uint64_t admission_queued; // Requests that had to wait for admission
+    uint64_t admission_rejected; // Requests the relay answered with an error instead of forwarding
+    uint64_t admission_wait_last_us; // Time the last admitted request waited
+    uint64_t admission_wait_max_us;
+    uint64_t admission_wait_histogram[WS_RTT_HISTOGRAM_BUCKETS]; // Admission waits, bucketed like rtt_histogram
+    uint64_t mirror_live; // 1 while the OBS state mirror follows OBS events
+    uint64_t mirror_events; // OBS events applied to the state mirror
+    uint64_t mirror_refreshes; // Fetches of OBS state through obs-websocket's plugin API
+    uint64_t mirror_snapshots; // State snapshots sent to the remote
+    uint64_t mirror_snapshot_bytes; // Size of the last snapshot message
+    uint64_t clock_exchanges; // Clock exchanges completed with the remote
+    int64_t clock_offset_us; // Remote clock minus relay clock, from the recent exchange with the lowest round trip
+    uint64_t clock_delay_us; // Round trip of that exchange
+    uint64_t one_way_messages; // Stamped messages from the remote measured while the clock offset was known
+    uint64_t one_way_last_us; // Remote to relay latency of the last of them
+    uint64_t one_way_max_us;
+    uint64_t one_way_histogram[WS_RTT_HISTOGRAM_BUCKETS]; // Their latencies, bucketed like rtt_histogram
+    uint64_t hub_peers; // Relays on this host attached to the relay's remote connection
+    uint64_t hub_messages; // Frames routed between attached relays and the remote
+    uint64_t hub_bytes;
+} ws_relay_direction_stats_t;
+
+// Relay statistics
+typedef struct {
+    ws_relay_direction_stats_t to_remote;
+    ws_relay_direction_stats_t to_obs;
+} ws_relay_stats_t;
+
+// Connection status, readable from any thread without waiting on the relay
+typedef struct {
+    ws_connection_state_t obs_state;
+    ws_connection_state_t remote_state;
+    int64_t obs_since; // Unix time the OBS connection entered its state
+    int64_t remote_since;
+    uint64_t messages_to_remote;
+    uint64_t messages_to_obs;
+    uint64_t bytes_to_remote;
+    uint64_t bytes_to_obs;
+    uint64_t dropped_messages; // Messages dropped in either direction
+    char last_error[128]; // Most recent connection error, empty if there was none
+    char remote_address[256]; // Endpoint of the remote connection, empty if there is none
+} ws_relay_status_t;
+
+// Endpoint probe defaults
+#define WS_PROBE_DEFAULT_TIMEOUT_MS 5000
+#define WS_PROBE_DEFAULT_PINGS 10
+
+// Endpoint probe results; times are in microseconds, -1 where a phase did not run
+typedef struct {
+    bool success;
+    char error[128]; // Why the probe failed, empty on success
+    int64_t dns_us;
+    int64_t tcp_us; // Socket connect, also for ws+unix:// endpoints
+    int64_t tls_us; // -1 for ws:// endpoints
+    bool tls_estimated; // tls_us is derived from a separate TCP connect, as lws was built without LWS_WITH_CONMON
+    int64_t upgrade_us; // WebSocket upgrade request to response
+    int pings_sent;
+    int pongs_received;
+    uint64_t rtt_min_us;
+    uint64_t rtt_median_us;
+    uint64_t rtt_p90_us;
+    uint64_t rtt_max_us;
+    uint64_t rtt_avg_us;
+} ws_probe_result_t;
+
 // WebSocket relay structure
 typedef struct ws_relay ws_relay_t;
 
@@ -43,9 +158,41 @@ extern ws_relay_t *global_relay;
 // Configuration structure
 typedef struct {
     char *local_obs_address; // Local OBS WebSocket address (e.g., "ws://localhost:4455")
-    char *remote_ws_address; // Remote WebSocket address (supports wss://)
+    char *remote_ws_address; // Remote WebSocket addresses (supports wss://), comma separated in order of preference
     int reconnect_interval; // Reconnect interval in seconds
     bool enable_logging; // Enable verbose logging
+    int dns_cache_ttl; // Lifetime of cached DNS results in seconds (0 disables caching)
+    bool enable_standby; // Keep a pre-established standby connection to the remote
+    int max_queued_kb; // Budget for all queued messages in KiB (0 = unlimited)
+    int max_queued_remote_kb; // Budget for messages queued to the remote in KiB (0 = global budget only)
+    int max_queued_obs_kb; // Budget for messages queued to OBS in KiB (0 = global budget only)
+    ws_drop_policy_t drop_policy; // What to drop when a budget is exceeded
+    int ping_interval; // Seconds between health check pings (0 disables)
+    int ping_max_missed; // Unanswered pings before a connection is declared dead
+    bool auth_offload; // Identify with OBS in the relay and present the remote an identified session
+    char *obs_password; // Local obs-websocket password, used with auth_offload
+    char *relay_token; // Secret the remote authenticates to the relay with, used with auth_offload
+    int mux_channel; // Channel id for multiplexed framing on the remote connection (0 disables)
+    int mux_window_kb; // Per-channel flow control window in KiB (0 disables flow control)
+    bool mux_share; // Share one remote connection with the other relays on this host, used with mux_channel
+    bool spill_enabled; // Keep OBS events on disk while the remote session is unavailable
+    int spill_max_mb; // Size cap of the spill log in MiB
+    int spill_ttl; // Seconds spilled events are kept (0 keeps them until replayed)
+    int spill_drain_kbps; // Replay rate of spilled events in KiB/s (0 = unlimited)
+    int uplink_rate_kbps; // Rate limit for traffic to the remote in KiB/s (0 = unlimited)
+    int uplink_burst_kb; // Burst size of the uplink rate limit in KiB
+    bool uplink_adaptive; // Lower the uplink rate while OBS's stream output is congested
+    int endpoint_probe_interval; // Seconds between latency probes of the remote endpoints (0 disables)
+    int failover_rtt_ms; // Move to another endpoint once the active one's RTT exceeds this (0 disables)
+    int admission_max_inflight; // Cost of requests OBS may work on at once (0 disables admission control)
+    int admission_queue_ms; // How long requests over the limit wait before they are rejected (0 rejects them at once)
+    char *admission_weights; // Request costs as "RequestType=weight" pairs, comma separated; others cost 1
+    int write_coalesce_kb; // Pack queued messages into writes of up to this many KiB (0 writes each on its own)
+    int rx_buffer_max_kb; // Largest receive buffer a connection is given in KiB
+    bool obs_in_process; // Execute requests through obs-websocket's plugin API instead of the local socket, used with auth_offload
+    bool state_mirror; // Keep a mirror of the OBS state the remote can fetch as one snapshot, used with auth_offload
+    bool state_push; // Push the state snapshot to the remote when it identifies, used with state_mirror
+    bool latency_stamping; // Stamp multiplexed frames with relay timestamps and track the remote's clock offset, used with mux_channel
 } ws_relay_config_t;
 
 // Callback function types
@@ -53,6 +200,10 @@ typedef void (*ws_message_callback_t)(const char *message, size_t length, void *
 
 typedef void (*ws_state_callback_t)(ws_connection_state_t state, void *user_data);
 
+// Called on the relay thread whenever the status is published, at least once a second while
+// running. Must return quickly and must not call back into the relay
+typedef void (*ws_status_callback_t)(const ws_relay_status_t *status, void *user_data);
+
 // Main relay functions
 ws_relay_t *ws_relay_create(const ws_relay_config_t *config);
 
@@ -62,17 +213,48 @@ bool ws_relay_start(ws_relay_t *relay);
 
 void ws_relay_stop(ws_relay_t *relay);
 
+bool ws_relay_is_running(ws_relay_t *relay);
+
+bool ws_relay_apply_config(ws_relay_t *relay, const ws_relay_config_t *config);
+
 bool ws_relay_is_connected(ws_relay_t *relay);
 
 ws_connection_state_t ws_relay_get_obs_state(ws_relay_t *relay);
 
 ws_connection_state_t ws_relay_get_remote_state(ws_relay_t *relay);
 
+// Copy the statistics published with the status, at least once a second while running; never
+// blocks on the relay
+bool ws_relay_get_stats(ws_relay_t *relay, ws_relay_stats_t *stats);
+
+bool ws_relay_get_status(ws_relay_t *relay, ws_relay_status_t *status);
+
+void ws_relay_set_status_callback(ws_relay_t *relay, ws_status_callback_t callback, void *user_data);
+
+// Probe an endpoint on a connection of its own; blocks, so call it off the UI thread
+bool ws_probe_endpoint(const char *address, const char *protocol, int ping_count, int timeout_ms,
+                       ws_probe_result_t *result);
+
+// Span tracing; without ENABLE_RELAY_TRACE nothing is recorded and the dump fails
+bool ws_relay_trace_available(void);
+
+bool ws_relay_trace_dump(const char *path);
+
+// obs-websocket vendor requests for the relay; register from obs_module_post_load and
+// unregister while obs-websocket is still loaded. The relay is attached separately
+void ws_relay_register_vendor(void);
+
+void ws_relay_set_vendor_relay(ws_relay_t *relay);
+
+void ws_relay_unregister_vendor(void);
+
 // Configuration management
 void ws_relay_config_init(ws_relay_config_t *config);
 
 void ws_relay_config_free(ws_relay_config_t *config);
 
+void ws_relay_config_copy(ws_relay_config_t *dst, const ws_relay_config_t *src);
+
 bool ws_relay_config_load(ws_relay_config_t *config);
 
 bool ws_relay_config_save(const ws_relay_config_t *config);
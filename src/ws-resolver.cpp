@@ -0,0 +1,203 @@
+/*
+OBS WebSocket Relay - Host Name Resolution
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "ws-relay-internal.h"
+#include <obs-module.h>
+#include <plugin-support.h>
+#include <util/threading.h>
+#include <libwebsockets.h>
+#include <deque>
+#include <set>
+#include <string>
+
+#ifdef _WIN32
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#endif
+
+// Lookup handed back by the worker; address is empty if it failed
+typedef struct {
+    std::string host;
+    std::string address;
+} ws_resolver_result_t;
+
+// getaddrinfo blocks for as long as the system resolver takes, so lookups run on a worker
+// thread of their own. The worker does not take the relay mutex: it hands its results over
+// under lock and wakes the service thread. The lock nests inside the relay mutex
+struct ws_resolver {
+    pthread_mutex_t lock;
+    os_sem_t *sem; // Posted for every queued lookup and on detach
+    struct lws_context *context; // Woken when a result is ready, NULL once detached
+    bool detached;
+    std::deque<std::string> requests;
+    std::set<std::string> in_flight; // Queued or running, so a host is looked up once at a time
+    std::deque<ws_resolver_result_t> results;
+    volatile bool result_ready;
+    long refs; // Held by the relay and the worker
+};
+
+static void ws_resolver_release(ws_resolver_t *resolver) {
+    if (os_atomic_dec_long(&resolver->refs) > 0) return;
+
+    os_sem_destroy(resolver->sem);
+    pthread_mutex_destroy(&resolver->lock);
+    delete resolver;
+}
+
+// First address of host in text form, empty if the lookup failed. Worker thread
+static std::string ws_resolver_lookup(const std::string &host) {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo *result = NULL;
+    if (getaddrinfo(host.c_str(), NULL, &hints, &result) != 0 || !result) return std::string();
+
+    const void *addr = NULL;
+    if (result->ai_family == AF_INET) {
+        addr = &((struct sockaddr_in *) result->ai_addr)->sin_addr;
+    } else if (result->ai_family == AF_INET6) {
+        addr = &((struct sockaddr_in6 *) result->ai_addr)->sin6_addr;
+    }
+
+    char text[INET6_ADDRSTRLEN] = "";
+    if (!addr || !inet_ntop(result->ai_family, addr, text, sizeof(text))) text[0] = '\0';
+    freeaddrinfo(result);
+    return text;
+}
+
+static void *ws_resolver_thread(void *data) {
+    ws_resolver_t *resolver = (ws_resolver_t *) data;
+    os_set_thread_name("ws-relay-resolver");
+
+    for (;;) {
+        os_sem_wait(resolver->sem);
+
+        pthread_mutex_lock(&resolver->lock);
+        if (resolver->detached) {
+            pthread_mutex_unlock(&resolver->lock);
+            break;
+        }
+        if (resolver->requests.empty()) {
+            pthread_mutex_unlock(&resolver->lock);
+            continue;
+        }
+        std::string host = std::move(resolver->requests.front());
+        resolver->requests.pop_front();
+        pthread_mutex_unlock(&resolver->lock);
+
+        std::string address = ws_resolver_lookup(host);
+
+        pthread_mutex_lock(&resolver->lock);
+        resolver->in_flight.erase(host);
+        if (!resolver->detached) {
+            resolver->results.push_back({std::move(host), std::move(address)});
+            os_atomic_store_bool(&resolver->result_ready, true);
+            lws_cancel_service(resolver->context);
+        }
+        pthread_mutex_unlock(&resolver->lock);
+    }
+
+    ws_resolver_release(resolver);
+    return NULL;
+}
+
+static ws_resolver_t *ws_resolver_attach(ws_relay_t *relay) {
+    ws_resolver_t *resolver = new ws_resolver_t();
+    resolver->context = relay->context;
+    resolver->refs = 2;
+    pthread_mutex_init(&resolver->lock, NULL);
+    os_sem_init(&resolver->sem, 0);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, ws_resolver_thread, resolver) != 0) {
+        obs_log(LOG_ERROR, "Failed to create resolver thread");
+        os_sem_destroy(resolver->sem);
+        pthread_mutex_destroy(&resolver->lock);
+        delete resolver;
+        return NULL;
+    }
+    // Nothing joins the worker: a lookup stuck in the system resolver must not block a relay
+    // stopped from the UI thread
+    pthread_detach(thread);
+
+    relay->resolver = resolver;
+    return resolver;
+}
+
+// Start looking up host in the background. Returns false if no worker could be started.
+// Called on the service thread with the mutex held
+bool ws_resolver_request(ws_relay_t *relay, const char *host) {
+    ws_resolver_t *resolver = relay->resolver ? relay->resolver : ws_resolver_attach(relay);
+    if (!resolver) return false;
+
+    pthread_mutex_lock(&resolver->lock);
+    if (resolver->in_flight.insert(host).second) {
+        resolver->requests.push_back(host);
+        os_sem_post(resolver->sem);
+    }
+    pthread_mutex_unlock(&resolver->lock);
+    return true;
+}
+
+// Whether lookups have completed since the last ws_resolver_flush. Service thread only, without
+// the mutex: only that thread attaches the resolver while the relay runs
+bool ws_resolver_result_ready(ws_relay_t *relay) {
+    return relay->resolver && os_atomic_load_bool(&relay->resolver->result_ready);
+}
+
+// Hand completed lookups to the connections waiting for them, which dial right away. Called on
+// the service thread with the mutex held
+void ws_resolver_flush(ws_relay_t *relay) {
+    ws_resolver_t *resolver = relay->resolver;
+    if (!resolver) return;
+
+    std::deque<ws_resolver_result_t> results;
+    pthread_mutex_lock(&resolver->lock);
+    results.swap(resolver->results);
+    os_atomic_store_bool(&resolver->result_ready, false);
+    pthread_mutex_unlock(&resolver->lock);
+
+    ws_connection_t *conns[] = {&relay->remote_conn, &relay->standby_conn, &relay->obs_conn};
+    for (const ws_resolver_result_t &result: results) {
+        for (ws_connection_t *conn: conns) {
+            if (!conn->resolving || strcmp(conn->address, result.host.c_str()) != 0) continue;
+            ws_connection_resolved(conn, result.address.empty() ? NULL : result.address.c_str());
+        }
+    }
+}
+
+// Stop the worker; a lookup still running finishes in the background. Called with the mutex held
+void ws_resolver_detach(ws_relay_t *relay) {
+    ws_resolver_t *resolver = relay->resolver;
+    if (!resolver) return;
+
+    relay->resolver = NULL;
+    pthread_mutex_lock(&resolver->lock);
+    resolver->detached = true;
+    resolver->context = NULL;
+    resolver->requests.clear();
+    resolver->results.clear();
+    pthread_mutex_unlock(&resolver->lock);
+    os_sem_post(resolver->sem);
+    ws_resolver_release(resolver);
+}
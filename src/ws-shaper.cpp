@@ -0,0 +1,117 @@
+/*
+OBS WebSocket Relay - Remote Uplink Shaping
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "ws-relay-internal.h"
+#include <obs-module.h>
+#include <obs-frontend-api.h>
+#include <plugin-support.h>
+#include <util/platform.h>
+#include <libwebsockets.h>
+#include <algorithm>
+
+// Current byte rate of the remote uplink, 0 if it is not shaped
+static double ws_shaper_rate(ws_relay_t *relay) {
+    if (relay->config.uplink_rate_kbps <= 0) return 0;
+
+    return relay->config.uplink_rate_kbps * 1024.0 * relay->shaper.factor;
+}
+
+static void ws_shaper_timer_cb(lws_sorted_usec_list_t *sul) {
+    ws_relay_t *relay = ((ws_relay_timer_t *) sul)->relay;
+
+    pthread_mutex_lock(&relay->mutex);
+    if (relay->remote_conn.wsi && !relay->remote_conn.buffers.empty()) {
+        lws_callback_on_writable(relay->remote_conn.wsi);
+    }
+    pthread_mutex_unlock(&relay->mutex);
+}
+
+void ws_shaper_init(ws_relay_t *relay) {
+    memset(&relay->shaper, 0, sizeof(relay->shaper));
+    relay->shaper.factor = 1.0;
+    relay->shaper.timer.relay = relay;
+}
+
+// Refill the token bucket; returns true if the uplink may send now. Otherwise a timer makes the
+// remote writeable again once the deficit is paid back. Called on the service thread with the
+// mutex held
+bool ws_shaper_ready(ws_relay_t *relay) {
+    double rate = ws_shaper_rate(relay);
+    if (rate <= 0) return true;
+
+    ws_shaper_state_t *shaper = &relay->shaper;
+    double burst = relay->config.uplink_burst_kb * 1024.0;
+    uint64_t now = os_gettime_ns();
+    shaper->tokens = std::min(shaper->tokens + rate * (double) (now - shaper->last_refill) / 1e9, burst);
+    shaper->last_refill = now;
+
+    // Like the multiplexing window, any credit lets a message through, so messages larger than
+    // the burst size cannot stall the uplink
+    if (shaper->tokens > 0) return true;
+
+    lws_usec_t wait = (lws_usec_t) (-shaper->tokens / rate * LWS_US_PER_SEC) + 1;
+    lws_sul_schedule(relay->context, 0, &shaper->timer.sul, ws_shaper_timer_cb, wait);
+    relay->stats.to_remote.shaper_delays++;
+    return false;
+}
+
+// Charge a message written to the remote against the bucket; called with the mutex held
+void ws_shaper_consume(ws_relay_t *relay, size_t size) {
+    if (ws_shaper_rate(relay) <= 0) return;
+
+    relay->shaper.tokens -= (double) size;
+}
+
+// Follow the congestion of OBS's stream output: halve the uplink rate while the stream drops
+// frames or its send buffer fills up, and recover it gradually once the stream is healthy.
+// Called from the service thread with the mutex held
+void ws_shaper_update(ws_relay_t *relay) {
+    ws_shaper_state_t *shaper = &relay->shaper;
+
+    if (!relay->config.uplink_adaptive || relay->config.uplink_rate_kbps <= 0) {
+        shaper->factor = 1.0;
+        relay->stats.to_remote.shaper_rate = (uint64_t) ws_shaper_rate(relay);
+        return;
+    }
+
+    uint64_t now = os_gettime_ns();
+    if (now - shaper->last_sample < WS_SHAPER_SAMPLE_INTERVAL_NS) return;
+    shaper->last_sample = now;
+
+    bool struggling = false;
+    obs_output_t *output = obs_frontend_get_streaming_output();
+    if (output) {
+        if (obs_output_active(output)) {
+            int dropped = obs_output_get_frames_dropped(output);
+            struggling = dropped > shaper->frames_dropped ||
+                         obs_output_get_congestion(output) > WS_SHAPER_CONGESTION_THRESHOLD;
+            shaper->frames_dropped = dropped;
+        } else {
+            shaper->frames_dropped = 0;
+        }
+        obs_output_release(output);
+    }
+
+    double factor = struggling ? std::max(shaper->factor / 2, WS_SHAPER_MIN_FACTOR)
+                               : std::min(shaper->factor + WS_SHAPER_RECOVERY_STEP, 1.0);
+    if (struggling && factor < shaper->factor) {
+        obs_log(LOG_INFO, "Stream output congested, limiting remote uplink to %d%%", (int) (factor * 100));
+    }
+    shaper->factor = factor;
+    relay->stats.to_remote.shaper_rate = (uint64_t) ws_shaper_rate(relay);
+}
@@ -0,0 +1,359 @@
+/*
+OBS WebSocket Relay - Outage Spill Log
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "ws-relay-internal.h"
+#include <obs-module.h>
+#include <plugin-support.h>
+#include <util/platform.h>
+#include <util/dstr.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// Records are appended to numbered segment files and replayed oldest first. A segment is
+// deleted once it has been replayed, expired or evicted by the size cap
+#define WS_SPILL_MAGIC 0x4C525357 // "WSRL"
+#define WS_SPILL_EXTENSION ".spill"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t len;
+    int64_t timestamp; // Seconds since the epoch
+} ws_spill_record_header_t;
+
+typedef struct {
+    uint32_t id;
+    uint64_t size; // Valid bytes in the file
+    uint64_t records; // Records not yet replayed
+    int64_t newest; // Timestamp of the newest record
+} ws_spill_segment_t;
+
+struct ws_spill {
+    char *dir;
+    std::deque<ws_spill_segment_t> segments;
+    uint32_t next_id;
+
+    FILE *writer; // Appends to segments.back()
+    FILE *reader; // Reads segments.front()
+    uint64_t read_offset;
+
+    uint64_t pending_bytes; // Bytes not yet replayed
+    uint64_t pending_records;
+    bool dirty; // Written since the last sync
+    uint64_t last_sync;
+
+    uint64_t spilled;
+    uint64_t replayed;
+    uint64_t dropped;
+};
+
+static char *ws_spill_segment_path(ws_spill_t *spill, uint32_t id) {
+    struct dstr path;
+    dstr_init(&path);
+    dstr_printf(&path, "%s/%08u" WS_SPILL_EXTENSION, spill->dir, id);
+    return path.array;
+}
+
+static void ws_spill_file_sync(FILE *file) {
+    fflush(file);
+#ifdef _WIN32
+    _commit(_fileno(file));
+#else
+    fsync(fileno(file));
+#endif
+}
+
+static void ws_spill_close_writer(ws_spill_t *spill) {
+    if (!spill->writer) return;
+
+    ws_spill_file_sync(spill->writer);
+    fclose(spill->writer);
+    spill->writer = NULL;
+    spill->dirty = false;
+}
+
+static void ws_spill_close_reader(ws_spill_t *spill) {
+    if (spill->reader) {
+        fclose(spill->reader);
+        spill->reader = NULL;
+    }
+    spill->read_offset = 0;
+}
+
+// Delete the oldest segment, counting whatever was not replayed as dropped
+static void ws_spill_drop_front(ws_spill_t *spill) {
+    ws_spill_segment_t &seg = spill->segments.front();
+
+    if (spill->segments.size() == 1) {
+        ws_spill_close_writer(spill);
+    }
+
+    spill->pending_bytes -= seg.size - spill->read_offset;
+    spill->pending_records -= seg.records;
+    spill->dropped += seg.records;
+    ws_spill_close_reader(spill);
+
+    char *path = ws_spill_segment_path(spill, seg.id);
+    os_unlink(path);
+    bfree(path);
+    spill->segments.pop_front();
+}
+
+// Walk the record headers of a segment left over from a previous session
+static bool ws_spill_scan_segment(ws_spill_t *spill, ws_spill_segment_t *seg) {
+    char *path = ws_spill_segment_path(spill, seg->id);
+    FILE *file = os_fopen(path, "rb");
+    bfree(path);
+    if (!file) return false;
+
+    // Stop at the first torn or corrupt record; a crash can only have cut off the tail
+    uint64_t file_size = (uint64_t) std::max<int64_t>(os_fgetsize(file), 0);
+    ws_spill_record_header_t header;
+    while (fread(&header, sizeof(header), 1, file) == 1 && header.magic == WS_SPILL_MAGIC &&
+           seg->size + sizeof(header) + header.len <= file_size &&
+           os_fseeki64(file, header.len, SEEK_CUR) == 0) {
+        seg->size += sizeof(header) + header.len;
+        seg->records++;
+        seg->newest = std::max(seg->newest, header.timestamp);
+    }
+
+    fclose(file);
+    return true;
+}
+
+ws_spill_t *ws_spill_create(const char *dir) {
+    if (!dir || os_mkdirs(dir) == MKDIR_ERROR) {
+        obs_log(LOG_ERROR, "Failed to create spill directory %s", dir ? dir : "(null)");
+        return NULL;
+    }
+
+    ws_spill_t *spill = new ws_spill_t();
+    spill->dir = bstrdup(dir);
+
+    // Pick up segments a previous session could not replay
+    std::vector<uint32_t> ids;
+    os_dir_t *handle = os_opendir(dir);
+    if (handle) {
+        struct os_dirent *ent;
+        while ((ent = os_readdir(handle)) != NULL) {
+            const char *ext = strstr(ent->d_name, WS_SPILL_EXTENSION);
+            if (ent->directory || !ext || strcmp(ext, WS_SPILL_EXTENSION) != 0) continue;
+            ids.push_back((uint32_t) strtoul(ent->d_name, NULL, 10));
+        }
+        os_closedir(handle);
+    }
+    std::sort(ids.begin(), ids.end());
+
+    for (uint32_t id: ids) {
+        ws_spill_segment_t seg = {id, 0, 0, 0};
+        spill->next_id = id + 1;
+
+        if (!ws_spill_scan_segment(spill, &seg) || !seg.records) {
+            char *path = ws_spill_segment_path(spill, id);
+            os_unlink(path);
+            bfree(path);
+            continue;
+        }
+
+        spill->segments.push_back(seg);
+        spill->pending_bytes += seg.size;
+        spill->pending_records += seg.records;
+    }
+
+    if (spill->pending_records) {
+        obs_log(LOG_INFO, "Spill log holds %llu events (%llu bytes) from a previous session",
+                (unsigned long long) spill->pending_records, (unsigned long long) spill->pending_bytes);
+    }
+    return spill;
+}
+
+void ws_spill_destroy(ws_spill_t *spill) {
+    if (!spill) return;
+
+    ws_spill_close_writer(spill);
+    ws_spill_close_reader(spill);
+    bfree(spill->dir);
+    delete spill;
+}
+
+bool ws_spill_empty(ws_spill_t *spill) {
+    return !spill || spill->pending_records == 0;
+}
+
+// Append one message; the oldest segments make room if the log would exceed max_bytes (0 for
+// no cap). Returns false if the message was dropped
+bool ws_spill_append(ws_spill_t *spill, const char *data, size_t len, uint64_t max_bytes) {
+    if (!spill || len > UINT32_MAX) return false;
+
+    uint64_t record_size = sizeof(ws_spill_record_header_t) + len;
+    while (max_bytes && spill->pending_bytes + record_size > max_bytes && spill->segments.size() > 1) {
+        ws_spill_drop_front(spill);
+    }
+    if (max_bytes && spill->pending_bytes + record_size > max_bytes) {
+        spill->dropped++;
+        return false;
+    }
+
+    // Start a new segment when there is none of ours to append to or it is full. Small caps get
+    // smaller segments, so the cap evicts a fraction of the log rather than all of it
+    uint64_t segment_size = max_bytes ? std::min<uint64_t>(WS_SPILL_SEGMENT_SIZE, max_bytes / 4) : WS_SPILL_SEGMENT_SIZE;
+    if (!spill->writer || spill->segments.back().size >= segment_size) {
+        ws_spill_close_writer(spill);
+
+        ws_spill_segment_t seg = {spill->next_id++, 0, 0, 0};
+        char *path = ws_spill_segment_path(spill, seg.id);
+        spill->writer = os_fopen(path, "wb");
+        bfree(path);
+        if (!spill->writer) {
+            obs_log(LOG_ERROR, "Failed to create spill segment in %s", spill->dir);
+            spill->dropped++;
+            return false;
+        }
+        spill->segments.push_back(seg);
+    }
+
+    ws_spill_record_header_t header = {WS_SPILL_MAGIC, (uint32_t) len, (int64_t) time(NULL)};
+    if (fwrite(&header, sizeof(header), 1, spill->writer) != 1 ||
+        (len && fwrite(data, len, 1, spill->writer) != 1)) {
+        // The tail of the segment is torn now, so never append to it again
+        obs_log(LOG_ERROR, "Failed to write to spill log");
+        fclose(spill->writer);
+        spill->writer = NULL;
+        spill->dropped++;
+        return false;
+    }
+
+    ws_spill_segment_t &seg = spill->segments.back();
+    seg.size += record_size;
+    seg.records++;
+    seg.newest = header.timestamp;
+    spill->pending_bytes += record_size;
+    spill->pending_records++;
+    spill->spilled++;
+    spill->dirty = true;
+    return true;
+}
+
+// Read the oldest record into record, skipping records older than ttl seconds (0 keeps them all).
+// Returns false once the log is empty
+bool ws_spill_read(ws_spill_t *spill, std::vector<char> &record, int ttl) {
+    if (!spill) return false;
+
+    int64_t oldest = ttl > 0 ? (int64_t) time(NULL) - ttl : INT64_MIN;
+
+    while (!spill->segments.empty()) {
+        ws_spill_segment_t &seg = spill->segments.front();
+        bool writing = spill->writer && spill->segments.size() == 1;
+
+        if (!seg.records) {
+            // Fully replayed; the next append starts a fresh segment
+            ws_spill_drop_front(spill);
+            continue;
+        }
+
+        if (writing) {
+            fflush(spill->writer);
+        }
+        if (!spill->reader) {
+            char *path = ws_spill_segment_path(spill, seg.id);
+            spill->reader = os_fopen(path, "rb");
+            bfree(path);
+            if (!spill->reader || os_fseeki64(spill->reader, (int64_t) spill->read_offset, SEEK_SET) != 0) {
+                obs_log(LOG_ERROR, "Failed to open spill segment %u", seg.id);
+                ws_spill_drop_front(spill);
+                continue;
+            }
+        }
+
+        if (writing) {
+            // The reader may have hit the end of the file before the latest appends
+            clearerr(spill->reader);
+        }
+
+        ws_spill_record_header_t header;
+        if (fread(&header, sizeof(header), 1, spill->reader) != 1 || header.magic != WS_SPILL_MAGIC ||
+            spill->read_offset + sizeof(header) + header.len > seg.size) {
+            obs_log(LOG_WARNING, "Spill segment %u is corrupt, dropping %llu events", seg.id,
+                    (unsigned long long) seg.records);
+            ws_spill_drop_front(spill);
+            continue;
+        }
+
+        record.resize(header.len);
+        if (header.len && fread(record.data(), header.len, 1, spill->reader) != 1) {
+            obs_log(LOG_WARNING, "Spill segment %u is truncated, dropping %llu events", seg.id,
+                    (unsigned long long) seg.records);
+            ws_spill_drop_front(spill);
+            continue;
+        }
+
+        uint64_t record_size = sizeof(header) + header.len;
+        spill->read_offset += record_size;
+        spill->pending_bytes -= record_size;
+        spill->pending_records--;
+        seg.records--;
+
+        if (header.timestamp < oldest) {
+            spill->dropped++;
+            continue;
+        }
+
+        spill->replayed++;
+        return true;
+    }
+
+    return false;
+}
+
+// Flush written records to disk at most once per sync interval, or right away if forced, and
+// delete segments whose records have all expired
+void ws_spill_maintain(ws_spill_t *spill, int ttl, bool force_sync) {
+    if (!spill) return;
+
+    uint64_t now = os_gettime_ns();
+    if (!force_sync && now - spill->last_sync < WS_SPILL_SYNC_INTERVAL_NS) return;
+    spill->last_sync = now;
+
+    if (spill->writer && spill->dirty) {
+        ws_spill_file_sync(spill->writer);
+        spill->dirty = false;
+    }
+
+    if (ttl > 0) {
+        int64_t oldest = (int64_t) time(NULL) - ttl;
+        while (!spill->segments.empty() && spill->segments.front().newest < oldest) {
+            ws_spill_drop_front(spill);
+        }
+    }
+}
+
+void ws_spill_get_stats(ws_spill_t *spill, ws_relay_direction_stats_t *stats) {
+    if (!spill) return;
+
+    stats->spilled_messages = spill->spilled;
+    stats->spill_replayed_messages = spill->replayed;
+    stats->spill_dropped_messages = spill->dropped;
+    stats->spill_queued_messages = spill->pending_records;
+    stats->spill_queued_bytes = spill->pending_bytes;
+}
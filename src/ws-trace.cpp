@@ -0,0 +1,198 @@
+/*
+OBS WebSocket Relay
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "ws-relay-internal.h"
+#include <obs-module.h>
+#include <plugin-support.h>
+#include <util/platform.h>
+#include <stdio.h>
+
+#if defined(WS_RELAY_TRACE)
+
+// Every thread that records a span gets a ring of its own, so recording never takes a lock.
+// The owning thread is the only writer; a dump reads the rings while they are written and
+// drops the slots that were overwritten under it
+typedef struct {
+    std::atomic<const char *> name;
+    std::atomic<uint64_t> start_ns;
+    std::atomic<uint64_t> end_ns;
+} ws_trace_span_t;
+
+typedef struct {
+    std::atomic<uint64_t> head; // Spans recorded so far; slot head % WS_TRACE_RING_SIZE is next
+    ws_trace_span_t spans[WS_TRACE_RING_SIZE];
+    uint32_t tid;
+    char thread_name[32]; // Guarded by ws_trace_lock
+} ws_trace_ring_t;
+
+// A span copied out of a ring for the dump
+typedef struct {
+    const char *name;
+    uint64_t start_ns;
+    uint64_t end_ns;
+} ws_trace_copy_t;
+
+static pthread_mutex_t ws_trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static ws_trace_ring_t *ws_trace_rings[WS_TRACE_MAX_THREADS];
+static std::atomic<uint32_t> ws_trace_ring_count{0};
+static std::atomic<bool> ws_trace_full_warned{false};
+static thread_local ws_trace_ring_t *ws_trace_local = NULL;
+static thread_local bool ws_trace_unavailable = false;
+
+// Rings are never freed, so the spans of threads that have exited are still dumped
+static ws_trace_ring_t *ws_trace_ring(void) {
+    if (ws_trace_local || ws_trace_unavailable) return ws_trace_local;
+
+    pthread_mutex_lock(&ws_trace_lock);
+    uint32_t count = ws_trace_ring_count.load(std::memory_order_relaxed);
+    if (count < WS_TRACE_MAX_THREADS) {
+        ws_trace_ring_t *ring = new ws_trace_ring_t();
+        ring->tid = count + 1;
+        snprintf(ring->thread_name, sizeof(ring->thread_name), "thread %u", ring->tid);
+        ws_trace_rings[count] = ring;
+        ws_trace_ring_count.store(count + 1, std::memory_order_release);
+        ws_trace_local = ring;
+    } else {
+        ws_trace_unavailable = true;
+    }
+    pthread_mutex_unlock(&ws_trace_lock);
+
+    if (ws_trace_unavailable && !ws_trace_full_warned.exchange(true)) {
+        obs_log(LOG_WARNING, "Trace rings exhausted, spans of further threads are not recorded");
+    }
+    return ws_trace_local;
+}
+
+void ws_trace_record(const char *name, uint64_t start_ns, uint64_t end_ns) {
+    ws_trace_ring_t *ring = ws_trace_ring();
+    if (!ring) return;
+
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    ws_trace_span_t *span = &ring->spans[head % WS_TRACE_RING_SIZE];
+    span->name.store(name, std::memory_order_relaxed);
+    span->start_ns.store(start_ns, std::memory_order_relaxed);
+    span->end_ns.store(end_ns, std::memory_order_relaxed);
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+void ws_trace_thread_name(const char *name) {
+    ws_trace_ring_t *ring = ws_trace_ring();
+    if (!ring) return;
+
+    pthread_mutex_lock(&ws_trace_lock);
+    snprintf(ring->thread_name, sizeof(ring->thread_name), "%s", name);
+    pthread_mutex_unlock(&ws_trace_lock);
+}
+
+// Span names are string literals from the relay, but quote them properly all the same
+static void ws_trace_write_string(FILE *file, const char *str) {
+    fputc('"', file);
+    for (const char *p = str; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            fputc('\\', file);
+        }
+        if ((unsigned char) *p >= 0x20) {
+            fputc(*p, file);
+        }
+    }
+    fputc('"', file);
+}
+
+bool ws_relay_trace_available(void) {
+    return true;
+}
+
+// Write the recorded spans as Chrome trace event JSON, which chrome://tracing and the Perfetto
+// UI both open. Timestamps are os_gettime_ns in microseconds
+bool ws_relay_trace_dump(const char *path) {
+    if (!path) return false;
+
+    FILE *file = os_fopen(path, "wb");
+    if (!file) {
+        obs_log(LOG_ERROR, "Failed to open trace file %s", path);
+        return false;
+    }
+
+    std::vector<ws_trace_copy_t> copy(WS_TRACE_RING_SIZE);
+    size_t written = 0;
+    bool first = true;
+
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", file);
+    uint32_t count = ws_trace_ring_count.load(std::memory_order_acquire);
+    for (uint32_t r = 0; r < count; r++) {
+        ws_trace_ring_t *ring = ws_trace_rings[r];
+
+        pthread_mutex_lock(&ws_trace_lock);
+        fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+                first ? "" : ",", ring->tid);
+        ws_trace_write_string(file, ring->thread_name);
+        fputs("}}", file);
+        pthread_mutex_unlock(&ws_trace_lock);
+        first = false;
+
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t begin = head > WS_TRACE_RING_SIZE ? head - WS_TRACE_RING_SIZE : 0;
+        for (uint64_t i = begin; i < head; i++) {
+            ws_trace_span_t *span = &ring->spans[i % WS_TRACE_RING_SIZE];
+            ws_trace_copy_t *dst = &copy[i - begin];
+            dst->name = span->name.load(std::memory_order_relaxed);
+            dst->start_ns = span->start_ns.load(std::memory_order_relaxed);
+            dst->end_ns = span->end_ns.load(std::memory_order_relaxed);
+        }
+
+        // Slots the owner has started to reuse while they were copied are torn
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t after = ring->head.load(std::memory_order_relaxed);
+        uint64_t valid = after >= WS_TRACE_RING_SIZE ? after - WS_TRACE_RING_SIZE + 1 : 0;
+        for (uint64_t i = begin > valid ? begin : valid; i < head; i++) {
+            const ws_trace_copy_t *span = &copy[i - begin];
+            fputs(",\n{\"name\":", file);
+            ws_trace_write_string(file, span->name);
+            fprintf(file, ",\"cat\":\"relay\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", ring->tid,
+                    (double) span->start_ns / 1000.0, (double) (span->end_ns - span->start_ns) / 1000.0);
+            written++;
+        }
+    }
+    fputs("\n]}\n", file);
+
+    bool ok = !ferror(file);
+    if (fclose(file) != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        obs_log(LOG_ERROR, "Failed to write trace file %s", path);
+        return false;
+    }
+
+    obs_log(LOG_INFO, "Wrote %zu trace spans of %u threads to %s", written, count, path);
+    return true;
+}
+
+#else
+
+bool ws_relay_trace_available(void) {
+    return false;
+}
+
+bool ws_relay_trace_dump(const char *path) {
+    UNUSED_PARAMETER(path);
+    obs_log(LOG_WARNING, "Tracing is not compiled in, build with ENABLE_RELAY_TRACE");
+    return false;
+}
+
+#endif
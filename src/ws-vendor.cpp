@@ -0,0 +1,409 @@
+/*
+OBS WebSocket Relay
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "ws-relay-internal.h"
+#include <obs-module.h>
+#include <plugin-support.h>
+#include <callback/calldata.h>
+#include <callback/proc.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <string.h>
+#include <string>
+
+// The relay registers an obs-websocket vendor named after the plugin, so any obs-websocket
+// client, the remote included, can query and steer the relay with CallVendorRequest. Like the
+// in-process session this goes through obs-websocket's plugin API procedures directly, which is
+// what obs_websocket_register_vendor and friends in obs-websocket-api.h wrap
+
+typedef void (*ws_vendor_handler_t)(obs_data_t *request_data, obs_data_t *response_data, void *priv);
+
+// Layout obs-websocket expects behind the "callback" argument of vendor_request_register
+typedef struct {
+    ws_vendor_handler_t callback;
+    void *priv_data;
+} ws_vendor_callback_t;
+
+typedef struct {
+    const char *type;
+    ws_vendor_callback_t callback;
+} ws_vendor_request_t;
+
+// Requests are answered on obs-websocket's threads. The lock only keeps the relay from going
+// away under a request: statistics come from the lock-free snapshot, and only requests that
+// change the relay take its mutex. The lock nests outside the relay mutex
+static pthread_mutex_t ws_vendor_lock = PTHREAD_MUTEX_INITIALIZER;
+static ws_relay_t *ws_vendor_relay = NULL;
+
+// Registration state, only touched from obs_module_post_load, the exit event and unload on the UI thread
+static proc_handler_t *ws_vendor_ph = NULL; // NULL unless the requests are registered
+static void *ws_vendor = NULL;
+
+// Scalar counters of ws_relay_direction_stats_t, by their names in GetRelayStats
+typedef struct {
+    const char *name;
+    size_t offset;
+    bool is_signed;
+} ws_vendor_counter_t;
+
+#define WS_COUNTER(name, field) {name, offsetof(ws_relay_direction_stats_t, field), false}
+
+static const ws_vendor_counter_t ws_vendor_counters[] = {
+    WS_COUNTER("messages", messages),
+    WS_COUNTER("bytes", bytes),
+    WS_COUNTER("fastPathMessages", fast_path_messages),
+    WS_COUNTER("writeCalls", write_calls),
+    WS_COUNTER("writeNs", write_ns),
+    WS_COUNTER("droppedMessages", dropped_messages),
+    WS_COUNTER("droppedBytes", dropped_bytes),
+    WS_COUNTER("oversizedMessages", oversized_messages),
+    WS_COUNTER("budgetDisconnects", budget_disconnects),
+    WS_COUNTER("queuedMessages", queued_messages),
+    WS_COUNTER("queuedBytes", queued_bytes),
+    WS_COUNTER("pingsSent", pings_sent),
+    WS_COUNTER("pongsReceived", pongs_received),
+    WS_COUNTER("pingTimeouts", ping_timeouts),
+    WS_COUNTER("rttLastUs", rtt_last_us),
+    WS_COUNTER("rttSmoothedUs", rtt_smoothed_us),
+    WS_COUNTER("spilledMessages", spilled_messages),
+    WS_COUNTER("spillReplayedMessages", spill_replayed_messages),
+    WS_COUNTER("spillDroppedMessages", spill_dropped_messages),
+    WS_COUNTER("spillQueuedMessages", spill_queued_messages),
+    WS_COUNTER("spillQueuedBytes", spill_queued_bytes),
+    WS_COUNTER("shaperDelays", shaper_delays),
+    WS_COUNTER("shaperRate", shaper_rate),
+    WS_COUNTER("rxBufferSize", rx_buffer_size),
+    WS_COUNTER("admissionInflightCost", admission_inflight_cost),
+    WS_COUNTER("admissionWaiting", admission_waiting),
+    WS_COUNTER("admissionQueued", admission_queued),
+    WS_COUNTER("admissionRejected", admission_rejected),
+    WS_COUNTER("admissionWaitLastUs", admission_wait_last_us),
+    WS_COUNTER("admissionWaitMaxUs", admission_wait_max_us),
+    WS_COUNTER("mirrorLive", mirror_live),
+    WS_COUNTER("mirrorEvents", mirror_events),
+    WS_COUNTER("mirrorRefreshes", mirror_refreshes),
+    WS_COUNTER("mirrorSnapshots", mirror_snapshots),
+    WS_COUNTER("mirrorSnapshotBytes", mirror_snapshot_bytes),
+    WS_COUNTER("clockExchanges", clock_exchanges),
+    {"clockOffsetUs", offsetof(ws_relay_direction_stats_t, clock_offset_us), true},
+    WS_COUNTER("clockDelayUs", clock_delay_us),
+    WS_COUNTER("oneWayMessages", one_way_messages),
+    WS_COUNTER("oneWayLastUs", one_way_last_us),
+    WS_COUNTER("oneWayMaxUs", one_way_max_us),
+    WS_COUNTER("hubPeers", hub_peers),
+    WS_COUNTER("hubMessages", hub_messages),
+    WS_COUNTER("hubBytes", hub_bytes),
+};
+
+#undef WS_COUNTER
+
+// Histograms of ws_relay_direction_stats_t, reported as arrays of bucket counts
+typedef struct {
+    const char *name;
+    size_t offset;
+    size_t buckets;
+} ws_vendor_histogram_t;
+
+static const ws_vendor_histogram_t ws_vendor_histograms[] = {
+    {"rttHistogram", offsetof(ws_relay_direction_stats_t, rtt_histogram), WS_RTT_HISTOGRAM_BUCKETS},
+    {"sizeHistogram", offsetof(ws_relay_direction_stats_t, size_histogram), WS_SIZE_HISTOGRAM_BUCKETS},
+    {"callbackHistogram", offsetof(ws_relay_direction_stats_t, callback_histogram), WS_CALLBACK_HISTOGRAM_BUCKETS},
+    {"admissionWaitHistogram", offsetof(ws_relay_direction_stats_t, admission_wait_histogram),
+     WS_RTT_HISTOGRAM_BUCKETS},
+    {"oneWayHistogram", offsetof(ws_relay_direction_stats_t, one_way_histogram), WS_RTT_HISTOGRAM_BUCKETS},
+};
+
+static const char *ws_vendor_state_name(ws_connection_state_t state) {
+    switch (state) {
+    case WS_STATE_CONNECTING:
+        return "connecting";
+    case WS_STATE_CONNECTED:
+        return "connected";
+    case WS_STATE_ERROR:
+        return "error";
+    default:
+        return "disconnected";
+    }
+}
+
+static void ws_vendor_error(obs_data_t *response_data, const char *error) {
+    obs_data_set_string(response_data, "error", error);
+}
+
+// Copy the statistics snapshot, failing the request if there is none. Called with ws_vendor_lock held
+static bool ws_vendor_read_stats(obs_data_t *response_data, ws_stats_snapshot_t *snapshot) {
+    if (!ws_vendor_relay) {
+        ws_vendor_error(response_data, "The relay is not available");
+        return false;
+    }
+    if (!ws_relay_read_stats(ws_vendor_relay, snapshot)) {
+        ws_vendor_error(response_data, "The relay has not published statistics yet");
+        return false;
+    }
+
+    obs_data_set_int(response_data, "snapshotAgeMs", (long long) ((os_gettime_ns() - snapshot->published_ns) / 1000000));
+    return true;
+}
+
+// Histograms have no obs_data form, so the direction is written as JSON and parsed back. obs_data
+// arrays only hold objects, so each bucket is one with its count
+static obs_data_t *ws_vendor_direction_stats(const ws_relay_direction_stats_t *stats) {
+    const char *base = (const char *) stats;
+    std::string json = "{";
+
+    for (const ws_vendor_counter_t &counter: ws_vendor_counters) {
+        char value[32];
+        if (counter.is_signed) {
+            snprintf(value, sizeof(value), "%" PRId64, *(const int64_t *) (base + counter.offset));
+        } else {
+            snprintf(value, sizeof(value), "%" PRIu64, *(const uint64_t *) (base + counter.offset));
+        }
+        json += std::string(json.size() > 1 ? "," : "") + "\"" + counter.name + "\":" + value;
+    }
+
+    for (const ws_vendor_histogram_t &histogram: ws_vendor_histograms) {
+        const uint64_t *buckets = (const uint64_t *) (base + histogram.offset);
+        json += std::string(",\"") + histogram.name + "\":[";
+        for (size_t i = 0; i < histogram.buckets; i++) {
+            json += std::string(i ? "," : "") + "{\"count\":" + std::to_string(buckets[i]) + "}";
+        }
+        json += "]";
+    }
+    json += "}";
+
+    return obs_data_create_from_json(json.c_str());
+}
+
+// GetRelayStats: every counter of both directions and the connection states
+static void ws_vendor_get_stats(obs_data_t *request_data, obs_data_t *response_data, void *priv) {
+    UNUSED_PARAMETER(request_data);
+    UNUSED_PARAMETER(priv);
+
+    pthread_mutex_lock(&ws_vendor_lock);
+    ws_stats_snapshot_t snapshot;
+    ws_relay_status_t status;
+    if (ws_vendor_read_stats(response_data, &snapshot) && ws_relay_get_status(ws_vendor_relay, &status)) {
+        obs_data_set_string(response_data, "obsState", ws_vendor_state_name(status.obs_state));
+        obs_data_set_string(response_data, "remoteState", ws_vendor_state_name(status.remote_state));
+
+        obs_data_t *to_remote = ws_vendor_direction_stats(&snapshot.stats.to_remote);
+        obs_data_t *to_obs = ws_vendor_direction_stats(&snapshot.stats.to_obs);
+        obs_data_set_obj(response_data, "toRemote", to_remote);
+        obs_data_set_obj(response_data, "toObs", to_obs);
+        obs_data_release(to_remote);
+        obs_data_release(to_obs);
+    }
+    pthread_mutex_unlock(&ws_vendor_lock);
+}
+
+// GetRelayQueueDepth: the backpressure figures a controller paces itself by
+static void ws_vendor_get_queue_depth(obs_data_t *request_data, obs_data_t *response_data, void *priv) {
+    UNUSED_PARAMETER(request_data);
+    UNUSED_PARAMETER(priv);
+
+    pthread_mutex_lock(&ws_vendor_lock);
+    ws_stats_snapshot_t snapshot;
+    if (ws_vendor_read_stats(response_data, &snapshot)) {
+        const ws_relay_direction_stats_t *remote = &snapshot.stats.to_remote;
+        const ws_relay_direction_stats_t *obs = &snapshot.stats.to_obs;
+
+        obs_data_t *to_remote = obs_data_create();
+        obs_data_set_int(to_remote, "queuedMessages", (long long) remote->queued_messages);
+        obs_data_set_int(to_remote, "queuedBytes", (long long) remote->queued_bytes);
+        obs_data_set_int(to_remote, "spillQueuedMessages", (long long) remote->spill_queued_messages);
+        obs_data_set_int(to_remote, "spillQueuedBytes", (long long) remote->spill_queued_bytes);
+        obs_data_set_int(to_remote, "shaperRate", (long long) remote->shaper_rate);
+        obs_data_set_int(to_remote, "rttSmoothedUs", (long long) remote->rtt_smoothed_us);
+
+        obs_data_t *to_obs = obs_data_create();
+        obs_data_set_int(to_obs, "queuedMessages", (long long) obs->queued_messages);
+        obs_data_set_int(to_obs, "queuedBytes", (long long) obs->queued_bytes);
+        obs_data_set_int(to_obs, "admissionWaiting", (long long) obs->admission_waiting);
+        obs_data_set_int(to_obs, "admissionInflightCost", (long long) obs->admission_inflight_cost);
+
+        obs_data_set_obj(response_data, "toRemote", to_remote);
+        obs_data_set_obj(response_data, "toObs", to_obs);
+        obs_data_release(to_remote);
+        obs_data_release(to_obs);
+    }
+    pthread_mutex_unlock(&ws_vendor_lock);
+}
+
+// FlushRelayQueues: drop the events queued in "direction" ("toRemote", "toObs" or "both", the
+// default). Requests and responses stay queued, as their senders wait for them
+static void ws_vendor_flush_queues(obs_data_t *request_data, obs_data_t *response_data, void *priv) {
+    UNUSED_PARAMETER(priv);
+
+    const char *direction = obs_data_get_string(request_data, "direction");
+    bool both = !*direction || strcmp(direction, "both") == 0;
+    bool to_remote = both || strcmp(direction, "toRemote") == 0;
+    bool to_obs = both || strcmp(direction, "toObs") == 0;
+    if (!to_remote && !to_obs) {
+        ws_vendor_error(response_data, "direction must be toRemote, toObs or both");
+        return;
+    }
+
+    pthread_mutex_lock(&ws_vendor_lock);
+    ws_relay_t *relay = ws_vendor_relay;
+    if (relay) {
+        ws_relay_lock(relay);
+        size_t dropped = 0;
+        if (to_remote) dropped += ws_connection_flush_events(&relay->remote_conn);
+        if (to_obs) dropped += ws_connection_flush_events(&relay->obs_conn);
+        pthread_mutex_unlock(&relay->mutex);
+
+        obs_log(LOG_INFO, "Flushed %zu queued events on request", dropped);
+        obs_data_set_int(response_data, "droppedMessages", (long long) dropped);
+    } else {
+        ws_vendor_error(response_data, "The relay is not available");
+    }
+    pthread_mutex_unlock(&ws_vendor_lock);
+}
+
+// SetRelayLogLevel: switch verbose logging with "logLevel" set to "verbose" or "normal" until the
+// settings are next applied. Without logLevel only the current level is returned
+static void ws_vendor_set_log_level(obs_data_t *request_data, obs_data_t *response_data, void *priv) {
+    UNUSED_PARAMETER(priv);
+
+    const char *level = obs_data_get_string(request_data, "logLevel");
+    bool verbose = strcmp(level, "verbose") == 0;
+    if (*level && !verbose && strcmp(level, "normal") != 0) {
+        ws_vendor_error(response_data, "logLevel must be verbose or normal");
+        return;
+    }
+
+    pthread_mutex_lock(&ws_vendor_lock);
+    ws_relay_t *relay = ws_vendor_relay;
+    if (relay) {
+        ws_relay_lock(relay);
+        if (*level && relay->config.enable_logging != verbose) {
+            relay->config.enable_logging = verbose;
+            if (relay->config_pending) relay->pending_config.enable_logging = verbose;
+            obs_log(LOG_INFO, "Verbose logging %s on request", verbose ? "enabled" : "disabled");
+        }
+        verbose = relay->config.enable_logging;
+        pthread_mutex_unlock(&relay->mutex);
+
+        obs_data_set_string(response_data, "logLevel", verbose ? "verbose" : "normal");
+    } else {
+        ws_vendor_error(response_data, "The relay is not available");
+    }
+    pthread_mutex_unlock(&ws_vendor_lock);
+}
+
+// GetStateSnapshot for clients of OBS itself; the relay answers its remote's requests from the
+// mirror before they reach OBS
+static void ws_vendor_get_snapshot(obs_data_t *request_data, obs_data_t *response_data, void *priv) {
+    UNUSED_PARAMETER(request_data);
+    UNUSED_PARAMETER(priv);
+
+    pthread_mutex_lock(&ws_vendor_lock);
+    char *json = NULL;
+    if (ws_vendor_relay) {
+        ws_relay_lock(ws_vendor_relay);
+        json = ws_mirror_get_snapshot(ws_vendor_relay);
+        pthread_mutex_unlock(&ws_vendor_relay->mutex);
+    }
+    pthread_mutex_unlock(&ws_vendor_lock);
+
+    obs_data_t *snapshot = json ? obs_data_create_from_json(json) : NULL;
+    if (snapshot) {
+        obs_data_apply(response_data, snapshot);
+        obs_data_release(snapshot);
+    } else {
+        ws_vendor_error(response_data, "The OBS state mirror is not enabled or is being refreshed, try again shortly");
+    }
+    bfree(json);
+}
+
+static ws_vendor_request_t ws_vendor_requests[] = {
+    {"GetRelayStats", {ws_vendor_get_stats, NULL}},
+    {"GetRelayQueueDepth", {ws_vendor_get_queue_depth, NULL}},
+    {"FlushRelayQueues", {ws_vendor_flush_queues, NULL}},
+    {"SetRelayLogLevel", {ws_vendor_set_log_level, NULL}},
+    {"GetStateSnapshot", {ws_vendor_get_snapshot, NULL}},
+};
+
+// Attach the relay the requests act on, or detach it with NULL. Called from the init thread
+// once the relay exists, so registration does not have to wait for it
+void ws_relay_set_vendor_relay(ws_relay_t *relay) {
+    pthread_mutex_lock(&ws_vendor_lock);
+    ws_vendor_relay = relay;
+    pthread_mutex_unlock(&ws_vendor_lock);
+}
+
+// Register the vendor and its requests once obs-websocket is loaded, from obs_module_post_load.
+// Until a relay is attached the requests report it unavailable
+void ws_relay_register_vendor(void) {
+    // obs-websocket holds its vendor lock while a request runs, so its procedures are called
+    // without ws_vendor_lock
+    if (ws_vendor_ph) return;
+
+    proc_handler_t *ph = ws_obs_api_get_ph();
+    if (!ph) {
+        obs_log(LOG_INFO, "obs-websocket is not loaded, relay vendor requests are unavailable");
+        return;
+    }
+
+    calldata_t vendor_cd = {0};
+    calldata_set_string(&vendor_cd, "name", PLUGIN_NAME);
+    proc_handler_call(ph, "vendor_register", &vendor_cd);
+    ws_vendor = calldata_ptr(&vendor_cd, "vendor");
+    calldata_free(&vendor_cd);
+    if (!ws_vendor) {
+        obs_log(LOG_WARNING, "Failed to register the %s obs-websocket vendor", PLUGIN_NAME);
+        return;
+    }
+
+    size_t registered = 0;
+    for (ws_vendor_request_t &request: ws_vendor_requests) {
+        calldata_t cd = {0};
+        calldata_set_ptr(&cd, "vendor", ws_vendor);
+        calldata_set_string(&cd, "type", request.type);
+        calldata_set_ptr(&cd, "callback", &request.callback);
+        if (proc_handler_call(ph, "vendor_request_register", &cd) && calldata_bool(&cd, "success")) {
+            registered++;
+        } else {
+            obs_log(LOG_WARNING, "Failed to register vendor request %s", request.type);
+        }
+        calldata_free(&cd);
+    }
+    ws_vendor_ph = ph;
+
+    obs_log(LOG_INFO, "Registered %zu vendor requests as obs-websocket vendor %s", registered, PLUGIN_NAME);
+}
+
+// Detach the relay from the requests and unregister them. Must run while obs-websocket is still
+// loaded; later calls only detach the relay. Requests already running finish first
+void ws_relay_unregister_vendor(void) {
+    ws_relay_set_vendor_relay(NULL);
+
+    proc_handler_t *ph = ws_vendor_ph;
+    ws_vendor_ph = NULL;
+    if (!ph) return;
+
+    for (const ws_vendor_request_t &request: ws_vendor_requests) {
+        calldata_t cd = {0};
+        calldata_set_ptr(&cd, "vendor", ws_vendor);
+        calldata_set_string(&cd, "type", request.type);
+        proc_handler_call(ph, "vendor_request_unregister", &cd);
+        calldata_free(&cd);
+    }
+}
@@ -0,0 +1,125 @@
+/*
+OBS WebSocket Relay - Write Coalescing Benchmark
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+// The remote write path with write coalescing off (every message its own lws_write) against the
+// default 16 KiB batches, for bursts of events queued while the remote was not writeable. Runs
+// against the lws mock, which masks each text frame in place and draws its mask from
+// lws_get_random as lws does, so the counts are the calls lws would make: on ws:// each write is
+// one send(), and on Unix each lws_get_random is one read() of /dev/urandom. The time covers one
+// WRITEABLE callback, relay and mock work only. Usage:
+// bench-coalesce [milliseconds per measurement]
+
+#include "ws-relay-internal.h"
+#include "mock-lws.h"
+#include "test-support.h"
+#include <obs-module.h>
+#include <util/platform.h>
+#include <vector>
+#include <sys/resource.h>
+
+typedef struct {
+    const char *label;
+    size_t size;
+    size_t burst; // Messages queued per WRITEABLE callback
+} bench_case_t;
+
+static const bench_case_t cases[] = {
+    {"events", 300, 32},
+    {"volume meters", 1500, 8},
+    {"scene list", 64 * 1024, 4},
+    {"screenshot", 2 * 1024 * 1024, 1},
+};
+
+static double cpu_seconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (double) (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+           (double) (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static void bench_case(int coalesce_kb, const bench_case_t &test, uint64_t duration_ns) {
+    ws_relay_config_t config;
+    ws_relay_config_init(&config);
+    config.write_coalesce_kb = coalesce_kb;
+    config.max_queued_kb = 0;
+    config.ping_interval = 0;
+    ws_relay_t *relay = ws_relay_create(&config);
+    ws_relay_config_free(&config);
+
+    struct lws *obs = mock_lws_create();
+    struct lws *remote = mock_lws_create();
+    relay->obs_conn.wsi = obs;
+    relay->remote_conn.wsi = remote;
+    relay->obs_conn.state = WS_STATE_CONNECTING;
+    relay->remote_conn.state = WS_STATE_CONNECTING;
+    lws_set_opaque_user_data(obs, &relay->obs_conn);
+    lws_set_opaque_user_data(remote, &relay->remote_conn);
+    ws_callback_obs(obs, LWS_CALLBACK_CLIENT_ESTABLISHED, NULL, NULL, 0);
+    ws_callback_remote(remote, LWS_CALLBACK_CLIENT_ESTABLISHED, NULL, NULL, 0);
+    mock_lws_set_recording(remote, false);
+
+    std::vector<unsigned char> buffer(LWS_PRE + test.size, 'x');
+    uint64_t messages = 0;
+    uint64_t write_ns = 0;
+    double cpu = 0;
+    mock_lws_stats_t total = {};
+    uint64_t start = os_gettime_ns();
+    while (os_gettime_ns() - start < duration_ns) {
+        mock_lws_set_choked(remote, true);
+        for (size_t i = 0; i < test.burst; i++) {
+            mock_lws_set_fragment(obs, true, true, 0);
+            ws_callback_obs(obs, LWS_CALLBACK_CLIENT_RECEIVE, NULL, buffer.data() + LWS_PRE, test.size);
+        }
+        mock_lws_set_choked(remote, false);
+        mock_lws_take_stats();
+
+        double cpu_start = cpu_seconds();
+        uint64_t writeable = os_gettime_ns();
+        ws_callback_remote(remote, LWS_CALLBACK_CLIENT_WRITEABLE, NULL, NULL, 0);
+        write_ns += os_gettime_ns() - writeable;
+        cpu += cpu_seconds() - cpu_start;
+
+        mock_lws_stats_t stats = mock_lws_take_stats();
+        total.writes += stats.writes;
+        total.random_calls += stats.random_calls;
+        messages += test.burst;
+    }
+
+    double mib = (double) messages * test.size / (1024.0 * 1024.0);
+    printf("coalesce %3d KiB  %-14s %8zu x %-3zu %6.3f writes/msg %6.3f random/msg %9.0f ns/msg %7.2f ms CPU/MiB\n",
+           coalesce_kb, test.label, test.size, test.burst, (double) total.writes / (double) messages,
+           (double) total.random_calls / (double) messages, (double) write_ns / (double) messages,
+           cpu * 1000.0 / mib);
+
+    ws_callback_obs(obs, LWS_CALLBACK_CLIENT_CLOSED, NULL, NULL, 0);
+    ws_callback_remote(remote, LWS_CALLBACK_CLIENT_CLOSED, NULL, NULL, 0);
+    mock_lws_destroy(obs);
+    mock_lws_destroy(remote);
+    ws_relay_destroy(relay);
+}
+
+int main(int argc, char **argv) {
+    uint64_t duration_ns = (uint64_t) (argc > 1 ? atoi(argv[1]) : 1000) * 1000000;
+    ws_test_set_log_level(LOG_ERROR - 1);
+
+    for (const bench_case_t &test: cases) {
+        bench_case(0, test, duration_ns);
+        bench_case(16, test, duration_ns);
+    }
+    return 0;
+}
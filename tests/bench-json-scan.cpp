@@ -0,0 +1,249 @@
+/*
+OBS WebSocket Relay - Message Scanner Benchmark
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+// Throughput of every scanner variant the CPU runs, and of the byte at a time scanner they
+// replaced, on the message shapes the relay sees most: small requests, volume meter events and
+// screenshot responses. Build with optimizations and without a sanitizer; usage:
+// bench-json-scan [milliseconds per measurement]
+
+#include "ws-relay-internal.h"
+#include "test-support.h"
+#include <util/platform.h>
+#include <string>
+#include <vector>
+
+static inline bool legacy_key_equals(const char *key, size_t key_len, const char *name) {
+    size_t name_len = strlen(name);
+    return key_len == name_len && memcmp(key, name, name_len) == 0;
+}
+
+static inline size_t legacy_skip_whitespace(const char *data, size_t len, size_t i) {
+    while (i < len && (data[i] == ' ' || data[i] == '\t' || data[i] == '\n' || data[i] == '\r')) i++;
+    return i;
+}
+
+static size_t legacy_find_string_end(const char *data, size_t len, size_t i) {
+    while (i < len) {
+        const char *quote = (const char *) memchr(data + i, '"', len - i);
+        if (!quote) return len;
+
+        size_t end = quote - data;
+        size_t backslashes = 0;
+        while (end - backslashes > i && data[end - backslashes - 1] == '\\') backslashes++;
+        if (backslashes % 2 == 0) return end;
+        i = end + 1;
+    }
+    return len;
+}
+
+// ws_json_scan before it was vectorized: a byte at a time walk between strings, memchr within
+// them. It did not locate "d.requestData"
+static bool legacy_json_scan(const char *data, size_t len, ws_json_fields_t *fields) {
+    memset(fields, 0, sizeof(*fields));
+    fields->op = -1;
+
+    uint64_t object_bits = 0;
+    int depth = 0;
+    bool expect_key = false;
+    bool pending_d = false;
+    bool in_d = false;
+
+    size_t i = legacy_skip_whitespace(data, len, 0);
+    if (i >= len || data[i] != '{') return false;
+
+    while (i < len) {
+        char c = data[i];
+
+        if (c == '"') {
+            size_t start = i + 1;
+            size_t end = legacy_find_string_end(data, len, start);
+            if (end >= len) return false;
+
+            bool top_key = expect_key && depth == 1;
+            bool d_key = expect_key && depth == 2 && in_d;
+            if (!top_key && !d_key) {
+                i = end + 1;
+                expect_key = false;
+                continue;
+            }
+
+            const char *key = data + start;
+            size_t key_len = end - start;
+            size_t value = legacy_skip_whitespace(data, len, end + 1);
+            if (value >= len || data[value] != ':') return false;
+            value = legacy_skip_whitespace(data, len, value + 1);
+            if (value >= len) return false;
+
+            if (top_key && legacy_key_equals(key, key_len, "op")) {
+                int op = 0;
+                bool digits = false;
+                while (value < len && data[value] >= '0' && data[value] <= '9' && op < 1000) {
+                    op = op * 10 + (data[value] - '0');
+                    digits = true;
+                    value++;
+                }
+                if (digits) fields->op = op;
+            } else if (top_key && legacy_key_equals(key, key_len, "d")) {
+                pending_d = data[value] == '{';
+            } else if (d_key && data[value] == '"') {
+                const char **target = NULL;
+                size_t *target_len = NULL;
+                if (legacy_key_equals(key, key_len, "eventType")) {
+                    target = &fields->event_type;
+                    target_len = &fields->event_type_len;
+                } else if (legacy_key_equals(key, key_len, "requestId")) {
+                    target = &fields->request_id;
+                    target_len = &fields->request_id_len;
+                } else if (legacy_key_equals(key, key_len, "requestType")) {
+                    target = &fields->request_type;
+                    target_len = &fields->request_type_len;
+                }
+
+                if (target) {
+                    size_t value_end = legacy_find_string_end(data, len, value + 1);
+                    if (value_end >= len) return false;
+                    *target = data + value + 1;
+                    *target_len = value_end - value - 1;
+                    i = value_end + 1;
+                    expect_key = false;
+                    continue;
+                }
+            }
+
+            i = value;
+            expect_key = false;
+            continue;
+        }
+
+        switch (c) {
+            case '{':
+                if (depth < 64) object_bits |= (uint64_t) 1 << depth;
+                depth++;
+                expect_key = true;
+                if (depth == 2 && pending_d) in_d = true;
+                pending_d = false;
+                break;
+            case '[':
+                if (depth < 64) object_bits &= ~((uint64_t) 1 << depth);
+                depth++;
+                expect_key = false;
+                pending_d = false;
+                break;
+            case '}':
+            case ']':
+                if (depth == 2) in_d = false;
+                depth--;
+                if (depth == 0) return true;
+                expect_key = false;
+                break;
+            case ',':
+                expect_key = depth > 0 && depth <= 64 && (object_bits & ((uint64_t) 1 << (depth - 1)));
+                break;
+            default:
+                break;
+        }
+        i++;
+    }
+
+    return false;
+}
+
+typedef struct {
+    const char *name;
+    std::string data;
+} bench_message_t;
+
+static std::vector<bench_message_t> bench_messages() {
+    std::vector<bench_message_t> messages;
+
+    messages.push_back({"request", "{\"op\":6,\"d\":{\"requestType\":\"SetInputSettings\",\"requestId\":\"1f3a\","
+                                   "\"requestData\":{\"inputName\":\"Text\",\"inputSettings\":{\"text\":\"Hello\"}}}}"});
+
+    // Volume meters for 8 inputs, as obs-websocket sends them every 50 ms
+    std::string meters = "{\"op\":5,\"d\":{\"eventType\":\"InputVolumeMeters\",\"eventIntent\":65536,"
+                         "\"eventData\":{\"inputs\":[";
+    for (int input = 0; input < 8; input++) {
+        if (input) meters += ",";
+        meters += "{\"inputName\":\"Input " + std::to_string(input) + "\",\"inputUuid\":"
+                  "\"7d2b0c4e-1f7a-4c36-9a9e-3b1f0d5e8c2" + std::to_string(input) + "\",\"inputLevelsMul\":"
+                  "[[0.0123456789,0.0234567891,0.0345678912],[0.0123456789,0.0234567891,0.0345678912]]}";
+    }
+    meters += "]}}}";
+    messages.push_back({"volume meters", meters});
+
+    // A 1080p screenshot response: about 2 MiB of base64 in one string
+    std::string image(2 * 1024 * 1024, 'A');
+    for (size_t i = 0; i < image.size(); i++) {
+        image[i] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"[(i * 7919) % 64];
+    }
+    messages.push_back({"screenshot", "{\"op\":7,\"d\":{\"requestType\":\"GetSourceScreenshot\",\"requestId\":\"9\","
+                                      "\"requestStatus\":{\"result\":true,\"code\":100},\"responseData\":"
+                                      "{\"imageData\":\"data:image/png;base64," +
+                                          image + "\"}}}"});
+    return messages;
+}
+
+static volatile size_t bench_sink;
+
+// Scan the message repeatedly for about duration_ns, returning nanoseconds per scan
+template<typename Scan> static double bench_run(const std::string &msg, uint64_t duration_ns, Scan scan) {
+    ws_json_fields_t fields;
+    uint64_t iterations = 0;
+    uint64_t batch = 1;
+    uint64_t start = os_gettime_ns();
+    uint64_t elapsed = 0;
+    while (elapsed < duration_ns) {
+        for (uint64_t i = 0; i < batch; i++) {
+            scan(msg.data(), msg.size(), &fields);
+            bench_sink = bench_sink + fields.request_id_len + fields.event_type_len;
+        }
+        iterations += batch;
+        batch *= 2;
+        elapsed = os_gettime_ns() - start;
+    }
+    return (double) elapsed / (double) iterations;
+}
+
+static void bench_report(const char *scanner, const bench_message_t &msg, double ns) {
+    double mb_per_s = (double) msg.data.size() / ns * 1e9 / (1024.0 * 1024.0);
+    printf("%-15s %-8s %10zu %12.1f %12.1f\n", msg.name, scanner, msg.data.size(), ns, mb_per_s);
+}
+
+int main(int argc, char **argv) {
+    uint64_t duration_ns = (uint64_t) (argc > 1 ? atoi(argv[1]) : 500) * 1000000;
+
+    printf("%-15s %-8s %10s %12s %12s\n", "message", "scanner", "bytes", "ns/scan", "MiB/s");
+    for (const bench_message_t &msg: bench_messages()) {
+        // Every scanner has to read the message the same way for the numbers to compare
+        ws_json_fields_t expected, fields;
+        WS_CHECK(legacy_json_scan(msg.data.data(), msg.data.size(), &expected));
+
+        bench_report("legacy", msg, bench_run(msg.data, duration_ns, legacy_json_scan));
+        for (size_t variant = 0; variant < ws_json_scan_variant_count(); variant++) {
+            WS_CHECK(ws_json_scan_variant(variant, msg.data.data(), msg.data.size(), &fields));
+            WS_CHECK(fields.op == expected.op && fields.request_id == expected.request_id &&
+                     fields.event_type == expected.event_type);
+
+            double ns = bench_run(msg.data, duration_ns, [variant](const char *data, size_t len, ws_json_fields_t *out) {
+                return ws_json_scan_variant(variant, data, len, out);
+            });
+            bench_report(ws_json_scan_variant_name(variant), msg, ns);
+        }
+    }
+    return ws_test_failures ? 1 : 0;
+}
@@ -0,0 +1,231 @@
+/*
+OBS WebSocket Relay - Local Transport Benchmark
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+// Loopback TCP against a Unix domain socket, for choosing between ws://127.0.0.1 and ws+unix://
+// for the local obs-websocket connection. WebSocket framing and the relay's own work are the same
+// on both, so only the sockets are measured: round trips at request, volume meter and larger
+// message sizes, and one way streams of volume meter events and screenshots, with the CPU time
+// both ends spent per MiB. TCP sockets have TCP_NODELAY set, as lws does. Usage:
+// bench-transport [milliseconds per measurement]
+
+#include <util/platform.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Each message starts with its payload size and the size of the reply to send, both u32
+typedef struct {
+    uint32_t size;
+    uint32_t reply_size;
+} bench_header_t;
+
+static bool send_all(int fd, const void *data, size_t len) {
+    const char *p = (const char *) data;
+    while (len > 0) {
+        ssize_t sent = send(fd, p, len, 0);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) return false;
+        p += sent;
+        len -= (size_t) sent;
+    }
+    return true;
+}
+
+static bool recv_all(int fd, void *data, size_t len) {
+    char *p = (char *) data;
+    while (len > 0) {
+        ssize_t received = recv(fd, p, len, 0);
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) return false;
+        p += received;
+        len -= (size_t) received;
+    }
+    return true;
+}
+
+static void set_nodelay(int fd, int family) {
+    if (family != AF_INET) return;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+typedef struct {
+    int listen_fd;
+    int family;
+} bench_server_t;
+
+// Answers every message with the reply size it asks for until the client disconnects
+static void *bench_serve(void *data) {
+    bench_server_t *server = (bench_server_t *) data;
+    int fd = accept(server->listen_fd, NULL, NULL);
+    if (fd < 0) return NULL;
+    set_nodelay(fd, server->family);
+
+    std::vector<char> buffer;
+    bench_header_t header;
+    while (recv_all(fd, &header, sizeof(header))) {
+        buffer.resize(std::max(header.size, header.reply_size));
+        if (!recv_all(fd, buffer.data(), header.size)) break;
+        if (header.reply_size && !send_all(fd, buffer.data(), header.reply_size)) break;
+    }
+    close(fd);
+    return NULL;
+}
+
+typedef struct {
+    const char *name;
+    int fd;
+} bench_transport_t;
+
+static double cpu_seconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (double) (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+           (double) (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+// Send a message and wait for its echo, repeatedly; prints the mean and 99th percentile
+static bool bench_round_trips(const bench_transport_t &transport, const char *label, uint32_t size,
+                              uint64_t duration_ns) {
+    std::vector<char> message(sizeof(bench_header_t) + size, 'x');
+    bench_header_t header = {size, size};
+    memcpy(message.data(), &header, sizeof(header));
+    std::vector<char> reply(size);
+    std::vector<uint64_t> samples;
+
+    uint64_t start = os_gettime_ns();
+    while (os_gettime_ns() - start < duration_ns) {
+        uint64_t sent = os_gettime_ns();
+        if (!send_all(transport.fd, message.data(), message.size())) return false;
+        if (!recv_all(transport.fd, reply.data(), size)) return false;
+        samples.push_back(os_gettime_ns() - sent);
+    }
+
+    std::sort(samples.begin(), samples.end());
+    uint64_t total = 0;
+    for (uint64_t sample: samples) total += sample;
+    printf("%-6s round trip  %-14s %9u %10.1f us mean %10.1f us p99\n", transport.name, label, size,
+           (double) total / (double) samples.size() / 1000.0, (double) samples[samples.size() * 99 / 100] / 1000.0);
+    return true;
+}
+
+// Unacknowledged messages in a stream. Unix sockets charge every one byte acknowledgement the
+// size of a whole buffer against the send buffer, so leaving many unread would stall the server
+#define BENCH_STREAM_WINDOW 64
+
+// Send messages back to back the way events are relayed; the server acknowledges each with one
+// byte, read once a window's worth is due
+static bool bench_stream(const bench_transport_t &transport, const char *label, uint32_t size, uint64_t duration_ns) {
+    std::vector<char> message(sizeof(bench_header_t) + size, 'x');
+    bench_header_t header = {size, 1};
+    memcpy(message.data(), &header, sizeof(header));
+
+    uint64_t count = 0;
+    uint64_t acked = 0;
+    char acks[BENCH_STREAM_WINDOW];
+    double cpu_start = cpu_seconds();
+    uint64_t start = os_gettime_ns();
+    while (os_gettime_ns() - start < duration_ns) {
+        if (!send_all(transport.fd, message.data(), message.size())) return false;
+        count++;
+        while (count - acked >= sizeof(acks)) {
+            if (!recv_all(transport.fd, acks, sizeof(acks))) return false;
+            acked += sizeof(acks);
+        }
+    }
+    while (acked < count) {
+        size_t chunk = (size_t) std::min<uint64_t>(count - acked, sizeof(acks));
+        if (!recv_all(transport.fd, acks, chunk)) return false;
+        acked += chunk;
+    }
+    double elapsed = (double) (os_gettime_ns() - start) / 1e9;
+    double cpu = cpu_seconds() - cpu_start;
+
+    double mib = (double) count * size / (1024.0 * 1024.0);
+    printf("%-6s stream      %-14s %9u %10.0f msg/s %9.0f MiB/s %8.2f ms CPU/MiB\n", transport.name, label, size,
+           (double) count / elapsed, mib / elapsed, cpu * 1000.0 / mib);
+    return true;
+}
+
+static bool bench_transport(const char *name, int family, uint64_t duration_ns) {
+    struct sockaddr_storage addr = {};
+    socklen_t addr_len;
+    std::string socket_path;
+
+    if (family == AF_INET) {
+        struct sockaddr_in *in = (struct sockaddr_in *) &addr;
+        in->sin_family = AF_INET;
+        in->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr_len = sizeof(*in);
+    } else {
+        struct sockaddr_un *un = (struct sockaddr_un *) &addr;
+        socket_path = std::string(P_tmpdir) + "/ws-relay-bench-" + std::to_string(getpid()) + ".sock";
+        un->sun_family = AF_UNIX;
+        snprintf(un->sun_path, sizeof(un->sun_path), "%s", socket_path.c_str());
+        addr_len = sizeof(*un);
+        unlink(socket_path.c_str());
+    }
+
+    bench_server_t server = {socket(family, SOCK_STREAM, 0), family};
+    if (server.listen_fd < 0 || bind(server.listen_fd, (struct sockaddr *) &addr, addr_len) != 0 ||
+        listen(server.listen_fd, 1) != 0 || getsockname(server.listen_fd, (struct sockaddr *) &addr, &addr_len) != 0) {
+        fprintf(stderr, "%s: cannot listen: %s\n", name, strerror(errno));
+        return false;
+    }
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, bench_serve, &server);
+
+    bench_transport_t transport = {name, socket(family, SOCK_STREAM, 0)};
+    bool ok = transport.fd >= 0 && connect(transport.fd, (struct sockaddr *) &addr, addr_len) == 0;
+    if (ok) {
+        set_nodelay(transport.fd, family);
+        ok = bench_round_trips(transport, "request", 256, duration_ns) &&
+             bench_round_trips(transport, "volume meters", 1500, duration_ns) &&
+             bench_round_trips(transport, "scene list", 64 * 1024, duration_ns) &&
+             bench_stream(transport, "volume meters", 1500, duration_ns) &&
+             bench_stream(transport, "screenshot", 2 * 1024 * 1024, duration_ns);
+    }
+    if (!ok) fprintf(stderr, "%s: %s\n", name, strerror(errno));
+
+    if (transport.fd >= 0) close(transport.fd);
+    shutdown(server.listen_fd, SHUT_RDWR);
+    pthread_join(thread, NULL);
+    close(server.listen_fd);
+    if (!socket_path.empty()) unlink(socket_path.c_str());
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    uint64_t duration_ns = (uint64_t) (argc > 1 ? atoi(argv[1]) : 1000) * 1000000;
+
+    bool ok = bench_transport("tcp", AF_INET, duration_ns);
+    ok = bench_transport("unix", AF_UNIX, duration_ns) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,78 @@
+/*
+OBS WebSocket Relay - Message Scanner Fuzzer
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+// ws_json_scan and message classification on arbitrary bytes. Both run on every message from
+// either side, so malformed or truncated JSON must never make them read outside the message or
+// hand out fields that point outside it. Every scanner variant the CPU runs must agree
+
+#include "ws-relay-internal.h"
+#include "test-support.h"
+#include <vector>
+
+// A located field lies entirely within the scanned buffer
+static bool field_in_range(const char *field, size_t field_len, const char *data, size_t len) {
+    if (!field) return field_len == 0;
+    return field >= data && field_len <= len && (size_t) (field - data) <= len - field_len;
+}
+
+static bool same_fields(const ws_json_fields_t &a, const ws_json_fields_t &b) {
+    return a.op == b.op && a.event_type == b.event_type && a.event_type_len == b.event_type_len &&
+           a.request_id == b.request_id && a.request_id_len == b.request_id_len &&
+           a.request_type == b.request_type && a.request_type_len == b.request_type_len &&
+           a.request_data == b.request_data && a.request_data_len == b.request_data_len;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    // An exact size copy, so a read past the end lands outside the allocation
+    std::vector<char> buffer(data, data + size);
+    const char *text = buffer.data();
+
+    ws_json_fields_t fields = {};
+    bool complete = ws_json_scan(text, size, &fields);
+
+    for (size_t variant = 0; variant < ws_json_scan_variant_count(); variant++) {
+        ws_json_fields_t other = {};
+        bool other_complete = ws_json_scan_variant(variant, text, size, &other);
+        WS_FUZZ_ASSERT(other_complete == complete);
+        WS_FUZZ_ASSERT(same_fields(other, fields));
+    }
+
+    WS_FUZZ_ASSERT(fields.op >= -1 && fields.op < 10000);
+    WS_FUZZ_ASSERT(field_in_range(fields.event_type, fields.event_type_len, text, size));
+    WS_FUZZ_ASSERT(field_in_range(fields.request_id, fields.request_id_len, text, size));
+    WS_FUZZ_ASSERT(field_in_range(fields.request_type, fields.request_type_len, text, size));
+    WS_FUZZ_ASSERT(field_in_range(fields.request_data, fields.request_data_len, text, size));
+
+    if (fields.request_data) {
+        // The whole object, brackets included
+        WS_FUZZ_ASSERT(fields.request_data_len >= 2 && fields.request_data[0] == '{');
+        char last = fields.request_data[fields.request_data_len - 1];
+        WS_FUZZ_ASSERT(last == '}' || last == ']');
+    }
+    if (complete) {
+        WS_FUZZ_ASSERT(size >= 2);
+    }
+
+    if (fields.event_type) {
+        ws_event_is_high_volume(fields.event_type, fields.event_type_len);
+    }
+
+    ws_message_class_t msg_class = ws_message_classify(text, size);
+    WS_FUZZ_ASSERT(msg_class >= WS_MESSAGE_UNCLASSIFIED && msg_class <= WS_MESSAGE_RESPONSE);
+    return 0;
+}
@@ -0,0 +1,71 @@
+/*
+OBS WebSocket Relay - Fuzz Corpus Replay
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+// Entry point for the fuzz harnesses when they are not built for libFuzzer: every file named on
+// the command line, or found in a directory named there, is run through the harness once. This
+// keeps the seed corpora and saved crash inputs running as regular tests
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static bool run_file(const std::filesystem::path &path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        fprintf(stderr, "Failed to read %s\n", path.string().c_str());
+        return false;
+    }
+
+    std::vector<char> input((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    // Heap copy of exactly the input size, so reads past its end are caught by the sanitizers
+    std::vector<uint8_t> data(input.begin(), input.end());
+    LLVMFuzzerTestOneInput(data.data(), data.size());
+    return true;
+}
+
+int main(int argc, char **argv) {
+    size_t runs = 0;
+    int failures = 0;
+
+    for (int i = 1; i < argc; i++) {
+        std::filesystem::path path(argv[i]);
+        if (std::filesystem::is_directory(path)) {
+            for (const auto &entry: std::filesystem::recursive_directory_iterator(path)) {
+                if (!entry.is_regular_file()) continue;
+                if (run_file(entry.path())) {
+                    runs++;
+                } else {
+                    failures++;
+                }
+            }
+        } else if (run_file(path)) {
+            runs++;
+        } else {
+            failures++;
+        }
+    }
+
+    printf("Ran %zu inputs\n", runs);
+    return failures || !runs ? 1 : 0;
+}
@@ -0,0 +1,280 @@
+/*
+OBS WebSocket Relay - Reassembly Fuzzer
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+// Drives the relay's protocol callbacks against the lws mock with fragments, writeable and timer
+// callbacks, send pipe stalls, failed writes and reconnects in the order the input gives them.
+// Checked after every step:
+// - queue accounting matches the queued messages and reassembly stays within WS_MAX_MESSAGE_SIZE
+// - a connection the relay closed is no longer referenced once lws reports it closed
+// - every write decodes as whole WebSocket frames, coalesced frames included
+// - what each side receives is a subsequence of the messages the other side completed, in order
+
+#include "ws-relay-internal.h"
+#include "mock-lws.h"
+#include "test-support.h"
+#include <obs-module.h>
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+
+// Fragments of filler bytes reach the reassembly limit in a few steps
+#define FUZZ_FILLER_UNIT (64 * 1024)
+#define FUZZ_FILLER_MAX (256 * FUZZ_FILLER_UNIT)
+// Filler per input, enough to cross the limit twice while keeping one run short
+#define FUZZ_FILLER_BUDGET (2 * WS_MAX_MESSAGE_SIZE + FUZZ_FILLER_MAX)
+
+typedef struct {
+    size_t size;
+    uint64_t hash;
+} fuzz_message_t;
+
+// One end of the relay: the connection, its current mocked wsi, the message it is sending and the
+// messages that may be delivered to it, oldest first
+typedef struct {
+    ws_connection_t *conn;
+    lws_callback_function *callback;
+    struct lws *wsi; // NULL while disconnected
+    bool in_message;
+    size_t sending_size;
+    uint64_t sending_hash;
+    std::deque<fuzz_message_t> expected;
+} fuzz_side_t;
+
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    size_t pos;
+} fuzz_input_t;
+
+static uint8_t fuzz_byte(fuzz_input_t *input) {
+    return input->pos < input->size ? input->data[input->pos++] : 0;
+}
+
+static uint16_t fuzz_u16(fuzz_input_t *input) {
+    uint16_t hi = fuzz_byte(input);
+    return (uint16_t) (hi << 8 | fuzz_byte(input));
+}
+
+// FNV-1a, continued from hash
+static uint64_t fuzz_hash(uint64_t hash, const unsigned char *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ data[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+#define FUZZ_HASH_INIT 0xcbf29ce484222325ULL
+
+// Split the writes made to one connection into the messages they carry
+static void fuzz_decode_writes(const std::vector<mock_lws_write_t> &writes, std::vector<fuzz_message_t> &messages) {
+    std::vector<mock_lws_message_t> decoded;
+    for (const mock_lws_write_t &write: writes) {
+        WS_FUZZ_ASSERT(mock_lws_decode_write(write, decoded));
+    }
+    for (const mock_lws_message_t &msg: decoded) {
+        const unsigned char *payload = (const unsigned char *) msg.payload.data();
+        messages.push_back({msg.payload.size(), fuzz_hash(FUZZ_HASH_INIT, payload, msg.payload.size())});
+    }
+}
+
+// Match what a side received against what the other side completed
+static void fuzz_collect(fuzz_side_t *side) {
+    if (!side->wsi) return;
+
+    std::vector<fuzz_message_t> received;
+    fuzz_decode_writes(mock_lws_take_writes(side->wsi), received);
+    for (const fuzz_message_t &msg: received) {
+        WS_FUZZ_ASSERT(msg.size <= WS_MAX_MESSAGE_SIZE);
+        while (!side->expected.empty() &&
+               (side->expected.front().size != msg.size || side->expected.front().hash != msg.hash)) {
+            side->expected.pop_front();
+        }
+        WS_FUZZ_ASSERT(!side->expected.empty());
+        side->expected.pop_front();
+    }
+}
+
+static void fuzz_check_connection(ws_connection_t *conn) {
+    size_t queued = 0;
+    for (const ws_message_t &msg: conn->buffers) {
+        WS_FUZZ_ASSERT(msg.data.size() >= WS_MSG_PRE);
+        queued += msg.data.size() - WS_MSG_PRE;
+    }
+    WS_FUZZ_ASSERT(queued == conn->queued_bytes);
+    WS_FUZZ_ASSERT(conn->payload.size() >= WS_MSG_PRE);
+    WS_FUZZ_ASSERT(conn->payload.size() - WS_MSG_PRE <= WS_MAX_MESSAGE_SIZE);
+    WS_FUZZ_ASSERT(conn->write_batch.empty() || conn->write_batch.size() == LWS_PRE);
+}
+
+// lws finishes closing a connection after the callback asked for it or the relay closed it
+static void fuzz_settle(fuzz_side_t *side, int result) {
+    if (!side->wsi || (result >= 0 && !mock_lws_closed(side->wsi))) return;
+
+    fuzz_collect(side);
+    side->callback(side->wsi, LWS_CALLBACK_CLIENT_CLOSED, NULL, NULL, 0);
+    WS_FUZZ_ASSERT(side->conn->wsi != side->wsi);
+    mock_lws_destroy(side->wsi);
+    side->wsi = NULL;
+    side->in_message = false;
+}
+
+// A connection the relay dialed comes up, as lws_client_connect_via_info would have started it
+static void fuzz_connect(fuzz_side_t *side) {
+    if (side->wsi) return;
+
+    side->wsi = mock_lws_create();
+    side->conn->wsi = side->wsi;
+    side->conn->state = WS_STATE_CONNECTING;
+    lws_set_opaque_user_data(side->wsi, side->conn);
+    fuzz_settle(side, side->callback(side->wsi, LWS_CALLBACK_CLIENT_ESTABLISHED, NULL, NULL, 0));
+}
+
+// One fragment from source, as lws hands it over: the payload follows LWS_PRE bytes of headroom
+static void fuzz_receive(fuzz_side_t *source, fuzz_side_t *target, unsigned char *in, size_t len, bool final,
+                         size_t remaining) {
+    if (!source->wsi) return;
+
+    bool first = !source->in_message;
+    if (first) {
+        source->sending_size = 0;
+        source->sending_hash = FUZZ_HASH_INIT;
+    }
+    source->sending_size += len;
+    source->sending_hash = fuzz_hash(source->sending_hash, in, len);
+    source->in_message = !final;
+    if (final) {
+        target->expected.push_back({source->sending_size, source->sending_hash});
+    }
+
+    mock_lws_set_fragment(source->wsi, first, final, final ? 0 : remaining);
+    fuzz_settle(source, source->callback(source->wsi, LWS_CALLBACK_CLIENT_RECEIVE, NULL, in, len));
+}
+
+static void fuzz_callback(fuzz_side_t *side, enum lws_callback_reasons reason) {
+    if (!side->wsi) return;
+
+    fuzz_settle(side, side->callback(side->wsi, reason, NULL, NULL, 0));
+    fuzz_collect(side);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    static std::vector<unsigned char> filler;
+    if (filler.empty()) {
+        ws_test_set_log_level(LOG_ERROR - 1);
+        filler.assign(LWS_PRE + FUZZ_FILLER_MAX, 'x');
+    }
+
+    fuzz_input_t input = {data, size, 0};
+
+    // The first byte picks the queueing configuration
+    uint8_t setup = fuzz_byte(&input);
+    static const int coalesce_kb[] = {0, 1, 16, 128};
+    static const int budget_kb[] = {0, 64, 1024, 64 * 1024};
+
+    ws_relay_config_t config;
+    ws_relay_config_init(&config);
+    config.write_coalesce_kb = coalesce_kb[setup & 3];
+    config.max_queued_kb = budget_kb[(setup >> 2) & 3];
+    config.drop_policy = (ws_drop_policy_t) ((setup >> 4) % 3);
+    config.ping_interval = setup & 0x40 ? 1 : 0;
+    config.ping_max_missed = 1;
+
+    ws_relay_t *relay = ws_relay_create(&config);
+    ws_relay_config_free(&config);
+    WS_FUZZ_ASSERT(relay);
+
+    fuzz_side_t obs = {&relay->obs_conn, ws_callback_obs};
+    fuzz_side_t remote = {&relay->remote_conn, ws_callback_remote};
+    fuzz_connect(&obs);
+    fuzz_connect(&remote);
+
+    std::vector<unsigned char> fragment;
+    size_t filler_used = 0;
+    while (input.pos < input.size) {
+        uint8_t op = fuzz_byte(&input);
+        fuzz_side_t *side = op & 0x80 ? &remote : &obs;
+        fuzz_side_t *other = side == &obs ? &remote : &obs;
+
+        switch (op & 0x7) {
+            case 0: {
+                // Fragment of the given length taken from the input
+                uint8_t flags = fuzz_byte(&input);
+                size_t len = fuzz_u16(&input);
+                len = std::min(len, input.size - input.pos);
+                fragment.assign(LWS_PRE, 0);
+                fragment.insert(fragment.end(), input.data + input.pos, input.data + input.pos + len);
+                input.pos += len;
+                fuzz_receive(side, other, fragment.data() + LWS_PRE, len, flags & 1, (size_t) (flags >> 1) * 1024);
+                break;
+            }
+            case 1: {
+                // Fragment of filler, up to a quarter of the reassembly limit
+                uint8_t flags = fuzz_byte(&input);
+                size_t len = ((size_t) fuzz_byte(&input) + 1) * FUZZ_FILLER_UNIT;
+                if (filler_used + len > FUZZ_FILLER_BUDGET) break;
+                filler_used += len;
+                fuzz_receive(side, other, filler.data() + LWS_PRE, len, flags & 1, len);
+                break;
+            }
+            case 2:
+                fuzz_callback(side, LWS_CALLBACK_CLIENT_WRITEABLE);
+                break;
+            case 3:
+                fuzz_callback(side, LWS_CALLBACK_TIMER);
+                break;
+            case 4:
+                if (side->wsi) mock_lws_set_choked(side->wsi, op & 0x08);
+                break;
+            case 5:
+                if (side->wsi) mock_lws_set_write_failure(side->wsi, op & 0x08);
+                break;
+            case 6:
+                fuzz_settle(side, -1);
+                break;
+            case 7:
+                fuzz_connect(side);
+                break;
+        }
+
+        // Either side may have been closed by the relay during the step
+        fuzz_settle(&obs, 0);
+        fuzz_settle(&remote, 0);
+        fuzz_check_connection(&relay->obs_conn);
+        fuzz_check_connection(&relay->remote_conn);
+    }
+
+    // Drain what is left, then take both connections down
+    for (fuzz_side_t *side: {&obs, &remote}) {
+        if (side->wsi) {
+            mock_lws_set_choked(side->wsi, false);
+            mock_lws_set_write_failure(side->wsi, false);
+        }
+        fuzz_callback(side, LWS_CALLBACK_CLIENT_WRITEABLE);
+        fuzz_settle(side, -1);
+        fuzz_check_connection(side->conn);
+    }
+
+    ws_relay_destroy(relay);
+
+    // Writes straight from a receive buffer mask it in place, as lws does
+    if (filler_used) {
+        memset(filler.data() + LWS_PRE, 'x', FUZZ_FILLER_MAX);
+    }
+    return 0;
+}
@@ -0,0 +1,77 @@
+/*
+OBS WebSocket Relay - URL Parser Fuzzer
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+// parse_ws_url on arbitrary text, covering ws://, wss:// and ws+unix:// URLs. Addresses come from
+// the settings dialog and the endpoint list, so anything a user can type has to be rejected or
+// parsed into a host and path lws can dial
+
+#include "ws-relay-internal.h"
+#include "test-support.h"
+#include <obs-module.h>
+#include <string>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    static bool initialized = false;
+    if (!initialized) {
+        ws_test_set_log_level(LOG_ERROR - 1);
+        initialized = true;
+    }
+
+    // The parser takes C strings; anything after an embedded NUL is never seen
+    std::string url((const char *) data, size);
+    url.resize(strlen(url.c_str()));
+
+    char *host = (char *) 1;
+    char *path = (char *) 1;
+    uint16_t port = 1;
+    bool use_ssl = true;
+    bool parsed = parse_ws_url(url.c_str(), &host, &port, &path, &use_ssl);
+
+    if (!parsed) {
+        WS_FUZZ_ASSERT(!host && !path);
+        return 0;
+    }
+
+    WS_FUZZ_ASSERT(host && path);
+    WS_FUZZ_ASSERT(host[0] != '\0');
+    WS_FUZZ_ASSERT(path[0] == '/');
+
+    if (url.compare(0, 10, "ws+unix://") == 0) {
+        // The socket path, in the lws form, is taken verbatim from the URL
+        WS_FUZZ_ASSERT(ws_host_is_unix(host) && host[1] != '\0');
+        WS_FUZZ_ASSERT(url.compare(10, strlen(host + 1), host + 1) == 0);
+        WS_FUZZ_ASSERT(port == 0 && !use_ssl);
+    } else {
+        // lws would take a host in the socket path form for one, whatever the scheme says
+        WS_FUZZ_ASSERT(!ws_host_is_unix(host));
+        WS_FUZZ_ASSERT(url.find(host) != std::string::npos);
+        WS_FUZZ_ASSERT(port != 0);
+        WS_FUZZ_ASSERT(use_ssl == (url.compare(0, 6, "wss://") == 0));
+        // A host that is not a bracketed IPv6 literal ends where the port or path starts
+        bool bracketed = url[use_ssl ? 6 : 5] == '[';
+        WS_FUZZ_ASSERT(bracketed || strcspn(host, ":/?") == strlen(host));
+        WS_FUZZ_ASSERT(!bracketed || !strchr(host, ']'));
+        for (const char *c = host; *c; c++) {
+            WS_FUZZ_ASSERT((unsigned char) *c > ' ' && *c != 0x7f);
+        }
+    }
+
+    bfree(host);
+    bfree(path);
+    return 0;
+}
@@ -0,0 +1,460 @@
+/*
+OBS WebSocket Relay - Loopback Test Server
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "loopback-server.h"
+#include "ws-relay-internal.h"
+#include <libwebsockets.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+
+#define LOOPBACK_TICK_US 1000
+
+// Mixed event sizes, cycled through by sequence number
+static const size_t loopback_sizes[] = {120, 700, 3000, 200, 18000, 450, 90000, 1500};
+
+typedef struct {
+    std::vector<unsigned char> data; // LWS_PRE bytes of headroom followed by the frame
+    enum lws_write_protocol type;
+} loopback_frame_t;
+
+// lws scheduled callback that knows its server
+typedef struct {
+    lws_sorted_usec_list_t sul; // Must stay first
+    ws_loopback_t *loopback;
+} loopback_tick_t;
+
+typedef struct {
+    bool remote; // Session of the remote stand-in, otherwise of the OBS stand-in
+    std::string rx; // Fragments of the message being received
+    std::deque<loopback_frame_t> tx; // Echoes waiting to be written
+    int64_t last_seq = -1; // Last event number received on this session
+} loopback_session_t;
+
+struct ws_loopback {
+    struct lws_context *context;
+    struct lws_vhost *obs_vhost;
+    struct lws_vhost *remote_vhost;
+    pthread_t thread;
+    volatile bool stop;
+
+    // Only touched on the server thread
+    loopback_tick_t tick;
+    std::map<struct lws *, loopback_session_t> sessions;
+    struct lws *obs_wsi; // Newest OBS session, the one events are sent on
+
+    // Shared with the test thread
+    pthread_mutex_t mutex;
+    bool traffic;
+    size_t window;
+    size_t message_size;
+    size_t in_flight;
+    uint64_t last_progress_ns;
+    uint64_t next_seq;
+    uint64_t phase_from;
+    std::vector<bool> forwarded_seen;
+    std::vector<bool> echoed_seen;
+    ws_loopback_stats_t stats;
+};
+
+static size_t loopback_event_size(ws_loopback_t *loopback, uint64_t seq) {
+    if (loopback->message_size) return loopback->message_size;
+    return loopback_sizes[seq % (sizeof(loopback_sizes) / sizeof(loopback_sizes[0]))];
+}
+
+// Event number seq, padded to size bytes with filler that depends on seq, so a message cut short,
+// spliced or delivered with another's content does not compare equal
+static std::string loopback_event(uint64_t seq, size_t size) {
+    std::string event = "{\"op\":5,\"d\":{\"eventType\":\"LoopbackEvent\",\"eventData\":{\"seq\":" +
+                        std::to_string(seq) + ",\"fill\":\"";
+    static const char tail[] = "\"}}}";
+    size_t fill = size > event.size() + sizeof(tail) - 1 ? size - event.size() - (sizeof(tail) - 1) : 0;
+    for (size_t i = 0; i < fill; i++) {
+        event += (char) ('a' + (seq + i) % 26);
+    }
+    event += tail;
+    return event;
+}
+
+// Event number of message, -1 if it is not an intact event
+static int64_t loopback_check_event(const char *message, size_t len) {
+    static const char key[] = "\"seq\":";
+    std::string text(message, len);
+    size_t at = text.find(key);
+    if (at == std::string::npos) return -1;
+
+    char *end = NULL;
+    long long seq = strtoll(text.c_str() + at + sizeof(key) - 1, &end, 10);
+    if (seq < 0 || end == text.c_str() + at + sizeof(key) - 1) return -1;
+    if (loopback_event((uint64_t) seq, len) != text) return -1;
+    return seq;
+}
+
+// Record event seq as received on session; called with the mutex held
+static void loopback_record(ws_loopback_t *loopback, loopback_session_t *session, std::vector<bool> &seen,
+                            int64_t seq) {
+    if ((uint64_t) seq >= seen.size()) {
+        seen.resize((size_t) seq + 1024);
+    }
+    if (seq <= session->last_seq || seen[(size_t) seq]) {
+        loopback->stats.reordered++;
+    }
+    seen[(size_t) seq] = true;
+    session->last_seq = seq;
+}
+
+// Remote stand-in: check the event and queue its echo, framed the way it arrived
+static void loopback_on_remote_message(ws_loopback_t *loopback, struct lws *wsi, loopback_session_t *session,
+                                       bool binary) {
+    const char *payload = session->rx.data();
+    size_t len = session->rx.size();
+    uint16_t channel = 0;
+
+    if (binary) {
+        const unsigned char *header = (const unsigned char *) payload;
+        if (len < WS_MUX_HEADER_SIZE || header[0] != WS_MUX_VERSION) {
+            pthread_mutex_lock(&loopback->mutex);
+            loopback->stats.corrupt++;
+            pthread_mutex_unlock(&loopback->mutex);
+            return;
+        }
+        // Session opens, window grants and clock exchanges are not events
+        if (header[1] != WS_MUX_DATA) return;
+        channel = (uint16_t) ((header[2] << 8) | header[3]);
+        payload += WS_MUX_HEADER_SIZE;
+        len -= WS_MUX_HEADER_SIZE;
+    }
+
+    int64_t seq = loopback_check_event(payload, len);
+    pthread_mutex_lock(&loopback->mutex);
+    if (seq < 0) {
+        loopback->stats.corrupt++;
+    } else {
+        loopback->stats.forwarded++;
+        loopback_record(loopback, session, loopback->forwarded_seen, seq);
+    }
+    pthread_mutex_unlock(&loopback->mutex);
+    if (seq < 0) return;
+
+    loopback_frame_t frame;
+    size_t header_size = binary ? WS_MUX_HEADER_SIZE : 0;
+    frame.data.resize(LWS_PRE + header_size + len);
+    if (binary) {
+        ws_mux_put_header(frame.data.data() + LWS_PRE, WS_MUX_DATA, channel, 0);
+    }
+    memcpy(frame.data.data() + LWS_PRE + header_size, payload, len);
+    frame.type = binary ? LWS_WRITE_BINARY : LWS_WRITE_TEXT;
+    session->tx.push_back(std::move(frame));
+    lws_callback_on_writable(wsi);
+}
+
+// OBS stand-in: check the echo and open the window by one
+static void loopback_on_obs_message(ws_loopback_t *loopback, struct lws *wsi, loopback_session_t *session) {
+    int64_t seq = loopback_check_event(session->rx.data(), session->rx.size());
+
+    pthread_mutex_lock(&loopback->mutex);
+    if (seq < 0) {
+        loopback->stats.corrupt++;
+    } else {
+        loopback->stats.echoed++;
+        loopback->stats.echoed_bytes += session->rx.size();
+        loopback_record(loopback, session, loopback->echoed_seen, seq);
+        if ((uint64_t) seq >= loopback->phase_from) {
+            loopback->stats.phase_echoed++;
+            loopback->stats.phase_echoed_bytes += session->rx.size();
+        }
+        if (loopback->in_flight > 0) {
+            loopback->in_flight--;
+        }
+        loopback->last_progress_ns = os_gettime_ns();
+    }
+    bool more = loopback->traffic && loopback->in_flight < loopback->window;
+    pthread_mutex_unlock(&loopback->mutex);
+
+    if (more && wsi == loopback->obs_wsi) {
+        lws_callback_on_writable(wsi);
+    }
+}
+
+// Send the next event if the window allows it; returns -1 if the write failed
+static int loopback_send_event(ws_loopback_t *loopback, struct lws *wsi) {
+    pthread_mutex_lock(&loopback->mutex);
+    if (!loopback->traffic || loopback->in_flight >= loopback->window) {
+        pthread_mutex_unlock(&loopback->mutex);
+        return 0;
+    }
+    uint64_t seq = loopback->next_seq++;
+    size_t size = loopback_event_size(loopback, seq);
+    loopback->in_flight++;
+    loopback->last_progress_ns = os_gettime_ns();
+    loopback->stats.sent++;
+    loopback->stats.sent_bytes += size;
+    bool more = loopback->in_flight < loopback->window;
+    pthread_mutex_unlock(&loopback->mutex);
+
+    std::string event = loopback_event(seq, size);
+    std::vector<unsigned char> buf(LWS_PRE + event.size());
+    memcpy(buf.data() + LWS_PRE, event.data(), event.size());
+    if (lws_write(wsi, buf.data() + LWS_PRE, event.size(), LWS_WRITE_TEXT) < 0) return -1;
+
+    if (more) {
+        lws_callback_on_writable(wsi);
+    }
+    return 0;
+}
+
+static int loopback_callback(struct lws *wsi, enum lws_callback_reasons reason, void *user, void *in, size_t len) {
+    ws_loopback_t *loopback = (ws_loopback_t *) lws_context_user(lws_get_context(wsi));
+
+    switch (reason) {
+        case LWS_CALLBACK_ESTABLISHED: {
+            loopback_session_t &session = loopback->sessions[wsi];
+            session.remote = lws_get_vhost(wsi) == loopback->remote_vhost;
+
+            pthread_mutex_lock(&loopback->mutex);
+            if (session.remote) {
+                loopback->stats.remote_sessions++;
+            } else {
+                // Whatever was in flight on the previous session is gone with it
+                loopback->stats.obs_sessions++;
+                loopback->in_flight = 0;
+                loopback->obs_wsi = wsi;
+            }
+            pthread_mutex_unlock(&loopback->mutex);
+            if (!session.remote) {
+                lws_callback_on_writable(wsi);
+            }
+            break;
+        }
+
+        case LWS_CALLBACK_RECEIVE: {
+            auto it = loopback->sessions.find(wsi);
+            if (it == loopback->sessions.end()) break;
+            loopback_session_t &session = it->second;
+
+            session.rx.append((const char *) in, len);
+            if (!lws_is_final_fragment(wsi)) break;
+
+            if (session.remote) {
+                loopback_on_remote_message(loopback, wsi, &session, lws_frame_is_binary(wsi) != 0);
+            } else {
+                loopback_on_obs_message(loopback, wsi, &session);
+            }
+            session.rx.clear();
+            break;
+        }
+
+        case LWS_CALLBACK_SERVER_WRITEABLE: {
+            auto it = loopback->sessions.find(wsi);
+            if (it == loopback->sessions.end()) break;
+            loopback_session_t &session = it->second;
+
+            if (!session.remote) {
+                if (wsi == loopback->obs_wsi) return loopback_send_event(loopback, wsi);
+                break;
+            }
+            if (session.tx.empty()) break;
+
+            loopback_frame_t &frame = session.tx.front();
+            if (lws_write(wsi, frame.data.data() + LWS_PRE, frame.data.size() - LWS_PRE, frame.type) < 0) {
+                return -1;
+            }
+            session.tx.pop_front();
+            if (!session.tx.empty()) {
+                lws_callback_on_writable(wsi);
+            }
+            break;
+        }
+
+        case LWS_CALLBACK_CLOSED:
+            loopback->sessions.erase(wsi);
+            if (wsi == loopback->obs_wsi) {
+                loopback->obs_wsi = NULL;
+            }
+            break;
+
+        default:
+            return lws_callback_http_dummy(wsi, reason, user, in, len);
+    }
+    return 0;
+}
+
+// Subprotocol names as the relay asks for them
+static const struct lws_protocols loopback_obs_protocols[] = {
+    {"obs-websocket", loopback_callback, 0, 0},
+    {NULL, NULL, 0, 0} /* terminator */
+};
+
+static const struct lws_protocols loopback_remote_protocols[] = {
+    {"websocket", loopback_callback, 0, 0},
+    {NULL, NULL, 0, 0} /* terminator */
+};
+
+// Give up on a stalled window and restart sending when the window has room
+static void loopback_tick(lws_sorted_usec_list_t *sul) {
+    ws_loopback_t *loopback = ((loopback_tick_t *) sul)->loopback;
+
+    pthread_mutex_lock(&loopback->mutex);
+    if (loopback->in_flight > 0 &&
+        os_gettime_ns() - loopback->last_progress_ns > (uint64_t) WS_LOOPBACK_STALL_MS * 1000000) {
+        loopback->in_flight = 0;
+        loopback->stats.stalls++;
+        loopback->stats.phase_stalls++;
+    }
+    bool send = loopback->traffic && loopback->in_flight < loopback->window;
+    pthread_mutex_unlock(&loopback->mutex);
+
+    if (send && loopback->obs_wsi) {
+        lws_callback_on_writable(loopback->obs_wsi);
+    }
+    lws_sul_schedule(loopback->context, 0, sul, loopback_tick, LOOPBACK_TICK_US);
+}
+
+static void *loopback_thread(void *data) {
+    ws_loopback_t *loopback = (ws_loopback_t *) data;
+    os_set_thread_name("ws-loopback");
+
+    lws_sul_schedule(loopback->context, 0, &loopback->tick.sul, loopback_tick, LOOPBACK_TICK_US);
+    while (!os_atomic_load_bool(&loopback->stop)) {
+        lws_service(loopback->context, 0);
+    }
+    return NULL;
+}
+
+static struct lws_vhost *loopback_listen(ws_loopback_t *loopback, const char *name,
+                                         const struct lws_protocols *protocols) {
+    struct lws_context_creation_info info = {0};
+    info.vhost_name = name;
+    info.port = 0; // Any free port
+    info.protocols = protocols;
+    info.gid = -1;
+    info.uid = -1;
+    info.user = loopback;
+
+    struct lws_vhost *vhost = lws_create_vhost(loopback->context, &info);
+    if (vhost && lws_get_vhost_listen_port(vhost) <= 0) {
+        lws_vhost_destroy(vhost);
+        return NULL;
+    }
+    return vhost;
+}
+
+ws_loopback_t *ws_loopback_create(void) {
+    ws_loopback_t *loopback = new ws_loopback_t();
+    pthread_mutex_init(&loopback->mutex, NULL);
+    loopback->tick.loopback = loopback;
+
+    struct lws_context_creation_info info = {0};
+    info.options = LWS_SERVER_OPTION_EXPLICIT_VHOSTS;
+    info.gid = -1;
+    info.uid = -1;
+    info.user = loopback;
+    loopback->context = lws_create_context(&info);
+    if (loopback->context) {
+        loopback->obs_vhost = loopback_listen(loopback, "obs", loopback_obs_protocols);
+        loopback->remote_vhost = loopback_listen(loopback, "remote", loopback_remote_protocols);
+    }
+
+    if (!loopback->obs_vhost || !loopback->remote_vhost ||
+        pthread_create(&loopback->thread, NULL, loopback_thread, loopback) != 0) {
+        if (loopback->context) {
+            lws_context_destroy(loopback->context);
+        }
+        pthread_mutex_destroy(&loopback->mutex);
+        delete loopback;
+        return NULL;
+    }
+    return loopback;
+}
+
+void ws_loopback_destroy(ws_loopback_t *loopback) {
+    if (!loopback) return;
+
+    os_atomic_store_bool(&loopback->stop, true);
+    lws_cancel_service(loopback->context);
+    pthread_join(loopback->thread, NULL);
+
+    lws_sul_cancel(&loopback->tick.sul);
+    lws_context_destroy(loopback->context);
+    pthread_mutex_destroy(&loopback->mutex);
+    delete loopback;
+}
+
+int ws_loopback_obs_port(ws_loopback_t *loopback) {
+    return lws_get_vhost_listen_port(loopback->obs_vhost);
+}
+
+int ws_loopback_remote_port(ws_loopback_t *loopback) {
+    return lws_get_vhost_listen_port(loopback->remote_vhost);
+}
+
+void ws_loopback_set_traffic(ws_loopback_t *loopback, bool on, size_t window, size_t message_size) {
+    pthread_mutex_lock(&loopback->mutex);
+    loopback->traffic = on;
+    loopback->window = window;
+    loopback->message_size = message_size;
+    pthread_mutex_unlock(&loopback->mutex);
+    // The next tick picks it up
+}
+
+bool ws_loopback_drain(ws_loopback_t *loopback, uint32_t timeout_ms) {
+    uint64_t deadline = os_gettime_ns() + (uint64_t) timeout_ms * 1000000;
+    for (;;) {
+        pthread_mutex_lock(&loopback->mutex);
+        size_t in_flight = loopback->in_flight;
+        pthread_mutex_unlock(&loopback->mutex);
+
+        if (in_flight == 0) return true;
+        if (os_gettime_ns() >= deadline) return false;
+        os_sleep_ms(1);
+    }
+}
+
+void ws_loopback_begin_phase(ws_loopback_t *loopback) {
+    pthread_mutex_lock(&loopback->mutex);
+    loopback->phase_from = loopback->next_seq;
+    loopback->stats.phase_echoed = 0;
+    loopback->stats.phase_echoed_bytes = 0;
+    loopback->stats.phase_stalls = 0;
+    pthread_mutex_unlock(&loopback->mutex);
+}
+
+void ws_loopback_get_stats(ws_loopback_t *loopback, ws_loopback_stats_t *stats) {
+    pthread_mutex_lock(&loopback->mutex);
+    *stats = loopback->stats;
+    stats->phase_sent = loopback->next_seq - loopback->phase_from;
+    stats->in_flight = loopback->in_flight;
+    pthread_mutex_unlock(&loopback->mutex);
+}
+
+bool ws_loopback_wait_relay(ws_relay_t *relay, uint32_t timeout_ms) {
+    uint64_t deadline = os_gettime_ns() + (uint64_t) timeout_ms * 1000000;
+    for (;;) {
+        ws_relay_status_t status;
+        if (ws_relay_get_status(relay, &status) && status.obs_state == WS_STATE_CONNECTED &&
+            status.remote_state == WS_STATE_CONNECTED) {
+            return true;
+        }
+        if (os_gettime_ns() >= deadline) return false;
+        os_sleep_ms(10);
+    }
+}
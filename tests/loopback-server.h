@@ -0,0 +1,75 @@
+/*
+OBS WebSocket Relay - Loopback Test Server
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+// Stand-ins for obs-websocket and the remote on loopback ports, served by one libwebsockets
+// context on a thread of their own, for running the relay against the real libwebsockets.
+// While traffic is on, the OBS stand-in sends numbered events, keeping up to a window of them
+// unanswered. The remote stand-in checks each event and echoes it back in the framing it arrived
+// in, multiplexed or not, and the OBS stand-in checks the echoes. Events in flight when a
+// connection closes are lost and not sent again
+
+#pragma once
+
+#include "ws-relay.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// A window with no echo for this long is given up on and counted as a stall
+#define WS_LOOPBACK_STALL_MS 2000
+
+typedef struct ws_loopback ws_loopback_t;
+
+typedef struct {
+    uint64_t sent; // Events sent by the OBS stand-in
+    uint64_t sent_bytes;
+    uint64_t forwarded; // Events that reached the remote stand-in
+    uint64_t echoed; // Echoes that made it back to the OBS stand-in
+    uint64_t echoed_bytes;
+    uint64_t corrupt; // Messages whose content did not match their number
+    uint64_t reordered; // Messages that arrived behind a later one or twice
+    uint64_t stalls;
+    uint64_t obs_sessions; // Connections the relay made to each stand-in
+    uint64_t remote_sessions;
+    uint64_t phase_sent; // The same counts since ws_loopback_begin_phase
+    uint64_t phase_echoed;
+    uint64_t phase_echoed_bytes;
+    uint64_t phase_stalls;
+    size_t in_flight; // Events sent and not echoed yet
+} ws_loopback_stats_t;
+
+// Start both stand-ins on ports picked by the system; NULL if they could not listen
+ws_loopback_t *ws_loopback_create(void);
+void ws_loopback_destroy(ws_loopback_t *loopback);
+
+int ws_loopback_obs_port(ws_loopback_t *loopback);
+int ws_loopback_remote_port(ws_loopback_t *loopback);
+
+// Turn event traffic on or off. Events are message_size bytes, or of mixed sizes from a few
+// hundred bytes to beyond the relay's smallest receive buffers if message_size is 0
+void ws_loopback_set_traffic(ws_loopback_t *loopback, bool on, size_t window, size_t message_size);
+
+// Wait until no event is in flight; false if that took longer than timeout_ms
+bool ws_loopback_drain(ws_loopback_t *loopback, uint32_t timeout_ms);
+
+// Count the phase_* statistics from the next event on
+void ws_loopback_begin_phase(ws_loopback_t *loopback);
+
+void ws_loopback_get_stats(ws_loopback_t *loopback, ws_loopback_stats_t *stats);
+
+// Wait until the relay has both of its connections up; false if that took longer than timeout_ms
+bool ws_loopback_wait_relay(ws_relay_t *relay, uint32_t timeout_ms);
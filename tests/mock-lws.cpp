@@ -0,0 +1,387 @@
+/*
+OBS WebSocket Relay - libwebsockets Mock
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "mock-lws.h"
+#include <algorithm>
+#include <map>
+#include <string.h>
+
+struct lws {
+    void *opaque = NULL;
+    bool first = true;
+    bool final = true;
+    size_t remaining = 0;
+    bool choked = false;
+    bool fail_writes = false;
+    bool closed = false;
+    bool writable = false;
+    bool record = true;
+    const struct lws_protocols *protocol = NULL;
+    std::vector<mock_lws_write_t> writes;
+};
+
+struct lws_context {
+    uint64_t random_state;
+};
+
+struct lws_vhost {
+    struct lws_context *context;
+    std::string iface;
+    const struct lws_protocols *protocols;
+};
+
+// Vhosts listening on an interface or socket path; any other vhost is this one
+static struct lws_vhost mock_default_vhost;
+static std::vector<struct lws_vhost *> mock_listening;
+
+// Masks for frames lws_write builds, drawn apart from the relay's context so its own draws replay
+// the same way whether or not a test writes
+static struct lws_context mock_mask_context = {0x2545f4914f6cdd1dULL};
+
+static mock_lws_stats_t mock_stats;
+
+// Timers pending since lws_sul_schedule, until cancelled, fired or their context goes
+typedef struct {
+    struct lws_context *context;
+    sul_cb_t cb;
+    lws_usec_t us;
+} mock_timer_t;
+
+static std::map<lws_sorted_usec_list_t *, mock_timer_t> mock_timers;
+
+struct lws *mock_lws_create(void) {
+    return new lws();
+}
+
+void mock_lws_destroy(struct lws *wsi) {
+    delete wsi;
+}
+
+struct lws *mock_lws_accept(const char *iface) {
+    for (struct lws_vhost *vhost: mock_listening) {
+        if (vhost->iface == iface) {
+            struct lws *wsi = new lws();
+            wsi->protocol = &vhost->protocols[0];
+            return wsi;
+        }
+    }
+    return NULL;
+}
+
+void mock_lws_set_fragment(struct lws *wsi, bool first, bool final, size_t remaining) {
+    wsi->first = first;
+    wsi->final = final;
+    wsi->remaining = remaining;
+}
+
+void mock_lws_set_choked(struct lws *wsi, bool choked) {
+    wsi->choked = choked;
+}
+
+void mock_lws_set_write_failure(struct lws *wsi, bool fail) {
+    wsi->fail_writes = fail;
+}
+
+bool mock_lws_closed(struct lws *wsi) {
+    return wsi->closed;
+}
+
+bool mock_lws_take_writable(struct lws *wsi) {
+    bool writable = wsi->writable;
+    wsi->writable = false;
+    return writable;
+}
+
+std::vector<mock_lws_write_t> mock_lws_take_writes(struct lws *wsi) {
+    std::vector<mock_lws_write_t> writes;
+    writes.swap(wsi->writes);
+    return writes;
+}
+
+void mock_lws_set_recording(struct lws *wsi, bool record) {
+    wsi->record = record;
+}
+
+mock_lws_stats_t mock_lws_take_stats(void) {
+    mock_lws_stats_t stats = mock_stats;
+    mock_stats = {};
+    return stats;
+}
+
+bool mock_lws_decode_write(const mock_lws_write_t &write, std::vector<mock_lws_message_t> &messages) {
+    if (write.protocol == LWS_WRITE_PING) return true;
+    if (write.protocol == LWS_WRITE_TEXT || write.protocol == LWS_WRITE_BINARY) {
+        messages.push_back({write.protocol == LWS_WRITE_BINARY, write.data});
+        return true;
+    }
+    if (write.protocol != LWS_WRITE_RAW) return false;
+
+    const unsigned char *data = (const unsigned char *) write.data.data();
+    size_t size = write.data.size();
+    size_t pos = 0;
+    while (pos < size) {
+        if (size - pos < 2 || (data[pos] != 0x81 && data[pos] != 0x82) || !(data[pos + 1] & 0x80)) return false;
+        bool binary = data[pos] == 0x82;
+        uint64_t len = data[pos + 1] & 0x7f;
+        pos += 2;
+        if (len == 126) {
+            if (size - pos < 2) return false;
+            len = (uint64_t) data[pos] << 8 | data[pos + 1];
+            if (len < 126) return false;
+            pos += 2;
+        } else if (len == 127) {
+            if (size - pos < 8) return false;
+            len = 0;
+            for (int i = 0; i < 8; i++) len = len << 8 | data[pos + i];
+            if (len <= 0xffff || len >> 63) return false;
+            pos += 8;
+        }
+        if (size - pos < 4 || size - pos - 4 < len) return false;
+        const unsigned char *mask = data + pos;
+        pos += 4;
+
+        std::string payload((const char *) data + pos, (size_t) len);
+        for (size_t i = 0; i < payload.size(); i++) {
+            payload[i] ^= mask[i & 3];
+        }
+        messages.push_back({binary, std::move(payload)});
+        pos += len;
+    }
+    return true;
+}
+
+struct lws_context *lws_create_context(const struct lws_context_creation_info *info) {
+    (void) info;
+    struct lws_context *context = new lws_context();
+    context->random_state = 0x9e3779b97f4a7c15ULL;
+    return context;
+}
+
+// Vhosts and timers go with their context; accepted connections stay with the test, which
+// destroys them
+void lws_context_destroy(struct lws_context *context) {
+    for (auto it = mock_timers.begin(); it != mock_timers.end();) {
+        it = it->second.context == context ? mock_timers.erase(it) : std::next(it);
+    }
+    for (auto it = mock_listening.begin(); it != mock_listening.end();) {
+        if ((*it)->context == context) {
+            delete *it;
+            it = mock_listening.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    delete context;
+}
+
+struct lws_vhost *lws_create_vhost(struct lws_context *context, const struct lws_context_creation_info *info) {
+    if (!info->iface) return &mock_default_vhost;
+
+    // Binding a socket path in use fails, as it would for lws
+    for (struct lws_vhost *vhost: mock_listening) {
+        if (vhost->iface == info->iface) return NULL;
+    }
+    struct lws_vhost *vhost = new lws_vhost();
+    vhost->context = context;
+    vhost->iface = info->iface;
+    vhost->protocols = info->protocols;
+    mock_listening.push_back(vhost);
+    return vhost;
+}
+
+void lws_vhost_destroy(struct lws_vhost *vhost) {
+    auto it = std::find(mock_listening.begin(), mock_listening.end(), vhost);
+    if (it == mock_listening.end()) return;
+
+    mock_listening.erase(it);
+    delete vhost;
+}
+
+const struct lws_protocols *lws_get_protocol(struct lws *wsi) {
+    return wsi->protocol;
+}
+
+int lws_service(struct lws_context *context, int timeout_ms) {
+    (void) context;
+    (void) timeout_ms;
+    return 0;
+}
+
+void lws_cancel_service(struct lws_context *context) {
+    (void) context;
+}
+
+// Nothing is dialed; the relay sees the same as for a connect that fails right away
+struct lws *lws_client_connect_via_info(const struct lws_client_connect_info *ccinfo) {
+    (void) ccinfo;
+    return NULL;
+}
+
+void lws_set_opaque_user_data(struct lws *wsi, void *data) {
+    wsi->opaque = data;
+}
+
+void *lws_get_opaque_user_data(const struct lws *wsi) {
+    return wsi->opaque;
+}
+
+// lws builds the frame header in the LWS_PRE bytes in front of buf, so they are overwritten here
+// as well: a caller without the headroom shows up under AddressSanitizer
+int lws_write(struct lws *wsi, unsigned char *buf, size_t len, enum lws_write_protocol protocol) {
+    memset(buf - LWS_PRE, 0xa5, LWS_PRE);
+    if (wsi->fail_writes) return -1;
+
+    mock_stats.writes++;
+    mock_stats.write_bytes += len;
+    if (wsi->record) {
+        wsi->writes.push_back({protocol, std::string((const char *) buf, len)});
+    }
+
+    if (protocol == LWS_WRITE_TEXT || protocol == LWS_WRITE_BINARY) {
+        unsigned char mask[4];
+        lws_get_random(&mock_mask_context, mask, sizeof(mask));
+        for (size_t i = 0; i < len; i++) {
+            buf[i] ^= mask[i & 3];
+        }
+    }
+    return (int) len;
+}
+
+int lws_is_first_fragment(struct lws *wsi) {
+    return wsi->first;
+}
+
+int lws_is_final_fragment(struct lws *wsi) {
+    return wsi->final;
+}
+
+size_t lws_remaining_packet_payload(struct lws *wsi) {
+    return wsi->remaining;
+}
+
+int lws_callback_on_writable(struct lws *wsi) {
+    if (!wsi) return -1;
+
+    wsi->writable = true;
+    return 1;
+}
+
+int lws_send_pipe_choked(struct lws *wsi) {
+    return wsi->choked;
+}
+
+void lws_close_reason(struct lws *wsi, enum lws_close_status status, unsigned char *buf, size_t len) {
+    (void) status;
+    (void) buf;
+    (void) len;
+    wsi->closed = true;
+}
+
+void lws_set_timeout(struct lws *wsi, enum pending_timeout reason, int secs) {
+    (void) reason;
+    (void) secs;
+    wsi->closed = true;
+}
+
+void lws_set_timer_usecs(struct lws *wsi, lws_usec_t usecs) {
+    (void) wsi;
+    (void) usecs;
+}
+
+void lws_sul_schedule(struct lws_context *context, int tsi, lws_sorted_usec_list_t *sul, sul_cb_t cb, lws_usec_t us) {
+    (void) tsi;
+    if (us == LWS_SET_TIMER_USEC_CANCEL) {
+        mock_timers.erase(sul);
+        return;
+    }
+    mock_timers[sul] = {context, cb, us};
+}
+
+void lws_sul_cancel(lws_sorted_usec_list_t *sul) {
+    mock_timers.erase(sul);
+}
+
+lws_usec_t mock_lws_timer_delay(lws_sorted_usec_list_t *sul) {
+    auto it = mock_timers.find(sul);
+    return it == mock_timers.end() ? -1 : it->second.us;
+}
+
+std::vector<lws_sorted_usec_list_t *> mock_lws_timers(void) {
+    std::vector<lws_sorted_usec_list_t *> timers;
+    for (const auto &timer: mock_timers) {
+        timers.push_back(timer.first);
+    }
+    return timers;
+}
+
+bool mock_lws_fire_timer(lws_sorted_usec_list_t *sul) {
+    auto it = mock_timers.find(sul);
+    if (it == mock_timers.end()) return false;
+
+    sul_cb_t cb = it->second.cb;
+    mock_timers.erase(it);
+    cb(sul);
+    return true;
+}
+
+// Deterministic, so a fuzzer input replays the same way every time
+size_t lws_get_random(struct lws_context *context, void *buf, size_t len) {
+    mock_stats.random_calls++;
+    unsigned char *out = (unsigned char *) buf;
+    for (size_t i = 0; i < len; i++) {
+        context->random_state ^= context->random_state << 13;
+        context->random_state ^= context->random_state >> 7;
+        context->random_state ^= context->random_state << 17;
+        out[i] = (unsigned char) context->random_state;
+    }
+    return len;
+}
+
+int lws_b64_encode_string(const char *in, int in_len, char *out, int out_size) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    const unsigned char *src = (const unsigned char *) in;
+    int n = 0;
+
+    for (int i = 0; i < in_len; i += 3) {
+        if (n + 4 >= out_size) return -1;
+
+        uint32_t group = (uint32_t) src[i] << 16;
+        if (i + 1 < in_len) group |= (uint32_t) src[i + 1] << 8;
+        if (i + 2 < in_len) group |= src[i + 2];
+
+        out[n++] = alphabet[(group >> 18) & 0x3f];
+        out[n++] = alphabet[(group >> 12) & 0x3f];
+        out[n++] = i + 1 < in_len ? alphabet[(group >> 6) & 0x3f] : '=';
+        out[n++] = i + 2 < in_len ? alphabet[group & 0x3f] : '=';
+    }
+    if (n >= out_size) return -1;
+
+    out[n] = '\0';
+    return n;
+}
+
+#if defined(LWS_WITH_CONMON)
+void lws_conmon_wsi_take(struct lws *wsi, struct lws_conmon *dest) {
+    (void) wsi;
+    memset(dest, 0, sizeof(*dest));
+}
+
+void lws_conmon_release(struct lws_conmon *conmon) {
+    (void) conmon;
+}
+#endif
@@ -0,0 +1,81 @@
+/*
+OBS WebSocket Relay - libwebsockets Mock
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <libwebsockets.h>
+#include <string>
+#include <vector>
+
+// Stand-in for the libwebsockets calls the relay makes, for tests that drive its protocol
+// callbacks directly. Connections are created by the test rather than dialed, nothing goes on
+// the wire: writes are recorded, timers wait for the test to fire them and service wakeups do
+// nothing. Text and binary writes then draw a mask and mask the buffer in place, the work lws
+// does for every client frame
+
+// One lws_write as the mock saw it
+typedef struct {
+    enum lws_write_protocol protocol;
+    std::string data;
+} mock_lws_write_t;
+
+// A message carried by a write, unmasked
+typedef struct {
+    bool binary;
+    std::string payload;
+} mock_lws_message_t;
+
+// lws calls made since the last mock_lws_take_stats, over all connections. On Unix lws reads
+// /dev/urandom for every lws_get_random, and sends each write with one send() on ws://
+typedef struct {
+    uint64_t writes;
+    uint64_t write_bytes;
+    uint64_t random_calls;
+} mock_lws_stats_t;
+
+struct lws *mock_lws_create(void);
+void mock_lws_destroy(struct lws *wsi);
+// A connection accepted by the vhost listening on iface, NULL if there is none; lws_get_protocol
+// reports the vhost's first protocol for it
+struct lws *mock_lws_accept(const char *iface);
+
+// What lws_is_first_fragment, lws_is_final_fragment and lws_remaining_packet_payload report
+// during the next receive callback
+void mock_lws_set_fragment(struct lws *wsi, bool first, bool final, size_t remaining);
+void mock_lws_set_choked(struct lws *wsi, bool choked);
+void mock_lws_set_write_failure(struct lws *wsi, bool fail);
+
+// Whether the relay closed the connection or asked for a WRITEABLE callback since the last call
+bool mock_lws_closed(struct lws *wsi);
+bool mock_lws_take_writable(struct lws *wsi);
+std::vector<mock_lws_write_t> mock_lws_take_writes(struct lws *wsi);
+// Benchmarks turn recording off, so writes are only counted
+void mock_lws_set_recording(struct lws *wsi, bool record);
+mock_lws_stats_t mock_lws_take_stats(void);
+
+// Delay a pending timer was scheduled with, -1 if it is not pending
+lws_usec_t mock_lws_timer_delay(lws_sorted_usec_list_t *sul);
+// Pending timers, for finding one a module keeps to itself by what was scheduled in between
+std::vector<lws_sorted_usec_list_t *> mock_lws_timers(void);
+// Run a pending timer's callback now; returns false if it was not pending
+bool mock_lws_fire_timer(lws_sorted_usec_list_t *sul);
+
+// Split a write into the messages it carries and append them. Raw writes must hold whole frames
+// as a client sends them: FIN set, text or binary, masked, each length in its shortest encoding.
+// Returns false if they do not; pings carry no message
+bool mock_lws_decode_write(const mock_lws_write_t &write, std::vector<mock_lws_message_t> &messages);
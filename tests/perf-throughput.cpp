@@ -0,0 +1,95 @@
+/*
+OBS WebSocket Relay - Throughput Test
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+// Events of a fixed size from the obs-websocket stand-in through the relay to the remote
+// stand-in and back, over loopback against the real libwebsockets, with a window of them in
+// flight. Fails if the relay moves fewer MiB/s each way than the given minimum, or loses any.
+// Usage: perf-throughput <minimum MiB/s> [seconds] [message KiB]
+
+#include "loopback-server.h"
+#include "test-support.h"
+#include <obs-module.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <string>
+
+#define PERF_WINDOW 32
+#define PERF_WARMUP_MS 500
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <minimum MiB/s> [seconds] [message KiB]\n", argv[0]);
+        return 2;
+    }
+    double minimum = atof(argv[1]);
+    int seconds = argc > 2 ? atoi(argv[2]) : 3;
+    size_t message_size = (argc > 3 ? (size_t) atoi(argv[3]) : 64) * 1024;
+    ws_test_set_log_level(LOG_WARNING);
+
+    ws_loopback_t *loopback = ws_loopback_create();
+    if (!loopback) {
+        fprintf(stderr, "Failed to start the loopback stand-ins\n");
+        return 1;
+    }
+
+    ws_relay_config_t config;
+    ws_relay_config_init(&config);
+    bfree(config.local_obs_address);
+    bfree(config.remote_ws_address);
+    config.local_obs_address = bstrdup(("ws://127.0.0.1:" + std::to_string(ws_loopback_obs_port(loopback))).c_str());
+    config.remote_ws_address = bstrdup(("ws://127.0.0.1:" + std::to_string(ws_loopback_remote_port(loopback))).c_str());
+
+    ws_relay_t *relay = ws_relay_create(&config);
+    if (!relay || !ws_relay_start(relay)) {
+        fprintf(stderr, "Failed to start relay\n");
+        return 1;
+    }
+    WS_CHECK(ws_loopback_wait_relay(relay, 10000));
+
+    // Let the receive buffers grow to the message size before measuring
+    ws_loopback_set_traffic(loopback, true, PERF_WINDOW, message_size);
+    os_sleep_ms(PERF_WARMUP_MS);
+    ws_loopback_begin_phase(loopback);
+    uint64_t start = os_gettime_ns();
+    os_sleep_ms((uint32_t) seconds * 1000);
+    ws_loopback_set_traffic(loopback, false, PERF_WINDOW, message_size);
+
+    // Events still in flight are counted, so the time they take to come back is as well
+    WS_CHECK(ws_loopback_drain(loopback, 10000));
+    double elapsed = (double) (os_gettime_ns() - start) / 1e9;
+
+    ws_loopback_stats_t stats;
+    ws_loopback_get_stats(loopback, &stats);
+    double throughput = (double) stats.phase_echoed_bytes / (1024.0 * 1024.0) / elapsed;
+
+    ws_relay_stop(relay);
+    ws_relay_destroy(relay);
+    ws_relay_config_free(&config);
+    ws_loopback_destroy(loopback);
+
+    WS_CHECK(stats.phase_echoed == stats.phase_sent);
+    WS_CHECK(stats.phase_stalls == 0);
+    WS_CHECK(stats.corrupt == 0);
+    WS_CHECK(stats.reordered == 0);
+    WS_CHECK(throughput >= minimum);
+
+    printf("%llu messages of %zu KiB in %.2f s: %.1f MiB/s each way (minimum %.1f)\n",
+           (unsigned long long) stats.phase_echoed, message_size / 1024, elapsed, throughput, minimum);
+    printf("%ld failed checks\n", ws_test_failures);
+    return ws_test_failures ? 1 : 0;
+}
@@ -0,0 +1,226 @@
+/*
+OBS WebSocket Relay - Lifecycle Stress Test
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+// Start/stop cycles, configuration changes and saves on one thread, the way the settings dialog
+// drives the relay from the UI thread, while other threads read its status and statistics like
+// the stats dock and vendor requests do. Meant to be built with RELAY_TEST_SANITIZER set to
+// thread or address. The relay runs against the real libwebsockets, between loopback stand-ins
+// for obs-websocket and the remote that keep events flowing through it the whole time. Remote
+// settings alternate between the remote stand-in, ports nothing listens on and no remote at all.
+// Events in flight when a cycle drops a connection are lost; every other event must arrive, in
+// order and intact, and once the cycles are over, in a steady phase per framing, all of them must.
+// Usage: stress-lifecycle [cycles]
+
+#include "ws-relay-internal.h"
+#include "loopback-server.h"
+#include "test-support.h"
+#include <obs-module.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <string>
+#include <unistd.h>
+
+#define STRESS_READERS 3
+#define STRESS_WINDOW 8 // Events in flight at a time
+#define STRESS_STEADY_MS 2000
+
+typedef struct {
+    ws_relay_t *relay;
+    volatile bool stop;
+    long reads;
+} stress_state_t;
+
+static long status_callbacks = 0;
+
+static void stress_status_callback(const ws_relay_status_t *status, void *user_data) {
+    UNUSED_PARAMETER(status);
+    UNUSED_PARAMETER(user_data);
+    os_atomic_inc_long(&status_callbacks);
+}
+
+static void *stress_reader(void *data) {
+    stress_state_t *state = (stress_state_t *) data;
+
+    while (!os_atomic_load_bool(&state->stop)) {
+        ws_relay_status_t status;
+        ws_relay_stats_t stats;
+        WS_CHECK(ws_relay_get_status(state->relay, &status));
+        // Fails only until the service thread first publishes
+        ws_relay_get_stats(state->relay, &stats);
+        os_atomic_inc_long(&state->reads);
+        os_sleep_ms(1);
+    }
+    return NULL;
+}
+
+static std::string loopback_address(int port) {
+    return "ws://127.0.0.1:" + std::to_string(port);
+}
+
+// Run events through the relay with nothing else going on; all of them must come back
+static void stress_steady_phase(ws_relay_t *relay, ws_loopback_t *loopback) {
+    WS_CHECK(ws_loopback_wait_relay(relay, 10000));
+
+    // Events lost to the cycles are given up on before counting starts
+    ws_loopback_set_traffic(loopback, false, STRESS_WINDOW, 0);
+    ws_loopback_drain(loopback, 2 * WS_LOOPBACK_STALL_MS);
+    ws_loopback_begin_phase(loopback);
+
+    ws_loopback_set_traffic(loopback, true, STRESS_WINDOW, 0);
+    os_sleep_ms(STRESS_STEADY_MS);
+    ws_loopback_set_traffic(loopback, false, STRESS_WINDOW, 0);
+    WS_CHECK(ws_loopback_drain(loopback, 10000));
+
+    ws_loopback_stats_t stats;
+    ws_loopback_get_stats(loopback, &stats);
+    WS_CHECK(stats.phase_sent > 0);
+    WS_CHECK(stats.phase_echoed == stats.phase_sent);
+    WS_CHECK(stats.phase_stalls == 0);
+}
+
+int main(int argc, char **argv) {
+    int cycles = argc > 1 ? atoi(argv[1]) : 100;
+    ws_test_set_log_level(LOG_WARNING);
+
+    ws_loopback_t *loopback = ws_loopback_create();
+    if (!loopback) {
+        fprintf(stderr, "Failed to start the loopback stand-ins\n");
+        return 1;
+    }
+    std::string remote_live = loopback_address(ws_loopback_remote_port(loopback));
+
+    // Remote settings cycled through; an empty address makes saving the configuration stop the relay
+    const std::string remote_addresses[] = {
+        remote_live,
+        "ws://127.0.0.1:9," + remote_live,
+        "",
+        "ws+unix:///nonexistent/ws-relay-stress.sock,ws://localhost:" +
+            std::to_string(ws_loopback_remote_port(loopback)),
+    };
+
+    std::string config_path = std::string(P_tmpdir) + "/ws-relay-stress-" + std::to_string(getpid()) + ".ini";
+    ws_test_set_config_path(config_path.c_str());
+
+    ws_relay_config_t config;
+    ws_relay_config_init(&config);
+    bfree(config.local_obs_address);
+    config.local_obs_address = bstrdup(loopback_address(ws_loopback_obs_port(loopback)).c_str());
+    config.reconnect_interval = 1;
+    config.endpoint_probe_interval = 1;
+    // The remote stand-in echoes multiplexed frames but grants no window
+    config.mux_window_kb = 0;
+
+    ws_relay_t *relay = ws_relay_create(&config);
+    if (!relay) {
+        fprintf(stderr, "Failed to create relay\n");
+        return 1;
+    }
+    ws_relay_set_status_callback(relay, stress_status_callback, NULL);
+    global_relay = relay;
+
+    stress_state_t state = {relay, false, 0};
+    pthread_t readers[STRESS_READERS];
+    for (pthread_t &reader: readers) {
+        pthread_create(&reader, NULL, stress_reader, &state);
+    }
+
+    ws_loopback_set_traffic(loopback, true, STRESS_WINDOW, 0);
+
+    std::string saved_remote;
+    for (int i = 0; i < cycles; i++) {
+        const std::string &remote = remote_addresses[i % (sizeof(remote_addresses) / sizeof(remote_addresses[0]))];
+        bfree(config.remote_ws_address);
+        config.remote_ws_address = bstrdup(remote.c_str());
+        config.enable_standby = (i / 2) % 2 == 1;
+        config.mux_channel = (i / 3) % 2 ? 7 : 0;
+        config.write_coalesce_kb = i % 5 == 0 ? 0 : 16;
+        config.dns_cache_ttl = i % 7 == 0 ? 0 : 300;
+
+        switch (i % 3) {
+            case 0:
+                // What the settings dialog does: save, which applies and starts or stops the relay
+                WS_CHECK(ws_relay_config_save(&config));
+                saved_remote = remote;
+                WS_CHECK(ws_relay_is_running(relay) == !remote.empty());
+                break;
+            case 1:
+                // Settings changed while running, then a restart
+                WS_CHECK(ws_relay_apply_config(relay, &config));
+                ws_relay_stop(relay);
+                WS_CHECK(!ws_relay_is_running(relay));
+                if (!remote.empty()) {
+                    WS_CHECK(ws_relay_start(relay));
+                }
+                break;
+            case 2:
+                // Quick stop and start with no settings change
+                ws_relay_stop(relay);
+                ws_relay_start(relay);
+                break;
+        }
+
+        // Give the service thread time to dial, fail or get events through, and reschedule
+        os_sleep_ms((uint32_t) (i % 4) * 10);
+    }
+
+    ws_loopback_stats_t cycle_stats;
+    ws_loopback_get_stats(loopback, &cycle_stats);
+
+    // Both framings of the remote connection, settled
+    for (int mux_channel: {0, 7}) {
+        bfree(config.remote_ws_address);
+        config.remote_ws_address = bstrdup(remote_live.c_str());
+        config.mux_channel = mux_channel;
+        WS_CHECK(ws_relay_config_save(&config));
+        saved_remote = remote_live;
+        stress_steady_phase(relay, loopback);
+    }
+
+    os_atomic_store_bool(&state.stop, true);
+    for (pthread_t reader: readers) {
+        pthread_join(reader, NULL);
+    }
+
+    global_relay = NULL;
+    ws_relay_destroy(relay);
+
+    ws_loopback_stats_t stats;
+    ws_loopback_get_stats(loopback, &stats);
+    ws_loopback_destroy(loopback);
+    WS_CHECK(stats.corrupt == 0);
+    WS_CHECK(stats.reordered == 0);
+
+    // The last saved settings are what the next session loads
+    ws_relay_config_t loaded;
+    ws_relay_config_init(&loaded);
+    WS_CHECK(ws_relay_config_load(&loaded));
+    WS_CHECK(strcmp(loaded.remote_ws_address, saved_remote.c_str()) == 0);
+    ws_relay_config_free(&loaded);
+    ws_relay_config_free(&config);
+
+    ws_test_set_config_path(NULL);
+    os_unlink(config_path.c_str());
+
+    printf("%d cycles, %ld status reads, %ld status callbacks\n", cycles, state.reads, status_callbacks);
+    printf("%llu OBS and %llu remote sessions, %llu of %llu events echoed during the cycles, %llu in total\n",
+           (unsigned long long) stats.obs_sessions, (unsigned long long) stats.remote_sessions,
+           (unsigned long long) cycle_stats.echoed, (unsigned long long) cycle_stats.sent,
+           (unsigned long long) stats.echoed);
+    printf("%ld failed checks\n", ws_test_failures);
+    return ws_test_failures ? 1 : 0;
+}
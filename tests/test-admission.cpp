@@ -0,0 +1,157 @@
+/*
+OBS WebSocket Relay - Admission Control Test
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+// Request admission against the lws mock: requests from the remote are weighed, forwarded while
+// their cost fits the limit and otherwise queued or answered in OBS's place. The answers must be
+// responses the remote can match to its request: the same type and id, escaping included, and a
+// NotReady status, or an empty result list for a batch. Responses from OBS free the cost and let
+// queued requests through in order; the queue deadline and a lost OBS connection reject them
+
+#include "ws-relay-internal.h"
+#include "mock-lws.h"
+#include "test-relay.h"
+#include "test-support.h"
+#include <obs-module.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#define TEST_MAX_INFLIGHT 2
+#define TEST_QUEUE_MS 20
+
+static ws_test_relay_t test_relay_create(int queue_ms) {
+    ws_relay_config_t config;
+    ws_relay_config_init(&config);
+    config.admission_max_inflight = TEST_MAX_INFLIGHT;
+    config.admission_queue_ms = queue_ms;
+    bfree(config.admission_weights);
+    config.admission_weights = bstrdup("GetStats=2, Free=0");
+    config.ping_interval = 0;
+    ws_test_relay_t test = ws_test_relay_create(&config);
+    ws_relay_config_free(&config);
+    return test;
+}
+
+static std::string request(const std::string &type, const std::string &id) {
+    return "{\"op\":6,\"d\":{\"requestType\":\"" + type + "\",\"requestId\":\"" + id + "\"}}";
+}
+
+static std::string response(const std::string &type, const std::string &id) {
+    return "{\"op\":7,\"d\":{\"requestType\":\"" + type + "\",\"requestId\":\"" + id +
+           "\",\"requestStatus\":{\"result\":true,\"code\":100}}}";
+}
+
+// What the relay answers in OBS's place
+static std::string rejection(const std::string &type, const std::string &id, const std::string &reason) {
+    return "{\"op\":7,\"d\":{\"requestType\":\"" + type + "\",\"requestId\":\"" + id +
+           "\",\"requestStatus\":{\"result\":false,\"code\":207,\"comment\":\"" + reason + "\"}}}";
+}
+
+static const std::vector<std::string> none;
+
+static void test_reject(void) {
+    ws_test_relay_t test = test_relay_create(0);
+    ws_relay_t *relay = test.relay;
+    ws_test_to_remote(&test);
+
+    // Weighed requests go through while they fit, free ones always
+    WS_CHECK(ws_test_from_remote(&test, request("GetStats", "a")) >= 0);
+    WS_CHECK(ws_test_from_remote(&test, request("Free", "b")) >= 0);
+    WS_CHECK(ws_test_to_obs(&test) == std::vector<std::string>({request("GetStats", "a"), request("Free", "b")}));
+
+    // Without a queue the next one is answered at once, type and id exactly as the remote sent them
+    WS_CHECK(ws_test_from_remote(&test, request("GetVersion", "c\\\"q\\u00e9")) >= 0);
+    WS_CHECK(ws_test_to_obs(&test) == none);
+    WS_CHECK(ws_test_to_remote(&test) ==
+             std::vector<std::string>({rejection("GetVersion", "c\\\"q\\u00e9", "OBS is busy, too many requests in flight")}));
+
+    // A batch has no status of its own, so it gets an empty result list
+    WS_CHECK(ws_test_from_remote(&test, "{\"op\":8,\"d\":{\"requestId\":\"batch\",\"requests\":[{\"requestType\":\"GetVersion\"}]}}") >= 0);
+    WS_CHECK(ws_test_to_obs(&test) == none);
+    WS_CHECK(ws_test_to_remote(&test) == std::vector<std::string>({"{\"op\":9,\"d\":{\"requestId\":\"batch\",\"results\":[]}}"}));
+    WS_CHECK(relay->stats.to_obs.admission_rejected == 2);
+
+    // A request without an id could not be matched to its response, so it is not counted
+    std::string anonymous = "{\"op\":6,\"d\":{\"requestType\":\"GetVersion\"}}";
+    WS_CHECK(ws_test_from_remote(&test, anonymous) >= 0);
+    WS_CHECK(ws_test_to_obs(&test) == std::vector<std::string>({anonymous}));
+
+    // OBS answering frees the cost for the next request
+    WS_CHECK(ws_test_from_obs(&test, response("GetStats", "a")) >= 0);
+    WS_CHECK(ws_test_to_remote(&test) == std::vector<std::string>({response("GetStats", "a")}));
+    WS_CHECK(ws_test_from_remote(&test, request("GetVersion", "d")) >= 0);
+    WS_CHECK(ws_test_to_obs(&test) == std::vector<std::string>({request("GetVersion", "d")}));
+    WS_CHECK(ws_test_to_remote(&test) == none);
+    WS_CHECK(relay->stats.to_obs.admission_rejected == 2);
+
+    ws_test_relay_destroy(&test);
+}
+
+static void test_queue(void) {
+    ws_test_relay_t test = test_relay_create(TEST_QUEUE_MS);
+    ws_relay_t *relay = test.relay;
+    ws_test_to_remote(&test);
+
+    // Requests over the limit wait, and are handed on in order as responses come back
+    WS_CHECK(ws_test_from_remote(&test, request("GetStats", "a")) >= 0);
+    WS_CHECK(ws_test_from_remote(&test, request("GetVersion", "q1")) >= 0);
+    WS_CHECK(ws_test_from_remote(&test, request("GetVersion", "q2")) >= 0);
+    WS_CHECK(ws_test_to_obs(&test) == std::vector<std::string>({request("GetStats", "a")}));
+    WS_CHECK(relay->stats.to_obs.admission_queued == 2);
+
+    WS_CHECK(ws_test_from_obs(&test, response("GetStats", "a")) >= 0);
+    WS_CHECK(ws_test_to_obs(&test) == std::vector<std::string>({request("GetVersion", "q1"), request("GetVersion", "q2")}));
+    WS_CHECK(ws_test_to_remote(&test) == std::vector<std::string>({response("GetStats", "a")}));
+
+    // One that waits past the deadline is answered by the relay; the timer that does so is the
+    // one queueing it scheduled
+    std::vector<lws_sorted_usec_list_t *> before = mock_lws_timers();
+    WS_CHECK(ws_test_from_remote(&test, request("GetVersion", "late")) >= 0);
+    lws_sorted_usec_list_t *deadline = NULL;
+    for (lws_sorted_usec_list_t *timer: mock_lws_timers()) {
+        if (std::find(before.begin(), before.end(), timer) == before.end()) deadline = timer;
+    }
+    WS_CHECK(deadline && mock_lws_timer_delay(deadline) <= TEST_QUEUE_MS * 1000 + 1);
+    os_sleep_ms(TEST_QUEUE_MS + 5);
+    WS_CHECK(deadline && mock_lws_fire_timer(deadline));
+    WS_CHECK(ws_test_to_remote(&test) ==
+             std::vector<std::string>({rejection("GetVersion", "late", "OBS is busy, the request timed out waiting in the relay")}));
+    WS_CHECK(ws_test_to_obs(&test) == none);
+
+    // Losing OBS turns the queue away, as nothing in flight will be answered
+    WS_CHECK(ws_test_from_remote(&test, request("GetVersion", "stranded")) >= 0);
+    WS_CHECK(ws_callback_obs(test.obs, LWS_CALLBACK_CLIENT_CLOSED, NULL, NULL, 0) >= 0);
+    WS_CHECK(ws_test_to_remote(&test) ==
+             std::vector<std::string>({rejection("GetVersion", "stranded", "The relay lost its connection to OBS")}));
+    WS_CHECK(relay->stats.to_obs.admission_rejected == 2);
+    WS_CHECK(mock_lws_timer_delay(deadline) < 0);
+
+    ws_test_relay_destroy(&test);
+}
+
+int main(void) {
+    ws_test_set_log_level(LOG_ERROR - 1);
+
+    test_reject();
+    test_queue();
+
+    printf("%ld failed checks\n", ws_test_failures);
+    return ws_test_failures ? 1 : 0;
+}
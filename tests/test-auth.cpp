@@ -0,0 +1,282 @@
+/*
+OBS WebSocket Relay - Authentication Offload Test
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+// The authentication string the relay computes for obs-websocket, against SHA-256 test vectors
+// and the example in the obs-websocket protocol documentation, then both handshakes against the
+// lws mock: the relay identifies with OBS and checks the remote's Identify against its token.
+// Last, where the password and token are saved
+
+#include "ws-relay-internal.h"
+#include "mock-lws.h"
+#include "test-relay.h"
+#include "test-support.h"
+#include <obs-module.h>
+#include <obs-frontend-api.h>
+#include <util/config-file.h>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// From the obs-websocket protocol documentation
+#define DOC_PASSWORD "supersecretpassword"
+#define DOC_SALT "lM1GncleQOaCu9lT1yeUZhFYnqhsLLP1G5lAGo3ixaI="
+#define DOC_CHALLENGE "+IxH4CnCiqpX1rM9scsNynZzbOe4KhDeYcTNS3PDaeY="
+#define DOC_AUTHENTICATION "1Ct943GAT+6YQUUX47Ia/ncufilbe6+oD6lY+5kaCu4="
+
+static void test_vectors(void) {
+    // FIPS 180-4 examples, base64 encoded; the second spans two blocks
+    WS_CHECK(ws_auth_sha256_base64("", "") == "47DEQpj8HBSa+/TImW+5JCeuQeRkm5NMpJWZG3hSuFU=");
+    WS_CHECK(ws_auth_sha256_base64("a", "bc") == "ungWv48Bz+pBQUDeXa4iI7ADYaOWF3qctBD/YfIAFa0=");
+    WS_CHECK(ws_auth_sha256_base64("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", "") ==
+             "JI1qYdIGOLjlwCaTDD5gOaM85Flk/yFn9uzt1BnbBsE=");
+    WS_CHECK(ws_auth_sha256_base64(std::string(1000, 'a'), "") == "Qe3s5C1j6Nm/UVqbppMuHCDLyfWl0TRkWttdsblzfqM=");
+
+    WS_CHECK(ws_auth_compute(DOC_PASSWORD, DOC_SALT, DOC_CHALLENGE) == DOC_AUTHENTICATION);
+    WS_CHECK(ws_auth_compute("", "salt", "challenge") == "5fmcrqR0I7snYOpUX/Ac22UdSA81TwCyHqCr6eFQyyI=");
+    WS_CHECK(ws_auth_compute("p\xc3\xa4ssw\xc3\xb6rd", "QUJD", "REVG") == "GIl907zICm+zuP4lG1+gQN8NG6nScOJirsfVXw3ghwY=");
+    WS_CHECK(ws_auth_compute(NULL, "salt", "challenge") == ws_auth_compute("", "salt", "challenge"));
+}
+
+static obs_data_t *parse_op(const std::string &json, int op) {
+    obs_data_t *msg = obs_data_create_from_json(json.c_str());
+    WS_CHECK(msg && obs_data_get_int(msg, "op") == op);
+    obs_data_t *d = msg ? obs_data_get_obj(msg, "d") : NULL;
+    obs_data_release(msg);
+    WS_CHECK(d != NULL);
+    return d;
+}
+
+static ws_test_relay_t test_relay_create(const char *password, const char *token) {
+    ws_relay_config_t config;
+    ws_relay_config_init(&config);
+    config.auth_offload = true;
+    config.ping_interval = 0;
+    bfree(config.obs_password);
+    config.obs_password = bstrdup(password);
+    bfree(config.relay_token);
+    config.relay_token = bstrdup(token);
+
+    ws_test_relay_t test = ws_test_relay_create(&config);
+    ws_relay_config_free(&config);
+    return test;
+}
+
+static void test_obs_handshake(void) {
+    ws_test_relay_t test = test_relay_create(DOC_PASSWORD, "token");
+
+    // Nothing goes to the remote before OBS greeted the relay
+    WS_CHECK(ws_test_to_remote(&test).empty());
+
+    std::string hello = "{\"op\":0,\"d\":{\"obsWebSocketVersion\":\"5.5.0\",\"rpcVersion\":1,\"authentication\":"
+                        "{\"challenge\":\"" DOC_CHALLENGE "\",\"salt\":\"" DOC_SALT "\"}}}";
+    WS_CHECK(ws_test_from_obs(&test, hello) >= 0);
+
+    std::vector<std::string> to_obs = ws_test_to_obs(&test);
+    WS_CHECK(to_obs.size() == 1);
+    if (to_obs.size() == 1) {
+        obs_data_t *d = parse_op(to_obs[0], 1);
+        WS_CHECK(strcmp(obs_data_get_string(d, "authentication"), DOC_AUTHENTICATION) == 0);
+        WS_CHECK(obs_data_get_int(d, "rpcVersion") == 1);
+        WS_CHECK(obs_data_get_int(d, "eventSubscriptions") == 0x7FF);
+        obs_data_release(d);
+    }
+
+    // The remote gets the relay's Hello, with a challenge of the relay's own
+    std::vector<std::string> to_remote = ws_test_to_remote(&test);
+    WS_CHECK(to_remote.size() == 1);
+    if (to_remote.size() == 1) {
+        obs_data_t *d = parse_op(to_remote[0], 0);
+        WS_CHECK(strcmp(obs_data_get_string(d, "obsWebSocketVersion"), "5.5.0") == 0);
+        obs_data_t *authentication = obs_data_get_obj(d, "authentication");
+        WS_CHECK(authentication != NULL);
+        if (authentication) {
+            WS_CHECK(strcmp(obs_data_get_string(authentication, "salt"), test.relay->auth.remote_salt) == 0);
+            WS_CHECK(strcmp(obs_data_get_string(authentication, "challenge"), test.relay->auth.remote_challenge) == 0);
+            WS_CHECK(strcmp(obs_data_get_string(authentication, "challenge"), DOC_CHALLENGE) != 0);
+            obs_data_release(authentication);
+        }
+        obs_data_release(d);
+    }
+
+    WS_CHECK(!test.relay->auth.obs_identified);
+    WS_CHECK(ws_test_from_obs(&test, "{\"op\":2,\"d\":{\"negotiatedRpcVersion\":1}}") >= 0);
+    WS_CHECK(test.relay->auth.obs_identified);
+    WS_CHECK(ws_test_to_remote(&test).empty());
+
+    ws_test_relay_destroy(&test);
+}
+
+static std::string identify(const std::string &authentication, int rpc_version = 1, const char *extra = "") {
+    return "{\"op\":1,\"d\":{\"rpcVersion\":" + std::to_string(rpc_version) + ",\"authentication\":\"" +
+           authentication + "\"" + extra + "}}";
+}
+
+static void test_remote_handshake(void) {
+    ws_test_relay_t test = test_relay_create("", "relay token");
+    WS_CHECK(ws_test_from_obs(&test, "{\"op\":0,\"d\":{\"obsWebSocketVersion\":\"5.5.0\",\"rpcVersion\":1}}") >= 0);
+    WS_CHECK(ws_test_from_obs(&test, "{\"op\":2,\"d\":{\"negotiatedRpcVersion\":1}}") >= 0);
+    ws_test_to_obs(&test);
+    ws_test_to_remote(&test);
+
+    ws_auth_state_t *auth = &test.relay->auth;
+    std::string expected = ws_auth_compute("relay token", auth->remote_salt, auth->remote_challenge);
+
+    // A wrong answer, the right answer to the wrong challenge and an unsupported RPC version
+    // are rejected with the codes obs-websocket closes with
+    std::string wrong = identify(ws_auth_compute("wrong token", auth->remote_salt, auth->remote_challenge));
+    WS_CHECK(ws_auth_handle_remote_message(test.relay, wrong.data(), wrong.size()) == WS_AUTH_REJECT_AUTHENTICATION);
+    std::string stale = identify(ws_auth_compute("relay token", DOC_SALT, DOC_CHALLENGE));
+    WS_CHECK(ws_auth_handle_remote_message(test.relay, stale.data(), stale.size()) == WS_AUTH_REJECT_AUTHENTICATION);
+    std::string missing = "{\"op\":1,\"d\":{\"rpcVersion\":1}}";
+    WS_CHECK(ws_auth_handle_remote_message(test.relay, missing.data(), missing.size()) == WS_AUTH_REJECT_AUTHENTICATION);
+    std::string version = identify(expected, 2);
+    WS_CHECK(ws_auth_handle_remote_message(test.relay, version.data(), version.size()) == WS_AUTH_REJECT_RPC_VERSION);
+    WS_CHECK(ws_auth_close_code(WS_AUTH_REJECT_AUTHENTICATION) == 4009);
+    WS_CHECK(ws_auth_close_code(WS_AUTH_REJECT_RPC_VERSION) == 4010);
+    WS_CHECK(!auth->remote_identified);
+    WS_CHECK(ws_test_to_remote(&test).empty());
+
+    // Requests before Identify go nowhere
+    WS_CHECK(ws_test_from_remote(&test, "{\"op\":6,\"d\":{\"requestType\":\"GetVersion\",\"requestId\":\"1\"}}") >= 0);
+    WS_CHECK(ws_test_to_obs(&test).empty());
+
+    // The right answer, asking for fewer events: the relay reidentifies with OBS
+    WS_CHECK(ws_test_from_remote(&test, identify(expected, 1, ",\"eventSubscriptions\":33")) >= 0);
+    WS_CHECK(auth->remote_identified);
+    std::vector<std::string> to_remote = ws_test_to_remote(&test);
+    WS_CHECK(to_remote.size() == 1);
+    if (to_remote.size() == 1) {
+        obs_data_t *d = parse_op(to_remote[0], 2);
+        WS_CHECK(obs_data_get_int(d, "negotiatedRpcVersion") == 1);
+        obs_data_release(d);
+    }
+    std::vector<std::string> to_obs = ws_test_to_obs(&test);
+    WS_CHECK(to_obs.size() == 1);
+    if (to_obs.size() == 1) {
+        obs_data_t *d = parse_op(to_obs[0], 3);
+        WS_CHECK(obs_data_get_int(d, "eventSubscriptions") == 33);
+        obs_data_release(d);
+    }
+
+    // The Identified answering the Reidentify stays with the relay
+    WS_CHECK(ws_test_from_obs(&test, "{\"op\":2,\"d\":{\"negotiatedRpcVersion\":1}}") >= 0);
+    WS_CHECK(!auth->obs_reidentify_pending);
+    WS_CHECK(ws_test_to_remote(&test).empty());
+
+    ws_test_relay_destroy(&test);
+}
+
+// Without a relay token any answer is accepted, as obs-websocket does with authentication off
+static void test_no_token(void) {
+    ws_test_relay_t test = test_relay_create("", "");
+    WS_CHECK(ws_test_from_obs(&test, "{\"op\":0,\"d\":{\"obsWebSocketVersion\":\"5.5.0\",\"rpcVersion\":1}}") >= 0);
+    ws_test_to_obs(&test);
+
+    std::vector<std::string> to_remote = ws_test_to_remote(&test);
+    WS_CHECK(to_remote.size() == 1);
+    if (to_remote.size() == 1) {
+        obs_data_t *d = parse_op(to_remote[0], 0);
+        WS_CHECK(!obs_data_has_user_value(d, "authentication"));
+        obs_data_release(d);
+    }
+
+    std::string msg = "{\"op\":1,\"d\":{\"rpcVersion\":1}}";
+    WS_CHECK(ws_auth_handle_remote_message(test.relay, msg.data(), msg.size()) == WS_AUTH_CONSUMED);
+    WS_CHECK(test.relay->auth.remote_identified);
+
+    ws_test_relay_destroy(&test);
+}
+
+static bool file_contains(const std::string &path, const char *text) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+    std::string contents;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), file)) > 0) contents.append(buf, n);
+    fclose(file);
+    return contents.find(text) != std::string::npos;
+}
+
+// The password and token are saved to the plugin's secrets file, not the OBS global config, and
+// ones an earlier version left in the global config are moved over on load
+static void test_secrets_storage(void) {
+    char dir_template[] = "/tmp/ws-relay-auth-XXXXXX";
+    const char *dir = mkdtemp(dir_template);
+    WS_CHECK(dir != NULL);
+    if (!dir) return;
+    std::string global_path = std::string(dir) + "/global.ini";
+    std::string secrets_path = std::string(dir) + "/secrets.ini";
+    ws_test_set_config_path(global_path.c_str());
+    ws_test_set_module_config_dir(dir);
+
+    ws_relay_config_t config;
+    ws_relay_config_init(&config);
+    bfree(config.obs_password);
+    config.obs_password = bstrdup("obs secret");
+    bfree(config.relay_token);
+    config.relay_token = bstrdup("token secret");
+    WS_CHECK(ws_relay_config_save(&config));
+    ws_relay_config_free(&config);
+
+    WS_CHECK(!file_contains(global_path, "secret"));
+    WS_CHECK(file_contains(secrets_path, "obs secret") && file_contains(secrets_path, "token secret"));
+    struct stat st;
+    WS_CHECK(stat(secrets_path.c_str(), &st) == 0 && (st.st_mode & 0777) == 0600);
+
+    ws_relay_config_t loaded;
+    ws_relay_config_init(&loaded);
+    WS_CHECK(ws_relay_config_load(&loaded));
+    WS_CHECK(strcmp(loaded.obs_password, "obs secret") == 0 && strcmp(loaded.relay_token, "token secret") == 0);
+    ws_relay_config_free(&loaded);
+
+    // As an earlier version saved them
+    os_unlink(secrets_path.c_str());
+    config_t *global = obs_frontend_get_app_config();
+    config_set_string(global, "ws_relay", "obs_password", "old secret");
+    config_set_string(global, "ws_relay", "relay_token", "old token");
+    config_save(global);
+
+    ws_relay_config_init(&loaded);
+    WS_CHECK(ws_relay_config_load(&loaded));
+    WS_CHECK(strcmp(loaded.obs_password, "old secret") == 0 && strcmp(loaded.relay_token, "old token") == 0);
+    ws_relay_config_free(&loaded);
+    WS_CHECK(!file_contains(global_path, "old"));
+    WS_CHECK(file_contains(secrets_path, "old secret") && file_contains(secrets_path, "old token"));
+
+    ws_test_set_config_path(NULL);
+    ws_test_set_module_config_dir(NULL);
+    os_unlink(global_path.c_str());
+    os_unlink(secrets_path.c_str());
+    rmdir(dir);
+}
+
+int main(void) {
+    ws_test_set_log_level(LOG_ERROR - 1);
+
+    test_vectors();
+    test_obs_handshake();
+    test_remote_handshake();
+    test_no_token();
+    test_secrets_storage();
+
+    printf("%ld failed checks\n", ws_test_failures);
+    return ws_test_failures ? 1 : 0;
+}
@@ -0,0 +1,233 @@
+/*
+OBS WebSocket Relay - Endpoint Selection Test
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+// Remote endpoint selection: parsing the address list, the order endpoints are picked in by
+// probe results and configured order, failing over past endpoints that are waiting out the
+// reconnect interval, RTT failover with its hold-down, and list updates keeping what is known
+// about endpoints that stay
+
+#include "ws-relay-internal.h"
+#include "mock-lws.h"
+#include "test-relay.h"
+#include "test-support.h"
+#include <obs-module.h>
+#include <util/bmem.h>
+#include <string.h>
+
+#define TEST_RECONNECT_INTERVAL 5
+#define TEST_NOW 1000000
+
+static ws_test_relay_t test_relay_create(const char *remote) {
+    ws_relay_config_t config;
+    ws_relay_config_init(&config);
+    bfree(config.remote_ws_address);
+    config.remote_ws_address = bstrdup(remote);
+    config.reconnect_interval = TEST_RECONNECT_INTERVAL;
+    config.ping_interval = 0;
+    ws_test_relay_t test = ws_test_relay_create(&config);
+    ws_relay_config_free(&config);
+    return test;
+}
+
+static void set_remote(ws_relay_t *relay, const char *remote) {
+    bfree(relay->config.remote_ws_address);
+    relay->config.remote_ws_address = bstrdup(remote);
+    ws_endpoints_update(relay);
+}
+
+static const char *address(ws_relay_t *relay, int index) {
+    return index >= 0 ? relay->endpoints[index].address : "";
+}
+
+static void test_parse(void) {
+    ws_test_relay_t test = test_relay_create("");
+    ws_relay_t *relay = test.relay;
+
+    // Commas and whitespace separate entries; empty entries and repeats are dropped
+    set_remote(relay, " ws://a:1,,ws://b:2 \n wss://c:3\tws://a:1, ");
+    WS_CHECK(relay->endpoint_count == 3);
+    WS_CHECK(strcmp(address(relay, 0), "ws://a:1") == 0);
+    WS_CHECK(strcmp(address(relay, 1), "ws://b:2") == 0);
+    WS_CHECK(strcmp(address(relay, 2), "wss://c:3") == 0);
+    for (size_t i = 0; i < relay->endpoint_count; i++) {
+        WS_CHECK(relay->endpoints[i].rtt_us == -1);
+        WS_CHECK(!relay->endpoints[i].unreachable && relay->endpoints[i].failed_at == 0);
+    }
+
+    set_remote(relay, " , ");
+    WS_CHECK(relay->endpoint_count == 0 && relay->endpoints == NULL);
+    time_t retry_at = 0;
+    WS_CHECK(ws_endpoint_pick(relay, -1, TEST_NOW, &retry_at) == -1);
+    WS_CHECK(retry_at == 0);
+
+    ws_test_relay_destroy(&test);
+}
+
+static void test_pick_order(void) {
+    ws_test_relay_t test = test_relay_create("ws://a:1,ws://b:2,ws://c:3");
+    ws_relay_t *relay = test.relay;
+    ws_endpoint_t *a = &relay->endpoints[0];
+    ws_endpoint_t *b = &relay->endpoints[1];
+    ws_endpoint_t *c = &relay->endpoints[2];
+
+    // Before any probe the configured order decides
+    WS_CHECK(ws_endpoint_pick(relay, -1, TEST_NOW, NULL) == 0);
+    WS_CHECK(ws_endpoint_pick(relay, 0, TEST_NOW, NULL) == 1);
+
+    // A measured endpoint goes ahead of unprobed ones, the lowest RTT first
+    c->rtt_us = 40000;
+    WS_CHECK(ws_endpoint_pick(relay, -1, TEST_NOW, NULL) == 2);
+    b->rtt_us = 20000;
+    WS_CHECK(ws_endpoint_pick(relay, -1, TEST_NOW, NULL) == 1);
+    WS_CHECK(ws_endpoint_pick(relay, 1, TEST_NOW, NULL) == 2);
+
+    // Equal RTTs keep the configured order
+    c->rtt_us = 20000;
+    WS_CHECK(ws_endpoint_pick(relay, -1, TEST_NOW, NULL) == 1);
+
+    // Unreachable endpoints come after unprobed ones, in configured order among themselves
+    a->unreachable = true;
+    b->rtt_us = -1;
+    c->rtt_us = -1;
+    c->unreachable = true;
+    WS_CHECK(ws_endpoint_pick(relay, -1, TEST_NOW, NULL) == 1);
+    WS_CHECK(ws_endpoint_pick(relay, 1, TEST_NOW, NULL) == 0);
+    b->unreachable = true;
+    WS_CHECK(ws_endpoint_pick(relay, -1, TEST_NOW, NULL) == 0);
+
+    ws_test_relay_destroy(&test);
+}
+
+static void test_failover(void) {
+    ws_test_relay_t test = test_relay_create("ws://a:1,ws://b:2,ws://c:3");
+    ws_relay_t *relay = test.relay;
+
+    // Each failure moves on to the next endpoint in order
+    time_t now = TEST_NOW;
+    int picked[3];
+    for (int &index: picked) {
+        time_t retry_at = 0;
+        index = ws_endpoint_pick(relay, -1, now, &retry_at);
+        ws_endpoint_failed(relay, index, now);
+        now++;
+    }
+    WS_CHECK(picked[0] == 0 && picked[1] == 1 && picked[2] == 2);
+
+    // With all of them waiting, nothing is picked and the earliest retry is reported
+    time_t retry_at = 0;
+    WS_CHECK(ws_endpoint_pick(relay, -1, now, &retry_at) == -1);
+    WS_CHECK(retry_at == TEST_NOW + TEST_RECONNECT_INTERVAL);
+
+    // Once its interval is over the first endpoint is eligible again, the others still wait
+    now = TEST_NOW + TEST_RECONNECT_INTERVAL;
+    retry_at = 0;
+    WS_CHECK(ws_endpoint_pick(relay, -1, now, &retry_at) == 0);
+    WS_CHECK(ws_endpoint_pick(relay, 0, now, &retry_at) == -1);
+    WS_CHECK(retry_at == TEST_NOW + 1 + TEST_RECONNECT_INTERVAL);
+
+    // A connection clears the failure; out of range indices are ignored
+    ws_endpoint_connected(relay, 2);
+    WS_CHECK(relay->endpoints[2].failed_at == 0);
+    WS_CHECK(ws_endpoint_pick(relay, 0, now, NULL) == 2);
+    ws_endpoint_failed(relay, 3, now);
+    ws_endpoint_failed(relay, -1, now);
+    ws_endpoint_connected(relay, 3);
+
+    ws_test_relay_destroy(&test);
+}
+
+static void test_degraded(void) {
+    ws_test_relay_t test = test_relay_create("ws://a:1,ws://b:2,ws://c:3");
+    ws_relay_t *relay = test.relay;
+    relay->config.failover_rtt_ms = 100;
+    relay->endpoint_active = 0;
+    relay->last_endpoint_switch = TEST_NOW - WS_ENDPOINT_SWITCH_HOLDDOWN;
+    relay->endpoints[0].rtt_us = 150000;
+    relay->endpoints[1].rtt_us = 120000;
+    relay->endpoints[2].rtt_us = 60000;
+    WS_CHECK(relay->remote_conn.state == WS_STATE_CONNECTED);
+
+    // Past the threshold, the best endpoint below it
+    WS_CHECK(ws_endpoint_degraded(relay, TEST_NOW) == 2);
+
+    // Not while the new endpoint is settling, a switch is under way or failover is off
+    WS_CHECK(ws_endpoint_degraded(relay, TEST_NOW - 1) == -1);
+    relay->remote_switch_pending = true;
+    WS_CHECK(ws_endpoint_degraded(relay, TEST_NOW) == -1);
+    relay->remote_switch_pending = false;
+    relay->config.failover_rtt_ms = 0;
+    WS_CHECK(ws_endpoint_degraded(relay, TEST_NOW) == -1);
+    relay->config.failover_rtt_ms = 100;
+
+    // Not if the active endpoint is within the threshold, or no other one is below it
+    relay->endpoints[0].rtt_us = 100000;
+    WS_CHECK(ws_endpoint_degraded(relay, TEST_NOW) == -1);
+    relay->endpoints[0].rtt_us = 150000;
+    relay->endpoints[2].rtt_us = 100000;
+    WS_CHECK(ws_endpoint_degraded(relay, TEST_NOW) == -1);
+
+    // An endpoint below the threshold that is waiting out a failure is passed over
+    relay->endpoints[2].rtt_us = 60000;
+    ws_endpoint_failed(relay, 2, TEST_NOW);
+    WS_CHECK(ws_endpoint_degraded(relay, TEST_NOW) == -1);
+    relay->endpoints[1].rtt_us = 80000;
+    WS_CHECK(ws_endpoint_degraded(relay, TEST_NOW) == 1);
+
+    ws_test_relay_destroy(&test);
+}
+
+static void test_update(void) {
+    ws_test_relay_t test = test_relay_create("ws://a:1,ws://b:2,ws://c:3");
+    ws_relay_t *relay = test.relay;
+    relay->endpoints[1].rtt_us = 30000;
+    relay->endpoints[2].unreachable = true;
+    relay->endpoints[2].failed_at = TEST_NOW;
+    relay->endpoint_active = 1;
+    relay->endpoint_standby = 2;
+
+    // Endpoints that stay keep their results and connections, wherever they move in the list
+    set_remote(relay, "ws://c:3,ws://d:4,ws://b:2");
+    WS_CHECK(relay->endpoint_count == 3);
+    WS_CHECK(strcmp(address(relay, relay->endpoint_active), "ws://b:2") == 0);
+    WS_CHECK(strcmp(address(relay, relay->endpoint_standby), "ws://c:3") == 0);
+    WS_CHECK(relay->endpoints[2].rtt_us == 30000);
+    WS_CHECK(relay->endpoints[0].unreachable && relay->endpoints[0].failed_at == TEST_NOW);
+    WS_CHECK(relay->endpoints[1].rtt_us == -1 && !relay->endpoints[1].unreachable);
+
+    // An endpoint that is dropped takes its connection's index with it
+    set_remote(relay, "ws://d:4,ws://b:2");
+    WS_CHECK(relay->endpoint_active == 1);
+    WS_CHECK(relay->endpoint_standby == -1);
+    set_remote(relay, "ws://d:4");
+    WS_CHECK(relay->endpoint_active == -1);
+
+    ws_test_relay_destroy(&test);
+}
+
+int main(void) {
+    ws_test_set_log_level(LOG_ERROR - 1);
+
+    test_parse();
+    test_pick_order();
+    test_failover();
+    test_degraded();
+    test_update();
+
+    printf("%ld failed checks\n", ws_test_failures);
+    return ws_test_failures ? 1 : 0;
+}
@@ -0,0 +1,247 @@
+/*
+OBS WebSocket Relay - Frame Encoder Test
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+// ws_frame_encode across the 7 bit, 16 bit and 64 bit length boundaries, then the coalescing write
+// path against the lws mock: messages around the batch limit must come out whole and in order,
+// with no batch over the limit and each frame under its own mask
+
+#include "ws-relay-internal.h"
+#include "mock-lws.h"
+#include "test-support.h"
+#include <obs-module.h>
+#include <set>
+#include <string>
+#include <vector>
+
+static const unsigned char test_mask[4] = {0x12, 0x34, 0x56, 0x78};
+
+static std::vector<unsigned char> test_payload(size_t len, unsigned seed) {
+    std::vector<unsigned char> payload(len);
+    for (size_t i = 0; i < len; i++) {
+        payload[i] = (unsigned char) (i * 31 + seed);
+    }
+    return payload;
+}
+
+// Encode a frame and compare its header with the expected bytes and its payload with the input
+static void check_frame(size_t len, bool binary, const std::vector<unsigned char> &header) {
+    std::vector<unsigned char> payload = test_payload(len, (unsigned) len);
+    // Room for the frame and a guard past it, so an overlong write shows up
+    std::vector<unsigned char> out(WS_FRAME_HEADER_MAX + len + 16, 0xee);
+    size_t written = ws_frame_encode(out.data(), binary, test_mask, payload.data(), len);
+
+    WS_CHECK(written == header.size() + 4 + len);
+    WS_CHECK(written <= WS_FRAME_HEADER_MAX + len);
+    if (written != header.size() + 4 + len) {
+        fprintf(stderr, "Frame of %zu bytes encoded as %zu\n", len, written);
+        return;
+    }
+    WS_CHECK(memcmp(out.data(), header.data(), header.size()) == 0);
+    WS_CHECK(memcmp(out.data() + header.size(), test_mask, 4) == 0);
+    WS_CHECK(out[written] == 0xee);
+
+    const unsigned char *masked = out.data() + header.size() + 4;
+    size_t mismatches = 0;
+    for (size_t i = 0; i < len; i++) {
+        if ((masked[i] ^ test_mask[i & 3]) != payload[i]) mismatches++;
+    }
+    WS_CHECK(mismatches == 0);
+
+    // The mock's decoder reads it back as the same message
+    mock_lws_write_t write = {LWS_WRITE_RAW, std::string((const char *) out.data(), written)};
+    std::vector<mock_lws_message_t> messages;
+    WS_CHECK(mock_lws_decode_write(write, messages));
+    WS_CHECK(messages.size() == 1 && messages[0].binary == binary &&
+             messages[0].payload == std::string(payload.begin(), payload.end()));
+}
+
+static void test_length_boundaries() {
+    for (bool binary: {false, true}) {
+        unsigned char op = binary ? 0x82 : 0x81;
+        check_frame(0, binary, {op, 0x80});
+        check_frame(1, binary, {op, 0x81});
+        check_frame(7, binary, {op, 0x87});
+        check_frame(125, binary, {op, 0xfd});
+        check_frame(126, binary, {op, 0xfe, 0x00, 0x7e});
+        check_frame(127, binary, {op, 0xfe, 0x00, 0x7f});
+        check_frame(65535, binary, {op, 0xfe, 0xff, 0xff});
+        check_frame(65536, binary, {op, 0xff, 0, 0, 0, 0, 0, 0x01, 0x00, 0x00});
+        check_frame(65537, binary, {op, 0xff, 0, 0, 0, 0, 0, 0x01, 0x00, 0x01});
+        check_frame(1024 * 1024 + 3, binary, {op, 0xff, 0, 0, 0, 0, 0, 0x10, 0x00, 0x03});
+    }
+
+    // Every payload length up to a few words, for the word-at-a-time masking and its tail
+    for (size_t len = 0; len < 40; len++) {
+        check_frame(len, false, {0x81, (unsigned char) (0x80 | len)});
+    }
+}
+
+typedef struct {
+    ws_relay_t *relay;
+    struct lws *obs;
+    struct lws *remote;
+} test_relay_t;
+
+static test_relay_t test_relay_create(int coalesce_kb) {
+    ws_relay_config_t config;
+    ws_relay_config_init(&config);
+    config.write_coalesce_kb = coalesce_kb;
+    config.max_queued_kb = 0;
+    config.ping_interval = 0;
+
+    test_relay_t test = {ws_relay_create(&config), mock_lws_create(), mock_lws_create()};
+    ws_relay_config_free(&config);
+
+    struct {
+        ws_connection_t *conn;
+        struct lws *wsi;
+        lws_callback_function *callback;
+    } sides[] = {{&test.relay->obs_conn, test.obs, ws_callback_obs},
+                 {&test.relay->remote_conn, test.remote, ws_callback_remote}};
+    for (auto &side: sides) {
+        side.conn->wsi = side.wsi;
+        side.conn->state = WS_STATE_CONNECTING;
+        lws_set_opaque_user_data(side.wsi, side.conn);
+        WS_CHECK(side.callback(side.wsi, LWS_CALLBACK_CLIENT_ESTABLISHED, NULL, NULL, 0) >= 0);
+    }
+    mock_lws_take_writes(test.remote);
+    return test;
+}
+
+static void test_relay_destroy(test_relay_t *test) {
+    for (struct lws *wsi: {test->obs, test->remote}) {
+        lws_callback_function *callback = wsi == test->obs ? ws_callback_obs : ws_callback_remote;
+        callback(wsi, LWS_CALLBACK_CLIENT_CLOSED, NULL, NULL, 0);
+        mock_lws_destroy(wsi);
+    }
+    ws_relay_destroy(test->relay);
+}
+
+// Messages from OBS of the given sizes, queued behind a stalled remote and then written in one go
+static void check_coalesced(int coalesce_kb, const std::vector<size_t> &sizes) {
+    test_relay_t test = test_relay_create(coalesce_kb);
+    size_t limit = (size_t) coalesce_kb * 1024;
+
+    std::vector<std::string> sent;
+    std::vector<unsigned char> buffer;
+    mock_lws_set_choked(test.remote, true);
+    for (size_t i = 0; i < sizes.size(); i++) {
+        std::vector<unsigned char> payload = test_payload(sizes[i], (unsigned) i);
+        buffer.assign(LWS_PRE, 0);
+        buffer.insert(buffer.end(), payload.begin(), payload.end());
+        sent.emplace_back(payload.begin(), payload.end());
+        mock_lws_set_fragment(test.obs, true, true, 0);
+        WS_CHECK(ws_callback_obs(test.obs, LWS_CALLBACK_CLIENT_RECEIVE, NULL, buffer.data() + LWS_PRE,
+                                 sizes[i]) >= 0);
+    }
+    mock_lws_set_choked(test.remote, false);
+    mock_lws_take_stats();
+    WS_CHECK(ws_callback_remote(test.remote, LWS_CALLBACK_CLIENT_WRITEABLE, NULL, NULL, 0) >= 0);
+    mock_lws_stats_t stats = mock_lws_take_stats();
+
+    std::vector<mock_lws_write_t> writes = mock_lws_take_writes(test.remote);
+    std::vector<mock_lws_message_t> received;
+    std::set<std::string> masks;
+    size_t frames = 0;
+    for (const mock_lws_write_t &write: writes) {
+        if (write.protocol != LWS_WRITE_RAW) {
+            WS_CHECK(write.protocol == LWS_WRITE_TEXT);
+            WS_CHECK(!limit || write.data.size() + WS_FRAME_HEADER_MAX > limit);
+            WS_CHECK(mock_lws_decode_write(write, received));
+            continue;
+        }
+
+        // Batches only hold what fits the limit, and each frame has a mask of its own
+        WS_CHECK(write.data.size() <= limit);
+        std::vector<mock_lws_message_t> batch;
+        WS_CHECK(mock_lws_decode_write(write, batch));
+        size_t pos = 0;
+        for (const mock_lws_message_t &msg: batch) {
+            size_t len = msg.payload.size();
+            pos += 2 + (len < 126 ? 0 : len <= 0xffff ? 2 : 8);
+            masks.insert(write.data.substr(pos, 4));
+            pos += 4 + len;
+            frames++;
+            received.push_back(msg);
+        }
+    }
+    WS_CHECK(masks.size() == frames);
+
+    WS_CHECK(received.size() == sent.size());
+    for (size_t i = 0; i < received.size() && i < sent.size(); i++) {
+        WS_CHECK(!received[i].binary);
+        WS_CHECK(received[i].payload == sent[i]);
+    }
+    WS_CHECK(stats.writes == writes.size());
+    WS_CHECK(test.relay->remote_conn.buffers.empty() && test.relay->remote_conn.queued_bytes == 0);
+
+    test_relay_destroy(&test);
+}
+
+static void test_coalescing() {
+    // Frames just fitting the 1 KiB limit on their own, and just not
+    size_t fits = 1024 - WS_FRAME_HEADER_MAX;
+    check_coalesced(1, {fits, fits, fits + 1, 1, fits + 1, fits});
+    check_coalesced(1, {300, 300, 300, 300, 2000, 300, 0, 125, 126});
+
+    // Around the 16 bit length boundary with the 128 KiB limit
+    check_coalesced(128, {125, 126, 65535, 65536, 65537, 10, 200000, 126});
+
+    // Many small messages, filling several batches exactly
+    std::vector<size_t> small(400, 300);
+    check_coalesced(16, small);
+
+    // Without coalescing every message is a text write of its own
+    check_coalesced(0, {1, 300, 65536, 5});
+}
+
+// A failed batch write drops the connection with its queue, as a failed single write does, and
+// the messages in the batch with it
+static void test_write_failure() {
+    test_relay_t test = test_relay_create(16);
+    std::vector<unsigned char> buffer(LWS_PRE + 100, 'm');
+
+    mock_lws_set_choked(test.remote, true);
+    for (int i = 0; i < 4; i++) {
+        mock_lws_set_fragment(test.obs, true, true, 0);
+        ws_callback_obs(test.obs, LWS_CALLBACK_CLIENT_RECEIVE, NULL, buffer.data() + LWS_PRE, 100);
+    }
+    mock_lws_set_choked(test.remote, false);
+    mock_lws_set_write_failure(test.remote, true);
+    WS_CHECK(ws_callback_remote(test.remote, LWS_CALLBACK_CLIENT_WRITEABLE, NULL, NULL, 0) < 0);
+    WS_CHECK(test.relay->remote_conn.buffers.empty() && test.relay->remote_conn.queued_bytes == 0);
+    WS_CHECK(test.relay->remote_conn.write_batch.size() == LWS_PRE);
+
+    // The batched messages never left, so they count as dropped rather than sent
+    ws_relay_direction_stats_t *stats = &test.relay->stats.to_remote;
+    WS_CHECK(stats->messages == 0 && stats->bytes == 0);
+    WS_CHECK(stats->dropped_messages == 4 && stats->dropped_bytes == 400);
+
+    test_relay_destroy(&test);
+}
+
+int main(void) {
+    ws_test_set_log_level(LOG_ERROR - 1);
+
+    test_length_boundaries();
+    test_coalescing();
+    test_write_failure();
+
+    printf("%ld failed checks\n", ws_test_failures);
+    return ws_test_failures ? 1 : 0;
+}
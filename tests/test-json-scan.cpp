@@ -0,0 +1,212 @@
+/*
+OBS WebSocket Relay - Message Scanner Test
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+// Every scanner variant the CPU runs must find the same fields as the scalar one. The SIMD
+// searches work in 16 and 32 byte blocks from where each search starts, so quotes, backslashes
+// and brackets are placed at every offset around the block edges, the buffer itself is moved
+// across alignments and every message is also scanned truncated at every length. Then the
+// decoding of the string fields it returns
+
+#include "ws-relay-internal.h"
+#include "test-support.h"
+#include <string>
+#include <vector>
+
+// Where each field was found, as offsets into the scanned buffer so buffers can be compared
+typedef struct {
+    bool complete;
+    int op;
+    long event_type, request_id, request_type, request_data;
+    size_t event_type_len, request_id_len, request_type_len, request_data_len;
+} scan_result_t;
+
+static long field_offset(const char *field, const char *data) {
+    return field ? (long) (field - data) : -1;
+}
+
+static scan_result_t scan_with(size_t variant, const char *data, size_t len) {
+    ws_json_fields_t fields;
+    scan_result_t result;
+    result.complete = ws_json_scan_variant(variant, data, len, &fields);
+    result.op = fields.op;
+    result.event_type = field_offset(fields.event_type, data);
+    result.request_id = field_offset(fields.request_id, data);
+    result.request_type = field_offset(fields.request_type, data);
+    result.request_data = field_offset(fields.request_data, data);
+    result.event_type_len = fields.event_type_len;
+    result.request_id_len = fields.request_id_len;
+    result.request_type_len = fields.request_type_len;
+    result.request_data_len = fields.request_data_len;
+    return result;
+}
+
+static bool same_result(const scan_result_t &a, const scan_result_t &b) {
+    return a.complete == b.complete && a.op == b.op && a.event_type == b.event_type &&
+           a.request_id == b.request_id && a.request_type == b.request_type && a.request_data == b.request_data &&
+           a.event_type_len == b.event_type_len && a.request_id_len == b.request_id_len &&
+           a.request_type_len == b.request_type_len && a.request_data_len == b.request_data_len;
+}
+
+static long scans = 0;
+
+// Scan an exact size copy with every variant and compare against scalar
+static scan_result_t scan_all(const char *data, size_t len) {
+    std::vector<char> buffer(data, data + len);
+    scan_result_t expected = scan_with(0, buffer.data(), len);
+    for (size_t variant = 1; variant < ws_json_scan_variant_count(); variant++) {
+        scan_result_t result = scan_with(variant, buffer.data(), len);
+        if (!same_result(result, expected)) {
+            fprintf(stderr, "%s differs from scalar on: %.*s\n", ws_json_scan_variant_name(variant), (int) len,
+                    data);
+            WS_CHECK(same_result(result, expected));
+        }
+    }
+    scans++;
+    return expected;
+}
+
+// A message, then every truncation of it and the message at every buffer alignment up to 64
+static scan_result_t scan_message(const std::string &msg) {
+    for (size_t len = 0; len < msg.size(); len++) {
+        scan_result_t truncated = scan_all(msg.data(), len);
+        WS_CHECK(!truncated.complete);
+    }
+
+    std::vector<char> shifted(msg.size() + 64);
+    for (size_t shift = 1; shift < 64; shift++) {
+        memcpy(shifted.data() + shift, msg.data(), msg.size());
+        scan_all(shifted.data() + shift, msg.size());
+    }
+    return scan_all(msg.data(), msg.size());
+}
+
+static std::string field_at(const std::string &msg, long offset, size_t len) {
+    return offset < 0 ? std::string() : msg.substr((size_t) offset, len);
+}
+
+static void test_known_messages() {
+    std::string event = "{\"op\": 5, \"d\": {\"eventType\": \"InputVolumeMeters\", \"eventIntent\": 65536, "
+                        "\"eventData\": {\"inputs\": [{\"inputName\": \"Mic\", \"inputLevelsMul\": [[0.1, 0.2]]}]}}}";
+    scan_result_t result = scan_message(event);
+    WS_CHECK(result.complete && result.op == 5);
+    WS_CHECK(field_at(event, result.event_type, result.event_type_len) == "InputVolumeMeters");
+
+    std::string request = "{\"op\":6,\"d\":{\"requestType\":\"SetInputSettings\",\"requestId\":\"a\\\"b\","
+                          "\"requestData\":{\"inputName\":\"x\",\"inputSettings\":{\"text\":\"}\\\\\"}}}}";
+    result = scan_message(request);
+    WS_CHECK(result.complete && result.op == 6);
+    WS_CHECK(field_at(request, result.request_type, result.request_type_len) == "SetInputSettings");
+    WS_CHECK(field_at(request, result.request_id, result.request_id_len) == "a\\\"b");
+    WS_CHECK(field_at(request, result.request_data, result.request_data_len) ==
+             "{\"inputName\":\"x\",\"inputSettings\":{\"text\":\"}\\\\\"}}");
+
+    // Keys that only match at the top level or inside "d" are ignored elsewhere
+    std::string nested = "{\"d\":{\"x\":{\"requestId\":\"no\"},\"requestId\":\"yes\"},\"x\":{\"op\":1},\"op\":9}";
+    result = scan_message(nested);
+    WS_CHECK(result.complete && result.op == 9);
+    WS_CHECK(field_at(nested, result.request_id, result.request_id_len) == "yes");
+
+    std::string batch = "[{\"op\":8}]";
+    result = scan_message(batch);
+    WS_CHECK(!result.complete && result.op == -1);
+}
+
+// Quotes and backslashes inside a string value at every offset from where the search for the
+// string's end starts, around both the 16 and the 32 byte block edges
+static void test_string_specials() {
+    static const char *const specials[] = {"\\\"", "\\\\", "\\\\\\\"", "\\n", "\\u0022"};
+
+    for (size_t offset = 0; offset <= 66; offset++) {
+        for (const char *special: specials) {
+            std::string value = std::string(offset, 'a') + special + std::string(70 - offset, 'b');
+            std::string msg = "{\"op\":7,\"d\":{\"requestId\":\"" + value + "\",\"requestType\":\"T\"}}";
+            scan_result_t result = scan_message(msg);
+            WS_CHECK(result.complete && result.op == 7);
+            WS_CHECK(field_at(msg, result.request_id, result.request_id_len) == value);
+            WS_CHECK(field_at(msg, result.request_type, result.request_type_len) == "T");
+
+            // The same string where the scanner skips it without extracting it
+            msg = "{\"op\":7,\"d\":{\"comment\":\"" + value + "\",\"requestId\":\"r\"}}";
+            result = scan_message(msg);
+            WS_CHECK(field_at(msg, result.request_id, result.request_id_len) == "r");
+        }
+
+        // A string ending exactly at the offset, and a backslash as its last byte
+        std::string value(offset, 'c');
+        std::string msg = "{\"d\":{\"eventType\":\"" + value + "\"},\"op\":5}";
+        scan_result_t result = scan_message(msg);
+        WS_CHECK(result.complete && result.op == 5);
+        WS_CHECK(field_at(msg, result.event_type, result.event_type_len) == value);
+
+        msg = "{\"d\":{\"eventType\":\"" + value + "\\";
+        result = scan_message(msg);
+        WS_CHECK(!result.complete && result.event_type < 0);
+    }
+}
+
+// Structural characters after runs of non-structural bytes of every length
+static void test_structural_offsets() {
+    for (size_t offset = 0; offset <= 66; offset++) {
+        std::string gap(offset, ' ');
+        std::string number = "1" + std::string(offset, '0');
+        std::string msg = "{\"x\":" + number + "," + gap + "\"op\":" + "6" + gap + ",\"d\":{\"a\":[" + number +
+                          "," + gap + "true]" + gap + ",\"requestType\":\"R\"" + gap + "}" + gap + "}";
+        scan_result_t result = scan_message(msg);
+        WS_CHECK(result.complete && result.op == 6);
+        WS_CHECK(field_at(msg, result.request_type, result.request_type_len) == "R");
+    }
+}
+
+// String contents the scanner returns, decoded the way in-process requests hand request types on
+static void test_unescape() {
+    struct {
+        const char *escaped;
+        const char *decoded;
+    } cases[] = {
+        {"GetVersion", "GetVersion"},
+        {"a\\\"b\\\\c\\/d", "a\"b\\c/d"},
+        {"\\b\\f\\n\\r\\t", "\b\f\n\r\t"},
+        {"\\u0041\\u00e9\\u20AC", "A\xc3\xa9\xe2\x82\xac"},
+        {"\\ud83d\\ude00", "\xf0\x9f\x98\x80"},
+        // Lone surrogates
+        {"\\ud83dx", "\xef\xbf\xbdx"},
+        {"\\ude00", "\xef\xbf\xbd"},
+        // Malformed escapes stay as they are
+        {"\\x\\u12", "\\x\\u12"},
+        {"end\\", "end\\"},
+    };
+    for (const auto &c: cases) {
+        WS_CHECK(ws_json_unescape(c.escaped, strlen(c.escaped)) == c.decoded);
+    }
+}
+
+int main(void) {
+    printf("Scanner variants:");
+    for (size_t variant = 0; variant < ws_json_scan_variant_count(); variant++) {
+        printf(" %s", ws_json_scan_variant_name(variant));
+    }
+    printf("\n");
+
+    test_known_messages();
+    test_string_specials();
+    test_structural_offsets();
+    test_unescape();
+
+    printf("%ld scans, %ld failed checks\n", scans, ws_test_failures);
+    return ws_test_failures ? 1 : 0;
+}
@@ -0,0 +1,306 @@
+/*
+OBS WebSocket Relay - Latency Stamping Test
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+// Latency stamping on the multiplexed connection against the lws mock: the relay clock in the
+// header of data for the remote, the clock exchange from request to the offset announcement with
+// the lowest round trip picked among recent exchanges, and one-way latencies taken from the
+// stamps of data from the remote, across the wrap of the 32 bit stamp. The remote's clock is
+// played by the test, so results are checked against bounds from the relay clock read around
+// each step
+
+#include "ws-relay-internal.h"
+#include "mock-lws.h"
+#include "test-relay.h"
+#include "test-support.h"
+#include <obs-module.h>
+#include <util/platform.h>
+#include <string>
+#include <vector>
+
+#define TEST_CHANNEL 3
+#define TEST_SENT_AGO_US 3000
+
+typedef struct {
+    int type;
+    uint32_t value;
+    std::string payload;
+} test_frame_t;
+
+static uint64_t clock_us(void) {
+    return os_gettime_ns() / 1000;
+}
+
+static void put_u64(std::string &out, uint64_t value) {
+    for (int i = 56; i >= 0; i -= 8) {
+        out.push_back((char) (value >> i));
+    }
+}
+
+static uint64_t get_u64(const std::string &in, size_t offset) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < 8; i++) {
+        value = (value << 8) | (unsigned char) in[offset + i];
+    }
+    return value;
+}
+
+static std::string mux_frame(ws_mux_frame_type_t type, uint32_t value, const std::string &payload) {
+    std::string frame(WS_MUX_HEADER_SIZE, '\0');
+    ws_mux_put_header((unsigned char *) &frame[0], type, TEST_CHANNEL, value);
+    return frame + payload;
+}
+
+// Frames the relay wrote to the remote since the last call
+static std::vector<test_frame_t> to_remote(ws_test_relay_t *test) {
+    ws_callback_remote(test->remote, LWS_CALLBACK_CLIENT_WRITEABLE, NULL, NULL, 0);
+    std::vector<mock_lws_message_t> messages;
+    for (const mock_lws_write_t &write: mock_lws_take_writes(test->remote)) {
+        WS_CHECK(mock_lws_decode_write(write, messages));
+    }
+
+    std::vector<test_frame_t> frames;
+    for (const mock_lws_message_t &msg: messages) {
+        WS_CHECK(msg.binary && msg.payload.size() >= WS_MUX_HEADER_SIZE);
+        if (msg.payload.size() < WS_MUX_HEADER_SIZE) continue;
+
+        const unsigned char *header = (const unsigned char *) msg.payload.data();
+        WS_CHECK(header[0] == WS_MUX_VERSION && ((header[2] << 8) | header[3]) == TEST_CHANNEL);
+        frames.push_back({header[1],
+                          (uint32_t) header[4] << 24 | (uint32_t) header[5] << 16 | (uint32_t) header[6] << 8 | header[7],
+                          msg.payload.substr(WS_MUX_HEADER_SIZE)});
+    }
+    return frames;
+}
+
+static ws_test_relay_t test_relay_create(bool stamping) {
+    ws_relay_config_t config;
+    ws_relay_config_init(&config);
+    config.mux_channel = TEST_CHANNEL;
+    config.latency_stamping = stamping;
+    config.ping_interval = 0;
+    ws_test_relay_t test = ws_test_relay_create(&config);
+    ws_relay_config_free(&config);
+    to_remote(&test);
+    return test;
+}
+
+static void maintain(ws_relay_t *relay) {
+    pthread_mutex_lock(&relay->mutex);
+    ws_mux_maintain(relay);
+    pthread_mutex_unlock(&relay->mutex);
+}
+
+// Start a clock exchange and return its t1, 0 if no request went out
+static uint64_t clock_request(ws_test_relay_t *test) {
+    // The exchange interval is over
+    test->relay->mux.clock_request_ns = 0;
+    uint64_t before = clock_us();
+    maintain(test->relay);
+    uint64_t after = clock_us();
+
+    std::vector<test_frame_t> frames = to_remote(test);
+    WS_CHECK(frames.size() == 1);
+    if (frames.size() != 1) return 0;
+    WS_CHECK(frames[0].type == WS_MUX_CLOCK && frames[0].value == WS_MUX_CLOCK_REQUEST);
+    WS_CHECK(frames[0].payload.size() == 8);
+    uint64_t t1 = frames[0].payload.size() == 8 ? get_u64(frames[0].payload, 0) : 0;
+    WS_CHECK(t1 >= before && t1 <= after);
+    return t1;
+}
+
+// Answer a clock request as the remote would, with its receive and send times
+static void clock_respond(ws_test_relay_t *test, uint64_t t1, uint64_t t2, uint64_t t3) {
+    std::string payload;
+    put_u64(payload, t1);
+    put_u64(payload, t2);
+    put_u64(payload, t3);
+    WS_CHECK(ws_test_from_remote(test, mux_frame(WS_MUX_CLOCK, WS_MUX_CLOCK_RESPONSE, payload)) >= 0);
+}
+
+// Check the offset the relay announced against the one it keeps
+static void check_announced(ws_test_relay_t *test) {
+    ws_relay_direction_stats_t *stats = &test->relay->stats.to_remote;
+    std::vector<test_frame_t> frames = to_remote(test);
+    WS_CHECK(frames.size() == 1);
+    if (frames.size() != 1) return;
+    WS_CHECK(frames[0].type == WS_MUX_CLOCK && frames[0].value == WS_MUX_CLOCK_OFFSET);
+    WS_CHECK(frames[0].payload.size() == 16);
+    if (frames[0].payload.size() != 16) return;
+    WS_CHECK((int64_t) get_u64(frames[0].payload, 0) == stats->clock_offset_us);
+    WS_CHECK(get_u64(frames[0].payload, 8) == stats->clock_delay_us);
+}
+
+// Make the remote clock run offset_us ahead of the relay's, as far as the relay can tell
+static void clock_sync(ws_test_relay_t *test, uint64_t offset_us) {
+    uint64_t t1 = clock_request(test);
+    clock_respond(test, t1, t1 + offset_us, t1 + offset_us);
+    to_remote(test);
+}
+
+static void test_stamp(void) {
+    // Data for the remote carries the relay clock when it was queued
+    ws_test_relay_t test = test_relay_create(true);
+    uint32_t before = (uint32_t) clock_us();
+    WS_CHECK(ws_test_from_obs(&test, "{\"op\":5,\"d\":{}}") >= 0);
+    uint32_t after = (uint32_t) clock_us();
+    std::vector<test_frame_t> frames = to_remote(&test);
+    WS_CHECK(frames.size() == 1);
+    if (frames.size() == 1) {
+        WS_CHECK(frames[0].type == WS_MUX_DATA && frames[0].payload == "{\"op\":5,\"d\":{}}");
+        WS_CHECK(frames[0].value != 0 && frames[0].value - before <= after - before);
+    }
+    ws_test_relay_destroy(&test);
+
+    // Without stamping, data goes unstamped and no clock exchange starts
+    test = test_relay_create(false);
+    WS_CHECK(ws_test_from_obs(&test, "{\"op\":5,\"d\":{}}") >= 0);
+    frames = to_remote(&test);
+    WS_CHECK(frames.size() == 1 && frames[0].value == 0);
+    maintain(test.relay);
+    WS_CHECK(to_remote(&test).empty());
+    ws_test_relay_destroy(&test);
+}
+
+static void test_clock_exchange(void) {
+    ws_test_relay_t test = test_relay_create(true);
+    ws_relay_direction_stats_t *stats = &test.relay->stats.to_remote;
+
+    // One request per interval
+    uint64_t t1 = clock_request(&test);
+    maintain(test.relay);
+    WS_CHECK(to_remote(&test).empty());
+
+    // Responses that are cut short or answer another request are ignored
+    std::string payload;
+    put_u64(payload, t1);
+    put_u64(payload, t1);
+    WS_CHECK(ws_test_from_remote(&test, mux_frame(WS_MUX_CLOCK, WS_MUX_CLOCK_RESPONSE, payload)) >= 0);
+    clock_respond(&test, t1 + 1, t1, t1);
+    WS_CHECK(stats->clock_exchanges == 0 && !test.relay->mux.clock_valid);
+    WS_CHECK(to_remote(&test).empty());
+
+    // The remote clock a second ahead, answering at once: the round trip is the time until the
+    // response arrived, and the offset is a second less half of it
+    clock_respond(&test, t1, t1 + 1000000, t1 + 1000000);
+    uint64_t t4_max = clock_us();
+    WS_CHECK(stats->clock_exchanges == 1 && test.relay->mux.clock_valid);
+    WS_CHECK(stats->clock_delay_us <= t4_max - t1);
+    WS_CHECK(stats->clock_offset_us <= 1000000 && stats->clock_offset_us >= 1000000 - (int64_t) (t4_max - t1) / 2 - 1);
+    check_announced(&test);
+
+    // A second response to the same request is ignored
+    clock_respond(&test, t1, t1 + 5000000, t1 + 5000000);
+    WS_CHECK(stats->clock_exchanges == 1);
+    WS_CHECK(to_remote(&test).empty());
+
+    // The remote held this one for 10 s, so its round trip comes out at 0, the lowest there is
+    t1 = clock_request(&test);
+    clock_respond(&test, t1, t1 + 2000000, t1 + 12000000);
+    t4_max = clock_us();
+    WS_CHECK(stats->clock_exchanges == 2 && stats->clock_delay_us == 0);
+    WS_CHECK(stats->clock_offset_us <= 7000000 && stats->clock_offset_us >= 7000000 - (int64_t) (t4_max - t1) / 2 - 1);
+    check_announced(&test);
+
+    // Later exchanges, their round trip stretched by a millisecond the remote reports, leave it in
+    // place until it is no longer among the recent ones
+    for (int i = 0; i < WS_MUX_CLOCK_SAMPLES - 1; i++) {
+        t1 = clock_request(&test);
+        clock_respond(&test, t1, t1 + 3000000, t1 + 2999000);
+        WS_CHECK(stats->clock_offset_us > 6000000 && stats->clock_delay_us == 0);
+        check_announced(&test);
+    }
+    t1 = clock_request(&test);
+    clock_respond(&test, t1, t1 + 3000000, t1 + 2999000);
+    WS_CHECK(stats->clock_delay_us >= 1000);
+    WS_CHECK(stats->clock_offset_us <= 3000000 && stats->clock_offset_us > 2000000);
+    WS_CHECK(stats->clock_exchanges == WS_MUX_CLOCK_SAMPLES + 2);
+    check_announced(&test);
+
+    ws_test_relay_destroy(&test);
+}
+
+// Deliver data stamped sent_ago_us before now in the remote clock; returns the bound on the
+// latency the relay may have measured beyond sent_ago_us
+static uint64_t from_remote_stamped(ws_test_relay_t *test, int64_t sent_ago_us) {
+    uint64_t before = clock_us();
+    uint32_t stamp = (uint32_t) (before + (uint64_t) test->relay->mux.clock_offset_us - (uint64_t) sent_ago_us);
+    WS_CHECK(ws_test_from_remote(test, mux_frame(WS_MUX_DATA, stamp, "{\"op\":6,\"d\":{}}")) >= 0);
+    uint64_t slack = clock_us() - before;
+    WS_CHECK(ws_test_to_obs(test) == std::vector<std::string>({"{\"op\":6,\"d\":{}}"}));
+    return slack;
+}
+
+static void test_one_way(void) {
+    ws_test_relay_t test = test_relay_create(true);
+    ws_relay_direction_stats_t *stats = &test.relay->stats.to_obs;
+
+    // Stamps are not read before the clock offset is known, and 0 is unstamped
+    from_remote_stamped(&test, TEST_SENT_AGO_US);
+    WS_CHECK(stats->one_way_messages == 0);
+    clock_sync(&test, 1000000);
+    WS_CHECK(ws_test_from_remote(&test, mux_frame(WS_MUX_DATA, 0, "{}")) >= 0);
+    ws_test_to_obs(&test);
+    WS_CHECK(stats->one_way_messages == 0);
+
+    uint64_t slack = from_remote_stamped(&test, TEST_SENT_AGO_US);
+    WS_CHECK(stats->one_way_messages == 1);
+    WS_CHECK(stats->one_way_last_us >= TEST_SENT_AGO_US && stats->one_way_last_us <= TEST_SENT_AGO_US + slack);
+    WS_CHECK(stats->one_way_max_us == stats->one_way_last_us);
+
+    // With the offset an estimate, a message may seem to arrive before it was sent
+    from_remote_stamped(&test, -100000);
+    WS_CHECK(stats->one_way_messages == 2 && stats->one_way_last_us <= slack);
+
+    uint64_t bucketed = 0;
+    for (uint64_t count: stats->one_way_histogram) {
+        bucketed += count;
+    }
+    WS_CHECK(bucketed == 2 && stats->one_way_histogram[0] == 1);
+    ws_test_relay_destroy(&test);
+
+    // The remote clock wrapped the stamp width just after the message was sent. A fresh relay, so
+    // that no earlier exchange with a lower round trip keeps its offset
+    test = test_relay_create(true);
+    stats = &test.relay->stats.to_obs;
+    uint64_t wrap = 1ULL << 32;
+    uint64_t now = clock_us();
+    clock_sync(&test, wrap - now % wrap + TEST_SENT_AGO_US / 2);
+    WS_CHECK((uint32_t) (clock_us() + (uint64_t) test.relay->mux.clock_offset_us) < 10 * TEST_SENT_AGO_US);
+    slack = from_remote_stamped(&test, TEST_SENT_AGO_US);
+    WS_CHECK(stats->one_way_messages == 1);
+    WS_CHECK(stats->one_way_last_us >= TEST_SENT_AGO_US && stats->one_way_last_us <= TEST_SENT_AGO_US + slack);
+    ws_test_relay_destroy(&test);
+
+    // Without stamping, stamped data is passed on and not measured
+    test = test_relay_create(false);
+    test.relay->mux.clock_valid = true;
+    from_remote_stamped(&test, TEST_SENT_AGO_US);
+    WS_CHECK(test.relay->stats.to_obs.one_way_messages == 0);
+    ws_test_relay_destroy(&test);
+}
+
+int main(void) {
+    ws_test_set_log_level(LOG_ERROR - 1);
+
+    test_stamp();
+    test_clock_exchange();
+    test_one_way();
+
+    printf("%ld failed checks\n", ws_test_failures);
+    return ws_test_failures ? 1 : 0;
+}
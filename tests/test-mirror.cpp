@@ -0,0 +1,462 @@
+/*
+OBS WebSocket Relay - OBS State Mirror Test
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+// The OBS state mirror against the lws mock, with obs-websocket's plugin API answering its
+// fetches from a canned OBS state: seeding, events applied in place without a fetch, events that
+// only mark their part to be fetched again, events arriving during a fetch applied on top of its
+// result, and the mirror dropping out of live mode when events stop covering it, then seeding
+// again once they do
+
+#include "ws-relay-internal.h"
+#include "mock-lws.h"
+#include "test-relay.h"
+#include "test-support.h"
+#include <obs-module.h>
+#include <plugin-support.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <initializer_list>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+
+#define TEST_SUBSCRIPTIONS 0x7FF // obs-websocket's EventSubscription::All
+#define TEST_SUBSCRIPTION_TRANSFORMS (1 << 19)
+#define TEST_SETTLE_MS 5000
+
+// Layout of obs-websocket's plugin API response, as obs-websocket-api.h declares it
+struct obs_websocket_request_response {
+    unsigned int status_code;
+    char *comment;
+    char *response_data;
+};
+
+// The canned OBS state: response data by request type and the scene or source it is about. The
+// plugin API is called on the mirror's worker thread
+static pthread_mutex_t obs_lock = PTHREAD_MUTEX_INITIALIZER;
+static std::map<std::string, std::string> obs_state;
+static std::vector<std::string> obs_requests;
+
+static std::string obs_key(const char *type, const char *name) {
+    return name && *name ? std::string(type) + " " + name : std::string(type);
+}
+
+static void obs_set(const char *type, const char *name, const std::string &response_data) {
+    pthread_mutex_lock(&obs_lock);
+    obs_state[obs_key(type, name)] = response_data;
+    pthread_mutex_unlock(&obs_lock);
+}
+
+// Requests made since the last call, in the form of obs_state's keys
+static std::set<std::string> obs_take_requests(void) {
+    pthread_mutex_lock(&obs_lock);
+    std::set<std::string> requests(obs_requests.begin(), obs_requests.end());
+    obs_requests.clear();
+    pthread_mutex_unlock(&obs_lock);
+    return requests;
+}
+
+static void obs_call_request(void *data, calldata_t *cd) {
+    UNUSED_PARAMETER(data);
+    const char *type = calldata_string(cd, "request_type");
+    const char *request_data = calldata_string(cd, "request_data");
+
+    std::string name;
+    obs_data_t *request = request_data ? obs_data_create_from_json(request_data) : NULL;
+    if (request) {
+        name = obs_data_get_string(request, obs_data_has_user_value(request, "sceneName") ? "sceneName" : "sourceName");
+        obs_data_release(request);
+    }
+    std::string key = obs_key(type, name.c_str());
+
+    auto *response = (obs_websocket_request_response *) bzalloc(sizeof(obs_websocket_request_response));
+    pthread_mutex_lock(&obs_lock);
+    obs_requests.push_back(key);
+    auto it = obs_state.find(key);
+    if (it != obs_state.end()) {
+        response->status_code = 100;
+        response->response_data = bstrdup(it->second.c_str());
+    } else {
+        // ResourceNotFound
+        response->status_code = 600;
+    }
+    pthread_mutex_unlock(&obs_lock);
+    calldata_set_ptr(cd, "response", response);
+}
+
+static void obs_get_api_ph(void *data, calldata_t *cd) {
+    calldata_set_ptr(cd, "ph", data);
+}
+
+static void obs_reset(void) {
+    pthread_mutex_lock(&obs_lock);
+    obs_state.clear();
+    obs_requests.clear();
+    pthread_mutex_unlock(&obs_lock);
+
+    obs_set("GetSceneList", NULL,
+            "{\"currentProgramSceneName\":\"Main\",\"currentPreviewSceneName\":\"Main\",\"scenes\":"
+            "[{\"sceneName\":\"Break\",\"sceneIndex\":0},{\"sceneName\":\"Main\",\"sceneIndex\":1}]}");
+    obs_set("GetInputList", NULL, "{\"inputs\":[{\"inputName\":\"Mic\",\"inputKind\":\"pulse_input_capture\"}]}");
+    obs_set("GetSceneTransitionList", NULL,
+            "{\"currentSceneTransitionName\":\"Fade\",\"currentSceneTransitionDuration\":300,\"transitions\":"
+            "[{\"transitionName\":\"Fade\",\"transitionKind\":\"fade_transition\"}]}");
+    obs_set("GetSceneItemList", "Main",
+            "{\"sceneItems\":[{\"sceneItemId\":1,\"sourceName\":\"Mic\",\"sceneItemEnabled\":true,"
+            "\"sceneItemLocked\":false}]}");
+    obs_set("GetSceneItemList", "Break", "{\"sceneItems\":[]}");
+    obs_set("GetSourceFilterList", "Main", "{\"filters\":[]}");
+    obs_set("GetSourceFilterList", "Break", "{\"filters\":[]}");
+    obs_set("GetSourceFilterList", "Mic",
+            "{\"filters\":[{\"filterName\":\"Gain\",\"filterEnabled\":true,\"filterSettings\":{\"db\":2}}]}");
+}
+
+static std::string event(const std::string &type, const std::string &data) {
+    return "{\"op\":5,\"d\":{\"eventType\":\"" + type + "\",\"eventIntent\":1,\"eventData\":" + data + "}}";
+}
+
+static std::string reidentify(int64_t subscriptions) {
+    return "{\"op\":3,\"d\":{\"eventSubscriptions\":" + std::to_string(subscriptions) + "}}";
+}
+
+static bool mirror_live(ws_relay_t *relay) {
+    ws_relay_direction_stats_t stats = {};
+    ws_mirror_get_stats(relay, &stats);
+    return stats.mirror_live != 0;
+}
+
+// Wait for the worker to hand its result over, then install it as the service thread does
+static bool settle(ws_relay_t *relay) {
+    for (int waited = 0; !ws_mirror_result_ready(relay); waited++) {
+        if (waited >= TEST_SETTLE_MS) return false;
+        os_sleep_ms(1);
+    }
+    pthread_mutex_lock(&relay->mutex);
+    ws_mirror_flush(relay);
+    pthread_mutex_unlock(&relay->mutex);
+    return true;
+}
+
+// The mirror's snapshot, NULL unless it is current; release it after use
+static obs_data_t *snapshot(ws_relay_t *relay) {
+    pthread_mutex_lock(&relay->mutex);
+    char *json = ws_mirror_get_snapshot(relay);
+    pthread_mutex_unlock(&relay->mutex);
+    obs_data_t *data = json ? obs_data_create_from_json(json) : NULL;
+    bfree(json);
+    return data;
+}
+
+// The object at path in data, where numbers index the array named before them; release it after use
+static obs_data_t *at(obs_data_t *data, std::initializer_list<const char *> path) {
+    obs_data_t *current = data;
+    if (current) obs_data_addref(current);
+    obs_data_array_t *array = NULL;
+    for (const char *name: path) {
+        obs_data_t *next = NULL;
+        if (array) {
+            size_t index = strtoul(name, NULL, 10);
+            next = index < obs_data_array_count(array) ? obs_data_array_item(array, index) : NULL;
+            obs_data_array_release(array);
+            array = NULL;
+        } else if (current) {
+            next = obs_data_get_obj(current, name);
+            if (!next) array = obs_data_get_array(current, name);
+        }
+        obs_data_release(current);
+        current = next;
+    }
+    obs_data_array_release(array);
+    return current;
+}
+
+static std::string string_at(obs_data_t *data, std::initializer_list<const char *> path, const char *key) {
+    obs_data_t *obj = at(data, path);
+    std::string value = obj && obs_data_has_user_value(obj, key) ? obs_data_get_string(obj, key) : "<missing>";
+    obs_data_release(obj);
+    return value;
+}
+
+static long long int_at(obs_data_t *data, std::initializer_list<const char *> path, const char *key) {
+    obs_data_t *obj = at(data, path);
+    long long value = obj && obs_data_has_user_value(obj, key) ? obs_data_get_int(obj, key) : -1;
+    obs_data_release(obj);
+    return value;
+}
+
+// 1 or 0, -1 if the value is missing
+static int bool_at(obs_data_t *data, std::initializer_list<const char *> path, const char *key) {
+    obs_data_t *obj = at(data, path);
+    int value = obj && obs_data_has_user_value(obj, key) ? obs_data_get_bool(obj, key) : -1;
+    obs_data_release(obj);
+    return value;
+}
+
+// Length of the array under key, -1 if there is none
+static long long count_at(obs_data_t *data, std::initializer_list<const char *> path, const char *key) {
+    obs_data_t *obj = at(data, path);
+    obs_data_array_t *array = obj ? obs_data_get_array(obj, key) : NULL;
+    long long count = array ? (long long) obs_data_array_count(array) : -1;
+    obs_data_array_release(array);
+    obs_data_release(obj);
+    return count;
+}
+
+// A relay with both sessions identified and a seeded mirror. The remote subscribes to transforms,
+// so the mirror keeps them current from events
+static ws_test_relay_t test_relay_create(void) {
+    obs_reset();
+
+    ws_relay_config_t config;
+    ws_relay_config_init(&config);
+    config.auth_offload = true;
+    config.state_mirror = true;
+    config.ping_interval = 0;
+    ws_test_relay_t test = ws_test_relay_create(&config);
+    ws_relay_config_free(&config);
+    ws_relay_t *relay = test.relay;
+
+    WS_CHECK(ws_test_from_obs(&test, "{\"op\":0,\"d\":{\"obsWebSocketVersion\":\"5.5.0\",\"rpcVersion\":1}}") >= 0);
+    WS_CHECK(ws_test_from_obs(&test, "{\"op\":2,\"d\":{\"negotiatedRpcVersion\":1}}") >= 0);
+    WS_CHECK(ws_test_from_remote(&test, "{\"op\":1,\"d\":{\"rpcVersion\":1,\"eventSubscriptions\":" +
+                                            std::to_string(TEST_SUBSCRIPTIONS | TEST_SUBSCRIPTION_TRANSFORMS) +
+                                            "}}") >= 0);
+    WS_CHECK(ws_test_from_obs(&test, "{\"op\":2,\"d\":{\"negotiatedRpcVersion\":1}}") >= 0);
+    WS_CHECK(relay->auth.remote_identified && !relay->auth.obs_reidentify_pending);
+    ws_test_to_obs(&test);
+    ws_test_to_remote(&test);
+
+    os_atomic_store_bool(&relay->running, true);
+    pthread_mutex_lock(&relay->mutex);
+    ws_mirror_sync(relay);
+    pthread_mutex_unlock(&relay->mutex);
+    WS_CHECK(relay->mirror != NULL);
+    WS_CHECK(settle(relay));
+    return test;
+}
+
+static void test_relay_destroy(ws_test_relay_t *test) {
+    pthread_mutex_lock(&test->relay->mutex);
+    ws_mirror_detach(test->relay);
+    pthread_mutex_unlock(&test->relay->mutex);
+    os_atomic_store_bool(&test->relay->running, false);
+    ws_test_relay_destroy(test);
+}
+
+static void test_seed(void) {
+    ws_test_relay_t test = test_relay_create();
+    ws_relay_t *relay = test.relay;
+
+    // One of each list, then the item and filter lists of every scene and input
+    WS_CHECK(obs_take_requests() ==
+             std::set<std::string>({"GetSceneList", "GetInputList", "GetSceneTransitionList", "GetSceneItemList Main",
+                                    "GetSceneItemList Break", "GetSourceFilterList Main",
+                                    "GetSourceFilterList Break", "GetSourceFilterList Mic"}));
+    WS_CHECK(mirror_live(relay));
+    WS_CHECK(relay->stats.to_remote.mirror_refreshes == 1);
+
+    obs_data_t *state = snapshot(relay);
+    WS_CHECK(state != NULL);
+    WS_CHECK(string_at(state, {"sceneList"}, "currentProgramSceneName") == "Main");
+    WS_CHECK(string_at(state, {"sceneList", "scenes", "1"}, "sceneName") == "Main");
+    WS_CHECK(string_at(state, {"inputList", "inputs", "0"}, "inputName") == "Mic");
+    WS_CHECK(int_at(state, {"transitionList"}, "currentSceneTransitionDuration") == 300);
+    WS_CHECK(string_at(state, {"sceneItems", "Main", "0"}, "sourceName") == "Mic");
+    WS_CHECK(count_at(state, {"sceneItems"}, "Break") == 0);
+    WS_CHECK(string_at(state, {"filters", "Mic", "0"}, "filterName") == "Gain");
+    obs_data_release(state);
+
+    // The remote's snapshot request is answered by the relay rather than OBS
+    std::string request = std::string("{\"op\":6,\"d\":{\"requestType\":\"CallVendorRequest\",\"requestId\":\"s1\","
+                                      "\"requestData\":{\"vendorName\":\"") +
+                          PLUGIN_NAME + "\",\"requestType\":\"GetStateSnapshot\"}}}";
+    WS_CHECK(ws_test_from_remote(&test, request) >= 0);
+    WS_CHECK(ws_test_to_obs(&test).empty());
+    std::vector<std::string> to_remote = ws_test_to_remote(&test);
+    WS_CHECK(to_remote.size() == 1);
+    obs_data_t *response = to_remote.size() == 1 ? obs_data_create_from_json(to_remote[0].c_str()) : NULL;
+    WS_CHECK(int_at(response, {}, "op") == 7);
+    WS_CHECK(string_at(response, {"d"}, "requestId") == "s1");
+    WS_CHECK(int_at(response, {"d", "requestStatus"}, "code") == 100);
+    WS_CHECK(string_at(response, {"d", "responseData", "responseData", "sceneItems", "Main", "0"}, "sourceName") ==
+             "Mic");
+    obs_data_release(response);
+    WS_CHECK(obs_take_requests().empty());
+
+    test_relay_destroy(&test);
+}
+
+static void test_events(void) {
+    ws_test_relay_t test = test_relay_create();
+    ws_relay_t *relay = test.relay;
+    obs_take_requests();
+
+    // Changes an event describes completely are applied in place, without asking OBS
+    std::string events[] = {
+        event("CurrentProgramSceneChanged", "{\"sceneName\":\"Break\"}"),
+        event("SceneItemEnableStateChanged", "{\"sceneName\":\"Main\",\"sceneItemId\":1,\"sceneItemEnabled\":false}"),
+        event("SceneItemTransformChanged",
+              "{\"sceneName\":\"Main\",\"sceneItemId\":1,\"sceneItemTransform\":{\"positionX\":10}}"),
+        event("InputNameChanged", "{\"oldInputName\":\"Mic\",\"inputName\":\"Voice\"}"),
+        event("SourceFilterEnableStateChanged",
+              "{\"sourceName\":\"Voice\",\"filterName\":\"Gain\",\"filterEnabled\":false}"),
+        event("SceneNameChanged", "{\"oldSceneName\":\"Break\",\"sceneName\":\"Pause\"}"),
+        event("CurrentSceneTransitionDurationChanged", "{\"transitionDuration\":500}"),
+    };
+    for (const std::string &msg: events) {
+        WS_CHECK(ws_test_from_obs(&test, msg) >= 0);
+    }
+    // obs-websocket writes eventType last, so a fragmented event is only known once complete
+    std::string locked = "{\"op\":5,\"d\":{\"eventData\":{\"sceneName\":\"Main\",\"sceneItemId\":1,"
+                         "\"sceneItemLocked\":true},\"eventIntent\":128,\"eventType\":\"SceneItemLockStateChanged\"}}";
+    WS_CHECK(ws_test_feed(ws_callback_obs, test.obs, LWS_CALLBACK_CLIENT_RECEIVE, locked.substr(0, 40), true, false) >=
+             0);
+    WS_CHECK(ws_test_feed(ws_callback_obs, test.obs, LWS_CALLBACK_CLIENT_RECEIVE, locked.substr(40), false, true) >= 0);
+    WS_CHECK(ws_test_to_remote(&test).size() == 8);
+
+    WS_CHECK(relay->stats.to_remote.mirror_events == 8);
+    WS_CHECK(obs_take_requests().empty());
+    obs_data_t *state = snapshot(relay);
+    WS_CHECK(state != NULL);
+    WS_CHECK(string_at(state, {"sceneList"}, "currentProgramSceneName") == "Pause");
+    WS_CHECK(string_at(state, {"sceneList", "scenes", "0"}, "sceneName") == "Pause");
+    WS_CHECK(count_at(state, {"sceneItems"}, "Pause") == 0 && count_at(state, {"sceneItems"}, "Break") == -1);
+    WS_CHECK(string_at(state, {"sceneItems", "Main", "0"}, "sourceName") == "Voice");
+    WS_CHECK(bool_at(state, {"sceneItems", "Main", "0"}, "sceneItemEnabled") == 0);
+    WS_CHECK(bool_at(state, {"sceneItems", "Main", "0"}, "sceneItemLocked") == 1);
+    WS_CHECK(int_at(state, {"sceneItems", "Main", "0", "sceneItemTransform"}, "positionX") == 10);
+    WS_CHECK(string_at(state, {"inputList", "inputs", "0"}, "inputName") == "Voice");
+    WS_CHECK(count_at(state, {"filters"}, "Mic") == -1 && count_at(state, {"filters"}, "Voice") == 1);
+    WS_CHECK(bool_at(state, {"filters", "Voice", "0"}, "filterEnabled") == 0);
+    WS_CHECK(int_at(state, {"transitionList"}, "currentSceneTransitionDuration") == 500);
+    obs_data_release(state);
+
+    // Changes an event only names mark their part stale; only that part is fetched again
+    obs_set("GetSceneItemList", "Pause", "{\"sceneItems\":[{\"sceneItemId\":2,\"sourceName\":\"Voice\"}]}");
+    WS_CHECK(ws_test_from_obs(&test, event("SceneItemCreated", "{\"sceneName\":\"Pause\",\"sceneItemId\":2}")) >= 0);
+    WS_CHECK(settle(relay));
+    WS_CHECK(obs_take_requests() == std::set<std::string>({"GetSceneItemList Pause"}));
+    state = snapshot(relay);
+    WS_CHECK(int_at(state, {"sceneItems", "Pause", "0"}, "sceneItemId") == 2);
+    WS_CHECK(string_at(state, {"sceneList"}, "currentProgramSceneName") == "Pause");
+    obs_data_release(state);
+
+    // A change arriving while the fetch runs may not be in its result, so it is applied on top.
+    // The canned list stands for one read before the item was disabled
+    obs_set("GetSceneItemList", "Main",
+            "{\"sceneItems\":[{\"sceneItemId\":1,\"sourceName\":\"Voice\",\"sceneItemEnabled\":true},"
+            "{\"sceneItemId\":3,\"sourceName\":\"Voice\",\"sceneItemEnabled\":true}]}");
+    WS_CHECK(ws_test_from_obs(&test, event("SceneItemCreated", "{\"sceneName\":\"Main\",\"sceneItemId\":3}")) >= 0);
+    WS_CHECK(snapshot(relay) == NULL);
+    WS_CHECK(ws_test_from_obs(&test, event("SceneItemEnableStateChanged",
+                                           "{\"sceneName\":\"Main\",\"sceneItemId\":1,\"sceneItemEnabled\":false}")) >=
+             0);
+    WS_CHECK(settle(relay));
+    state = snapshot(relay);
+    WS_CHECK(bool_at(state, {"sceneItems", "Main", "0"}, "sceneItemEnabled") == 0);
+    WS_CHECK(int_at(state, {"sceneItems", "Main", "1"}, "sceneItemId") == 3);
+    obs_data_release(state);
+    WS_CHECK(mirror_live(relay));
+
+    test_relay_destroy(&test);
+}
+
+static void test_invalidation(void) {
+    ws_test_relay_t test = test_relay_create();
+    ws_relay_t *relay = test.relay;
+    relay->config.reconnect_interval = 0;
+    obs_take_requests();
+
+    // Without the subscriptions the mirror follows, changes go unseen: no snapshot until seeded again
+    WS_CHECK(ws_test_from_remote(&test, reidentify(TEST_SUBSCRIPTIONS & ~(1 << 2))) >= 0);
+    WS_CHECK(ws_test_from_obs(&test, "{\"op\":2,\"d\":{\"negotiatedRpcVersion\":1}}") >= 0);
+    WS_CHECK(!mirror_live(relay));
+    WS_CHECK(snapshot(relay) == NULL);
+    pthread_mutex_lock(&relay->mutex);
+    ws_mirror_maintain(relay);
+    pthread_mutex_unlock(&relay->mutex);
+    WS_CHECK(!ws_mirror_result_ready(relay));
+    WS_CHECK(obs_take_requests().empty());
+
+    // Covered again, it is seeded afresh, picking up what changed in the meantime
+    obs_set("GetSceneList", NULL,
+            "{\"currentProgramSceneName\":\"Break\",\"scenes\":[{\"sceneName\":\"Break\"},{\"sceneName\":\"Main\"}]}");
+    WS_CHECK(ws_test_from_remote(&test, reidentify(TEST_SUBSCRIPTIONS | TEST_SUBSCRIPTION_TRANSFORMS)) >= 0);
+    WS_CHECK(ws_test_from_obs(&test, "{\"op\":2,\"d\":{\"negotiatedRpcVersion\":1}}") >= 0);
+    pthread_mutex_lock(&relay->mutex);
+    ws_mirror_maintain(relay);
+    pthread_mutex_unlock(&relay->mutex);
+    WS_CHECK(settle(relay));
+    WS_CHECK(obs_take_requests().count("GetSceneList") == 1);
+    WS_CHECK(mirror_live(relay));
+    WS_CHECK(relay->stats.to_remote.mirror_refreshes == 2);
+    obs_data_t *state = snapshot(relay);
+    WS_CHECK(string_at(state, {"sceneList"}, "currentProgramSceneName") == "Break");
+    obs_data_release(state);
+
+    // An event too large to collect might have been one the mirror follows
+    std::string head = "{\"op\":5,\"d\":{\"eventData\":{\"fill\":\"";
+    WS_CHECK(ws_test_feed(ws_callback_obs, test.obs, LWS_CALLBACK_CLIENT_RECEIVE, head, true, false) >= 0);
+    WS_CHECK(ws_test_feed(ws_callback_obs, test.obs, LWS_CALLBACK_CLIENT_RECEIVE, std::string(WS_MIRROR_EVENT_MAX, 'x'),
+                          false, false) >= 0);
+    WS_CHECK(ws_test_feed(ws_callback_obs, test.obs, LWS_CALLBACK_CLIENT_RECEIVE,
+                          "\"},\"eventIntent\":4,\"eventType\":\"SceneListChanged\"}}", false, true) >= 0);
+    WS_CHECK(!mirror_live(relay));
+    WS_CHECK(snapshot(relay) == NULL);
+    ws_test_to_remote(&test);
+
+    pthread_mutex_lock(&relay->mutex);
+    ws_mirror_maintain(relay);
+    pthread_mutex_unlock(&relay->mutex);
+    WS_CHECK(settle(relay));
+    WS_CHECK(mirror_live(relay));
+
+    // So is everything that happens while OBS is away; without events it is not seeded again
+    WS_CHECK(ws_callback_obs(test.obs, LWS_CALLBACK_CLIENT_CLOSED, NULL, NULL, 0) >= 0);
+    WS_CHECK(!mirror_live(relay));
+    WS_CHECK(snapshot(relay) == NULL);
+    obs_take_requests();
+    pthread_mutex_lock(&relay->mutex);
+    ws_mirror_maintain(relay);
+    pthread_mutex_unlock(&relay->mutex);
+    WS_CHECK(!ws_mirror_result_ready(relay));
+    WS_CHECK(obs_take_requests().empty());
+
+    test_relay_destroy(&test);
+}
+
+int main(void) {
+    ws_test_set_log_level(LOG_ERROR - 1);
+
+    // obs-websocket's plugin API, found through OBS's global proc handler
+    proc_handler_t *global_ph = proc_handler_create();
+    proc_handler_t *api_ph = proc_handler_create();
+    proc_handler_add(global_ph, "void obs_websocket_api_get_ph(out ptr ph)", obs_get_api_ph, api_ph);
+    proc_handler_add(api_ph, "bool call_request(in string request_type, in string request_data, out ptr response)",
+                     obs_call_request, NULL);
+    ws_test_set_proc_handler(global_ph);
+
+    test_seed();
+    test_events();
+    test_invalidation();
+
+    printf("%ld failed checks\n", ws_test_failures);
+    return ws_test_failures ? 1 : 0;
+}
@@ -0,0 +1,541 @@
+/*
+OBS WebSocket Relay - Channel Multiplexing Test
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+// The multiplexing header, demultiplexing of received frames, the send credit and window grants,
+// then remote connection sharing against the lws mock: one relay owns the remote connection and
+// another, attached to it through the owner's socket, gets its channel carried over it both ways
+
+#include "ws-relay-internal.h"
+#include "mock-lws.h"
+#include "test-support.h"
+#include <obs-module.h>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TEST_REMOTE "ws://remote.example:9000/relay"
+
+typedef struct {
+    int type;
+    int channel;
+    uint32_t value;
+    std::string payload;
+} test_frame_t;
+
+static std::string mux_frame(ws_mux_frame_type_t type, int channel, uint32_t value, const std::string &payload = "") {
+    std::string frame(WS_MUX_HEADER_SIZE, '\0');
+    ws_mux_put_header((unsigned char *) &frame[0], type, (uint16_t) channel, value);
+    return frame + payload;
+}
+
+// Decode the messages wsi wrote since the last call, each a multiplexed frame
+static std::vector<test_frame_t> written_frames(struct lws *wsi) {
+    std::vector<mock_lws_message_t> messages;
+    for (const mock_lws_write_t &write: mock_lws_take_writes(wsi)) {
+        WS_CHECK(mock_lws_decode_write(write, messages));
+    }
+
+    std::vector<test_frame_t> frames;
+    for (const mock_lws_message_t &msg: messages) {
+        WS_CHECK(msg.binary && msg.payload.size() >= WS_MUX_HEADER_SIZE);
+        if (msg.payload.size() < WS_MUX_HEADER_SIZE) continue;
+
+        const unsigned char *header = (const unsigned char *) msg.payload.data();
+        WS_CHECK(header[0] == WS_MUX_VERSION);
+        frames.push_back({header[1], (header[2] << 8) | header[3],
+                          (uint32_t) header[4] << 24 | (uint32_t) header[5] << 16 | (uint32_t) header[6] << 8 | header[7],
+                          msg.payload.substr(WS_MUX_HEADER_SIZE)});
+    }
+    return frames;
+}
+
+// Text messages wsi wrote since the last call
+static std::vector<std::string> written_text(struct lws *wsi) {
+    std::vector<mock_lws_message_t> messages;
+    for (const mock_lws_write_t &write: mock_lws_take_writes(wsi)) {
+        WS_CHECK(mock_lws_decode_write(write, messages));
+    }
+
+    std::vector<std::string> texts;
+    for (const mock_lws_message_t &msg: messages) {
+        WS_CHECK(!msg.binary);
+        texts.push_back(msg.payload);
+    }
+    return texts;
+}
+
+// Deliver a message, or a fragment of one, to a protocol callback the way lws does: from a
+// buffer with LWS_PRE bytes of headroom
+static int feed(lws_callback_function *callback, struct lws *wsi, enum lws_callback_reasons reason,
+                const std::string &data, bool first = true, bool final = true) {
+    std::vector<unsigned char> buffer(LWS_PRE + data.size());
+    memcpy(buffer.data() + LWS_PRE, data.data(), data.size());
+    mock_lws_set_fragment(wsi, first, final, 0);
+    return callback(wsi, reason, NULL, buffer.data() + LWS_PRE, data.size());
+}
+
+typedef struct {
+    ws_relay_t *relay;
+    struct lws *obs;
+    struct lws *remote;
+} test_relay_t;
+
+static ws_relay_t *test_relay_new(int channel, int window_kb, const char *remote) {
+    ws_relay_config_t config;
+    ws_relay_config_init(&config);
+    bfree(config.remote_ws_address);
+    config.remote_ws_address = bstrdup(remote);
+    config.mux_channel = channel;
+    config.mux_window_kb = window_kb;
+    config.ping_interval = 0;
+
+    ws_relay_t *relay = ws_relay_create(&config);
+    ws_relay_config_free(&config);
+    return relay;
+}
+
+// Connect a relay's OBS and remote connections to the mock's and write the channel's OPEN
+static void test_relay_connect(test_relay_t *test) {
+    struct {
+        ws_connection_t *conn;
+        struct lws *wsi;
+        lws_callback_function *callback;
+    } sides[] = {{&test->relay->obs_conn, test->obs, ws_callback_obs},
+                 {&test->relay->remote_conn, test->remote, ws_callback_remote}};
+    for (auto &side: sides) {
+        side.conn->wsi = side.wsi;
+        side.conn->state = WS_STATE_CONNECTING;
+        lws_set_opaque_user_data(side.wsi, side.conn);
+        WS_CHECK(side.callback(side.wsi, LWS_CALLBACK_CLIENT_ESTABLISHED, NULL, NULL, 0) >= 0);
+    }
+    WS_CHECK(ws_callback_remote(test->remote, LWS_CALLBACK_CLIENT_WRITEABLE, NULL, NULL, 0) >= 0);
+}
+
+static test_relay_t test_relay_create(int channel, int window_kb, const char *remote = TEST_REMOTE) {
+    test_relay_t test = {test_relay_new(channel, window_kb, remote), mock_lws_create(), mock_lws_create()};
+    test_relay_connect(&test);
+    return test;
+}
+
+static void test_relay_destroy(test_relay_t *test) {
+    if (test->relay->obs_conn.wsi) {
+        ws_callback_obs(test->obs, LWS_CALLBACK_CLIENT_CLOSED, NULL, NULL, 0);
+    }
+    if (test->relay->remote_conn.wsi) {
+        ws_callback_remote(test->remote, LWS_CALLBACK_CLIENT_CLOSED, NULL, NULL, 0);
+    }
+    mock_lws_destroy(test->obs);
+    mock_lws_destroy(test->remote);
+    ws_relay_destroy(test->relay);
+}
+
+static void test_header(void) {
+    unsigned char header[WS_MUX_HEADER_SIZE];
+    ws_mux_put_header(header, WS_MUX_WINDOW, 0x1234, 0xa1b2c3d4);
+    const unsigned char expected[WS_MUX_HEADER_SIZE] = {WS_MUX_VERSION, WS_MUX_WINDOW, 0x12, 0x34, 0xa1, 0xb2, 0xc3, 0xd4};
+    WS_CHECK(memcmp(header, expected, sizeof(expected)) == 0);
+
+    // The relay's first frame opens its channel with its window
+    test_relay_t test = test_relay_create(7, 64);
+    std::vector<test_frame_t> frames = written_frames(test.remote);
+    WS_CHECK(frames.size() == 1 && frames[0].type == WS_MUX_OPEN && frames[0].channel == 7 &&
+             frames[0].value == 64 * 1024 && frames[0].payload.empty());
+    test_relay_destroy(&test);
+}
+
+// Run ws_mux_receive over one fragment; returns its result along with what is left to forward
+static ws_mux_rx_result_t receive(test_relay_t *test, const std::string &data, bool first, bool final,
+                                  std::string *forwarded = NULL) {
+    std::vector<char> buffer(data.begin(), data.end());
+    void *in = buffer.data();
+    size_t len = buffer.size();
+    mock_lws_set_fragment(test->remote, first, final, 0);
+    ws_mux_rx_result_t rx = ws_mux_receive(test->relay, test->remote, &in, &len);
+    if (forwarded) {
+        *forwarded = rx == WS_MUX_RX_FORWARD ? std::string((const char *) in, len) : std::string();
+    }
+    return rx;
+}
+
+static void test_receive(void) {
+    test_relay_t test = test_relay_create(5, 64);
+    std::string forwarded;
+
+    // Data on the relay's channel comes without its header
+    WS_CHECK(receive(&test, mux_frame(WS_MUX_DATA, 5, 0, "hello"), true, true, &forwarded) == WS_MUX_RX_FORWARD);
+    WS_CHECK(forwarded == "hello");
+    WS_CHECK(test.relay->mux.recv_pending == 5);
+
+    // Continuations carry no header and are forwarded whole
+    WS_CHECK(receive(&test, mux_frame(WS_MUX_DATA, 5, 0, "ab"), true, false, &forwarded) == WS_MUX_RX_FORWARD);
+    WS_CHECK(forwarded == "ab");
+    WS_CHECK(receive(&test, "cdefgh", false, true, &forwarded) == WS_MUX_RX_FORWARD);
+    WS_CHECK(forwarded == "cdefgh");
+    WS_CHECK(test.relay->mux.recv_pending == 13);
+
+    // Another channel, with its continuations
+    WS_CHECK(receive(&test, mux_frame(WS_MUX_DATA, 6, 0, "other"), true, false) == WS_MUX_RX_CONSUMED);
+    WS_CHECK(receive(&test, "more", false, true) == WS_MUX_RX_CONSUMED);
+
+    // A short header and an unknown version, with the continuation of the latter
+    WS_CHECK(receive(&test, std::string(WS_MUX_HEADER_SIZE - 1, '\x01'), true, true) == WS_MUX_RX_CONSUMED);
+    std::string bad = mux_frame(WS_MUX_DATA, 5, 0, "x");
+    bad[0] = WS_MUX_VERSION + 1;
+    WS_CHECK(receive(&test, bad, true, false) == WS_MUX_RX_CONSUMED);
+    WS_CHECK(receive(&test, "y", false, true) == WS_MUX_RX_CONSUMED);
+    WS_CHECK(test.relay->mux.recv_pending == 13);
+
+    // A grant adds to the credit, and a CLOSE restarts the session
+    int64_t credit = test.relay->mux.send_credit;
+    WS_CHECK(receive(&test, mux_frame(WS_MUX_WINDOW, 5, 1000), true, true) == WS_MUX_RX_CONSUMED);
+    WS_CHECK(test.relay->mux.send_credit == credit + 1000);
+    WS_CHECK(receive(&test, mux_frame(WS_MUX_WINDOW, 6, 1000), true, true) == WS_MUX_RX_CONSUMED);
+    WS_CHECK(test.relay->mux.send_credit == credit + 1000);
+    WS_CHECK(receive(&test, mux_frame(WS_MUX_CLOSE, 5, 0), true, true) == WS_MUX_RX_RESET);
+
+    // Through the callback: data reaches OBS, anything else does not
+    mock_lws_take_writes(test.obs);
+    WS_CHECK(feed(ws_callback_remote, test.remote, LWS_CALLBACK_CLIENT_RECEIVE, mux_frame(WS_MUX_DATA, 5, 0, "{}")) >= 0);
+    WS_CHECK(feed(ws_callback_remote, test.remote, LWS_CALLBACK_CLIENT_RECEIVE, mux_frame(WS_MUX_DATA, 9, 0, "[]")) >= 0);
+    std::vector<std::string> texts = written_text(test.obs);
+    WS_CHECK(texts.size() == 1 && texts[0] == "{}");
+
+    test_relay_destroy(&test);
+}
+
+static void test_credit(void) {
+    test_relay_t test = test_relay_create(1, 1);
+
+    // A message may overshoot what is left of the window, after which the channel waits
+    WS_CHECK(test.relay->mux.send_credit == 1024);
+    WS_CHECK(ws_mux_take_credit(test.relay, 1000));
+    WS_CHECK(test.relay->mux.send_credit == 24);
+    WS_CHECK(ws_mux_take_credit(test.relay, 500));
+    WS_CHECK(test.relay->mux.send_credit == -476);
+    WS_CHECK(!ws_mux_take_credit(test.relay, 1));
+    WS_CHECK(test.relay->mux.send_credit == -476);
+
+    // Data from OBS waits in the queue until the remote grants more
+    mock_lws_take_writes(test.remote);
+    WS_CHECK(feed(ws_callback_obs, test.obs, LWS_CALLBACK_CLIENT_RECEIVE, "{\"op\":5}") >= 0);
+    ws_callback_remote(test.remote, LWS_CALLBACK_CLIENT_WRITEABLE, NULL, NULL, 0);
+    WS_CHECK(written_frames(test.remote).empty());
+    WS_CHECK(test.relay->remote_conn.buffers.size() == 1);
+    WS_CHECK(feed(ws_callback_remote, test.remote, LWS_CALLBACK_CLIENT_RECEIVE, mux_frame(WS_MUX_WINDOW, 1, 1000)) >= 0);
+    ws_callback_remote(test.remote, LWS_CALLBACK_CLIENT_WRITEABLE, NULL, NULL, 0);
+    std::vector<test_frame_t> frames = written_frames(test.remote);
+    WS_CHECK(frames.size() == 1 && frames[0].type == WS_MUX_DATA && frames[0].channel == 1 &&
+             frames[0].payload == "{\"op\":5}");
+    test_relay_destroy(&test);
+
+    // Without a window nothing is accounted
+    test = test_relay_create(1, 0);
+    for (int i = 0; i < 4; i++) {
+        WS_CHECK(ws_mux_take_credit(test.relay, 1 << 30));
+    }
+    test_relay_destroy(&test);
+}
+
+static void test_window(void) {
+    test_relay_t test = test_relay_create(1, 64);
+    ws_relay_t *relay = test.relay;
+    mock_lws_take_writes(test.remote);
+
+    // Grants wait for half the window
+    relay->mux.recv_pending = 32 * 1024 - 1;
+    ws_mux_update_window(relay);
+    WS_CHECK(relay->remote_conn.buffers.empty());
+
+    relay->mux.recv_pending = 40 * 1024;
+    ws_mux_update_window(relay);
+    WS_CHECK(relay->remote_conn.buffers.size() == 1);
+    WS_CHECK(relay->mux.recv_pending == 0);
+    ws_callback_remote(test.remote, LWS_CALLBACK_CLIENT_WRITEABLE, NULL, NULL, 0);
+    std::vector<test_frame_t> frames = written_frames(test.remote);
+    WS_CHECK(frames.size() == 1 && frames[0].type == WS_MUX_WINDOW && frames[0].value == 40 * 1024);
+
+    // Bytes still queued for OBS keep their window
+    relay->mux.recv_pending = 40 * 1024;
+    relay->obs_conn.queued_bytes = 10 * 1024;
+    ws_mux_update_window(relay);
+    WS_CHECK(relay->remote_conn.buffers.empty());
+    relay->obs_conn.queued_bytes = 0;
+    ws_mux_update_window(relay);
+    WS_CHECK(relay->remote_conn.buffers.size() == 1 && relay->remote_conn.buffers.front().mux_value == 40 * 1024);
+
+    // A control frame goes ahead of data the window holds back
+    relay->mux.send_credit = 0;
+    WS_CHECK(feed(ws_callback_obs, test.obs, LWS_CALLBACK_CLIENT_RECEIVE, "{\"op\":7}") >= 0);
+    relay->mux.recv_pending = 64 * 1024;
+    ws_mux_update_window(relay);
+    ws_callback_remote(test.remote, LWS_CALLBACK_CLIENT_WRITEABLE, NULL, NULL, 0);
+    frames = written_frames(test.remote);
+    WS_CHECK(frames.size() == 2 && frames[0].type == WS_MUX_WINDOW && frames[1].type == WS_MUX_WINDOW);
+    WS_CHECK(relay->remote_conn.buffers.size() == 1);
+
+    // Without flow control there are no grants
+    test_relay_destroy(&test);
+    test = test_relay_create(1, 0);
+    mock_lws_take_writes(test.remote);
+    test.relay->mux.recv_pending = 1 << 30;
+    ws_mux_update_window(test.relay);
+    WS_CHECK(test.relay->remote_conn.buffers.empty());
+    test_relay_destroy(&test);
+}
+
+// Pass what one relay wrote to its remote on to the hub as the owner receives it
+static int pump_to_hub(struct lws *from, struct lws *peer) {
+    std::vector<mock_lws_message_t> messages;
+    for (const mock_lws_write_t &write: mock_lws_take_writes(from)) {
+        WS_CHECK(mock_lws_decode_write(write, messages));
+    }
+    int result = 0;
+    for (const mock_lws_message_t &msg: messages) {
+        result = feed(ws_callback_hub, peer, LWS_CALLBACK_RECEIVE, msg.payload);
+        if (result < 0) break;
+    }
+    return result;
+}
+
+// Pass what the hub wrote to an attached relay on to that relay's remote connection
+static void pump_from_hub(struct lws *peer, struct lws *to) {
+    WS_CHECK(ws_callback_hub(peer, LWS_CALLBACK_SERVER_WRITEABLE, NULL, NULL, 0) >= 0);
+    std::vector<mock_lws_message_t> messages;
+    for (const mock_lws_write_t &write: mock_lws_take_writes(peer)) {
+        WS_CHECK(mock_lws_decode_write(write, messages));
+    }
+    for (const mock_lws_message_t &msg: messages) {
+        WS_CHECK(feed(ws_callback_remote, to, LWS_CALLBACK_CLIENT_RECEIVE, msg.payload) >= 0);
+    }
+}
+
+// Current count rather than the last published one, which only the service thread refreshes
+static uint64_t hub_peers(ws_relay_t *relay) {
+    ws_relay_stats_t stats;
+    pthread_mutex_lock(&relay->mutex);
+    ws_relay_collect_stats(relay, &stats);
+    pthread_mutex_unlock(&relay->mutex);
+    return stats.to_remote.hub_peers;
+}
+
+static void test_hub(const std::string &tmp) {
+    ws_relay_t *owner_relay = test_relay_new(1, 64, TEST_REMOTE);
+    ws_relay_t *attached_relay = test_relay_new(2, 64, TEST_REMOTE);
+    ws_relay_t *other_relay = test_relay_new(3, 64, "ws://other.example:9000");
+
+    // The first relay to elect owns the connection, the next with the same remote attaches
+    WS_CHECK(ws_mux_hub_elect(owner_relay) == WS_HUB_OWNER);
+    WS_CHECK(ws_mux_hub_address(owner_relay) == NULL);
+    WS_CHECK(ws_mux_hub_elect(attached_relay) == WS_HUB_ATTACHED);
+    WS_CHECK(ws_mux_hub_elect(owner_relay) == WS_HUB_OWNER);
+    WS_CHECK(ws_mux_hub_elect(other_relay) == WS_HUB_OWNER);
+
+    const char *address = ws_mux_hub_address(attached_relay);
+    std::string dir = tmp + "/" WS_HUB_DIR_PREFIX + std::to_string(getuid());
+    WS_CHECK(address && strncmp(address, "ws+unix://", 10) == 0);
+    std::string socket_path = address ? address + 10 : "";
+    WS_CHECK(socket_path.compare(0, dir.size() + 1, dir + "/") == 0);
+    struct stat st;
+    WS_CHECK(stat(dir.c_str(), &st) == 0 && (st.st_mode & 0777) == 0700);
+
+    char *host = NULL;
+    char *path = NULL;
+    uint16_t port;
+    bool use_ssl;
+    WS_CHECK(parse_ws_url(address, &host, &port, &path, &use_ssl));
+    WS_CHECK(host && host[0] == '+' && socket_path == host + 1 && strcmp(path, "/") == 0);
+    bfree(host);
+    bfree(path);
+
+    test_relay_t owner = {owner_relay, mock_lws_create(), mock_lws_create()};
+    test_relay_t attached = {attached_relay, mock_lws_create(), mock_lws_create()};
+
+    // Relays are only taken on while the owner's remote is up
+    struct lws *peer = mock_lws_accept(socket_path.c_str());
+    WS_CHECK(peer != NULL);
+    WS_CHECK(ws_callback_hub(peer, LWS_CALLBACK_ESTABLISHED, NULL, NULL, 0) < 0);
+    mock_lws_destroy(peer);
+
+    test_relay_connect(&owner);
+    WS_CHECK(written_frames(owner.remote).size() == 1);
+    peer = mock_lws_accept(socket_path.c_str());
+    WS_CHECK(ws_callback_hub(peer, LWS_CALLBACK_ESTABLISHED, NULL, NULL, 0) == 0);
+    WS_CHECK(hub_peers(owner.relay) == 1);
+
+    // The attached relay's OPEN and data go out on the owner's connection as they are, outside
+    // the owner's own window
+    test_relay_connect(&attached);
+    WS_CHECK(pump_to_hub(attached.remote, peer) == 0);
+    WS_CHECK(feed(ws_callback_obs, attached.obs, LWS_CALLBACK_CLIENT_RECEIVE, "{\"op\":5,\"d\":{}}") >= 0);
+    ws_callback_remote(attached.remote, LWS_CALLBACK_CLIENT_WRITEABLE, NULL, NULL, 0);
+    WS_CHECK(pump_to_hub(attached.remote, peer) == 0);
+
+    int64_t owner_credit = owner.relay->mux.send_credit;
+    ws_callback_remote(owner.remote, LWS_CALLBACK_CLIENT_WRITEABLE, NULL, NULL, 0);
+    std::vector<test_frame_t> frames = written_frames(owner.remote);
+    WS_CHECK(frames.size() == 2);
+    if (frames.size() == 2) {
+        WS_CHECK(frames[0].type == WS_MUX_OPEN && frames[0].channel == 2 && frames[0].value == 64 * 1024);
+        WS_CHECK(frames[1].type == WS_MUX_DATA && frames[1].channel == 2 && frames[1].payload == "{\"op\":5,\"d\":{}}");
+    }
+    WS_CHECK(owner.relay->mux.send_credit == owner_credit);
+    WS_CHECK(owner.relay->stats.to_remote.messages == 0 && owner.relay->stats.to_remote.hub_messages == 2);
+
+    // The remote's frames for channel 2 reach the attached relay's OBS, fragmented or not, and
+    // the owner's own channel still reaches the owner's
+    mock_lws_take_writes(owner.obs);
+    WS_CHECK(feed(ws_callback_remote, owner.remote, LWS_CALLBACK_CLIENT_RECEIVE,
+                  mux_frame(WS_MUX_DATA, 2, 0, "{\"op\":7}")) >= 0);
+    std::string first = mux_frame(WS_MUX_DATA, 2, 0, "{\"op\":7,\"d\":");
+    WS_CHECK(feed(ws_callback_remote, owner.remote, LWS_CALLBACK_CLIENT_RECEIVE, first, true, false) >= 0);
+    WS_CHECK(feed(ws_callback_remote, owner.remote, LWS_CALLBACK_CLIENT_RECEIVE, "{}}", false, true) >= 0);
+    WS_CHECK(feed(ws_callback_remote, owner.remote, LWS_CALLBACK_CLIENT_RECEIVE,
+                  mux_frame(WS_MUX_DATA, 1, 0, "{\"op\":6}")) >= 0);
+    WS_CHECK(feed(ws_callback_remote, owner.remote, LWS_CALLBACK_CLIENT_RECEIVE,
+                  mux_frame(WS_MUX_DATA, 4, 0, "{\"op\":8}")) >= 0);
+    WS_CHECK(mock_lws_take_writable(peer));
+
+    std::vector<std::string> texts = written_text(owner.obs);
+    WS_CHECK(texts.size() == 1 && texts[0] == "{\"op\":6}");
+    mock_lws_take_writes(attached.obs);
+    pump_from_hub(peer, attached.remote);
+    texts = written_text(attached.obs);
+    WS_CHECK(texts.size() == 2 && texts[0] == "{\"op\":7}" && texts[1] == "{\"op\":7,\"d\":{}}");
+    WS_CHECK(owner.relay->stats.to_obs.hub_messages == 2);
+
+    // Grants for channel 2 go to the attached relay's window, not the owner's
+    owner_credit = owner.relay->mux.send_credit;
+    int64_t attached_credit = attached.relay->mux.send_credit;
+    WS_CHECK(feed(ws_callback_remote, owner.remote, LWS_CALLBACK_CLIENT_RECEIVE, mux_frame(WS_MUX_WINDOW, 2, 500)) >= 0);
+    pump_from_hub(peer, attached.remote);
+    WS_CHECK(owner.relay->mux.send_credit == owner_credit);
+    WS_CHECK(attached.relay->mux.send_credit == attached_credit + 500);
+
+    // A second relay may not take a channel in use, nor speak for another than its own
+    for (int channel: {1, 2, 0}) {
+        struct lws *intruder = mock_lws_accept(socket_path.c_str());
+        WS_CHECK(ws_callback_hub(intruder, LWS_CALLBACK_ESTABLISHED, NULL, NULL, 0) == 0);
+        WS_CHECK(feed(ws_callback_hub, intruder, LWS_CALLBACK_RECEIVE, mux_frame(WS_MUX_OPEN, channel, 0)) < 0);
+        WS_CHECK(ws_callback_hub(intruder, LWS_CALLBACK_CLOSED, NULL, NULL, 0) == 0);
+        mock_lws_destroy(intruder);
+    }
+    struct lws *third = mock_lws_accept(socket_path.c_str());
+    WS_CHECK(ws_callback_hub(third, LWS_CALLBACK_ESTABLISHED, NULL, NULL, 0) == 0);
+    WS_CHECK(feed(ws_callback_hub, third, LWS_CALLBACK_RECEIVE, mux_frame(WS_MUX_OPEN, 3, 0)) == 0);
+    WS_CHECK(feed(ws_callback_hub, third, LWS_CALLBACK_RECEIVE, mux_frame(WS_MUX_DATA, 2, 0, "{}")) < 0);
+    WS_CHECK(ws_callback_hub(third, LWS_CALLBACK_CLOSED, NULL, NULL, 0) == 0);
+    mock_lws_destroy(third);
+
+    // The OPEN of channel 3 went out, and its end was announced
+    ws_callback_remote(owner.remote, LWS_CALLBACK_CLIENT_WRITEABLE, NULL, NULL, 0);
+    frames = written_frames(owner.remote);
+    WS_CHECK(frames.size() == 2);
+    if (frames.size() == 2) {
+        WS_CHECK(frames[0].type == WS_MUX_OPEN && frames[0].channel == 3);
+        WS_CHECK(frames[1].type == WS_MUX_CLOSE && frames[1].channel == 3);
+    }
+    WS_CHECK(hub_peers(owner.relay) == 1);
+
+    // Closing the attached relay's connection ends its channel at the remote
+    WS_CHECK(ws_callback_hub(peer, LWS_CALLBACK_CLOSED, NULL, NULL, 0) == 0);
+    mock_lws_destroy(peer);
+    WS_CHECK(hub_peers(owner.relay) == 0);
+    ws_callback_remote(owner.remote, LWS_CALLBACK_CLIENT_WRITEABLE, NULL, NULL, 0);
+    frames = written_frames(owner.remote);
+    WS_CHECK(frames.size() == 1 && frames[0].type == WS_MUX_CLOSE && frames[0].channel == 2);
+
+    // Losing the remote drops the attached relays, whose late callbacks are ignored
+    peer = mock_lws_accept(socket_path.c_str());
+    WS_CHECK(ws_callback_hub(peer, LWS_CALLBACK_ESTABLISHED, NULL, NULL, 0) == 0);
+    WS_CHECK(feed(ws_callback_hub, peer, LWS_CALLBACK_RECEIVE, mux_frame(WS_MUX_OPEN, 2, 0)) == 0);
+    ws_callback_remote(owner.remote, LWS_CALLBACK_CLIENT_CLOSED, NULL, NULL, 0);
+    WS_CHECK(mock_lws_closed(peer));
+    WS_CHECK(hub_peers(owner.relay) == 0);
+    WS_CHECK(feed(ws_callback_hub, peer, LWS_CALLBACK_RECEIVE, mux_frame(WS_MUX_DATA, 2, 0, "{}")) == 0);
+    WS_CHECK(ws_callback_hub(peer, LWS_CALLBACK_CLOSED, NULL, NULL, 0) == 0);
+    mock_lws_destroy(peer);
+
+    // Once the owner lets go, the next relay to dial takes over
+    ws_mux_hub_release(owner.relay);
+    WS_CHECK(ws_mux_hub_role(owner.relay) == WS_HUB_NONE);
+    WS_CHECK(mock_lws_accept(socket_path.c_str()) == NULL);
+    WS_CHECK(ws_mux_hub_elect(attached.relay) == WS_HUB_OWNER);
+    WS_CHECK(ws_mux_hub_elect(owner.relay) == WS_HUB_ATTACHED);
+
+    // Sharing is off without multiplexing or with sharing disabled
+    ws_relay_t *plain = test_relay_new(0, 64, TEST_REMOTE);
+    WS_CHECK(ws_mux_hub_elect(plain) == WS_HUB_NONE);
+    ws_relay_destroy(plain);
+    ws_relay_config_t config;
+    ws_relay_config_init(&config);
+    ws_relay_config_copy(&config, &owner.relay->config);
+    config.mux_share = false;
+    ws_relay_apply_config(owner.relay, &config);
+    ws_relay_config_free(&config);
+    WS_CHECK(ws_mux_hub_role(owner.relay) == WS_HUB_NONE);
+    WS_CHECK(ws_mux_hub_elect(owner.relay) == WS_HUB_NONE);
+
+    test_relay_destroy(&owner);
+    test_relay_destroy(&attached);
+    ws_relay_destroy(other_relay);
+}
+
+static void remove_dir(const std::string &dir) {
+    DIR *handle = opendir(dir.c_str());
+    if (!handle) return;
+
+    while (struct dirent *entry = readdir(handle)) {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..") continue;
+        std::string path = dir + "/" + name;
+        struct stat st;
+        if (lstat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+            remove_dir(path);
+        } else {
+            unlink(path.c_str());
+        }
+    }
+    closedir(handle);
+    rmdir(dir.c_str());
+}
+
+int main(void) {
+    ws_test_set_log_level(LOG_ERROR - 1);
+
+    // Sharing keeps its lock files in the temporary directory, so each run gets its own
+    char tmp_template[] = "/tmp/test-mux-XXXXXX";
+    const char *tmp = mkdtemp(tmp_template);
+    if (!tmp) {
+        perror("mkdtemp");
+        return 1;
+    }
+    setenv("TMPDIR", tmp, 1);
+
+    test_header();
+    test_receive();
+    test_credit();
+    test_window();
+    test_hub(tmp);
+
+    remove_dir(tmp);
+    printf("%ld failed checks\n", ws_test_failures);
+    return ws_test_failures ? 1 : 0;
+}
@@ -0,0 +1,92 @@
+/*
+OBS WebSocket Relay - Relay Test Fixture
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "test-relay.h"
+#include "mock-lws.h"
+#include "test-support.h"
+
+ws_test_relay_t ws_test_relay_create(const ws_relay_config_t *config) {
+    ws_test_relay_t test = {ws_relay_create(config), mock_lws_create(), mock_lws_create()};
+
+    struct {
+        ws_connection_t *conn;
+        struct lws *wsi;
+        lws_callback_function *callback;
+    } sides[] = {{&test.relay->obs_conn, test.obs, ws_callback_obs},
+                 {&test.relay->remote_conn, test.remote, ws_callback_remote}};
+    for (auto &side: sides) {
+        side.conn->wsi = side.wsi;
+        side.conn->state = WS_STATE_CONNECTING;
+        lws_set_opaque_user_data(side.wsi, side.conn);
+        WS_CHECK(side.callback(side.wsi, LWS_CALLBACK_CLIENT_ESTABLISHED, NULL, NULL, 0) >= 0);
+    }
+    return test;
+}
+
+void ws_test_relay_destroy(ws_test_relay_t *test) {
+    if (test->relay->obs_conn.wsi) {
+        ws_callback_obs(test->obs, LWS_CALLBACK_CLIENT_CLOSED, NULL, NULL, 0);
+    }
+    if (test->relay->remote_conn.wsi) {
+        ws_callback_remote(test->remote, LWS_CALLBACK_CLIENT_CLOSED, NULL, NULL, 0);
+    }
+    mock_lws_destroy(test->obs);
+    mock_lws_destroy(test->remote);
+    ws_relay_destroy(test->relay);
+}
+
+int ws_test_feed(lws_callback_function *callback, struct lws *wsi, enum lws_callback_reasons reason,
+                 const std::string &data, bool first, bool final) {
+    std::vector<unsigned char> buffer(LWS_PRE + data.size());
+    memcpy(buffer.data() + LWS_PRE, data.data(), data.size());
+    mock_lws_set_fragment(wsi, first, final, 0);
+    return callback(wsi, reason, NULL, buffer.data() + LWS_PRE, data.size());
+}
+
+int ws_test_from_obs(ws_test_relay_t *test, const std::string &data) {
+    return ws_test_feed(ws_callback_obs, test->obs, LWS_CALLBACK_CLIENT_RECEIVE, data);
+}
+
+int ws_test_from_remote(ws_test_relay_t *test, const std::string &data) {
+    return ws_test_feed(ws_callback_remote, test->remote, LWS_CALLBACK_CLIENT_RECEIVE, data);
+}
+
+static std::vector<std::string> written_text(lws_callback_function *callback, struct lws *wsi) {
+    if (lws_get_opaque_user_data(wsi)) {
+        callback(wsi, LWS_CALLBACK_CLIENT_WRITEABLE, NULL, NULL, 0);
+    }
+
+    std::vector<mock_lws_message_t> messages;
+    for (const mock_lws_write_t &write: mock_lws_take_writes(wsi)) {
+        WS_CHECK(mock_lws_decode_write(write, messages));
+    }
+
+    std::vector<std::string> texts;
+    for (const mock_lws_message_t &msg: messages) {
+        if (!msg.binary) texts.push_back(msg.payload);
+    }
+    return texts;
+}
+
+std::vector<std::string> ws_test_to_obs(ws_test_relay_t *test) {
+    return written_text(ws_callback_obs, test->obs);
+}
+
+std::vector<std::string> ws_test_to_remote(ws_test_relay_t *test) {
+    return written_text(ws_callback_remote, test->remote);
+}
@@ -0,0 +1,48 @@
+/*
+OBS WebSocket Relay - Relay Test Fixture
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include "ws-relay-internal.h"
+#include <string>
+#include <vector>
+
+// A relay with its OBS and remote connections on the lws mock, for unit tests that talk to it
+// through its protocol callbacks the way OBS and the remote would
+typedef struct {
+    ws_relay_t *relay;
+    struct lws *obs;
+    struct lws *remote;
+} ws_test_relay_t;
+
+// Create a relay from config and bring both connections up; what the relay writes while they
+// come up is left for the test to take
+ws_test_relay_t ws_test_relay_create(const ws_relay_config_t *config);
+void ws_test_relay_destroy(ws_test_relay_t *test);
+
+// Deliver a message, or a fragment of one, to a protocol callback the way lws does: from a
+// buffer with LWS_PRE bytes of headroom
+int ws_test_feed(lws_callback_function *callback, struct lws *wsi, enum lws_callback_reasons reason,
+                 const std::string &data, bool first = true, bool final = true);
+int ws_test_from_obs(ws_test_relay_t *test, const std::string &data);
+int ws_test_from_remote(ws_test_relay_t *test, const std::string &data);
+
+// Let the relay write what it queued for OBS or the remote, and return the text messages
+// written there since the last call
+std::vector<std::string> ws_test_to_obs(ws_test_relay_t *test);
+std::vector<std::string> ws_test_to_remote(ws_test_relay_t *test);
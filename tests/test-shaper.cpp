@@ -0,0 +1,167 @@
+/*
+OBS WebSocket Relay - Uplink Shaper Test
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+// The uplink token bucket: refill at the configured rate up to the burst size, the wait it
+// schedules while in deficit and the share of the rate left after congestion. Then the relay
+// against the lws mock, holding messages for the remote back until the bucket refills. Time is
+// simulated by moving the last refill back rather than by sleeping
+
+#include "ws-relay-internal.h"
+#include "mock-lws.h"
+#include "test-relay.h"
+#include "test-support.h"
+#include <obs-module.h>
+#include <util/platform.h>
+#include <math.h>
+#include <string>
+#include <vector>
+
+#define TEST_RATE_KBPS 100
+#define TEST_BURST_KB 64
+
+static const double rate = TEST_RATE_KBPS * 1024.0;
+static const double burst = TEST_BURST_KB * 1024.0;
+
+static ws_test_relay_t test_relay_create(int rate_kbps) {
+    ws_relay_config_t config;
+    ws_relay_config_init(&config);
+    config.uplink_rate_kbps = rate_kbps;
+    config.uplink_burst_kb = TEST_BURST_KB;
+    config.ping_interval = 0;
+    config.max_queued_kb = 0;
+    ws_test_relay_t test = ws_test_relay_create(&config);
+    ws_relay_config_free(&config);
+    return test;
+}
+
+// Let seconds pass for the bucket
+static void elapse(ws_relay_t *relay, double seconds) {
+    relay->shaper.last_refill -= (uint64_t) (seconds * 1e9);
+}
+
+// Tokens within the refill of the few microseconds a check takes
+static bool tokens_near(ws_relay_t *relay, double expected) {
+    return fabs(relay->shaper.tokens - expected) < rate * 0.01;
+}
+
+static void test_refill(void) {
+    ws_test_relay_t test = test_relay_create(TEST_RATE_KBPS);
+    ws_relay_t *relay = test.relay;
+
+    // An idle bucket fills up to the burst size and no further
+    WS_CHECK(ws_shaper_ready(relay));
+    WS_CHECK(relay->shaper.tokens == burst);
+    elapse(relay, 10);
+    WS_CHECK(ws_shaper_ready(relay) && relay->shaper.tokens == burst);
+
+    // Any credit lets a message through, even one larger than the bucket
+    ws_shaper_consume(relay, (size_t) (burst + rate * 1.5));
+    WS_CHECK(tokens_near(relay, -rate * 1.5));
+    uint64_t delays = relay->stats.to_remote.shaper_delays;
+    WS_CHECK(!ws_shaper_ready(relay));
+    WS_CHECK(relay->stats.to_remote.shaper_delays == delays + 1);
+
+    // The wait scheduled is the time the deficit takes to pay back
+    lws_usec_t wait = mock_lws_timer_delay(&relay->shaper.timer.sul);
+    WS_CHECK(llabs(wait - 1500000) < 20000);
+
+    // A second at the configured rate leaves half a second of deficit, the next one credit
+    elapse(relay, 1);
+    WS_CHECK(!ws_shaper_ready(relay) && tokens_near(relay, -rate * 0.5));
+    elapse(relay, 0.75);
+    WS_CHECK(ws_shaper_ready(relay) && tokens_near(relay, rate * 0.25));
+
+    // Congestion backs the rate off; a healthy stream brings it back a step per sample
+    relay->shaper.tokens = -rate;
+    relay->shaper.factor = 0.5;
+    elapse(relay, 1);
+    WS_CHECK(!ws_shaper_ready(relay) && tokens_near(relay, -rate * 0.5));
+
+    relay->config.uplink_adaptive = true;
+    relay->shaper.last_sample = 0;
+    ws_shaper_update(relay);
+    WS_CHECK(fabs(relay->shaper.factor - (0.5 + WS_SHAPER_RECOVERY_STEP)) < 1e-9);
+    WS_CHECK(relay->stats.to_remote.shaper_rate == (uint64_t) (rate * (0.5 + WS_SHAPER_RECOVERY_STEP)));
+    // Samples are taken once per interval
+    ws_shaper_update(relay);
+    WS_CHECK(fabs(relay->shaper.factor - (0.5 + WS_SHAPER_RECOVERY_STEP)) < 1e-9);
+    for (int i = 0; i < 10; i++) {
+        relay->shaper.last_sample = 0;
+        ws_shaper_update(relay);
+    }
+    WS_CHECK(relay->shaper.factor == 1.0);
+
+    ws_test_relay_destroy(&test);
+}
+
+// Without a rate nothing is held back or counted
+static void test_unshaped(void) {
+    ws_test_relay_t test = test_relay_create(0);
+    ws_shaper_consume(test.relay, 1 << 20);
+    WS_CHECK(ws_shaper_ready(test.relay));
+    WS_CHECK(test.relay->shaper.tokens == 0);
+    WS_CHECK(mock_lws_timer_delay(&test.relay->shaper.timer.sul) < 0);
+    ws_test_relay_destroy(&test);
+}
+
+// Messages from OBS go to the remote while there is credit, then wait for the timer
+static void test_relay_shaping(void) {
+    ws_test_relay_t test = test_relay_create(TEST_RATE_KBPS);
+    ws_relay_t *relay = test.relay;
+    ws_test_to_remote(&test);
+
+    std::vector<std::string> sent;
+    for (int i = 0; i < 6; i++) {
+        sent.push_back(std::string(30 * 1024, (char) ('a' + i)));
+        WS_CHECK(ws_test_from_obs(&test, sent.back()) >= 0);
+    }
+
+    // The full bucket covers three messages: two fit and the third takes the last credit
+    std::vector<std::string> received = ws_test_to_remote(&test);
+    WS_CHECK(received.size() == 3);
+    WS_CHECK(relay->remote_conn.buffers.size() == 3);
+    WS_CHECK(mock_lws_timer_delay(&relay->shaper.timer.sul) > 0);
+
+    // Still in deficit, the timer only asks for another WRITEABLE that writes nothing
+    WS_CHECK(mock_lws_fire_timer(&relay->shaper.timer.sul));
+    WS_CHECK(mock_lws_take_writable(test.remote));
+    WS_CHECK(ws_test_to_remote(&test).empty());
+
+    // A second later the deficit is paid back with room for three more
+    elapse(relay, 1);
+    std::vector<std::string> more = ws_test_to_remote(&test);
+    received.insert(received.end(), more.begin(), more.end());
+    WS_CHECK(received == sent);
+    WS_CHECK(relay->remote_conn.buffers.empty());
+
+    ws_relay_direction_stats_t *stats = &relay->stats.to_remote;
+    WS_CHECK(stats->messages == 6 && stats->shaper_delays >= 2);
+
+    ws_test_relay_destroy(&test);
+}
+
+int main(void) {
+    ws_test_set_log_level(LOG_ERROR - 1);
+
+    test_refill();
+    test_unshaped();
+    test_relay_shaping();
+
+    printf("%ld failed checks\n", ws_test_failures);
+    return ws_test_failures ? 1 : 0;
+}
@@ -0,0 +1,325 @@
+/*
+OBS WebSocket Relay - Outage Spill Log Test
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+// The spill log on its own: records read back in order, recovery of the segments a previous
+// session left behind (up to a torn tail), expiry by TTL and eviction by the size cap. Then the
+// relay against the lws mock, spilling OBS events while the remote is not identified and
+// replaying them once it is
+
+#include "ws-relay-internal.h"
+#include "mock-lws.h"
+#include "test-relay.h"
+#include "test-support.h"
+#include <obs-module.h>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+// The on-disk record header, for writing segments as an older session would have
+typedef struct {
+    uint32_t magic;
+    uint32_t len;
+    int64_t timestamp;
+} test_record_header_t;
+
+static std::string test_dir;
+
+static std::string segment_path(const char *dir, uint32_t id) {
+    char name[32];
+    snprintf(name, sizeof(name), "/%08u.spill", id);
+    return std::string(dir) + name;
+}
+
+static void write_segment(const char *dir, uint32_t id, const std::vector<std::string> &records, int64_t timestamp) {
+    FILE *file = fopen(segment_path(dir, id).c_str(), "wb");
+    WS_CHECK(file != NULL);
+    if (!file) return;
+    for (const std::string &record: records) {
+        test_record_header_t header = {0x4C525357, (uint32_t) record.size(), timestamp};
+        fwrite(&header, sizeof(header), 1, file);
+        fwrite(record.data(), record.size(), 1, file);
+    }
+    fclose(file);
+}
+
+static size_t count_segments(const char *dir) {
+    size_t count = 0;
+    DIR *handle = opendir(dir);
+    if (!handle) return 0;
+    while (struct dirent *ent = readdir(handle)) {
+        if (strstr(ent->d_name, ".spill")) count++;
+    }
+    closedir(handle);
+    return count;
+}
+
+static void remove_dir(const char *dir) {
+    DIR *handle = opendir(dir);
+    if (handle) {
+        while (struct dirent *ent = readdir(handle)) {
+            if (strcmp(ent->d_name, ".") && strcmp(ent->d_name, "..")) {
+                std::string path = std::string(dir) + "/" + ent->d_name;
+                if (unlink(path.c_str()) != 0) remove_dir(path.c_str());
+            }
+        }
+        closedir(handle);
+    }
+    rmdir(dir);
+}
+
+static std::string fresh_dir(const char *name) {
+    std::string dir = test_dir + "/" + name;
+    remove_dir(dir.c_str());
+    return dir;
+}
+
+static std::vector<std::string> read_all(ws_spill_t *spill, int ttl) {
+    std::vector<std::string> records;
+    std::vector<char> record;
+    while (ws_spill_read(spill, record, ttl)) {
+        records.emplace_back(record.begin(), record.end());
+    }
+    return records;
+}
+
+static ws_relay_direction_stats_t spill_stats(ws_spill_t *spill) {
+    ws_relay_direction_stats_t stats = {};
+    ws_spill_get_stats(spill, &stats);
+    return stats;
+}
+
+static void test_append_read(void) {
+    std::string dir = fresh_dir("append");
+    ws_spill_t *spill = ws_spill_create(dir.c_str());
+    WS_CHECK(spill != NULL);
+    if (!spill) return;
+    WS_CHECK(ws_spill_empty(spill));
+
+    std::vector<std::string> written = {"{\"op\":5}", "", std::string(100000, 'x'), "last"};
+    for (const std::string &record: written) {
+        WS_CHECK(ws_spill_append(spill, record.data(), record.size(), 0));
+    }
+    ws_relay_direction_stats_t stats = spill_stats(spill);
+    WS_CHECK(stats.spilled_messages == 4 && stats.spill_queued_messages == 4);
+    WS_CHECK(stats.spill_queued_bytes == 4 * sizeof(test_record_header_t) + 8 + 100000 + 4);
+
+    // Reading and appending interleave on the segment being written
+    std::vector<char> record;
+    WS_CHECK(ws_spill_read(spill, record, 0) && std::string(record.begin(), record.end()) == written[0]);
+    WS_CHECK(ws_spill_append(spill, "after", 5, 0));
+    written.push_back("after");
+    std::vector<std::string> rest = read_all(spill, 0);
+    WS_CHECK(rest == std::vector<std::string>(written.begin() + 1, written.end()));
+    WS_CHECK(ws_spill_empty(spill));
+
+    stats = spill_stats(spill);
+    WS_CHECK(stats.spill_replayed_messages == 5 && stats.spill_dropped_messages == 0);
+    WS_CHECK(stats.spill_queued_messages == 0 && stats.spill_queued_bytes == 0);
+
+    // A replayed segment is deleted and the next append starts another
+    WS_CHECK(ws_spill_append(spill, "again", 5, 0));
+    WS_CHECK(read_all(spill, 0) == std::vector<std::string>{"again"});
+    ws_spill_destroy(spill);
+    WS_CHECK(count_segments(dir.c_str()) <= 1);
+}
+
+// Segments left by a session that ended before replaying them are picked up in order, up to the
+// first torn record; empty and corrupt segments are deleted
+static void test_recovery(void) {
+    std::string dir = fresh_dir("recovery");
+    ws_spill_t *spill = ws_spill_create(dir.c_str());
+    WS_CHECK(spill != NULL);
+    if (!spill) return;
+    for (int i = 0; i < 10; i++) {
+        std::string record = "event " + std::to_string(i);
+        WS_CHECK(ws_spill_append(spill, record.data(), record.size(), 0));
+    }
+    ws_spill_maintain(spill, 0, true);
+    ws_spill_destroy(spill);
+
+    // A crash cut the last record short, and an older session left a segment of its own
+    std::string path = segment_path(dir.c_str(), 0);
+    FILE *file = fopen(path.c_str(), "ab");
+    test_record_header_t torn = {0x4C525357, 1000, (int64_t) time(NULL)};
+    fwrite(&torn, sizeof(torn), 1, file);
+    fwrite("cut", 3, 1, file);
+    fclose(file);
+    write_segment(dir.c_str(), 7, {"later 0", "later 1"}, (int64_t) time(NULL));
+    write_segment(dir.c_str(), 8, {}, (int64_t) time(NULL));
+    FILE *garbage = fopen(segment_path(dir.c_str(), 9).c_str(), "wb");
+    fputs("not a spill segment", garbage);
+    fclose(garbage);
+
+    spill = ws_spill_create(dir.c_str());
+    WS_CHECK(spill != NULL);
+    if (!spill) return;
+    WS_CHECK(spill_stats(spill).spill_queued_messages == 12);
+    WS_CHECK(count_segments(dir.c_str()) == 2);
+
+    // New events go behind the recovered ones
+    WS_CHECK(ws_spill_append(spill, "new", 3, 0));
+    std::vector<std::string> expected;
+    for (int i = 0; i < 10; i++) expected.push_back("event " + std::to_string(i));
+    expected.insert(expected.end(), {"later 0", "later 1", "new"});
+    WS_CHECK(read_all(spill, 0) == expected);
+    ws_spill_destroy(spill);
+}
+
+static void test_ttl(void) {
+    std::string dir = fresh_dir("ttl");
+    os_mkdirs(dir.c_str());
+    int64_t now = (int64_t) time(NULL);
+    write_segment(dir.c_str(), 1, {"stale 0", "stale 1"}, now - 7200);
+    write_segment(dir.c_str(), 2, {"recent"}, now - 10);
+
+    // Reading skips what is past the TTL and counts it as dropped
+    ws_spill_t *spill = ws_spill_create(dir.c_str());
+    WS_CHECK(spill != NULL);
+    if (!spill) return;
+    WS_CHECK(ws_spill_append(spill, "fresh", 5, 0));
+    WS_CHECK(read_all(spill, 3600) == (std::vector<std::string>{"recent", "fresh"}));
+    ws_relay_direction_stats_t stats = spill_stats(spill);
+    WS_CHECK(stats.spill_dropped_messages == 2 && stats.spill_replayed_messages == 2);
+    ws_spill_destroy(spill);
+
+    // Without a TTL nothing expires
+    dir = fresh_dir("ttl-off");
+    os_mkdirs(dir.c_str());
+    write_segment(dir.c_str(), 1, {"stale"}, now - 7200);
+    spill = ws_spill_create(dir.c_str());
+    ws_spill_maintain(spill, 0, true);
+    WS_CHECK(read_all(spill, 0) == std::vector<std::string>{"stale"});
+    ws_spill_destroy(spill);
+
+    // Upkeep deletes segments whose newest record has expired, without reading them
+    dir = fresh_dir("ttl-maintain");
+    os_mkdirs(dir.c_str());
+    write_segment(dir.c_str(), 1, {"stale 0", "stale 1"}, now - 7200);
+    write_segment(dir.c_str(), 2, {"recent"}, now - 10);
+    spill = ws_spill_create(dir.c_str());
+    ws_spill_maintain(spill, 3600, true);
+    stats = spill_stats(spill);
+    WS_CHECK(stats.spill_dropped_messages == 2 && stats.spill_queued_messages == 1);
+    WS_CHECK(count_segments(dir.c_str()) == 1);
+    WS_CHECK(read_all(spill, 3600) == std::vector<std::string>{"recent"});
+    ws_spill_destroy(spill);
+}
+
+// The size cap evicts whole segments, oldest first, and refuses a record that cannot fit at all
+static void test_cap(void) {
+    std::string dir = fresh_dir("cap");
+    ws_spill_t *spill = ws_spill_create(dir.c_str());
+    WS_CHECK(spill != NULL);
+    if (!spill) return;
+
+    const uint64_t cap = 64 * 1024;
+    std::string record(1000, 'r');
+    for (int i = 0; i < 200; i++) {
+        record[0] = (char) i;
+        WS_CHECK(ws_spill_append(spill, record.data(), record.size(), cap));
+        WS_CHECK(spill_stats(spill).spill_queued_bytes <= cap);
+    }
+    ws_relay_direction_stats_t stats = spill_stats(spill);
+    WS_CHECK(stats.spill_dropped_messages > 0);
+    WS_CHECK(stats.spill_dropped_messages + stats.spill_queued_messages == 200);
+    // Well over half the cap survives, since segments are a quarter of it
+    WS_CHECK(stats.spill_queued_bytes > cap / 2);
+
+    std::vector<std::string> kept = read_all(spill, 0);
+    WS_CHECK(kept.size() == stats.spill_queued_messages);
+    for (size_t i = 0; i < kept.size(); i++) {
+        WS_CHECK((unsigned char) kept[i][0] == (unsigned char) (200 - kept.size() + i));
+    }
+
+    std::string huge(cap, 'h');
+    WS_CHECK(!ws_spill_append(spill, huge.data(), huge.size(), cap));
+    ws_spill_destroy(spill);
+}
+
+// OBS events go to disk while the remote has not identified, and are replayed to it in order
+// once it has, ahead of events that arrive later
+static void test_relay_spill(void) {
+    ws_test_set_module_config_dir(fresh_dir("relay").c_str());
+
+    ws_relay_config_t config;
+    ws_relay_config_init(&config);
+    config.auth_offload = true;
+    config.spill_enabled = true;
+    config.spill_drain_kbps = 0;
+    config.ping_interval = 0;
+    ws_test_relay_t test = ws_test_relay_create(&config);
+    ws_relay_config_free(&config);
+    WS_CHECK(test.relay->spill != NULL);
+
+    WS_CHECK(ws_test_from_obs(&test, "{\"op\":0,\"d\":{\"obsWebSocketVersion\":\"5.5.0\",\"rpcVersion\":1}}") >= 0);
+    WS_CHECK(ws_test_from_obs(&test, "{\"op\":2,\"d\":{\"negotiatedRpcVersion\":1}}") >= 0);
+    ws_test_to_obs(&test);
+    ws_test_to_remote(&test);
+
+    std::vector<std::string> events;
+    for (int i = 0; i < 3; i++) {
+        events.push_back("{\"op\":5,\"d\":{\"eventType\":\"CurrentProgramSceneChanged\",\"eventIntent\":4,"
+                         "\"eventData\":{\"sceneName\":\"Scene " + std::to_string(i) + "\"}}}");
+        WS_CHECK(ws_test_from_obs(&test, events.back()) >= 0);
+    }
+    WS_CHECK(ws_test_to_remote(&test).empty());
+    ws_relay_direction_stats_t stats = {};
+    ws_spill_get_stats(test.relay->spill, &stats);
+    WS_CHECK(stats.spilled_messages == 3 && stats.spill_queued_messages == 3);
+
+    WS_CHECK(ws_test_from_remote(&test, "{\"op\":1,\"d\":{\"rpcVersion\":1}}") >= 0);
+    events.push_back("{\"op\":5,\"d\":{\"eventType\":\"CurrentProgramSceneChanged\",\"eventIntent\":4,"
+                     "\"eventData\":{\"sceneName\":\"Scene 3\"}}}");
+    WS_CHECK(ws_test_from_obs(&test, events.back()) >= 0);
+
+    std::vector<std::string> to_remote = ws_test_to_remote(&test);
+    WS_CHECK(to_remote.size() == 5);
+    if (to_remote.size() == 5) {
+        WS_CHECK(to_remote[0].find("\"op\":2") != std::string::npos);
+        WS_CHECK(std::vector<std::string>(to_remote.begin() + 1, to_remote.end()) == events);
+    }
+    WS_CHECK(ws_spill_empty(test.relay->spill));
+
+    ws_test_relay_destroy(&test);
+    ws_test_set_module_config_dir(NULL);
+}
+
+int main(void) {
+    ws_test_set_log_level(LOG_ERROR - 1);
+
+    char dir_template[] = "/tmp/ws-relay-spill-XXXXXX";
+    const char *dir = mkdtemp(dir_template);
+    if (!dir) {
+        perror("mkdtemp");
+        return 1;
+    }
+    test_dir = dir;
+
+    test_append_read();
+    test_recovery();
+    test_ttl();
+    test_cap();
+    test_relay_spill();
+
+    remove_dir(dir);
+    printf("%ld failed checks\n", ws_test_failures);
+    return ws_test_failures ? 1 : 0;
+}
@@ -0,0 +1,119 @@
+/*
+OBS WebSocket Relay - Test Support
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+// What plugin-main.c and the OBS frontend provide to the relay sources, for test binaries that
+// run them outside of OBS
+
+#include <obs-module.h>
+#include <util/base.h>
+#include <util/config-file.h>
+#include <util/dstr.h>
+#include <util/threading.h>
+#include "ws-relay.h"
+#include "test-support.h"
+
+OBS_DECLARE_MODULE()
+
+ws_relay_t *global_relay = NULL;
+long ws_test_failures = 0;
+
+static int log_level = LOG_DEBUG;
+
+static void test_log_handler(int level, const char *format, va_list args, void *param) {
+    UNUSED_PARAMETER(param);
+    if (level > log_level) return;
+
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+}
+
+void ws_test_set_log_level(int level) {
+    log_level = level;
+    base_set_log_handler(test_log_handler, NULL);
+}
+
+static pthread_mutex_t app_config_mutex = PTHREAD_MUTEX_INITIALIZER;
+static config_t *app_config = NULL;
+static char *app_config_path = NULL;
+
+void ws_test_set_config_path(const char *path) {
+    pthread_mutex_lock(&app_config_mutex);
+    if (app_config) {
+        config_close(app_config);
+        app_config = NULL;
+    }
+    bfree(app_config_path);
+    app_config_path = bstrdup(path);
+    pthread_mutex_unlock(&app_config_mutex);
+}
+
+static char *module_config_dir = NULL;
+
+void ws_test_set_module_config_dir(const char *dir) {
+    pthread_mutex_lock(&app_config_mutex);
+    bfree(module_config_dir);
+    module_config_dir = bstrdup(dir);
+    pthread_mutex_unlock(&app_config_mutex);
+}
+
+// Takes the place of the libobs function, which only knows a module's config directory once
+// OBS has loaded the module
+char *obs_module_get_config_path(obs_module_t *module, const char *file) {
+    UNUSED_PARAMETER(module);
+    pthread_mutex_lock(&app_config_mutex);
+    char *path = NULL;
+    if (module_config_dir) {
+        struct dstr output = {0};
+        dstr_printf(&output, "%s/%s", module_config_dir, file);
+        path = output.array;
+    }
+    pthread_mutex_unlock(&app_config_mutex);
+    return path;
+}
+
+static proc_handler_t *proc_handler = NULL;
+
+void ws_test_set_proc_handler(proc_handler_t *handler) {
+    proc_handler = handler;
+}
+
+// Takes the place of the libobs function, which returns OBS's global proc handler once OBS has
+// started
+proc_handler_t *obs_get_proc_handler(void) {
+    return proc_handler;
+}
+
+// Declared by obs-frontend-api.h, which the tests do not link
+config_t *obs_frontend_get_app_config(void);
+obs_output_t *obs_frontend_get_streaming_output(void);
+
+// The OBS global config, opened on first use like the frontend's
+config_t *obs_frontend_get_app_config(void) {
+    pthread_mutex_lock(&app_config_mutex);
+    if (!app_config && app_config_path && config_open(&app_config, app_config_path, CONFIG_OPEN_ALWAYS) != 0) {
+        app_config = NULL;
+    }
+    config_t *config = app_config;
+    pthread_mutex_unlock(&app_config_mutex);
+    return config;
+}
+
+// Not streaming; the uplink shaper then has no congestion to adapt to
+obs_output_t *obs_frontend_get_streaming_output(void) {
+    return NULL;
+}
@@ -0,0 +1,66 @@
+/*
+OBS WebSocket Relay - Test Support
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <util/threading.h>
+#include <callback/proc.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Path of the file standing in for the OBS global config, set before the relay loads or saves
+void ws_test_set_config_path(const char *path);
+// Directory obs_module_config_path resolves into, which holds the plugin's secrets file; unset,
+// it returns NULL as libobs does for a module OBS has not loaded
+void ws_test_set_module_config_dir(const char *dir);
+
+// Proc handler obs_get_proc_handler returns, standing in for the global one of a running OBS
+// that obs-websocket registers its plugin API on; unset, it returns NULL as libobs does before
+// OBS has started
+void ws_test_set_proc_handler(proc_handler_t *handler);
+
+// Drop relay log output below level, so fuzzing is not slowed down by rejected input being logged
+void ws_test_set_log_level(int level);
+
+#ifdef __cplusplus
+}
+#endif
+
+// Fuzz harnesses stop at the first broken invariant, so the crash leaves a reproducer behind
+#define WS_FUZZ_ASSERT(expr)                                                                 \
+    do {                                                                                     \
+        if (!(expr)) {                                                                       \
+            fprintf(stderr, "%s:%d: invariant failed: %s\n", __FILE__, __LINE__, #expr);     \
+            abort();                                                                         \
+        }                                                                                    \
+    } while (0)
+
+// Tests count failed checks, from any thread, and keep going; main fails if there were any
+extern long ws_test_failures;
+
+#define WS_CHECK(expr)                                                                       \
+    do {                                                                                     \
+        if (!(expr)) {                                                                       \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #expr);         \
+            os_atomic_inc_long(&ws_test_failures);                                           \
+        }                                                                                    \
+    } while (0)
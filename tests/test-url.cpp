@@ -0,0 +1,131 @@
+/*
+OBS WebSocket Relay - URL Parser Test
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+// parse_ws_url on the address forms the settings dialog accepts, ws+unix:// socket addresses
+// included, and on the malformed ones it must reject
+
+#include "ws-relay-internal.h"
+#include "test-support.h"
+#include <obs-module.h>
+
+typedef struct {
+    const char *url;
+    const char *host; // NULL if the URL must be rejected
+    uint16_t port;
+    const char *path;
+    bool use_ssl;
+} url_case_t;
+
+static const url_case_t tcp_cases[] = {
+    {"ws://localhost:4455", "localhost", 4455, "/", false},
+    {"ws://127.0.0.1", "127.0.0.1", 80, "/", false},
+    {"wss://relay.example.com", "relay.example.com", 443, "/", true},
+    {"wss://relay.example.com:8443/obs/ws", "relay.example.com", 8443, "/obs/ws", true},
+    {"ws://[::1]:4455/ws?token=a:b", "::1", 4455, "/ws?token=a:b", false},
+    {"ws://[fe80::1%25eth0]", "fe80::1%25eth0", 80, "/", false},
+    {"ws://host?session=1", "host", 80, "/?session=1", false},
+    {"ws://host:65535/", "host", 65535, "/", false},
+
+    {"http://host", NULL},
+    {"ws:/host", NULL},
+    {"ws://", NULL},
+    {"ws://:4455", NULL},
+    {"ws://[]:4455", NULL},
+    {"ws://[::1", NULL},
+    {"ws://[::1]x", NULL},
+    {"ws://host:0", NULL},
+    {"ws://host:65536", NULL},
+    {"ws://host:", NULL},
+    {"ws://host:44a5", NULL},
+    {"ws://host:000004455", NULL},
+    {"ws://host name", NULL},
+    // lws would dial these as socket paths
+    {"ws://+/tmp/obs.sock", NULL},
+    {"wss://[+abc]:443", NULL},
+};
+
+static const url_case_t unix_cases[] = {
+    {"ws+unix:///run/obs/websocket.sock", "+/run/obs/websocket.sock", 0, "/", false},
+    {"ws+unix:///run/obs/websocket.sock:/ws", "+/run/obs/websocket.sock", 0, "/ws", false},
+    {"ws+unix:///run/obs/websocket.sock:/ws?a=1:2", "+/run/obs/websocket.sock", 0, "/ws?a=1:2", false},
+    {"ws+unix:///run/obs/websocket.sock:?a=1", "+/run/obs/websocket.sock", 0, "/?a=1", false},
+    {"ws+unix:///run/obs/websocket.sock:", "+/run/obs/websocket.sock", 0, "/", false},
+    {"ws+unix://relative/websocket.sock", "+relative/websocket.sock", 0, "/", false},
+    // Linux abstract namespace, passed through in the lws form
+    {"ws+unix://@obs-websocket:/ws", "+@obs-websocket", 0, "/ws", false},
+
+    {"ws+unix://", NULL},
+    {"ws+unix://:/ws", NULL},
+    {"ws+unix:///run/obs/websocket.sock:ws", NULL},
+    {"ws+unix:///run/a:b/websocket.sock", NULL},
+    {"wss+unix:///run/obs/websocket.sock", NULL},
+};
+
+static void check_case(const url_case_t &test, bool supported) {
+    char *host = NULL;
+    char *path = NULL;
+    uint16_t port = 0;
+    bool use_ssl = false;
+    bool parsed = parse_ws_url(test.url, &host, &port, &path, &use_ssl);
+
+    if (!test.host || !supported) {
+        if (parsed) fprintf(stderr, "Accepted %s\n", test.url);
+        WS_CHECK(!parsed && !host && !path);
+    } else if (!parsed) {
+        fprintf(stderr, "Rejected %s\n", test.url);
+        WS_CHECK(parsed);
+    } else {
+        if (strcmp(host, test.host) != 0 || port != test.port || strcmp(path, test.path) != 0 ||
+            use_ssl != test.use_ssl) {
+            fprintf(stderr, "%s parsed as host %s, port %u, path %s, TLS %d\n", test.url, host, port, path,
+                    use_ssl);
+        }
+        WS_CHECK(strcmp(host, test.host) == 0);
+        WS_CHECK(port == test.port);
+        WS_CHECK(strcmp(path, test.path) == 0);
+        WS_CHECK(use_ssl == test.use_ssl);
+        WS_CHECK(ws_host_is_unix(host) == (port == 0));
+    }
+
+    bfree(host);
+    bfree(path);
+}
+
+int main(void) {
+    ws_test_set_log_level(LOG_ERROR - 1);
+
+    for (const url_case_t &test: tcp_cases) {
+        check_case(test, true);
+    }
+
+    // Without socket support in lws every ws+unix:// address is rejected up front
+#if defined(LWS_WITH_UNIX_SOCK)
+    bool unix_supported = true;
+#else
+    bool unix_supported = false;
+#endif
+    for (const url_case_t &test: unix_cases) {
+        check_case(test, unix_supported);
+    }
+
+    WS_CHECK(!parse_ws_url(NULL, NULL, NULL, NULL, NULL));
+
+    printf("%zu URLs, %ld failed checks\n",
+           sizeof(tcp_cases) / sizeof(tcp_cases[0]) + sizeof(unix_cases) / sizeof(unix_cases[0]), ws_test_failures);
+    return ws_test_failures ? 1 : 0;
+}
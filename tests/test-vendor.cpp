@@ -0,0 +1,324 @@
+/*
+OBS WebSocket Relay - Vendor Request Test
+Copyright (C) 2025 BlueGlassBlock
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+// The relay's obs-websocket vendor against the lws mock, with obs-websocket's plugin API played
+// by the test: registration once obs-websocket is there and accepts the vendor, requests
+// dispatched to their handlers the way obs-websocket calls them, each answering from the relay
+// attached at the time or reporting it unavailable, and unregistration
+
+#include "ws-relay-internal.h"
+#include "mock-lws.h"
+#include "test-relay.h"
+#include "test-support.h"
+#include <obs-module.h>
+#include <plugin-support.h>
+#include <map>
+#include <string>
+#include <vector>
+
+// Layout of obs-websocket's vendor request callback, as obs-websocket-api.h declares it
+struct obs_websocket_request_callback {
+    void (*callback)(obs_data_t *request_data, obs_data_t *response_data, void *priv_data);
+    void *priv_data;
+};
+
+// obs-websocket's vendor registry. The relay only registers and unregisters from this thread
+static bool vendor_accept = true; // vendor_register hands out a vendor
+static std::vector<std::string> vendors_registered;
+static std::map<std::string, obs_websocket_request_callback *> vendor_requests;
+static std::vector<std::string> vendor_unregistered;
+static int vendor_handle; // What the vendor pointer points at
+
+static void vendor_register(void *data, calldata_t *cd) {
+    UNUSED_PARAMETER(data);
+    vendors_registered.push_back(calldata_string(cd, "name"));
+    calldata_set_ptr(cd, "vendor", vendor_accept ? &vendor_handle : NULL);
+}
+
+static void vendor_request_register(void *data, calldata_t *cd) {
+    UNUSED_PARAMETER(data);
+    const char *type = calldata_string(cd, "type");
+    bool success = calldata_ptr(cd, "vendor") == &vendor_handle && !vendor_requests.count(type);
+    if (success) {
+        vendor_requests[type] = (obs_websocket_request_callback *) calldata_ptr(cd, "callback");
+    }
+    calldata_set_bool(cd, "success", success);
+}
+
+static void vendor_request_unregister(void *data, calldata_t *cd) {
+    UNUSED_PARAMETER(data);
+    const char *type = calldata_string(cd, "type");
+    WS_CHECK(calldata_ptr(cd, "vendor") == &vendor_handle);
+    vendor_unregistered.push_back(type);
+    calldata_set_bool(cd, "success", vendor_requests.erase(type) != 0);
+}
+
+static void obs_get_api_ph(void *data, calldata_t *cd) {
+    calldata_set_ptr(cd, "ph", data);
+}
+
+// Call a registered request the way obs-websocket does; the caller releases the response
+static obs_data_t *vendor_request(const char *type, const char *request_json = "{}") {
+    obs_data_t *response = obs_data_create();
+    auto it = vendor_requests.find(type);
+    WS_CHECK(it != vendor_requests.end());
+    if (it == vendor_requests.end()) return response;
+
+    obs_data_t *request = obs_data_create_from_json(request_json);
+    it->second->callback(request, response, it->second->priv_data);
+    obs_data_release(request);
+    return response;
+}
+
+// The error a request answered with, empty if it succeeded
+static std::string vendor_error(const char *type, const char *request_json = "{}") {
+    obs_data_t *response = vendor_request(type, request_json);
+    std::string error = obs_data_get_string(response, "error");
+    obs_data_release(response);
+    return error;
+}
+
+static long long int_in(obs_data_t *data, const char *obj_key, const char *key) {
+    obs_data_t *obj = obs_data_get_obj(data, obj_key);
+    long long value = obj && obs_data_has_user_value(obj, key) ? obs_data_get_int(obj, key) : -1;
+    obs_data_release(obj);
+    return value;
+}
+
+static long long count_in(obs_data_t *data, const char *obj_key, const char *key) {
+    obs_data_t *obj = obs_data_get_obj(data, obj_key);
+    obs_data_array_t *array = obj ? obs_data_get_array(obj, key) : NULL;
+    long long count = array ? (long long) obs_data_array_count(array) : -1;
+    obs_data_array_release(array);
+    obs_data_release(obj);
+    return count;
+}
+
+// Publish statistics the way the relay's housekeeping does
+static void publish(ws_relay_t *relay) {
+    pthread_mutex_lock(&relay->mutex);
+    ws_relay_publish_status(relay);
+    pthread_mutex_unlock(&relay->mutex);
+}
+
+static ws_test_relay_t test_relay_create(void) {
+    ws_relay_config_t config;
+    ws_relay_config_init(&config);
+    config.ping_interval = 0;
+    ws_test_relay_t test = ws_test_relay_create(&config);
+    ws_relay_config_free(&config);
+    ws_relay_set_vendor_relay(test.relay);
+    return test;
+}
+
+static void test_relay_destroy(ws_test_relay_t *test) {
+    ws_relay_set_vendor_relay(NULL);
+    ws_test_relay_destroy(test);
+}
+
+static void test_register(proc_handler_t *global_ph) {
+    // Without obs-websocket nothing is registered, nor while it refuses the vendor
+    ws_test_set_proc_handler(NULL);
+    ws_relay_register_vendor();
+    ws_test_set_proc_handler(global_ph);
+    vendor_accept = false;
+    ws_relay_register_vendor();
+    WS_CHECK(vendors_registered.size() == 1 && vendor_requests.empty());
+
+    // Both are retried from the next call
+    vendor_accept = true;
+    ws_relay_register_vendor();
+    WS_CHECK(vendors_registered.size() == 2 && vendors_registered[1] == PLUGIN_NAME);
+    WS_CHECK(vendor_requests.size() == 5);
+    for (const char *type:
+         {"GetRelayStats", "GetRelayQueueDepth", "FlushRelayQueues", "SetRelayLogLevel", "GetStateSnapshot"}) {
+        WS_CHECK(vendor_requests.count(type) == 1);
+    }
+
+    // Registered once only
+    ws_relay_register_vendor();
+    WS_CHECK(vendors_registered.size() == 2);
+}
+
+static void test_unavailable(void) {
+    // Requests made before a relay is attached, or after it is detached, report it unavailable;
+    // invalid arguments are turned down before the relay is looked at
+    for (const char *type: {"GetRelayStats", "GetRelayQueueDepth", "FlushRelayQueues", "SetRelayLogLevel"}) {
+        WS_CHECK(vendor_error(type) == "The relay is not available");
+    }
+    WS_CHECK(vendor_error("GetStateSnapshot") ==
+             "The OBS state mirror is not enabled or is being refreshed, try again shortly");
+    WS_CHECK(vendor_error("FlushRelayQueues", "{\"direction\":\"sideways\"}") ==
+             "direction must be toRemote, toObs or both");
+    WS_CHECK(vendor_error("SetRelayLogLevel", "{\"logLevel\":\"loud\"}") == "logLevel must be verbose or normal");
+}
+
+static void test_stats(void) {
+    ws_test_relay_t test = test_relay_create();
+    ws_relay_t *relay = test.relay;
+
+    // Nothing to report until the relay publishes statistics
+    WS_CHECK(vendor_error("GetRelayStats") == "The relay has not published statistics yet");
+    WS_CHECK(vendor_error("GetRelayQueueDepth") == "The relay has not published statistics yet");
+
+    // Two events held back for the remote, and a request relayed to OBS
+    mock_lws_set_choked(test.remote, true);
+    WS_CHECK(ws_test_from_obs(&test, "{\"op\":5,\"d\":{\"eventType\":\"A\"}}") >= 0);
+    WS_CHECK(ws_test_from_obs(&test, "{\"op\":5,\"d\":{\"eventType\":\"B\"}}") >= 0);
+    WS_CHECK(ws_test_from_remote(&test, "{\"op\":6,\"d\":{\"requestType\":\"GetVersion\",\"requestId\":\"1\"}}") >= 0);
+    ws_test_to_obs(&test);
+    pthread_mutex_lock(&relay->mutex);
+    relay->stats.to_remote.clock_offset_us = -1234;
+    relay->stats.to_obs.rtt_histogram[2] = 7;
+    pthread_mutex_unlock(&relay->mutex);
+    publish(relay);
+
+    obs_data_t *response = vendor_request("GetRelayStats");
+    WS_CHECK(!obs_data_has_user_value(response, "error"));
+    WS_CHECK(obs_data_has_user_value(response, "snapshotAgeMs"));
+    WS_CHECK(std::string(obs_data_get_string(response, "obsState")) == "connected");
+    WS_CHECK(std::string(obs_data_get_string(response, "remoteState")) == "connected");
+    WS_CHECK(int_in(response, "toObs", "messages") == 1);
+    WS_CHECK(int_in(response, "toRemote", "queuedMessages") == 2);
+    WS_CHECK(int_in(response, "toRemote", "clockOffsetUs") == -1234);
+    WS_CHECK(count_in(response, "toRemote", "rttHistogram") == WS_RTT_HISTOGRAM_BUCKETS);
+    WS_CHECK(count_in(response, "toObs", "sizeHistogram") == WS_SIZE_HISTOGRAM_BUCKETS);
+    obs_data_t *to_obs = obs_data_get_obj(response, "toObs");
+    obs_data_array_t *rtt = to_obs ? obs_data_get_array(to_obs, "rttHistogram") : NULL;
+    obs_data_t *bucket = rtt ? obs_data_array_item(rtt, 2) : NULL;
+    WS_CHECK(bucket && obs_data_get_int(bucket, "count") == 7);
+    obs_data_release(bucket);
+    obs_data_array_release(rtt);
+    obs_data_release(to_obs);
+    obs_data_release(response);
+
+    response = vendor_request("GetRelayQueueDepth");
+    WS_CHECK(int_in(response, "toRemote", "queuedMessages") == 2);
+    WS_CHECK(int_in(response, "toRemote", "queuedBytes") > 0);
+    WS_CHECK(int_in(response, "toObs", "queuedMessages") == 0);
+    WS_CHECK(int_in(response, "toObs", "admissionWaiting") == 0);
+    obs_data_release(response);
+
+    test_relay_destroy(&test);
+}
+
+static void test_flush(void) {
+    ws_test_relay_t test = test_relay_create();
+
+    mock_lws_set_choked(test.obs, true);
+    mock_lws_set_choked(test.remote, true);
+    WS_CHECK(ws_test_from_obs(&test, "{\"op\":5,\"d\":{\"eventType\":\"A\"}}") >= 0);
+    WS_CHECK(ws_test_from_obs(&test, "{\"op\":7,\"d\":{\"requestId\":\"1\"}}") >= 0);
+    WS_CHECK(ws_test_from_obs(&test, "{\"op\":5,\"d\":{\"eventType\":\"B\"}}") >= 0);
+    WS_CHECK(ws_test_from_remote(&test, "{\"op\":6,\"d\":{\"requestId\":\"2\"}}") >= 0);
+    WS_CHECK(ws_test_from_remote(&test, "{\"op\":5,\"d\":{\"eventType\":\"D\"}}") >= 0);
+
+    // Only events go, and only in the direction asked for
+    obs_data_t *response = vendor_request("FlushRelayQueues", "{\"direction\":\"toObs\"}");
+    WS_CHECK(obs_data_get_int(response, "droppedMessages") == 1);
+    obs_data_release(response);
+    response = vendor_request("FlushRelayQueues", "{\"direction\":\"toRemote\"}");
+    WS_CHECK(obs_data_get_int(response, "droppedMessages") == 2);
+    obs_data_release(response);
+    mock_lws_set_choked(test.obs, false);
+    mock_lws_set_choked(test.remote, false);
+    WS_CHECK(ws_test_to_remote(&test) == std::vector<std::string>({"{\"op\":7,\"d\":{\"requestId\":\"1\"}}"}));
+    WS_CHECK(ws_test_to_obs(&test) == std::vector<std::string>({"{\"op\":6,\"d\":{\"requestId\":\"2\"}}"}));
+
+    // Both directions by default
+    mock_lws_set_choked(test.remote, true);
+    WS_CHECK(ws_test_from_obs(&test, "{\"op\":5,\"d\":{\"eventType\":\"C\"}}") >= 0);
+    response = vendor_request("FlushRelayQueues");
+    WS_CHECK(!obs_data_has_user_value(response, "error") && obs_data_get_int(response, "droppedMessages") == 1);
+    obs_data_release(response);
+    mock_lws_set_choked(test.remote, false);
+    WS_CHECK(ws_test_to_remote(&test).empty());
+
+    test_relay_destroy(&test);
+}
+
+static void test_log_level(void) {
+    ws_test_relay_t test = test_relay_create();
+    ws_relay_t *relay = test.relay;
+
+    auto log_level = [](const char *request_json) {
+        obs_data_t *response = vendor_request("SetRelayLogLevel", request_json);
+        std::string level = obs_data_get_string(response, "logLevel");
+        obs_data_release(response);
+        return level;
+    };
+
+    WS_CHECK(log_level("{\"logLevel\":\"verbose\"}") == "verbose" && relay->config.enable_logging);
+    WS_CHECK(log_level("{}") == "verbose" && relay->config.enable_logging);
+    WS_CHECK(vendor_error("SetRelayLogLevel", "{\"logLevel\":\"loud\"}") == "logLevel must be verbose or normal");
+    WS_CHECK(relay->config.enable_logging);
+    WS_CHECK(log_level("{\"logLevel\":\"normal\"}") == "normal" && !relay->config.enable_logging);
+
+    // The mirror is off, so there is no snapshot to give
+    WS_CHECK(vendor_error("GetStateSnapshot") ==
+             "The OBS state mirror is not enabled or is being refreshed, try again shortly");
+
+    test_relay_destroy(&test);
+}
+
+static void test_unregister(void) {
+    ws_test_relay_t test = test_relay_create();
+
+    // Every request goes, and the relay is detached from any still held on to
+    obs_websocket_request_callback *stats = vendor_requests["GetRelayStats"];
+    ws_relay_unregister_vendor();
+    WS_CHECK(vendor_requests.empty() && vendor_unregistered.size() == 5);
+    obs_data_t *response = obs_data_create();
+    stats->callback(NULL, response, stats->priv_data);
+    WS_CHECK(std::string(obs_data_get_string(response, "error")) == "The relay is not available");
+    obs_data_release(response);
+
+    // Once only
+    ws_relay_unregister_vendor();
+    WS_CHECK(vendor_unregistered.size() == 5);
+
+    ws_test_relay_destroy(&test);
+}
+
+int main(void) {
+    ws_test_set_log_level(LOG_ERROR - 1);
+
+    // obs-websocket's plugin API, found through OBS's global proc handler
+    proc_handler_t *global_ph = proc_handler_create();
+    proc_handler_t *api_ph = proc_handler_create();
+    proc_handler_add(global_ph, "void obs_websocket_api_get_ph(out ptr ph)", obs_get_api_ph, api_ph);
+    proc_handler_add(api_ph, "void vendor_register(in string name, out ptr vendor)", vendor_register, NULL);
+    proc_handler_add(api_ph, "bool vendor_request_register(in ptr vendor, in string type, in ptr callback, out bool success)",
+                     vendor_request_register, NULL);
+    proc_handler_add(api_ph, "bool vendor_request_unregister(in ptr vendor, in string type, out bool success)",
+                     vendor_request_unregister, NULL);
+
+    test_register(global_ph);
+    test_unavailable();
+    test_stats();
+    test_flush();
+    test_log_level();
+    test_unregister();
+
+    ws_test_set_proc_handler(NULL);
+    proc_handler_destroy(api_ph);
+    proc_handler_destroy(global_ph);
+
+    printf("%ld failed checks\n", ws_test_failures);
+    return ws_test_failures ? 1 : 0;
+}
@@ -0,0 +1,290 @@
+#!/usr/bin/env python3
+"""Reference demultiplexer for the relay's multiplexed remote connection.
+
+Accepts relay connections and exposes every channel as its own WebSocket endpoint, so an
+obs-websocket controller can be pointed at ws://<host>:<client-port>/<channel> for local testing.
+It also answers the relay's clock exchange, stamps what controllers send and reports how long
+stamped messages from the relay took to reach the controller. --delay-ms and --clock-skew-ms
+simulate a network and a remote clock, to check the latency figures against known values.
+Requires the `websockets` package, version 13 or later.
+"""
+
+import argparse
+import asyncio
+import logging
+import struct
+import time
+
+from websockets.asyncio.server import serve
+
+VERSION = 1
+DATA, OPEN, WINDOW, CLOSE, CLOCK = 0, 1, 2, 3, 4
+CLOCK_REQUEST, CLOCK_RESPONSE, CLOCK_OFFSET = 0, 1, 2
+
+# version, frame type, channel, value
+HEADER = struct.Struct("!BBHI")
+# Clock exchange payloads, microseconds
+U64 = struct.Struct("!Q")
+OFFSET = struct.Struct("!qQ")
+
+channels = {}
+options = None
+
+
+def clock_us():
+    """This side's monotonic clock in microseconds, shifted by --clock-skew-ms."""
+    return time.monotonic_ns() // 1000 + options.clock_skew_ms * 1000
+
+
+def stamp_elapsed_us(now, stamp):
+    """Microseconds from a 32 bit stamp to now, both on the same clock, modulo 2^32."""
+    elapsed = (now - stamp) & 0xFFFFFFFF
+    return elapsed - (1 << 32) if elapsed >= 1 << 31 else elapsed
+
+
+def percentile(values, fraction):
+    return values[min(len(values) - 1, int(len(values) * fraction))]
+
+
+class Link:
+    """The connection to one relay, with --delay-ms added in each direction."""
+
+    def __init__(self, ws):
+        self.ws = ws
+        self.outbox = asyncio.Queue()
+        self.sender = asyncio.create_task(self.send_delayed()) if options.delay_ms else None
+
+    async def send(self, frame):
+        if self.sender:
+            self.outbox.put_nowait((time.monotonic() + options.delay_ms / 1000, frame))
+        else:
+            await self.ws.send(frame)
+
+    async def send_delayed(self):
+        while True:
+            due, frame = await self.outbox.get()
+            await asyncio.sleep(max(0.0, due - time.monotonic()))
+            await self.ws.send(frame)
+
+    async def frames(self):
+        """Frames from the relay, each released --delay-ms after it arrived."""
+        if not options.delay_ms:
+            async for frame in self.ws:
+                yield frame
+            return
+
+        inbox = asyncio.Queue()
+
+        async def receive():
+            try:
+                async for frame in self.ws:
+                    inbox.put_nowait((time.monotonic() + options.delay_ms / 1000, frame))
+            finally:
+                inbox.put_nowait((0, None))
+
+        receiver = asyncio.create_task(receive())
+        try:
+            while True:
+                due, frame = await inbox.get()
+                if frame is None:
+                    return
+                await asyncio.sleep(max(0.0, due - time.monotonic()))
+                yield frame
+        finally:
+            receiver.cancel()
+
+    def close(self):
+        if self.sender:
+            self.sender.cancel()
+
+
+class Channel:
+    def __init__(self, relay, channel_id, window):
+        self.relay = relay
+        self.id = channel_id
+        self.window = window  # 0 means no flow control
+        self.send_credit = window  # Bytes the relay still accepts from us
+        self.credit_available = asyncio.Event()
+        self.inbox = asyncio.Queue()  # Messages from the relay waiting for the controller, with their stamps
+        self.delivered = 0  # Bytes delivered since our last WINDOW grant
+        self.controller = None
+        self.stamping = False  # The relay runs the clock exchange, so our messages get stamped too
+        self.offset_us = None  # Our clock minus the relay's, as announced by the relay
+        self.clock_rtt_us = None
+        self.latencies_us = []  # Relay to controller latencies since the last report
+
+    async def send_frame(self, frame_type, value=0, payload=b""):
+        await self.relay.send(HEADER.pack(VERSION, frame_type, self.id, value) + payload)
+
+    async def to_relay(self, payload):
+        if self.window:
+            # Same rule as the relay: send while any credit is left
+            while self.send_credit <= 0:
+                self.credit_available.clear()
+                await self.credit_available.wait()
+            self.send_credit -= len(payload)
+        stamp = (clock_us() & 0xFFFFFFFF or 1) if self.stamping else 0
+        await self.send_frame(DATA, stamp, payload)
+
+    def grant(self, value):
+        self.send_credit += value
+        self.credit_available.set()
+
+    async def on_clock(self, value, payload, received_us):
+        self.stamping = True
+        if value == CLOCK_REQUEST and len(payload) >= U64.size:
+            (t1,) = U64.unpack_from(payload)
+            await self.send_frame(CLOCK, CLOCK_RESPONSE, U64.pack(t1) + U64.pack(received_us) + U64.pack(clock_us()))
+        elif value == CLOCK_OFFSET and len(payload) >= OFFSET.size:
+            self.offset_us, self.clock_rtt_us = OFFSET.unpack_from(payload)
+
+    def delivered_stamp(self, stamp):
+        if not stamp or self.offset_us is None:
+            return
+        # Our clock now, on the relay's clock
+        self.latencies_us.append(max(0, stamp_elapsed_us(clock_us() - self.offset_us, stamp)))
+
+    async def delivered_to_controller(self, size):
+        if not self.window:
+            return
+        self.delivered += size
+        if self.delivered >= self.window // 2:
+            await self.send_frame(WINDOW, self.delivered)
+            self.delivered = 0
+
+    def report(self):
+        if self.offset_us is None:
+            return
+        line = "channel %d: clock offset %+.3f ms (round trip %.3f ms)" % (
+            self.id, self.offset_us / 1000, self.clock_rtt_us / 1000)
+        if self.latencies_us:
+            values = sorted(self.latencies_us)
+            line += ", relay to controller over %d messages: p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, max %.3f ms" % (
+                len(values), percentile(values, 0.5) / 1000, percentile(values, 0.9) / 1000,
+                percentile(values, 0.99) / 1000, values[-1] / 1000)
+            self.latencies_us.clear()
+        logging.info("%s", line)
+
+
+async def handle_relay(ws):
+    logging.info("relay connected from %s", ws.remote_address)
+    link = Link(ws)
+    try:
+        async for frame in link.frames():
+            received_us = clock_us()
+            if isinstance(frame, str) or len(frame) < HEADER.size:
+                logging.warning("relay sent a frame without multiplexing header")
+                continue
+
+            version, frame_type, channel_id, value = HEADER.unpack_from(frame)
+            if version != VERSION:
+                logging.warning("unsupported multiplexing version %d", version)
+                continue
+
+            if frame_type == OPEN:
+                old = channels.get(channel_id)
+                if old and old.controller:
+                    await old.controller.close(1001, "channel reopened")
+                channels[channel_id] = Channel(link, channel_id, value)
+                logging.info("channel %d opened (window %d bytes)", channel_id, value)
+                continue
+
+            channel = channels.get(channel_id)
+            if channel is None or channel.relay is not link:
+                logging.warning("frame for channel %d, which this relay has not opened", channel_id)
+            elif frame_type == DATA:
+                channel.inbox.put_nowait((frame[HEADER.size:], value))
+            elif frame_type == WINDOW:
+                channel.grant(value)
+            elif frame_type == CLOSE:
+                del channels[channel_id]
+                if channel.controller:
+                    await channel.controller.close(1001, "channel closed")
+            elif frame_type == CLOCK:
+                await channel.on_clock(value, frame[HEADER.size:], received_us)
+    finally:
+        link.close()
+        for channel_id, channel in list(channels.items()):
+            if channel.relay is link:
+                del channels[channel_id]
+                if channel.controller:
+                    await channel.controller.close(1001, "relay disconnected")
+        logging.info("relay %s disconnected", ws.remote_address)
+
+
+async def handle_controller(ws):
+    try:
+        channel_id = int(ws.request.path.strip("/"))
+    except ValueError:
+        await ws.close(1008, "expected /<channel>")
+        return
+
+    channel = channels.get(channel_id)
+    if channel is None:
+        await ws.close(1008, "channel is not open")
+        return
+    if channel.controller:
+        await ws.close(1008, "channel already has a controller")
+        return
+
+    channel.controller = ws
+    logging.info("controller attached to channel %d", channel_id)
+
+    async def pump():
+        while True:
+            payload, stamp = await channel.inbox.get()
+            await ws.send(payload.decode("utf-8"))
+            channel.delivered_stamp(stamp)
+            await channel.delivered_to_controller(len(payload))
+
+    pump_task = asyncio.create_task(pump())
+    try:
+        async for message in ws:
+            await channel.to_relay(message.encode("utf-8") if isinstance(message, str) else message)
+    finally:
+        pump_task.cancel()
+        channel.controller = None
+        logging.info("controller detached from channel %d", channel_id)
+
+        # The relay answers with a fresh OPEN and session for the next controller
+        if channels.get(channel_id) is channel:
+            del channels[channel_id]
+            try:
+                await channel.send_frame(CLOSE)
+            except Exception:
+                pass
+
+
+async def report_latency():
+    while True:
+        await asyncio.sleep(options.report_interval)
+        for channel in list(channels.values()):
+            channel.report()
+
+
+async def main():
+    global options
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--relay-port", type=int, default=8765, help="port the relays connect to")
+    parser.add_argument("--client-port", type=int, default=4456, help="port controllers connect to")
+    parser.add_argument("--delay-ms", type=float, default=0, help="simulated network delay in each direction")
+    parser.add_argument("--clock-skew-ms", type=int, default=0, help="offset added to this server's clock")
+    parser.add_argument("--report-interval", type=float, default=10, help="seconds between latency reports")
+    options = parser.parse_args()
+
+    logging.basicConfig(level=logging.INFO, format="%(asctime)s %(message)s")
+
+    async with serve(handle_relay, options.host, options.relay_port, subprotocols=["websocket"], max_size=None), \
+            serve(handle_controller, options.host, options.client_port, max_size=None):
+        logging.info("relays: ws://%s:%d, controllers: ws://%s:%d/<channel>", options.host, options.relay_port,
+                     options.host, options.client_port)
+        reporter = asyncio.create_task(report_latency())
+        try:
+            await asyncio.Future()
+        finally:
+            reporter.cancel()
+
+
+if __name__ == "__main__":
+    asyncio.run(main())